@@ -1,24 +1,24 @@
 #include "AST.h"
 
+#include <unordered_set>
+
 Stmt::Stmt(NodeType kind) { this->kind = kind; }
 Expr::Expr(NodeType kind) : Stmt(kind) {}
 
 Program::Program() : Stmt(NodeType::Program) {}
 
-VarDeclaration::VarDeclaration(bool isConst, const std::string &id,
-                               std::unique_ptr<Expr> val)
+VarDeclaration::VarDeclaration(bool isConst, Symbol id, Expr *val)
     : Stmt(NodeType::VarDeclaration), constant(isConst), identifier(id),
-      value(std::move(val)) {}
+      value(val) {}
 
-BinaryExpr::BinaryExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right,
-                       const std::string &op)
-    : Expr(NodeType::BinaryExpr), left(std::move(left)),
-      right(std::move(right)), binaryOperator(op) {}
+BinaryExpr::BinaryExpr(Expr *left, Expr *right, Operator op)
+    : Expr(NodeType::BinaryExpr), left(left), right(right),
+      binaryOperator(op) {}
 
-UnaryExpr::UnaryExpr(std::unique_ptr<Expr> right, const std::string &op)
-    : Expr(NodeType::UnaryExpr), right(std::move(right)), op(op) {}
+UnaryExpr::UnaryExpr(Expr *right, Operator op)
+    : Expr(NodeType::UnaryExpr), right(right), op(op) {}
 
-IdentifierExpr::IdentifierExpr(const std::string &symbol)
+IdentifierExpr::IdentifierExpr(Symbol symbol)
     : Expr(NodeType::Identifier), symbol(symbol) {}
 
 NumericLiteral::NumericLiteral(double value)
@@ -27,57 +27,97 @@ NumericLiteral::NumericLiteral(double value)
 FloatLiteral::FloatLiteral(double value)
     : Expr(NodeType::NumericLiteral), value(value) {}
 
-StrLiteral::StrLiteral(std::string value)
+StrLiteral::StrLiteral(std::string_view value)
     : Expr(NodeType::StrLiteral), value(value) {}
 
-NullLiteral::NullLiteral(const std::string &value)
-    : Expr(NodeType::Null), value(value) {}
-
-AssignmentExpr::AssignmentExpr(std::unique_ptr<Expr> assigne,
-                               std::unique_ptr<Expr> val)
-    : Expr(NodeType::AssignmentExpr), assigne(std::move(assigne)),
-      value(std::move(val)) {}
-
-CallExpr::CallExpr(std::unique_ptr<Expr> caller,
-                   std::vector<std::unique_ptr<Expr>> args)
-    : Expr(NodeType::CallExpr), caller(std::move(caller)),
-      args(std::move(args)) {}
-
-MemberAccessExpr::MemberAccessExpr(std::unique_ptr<Expr> obj,
-                                   const std::string &member)
-    : Expr(NodeType::MemberAccessExpr), object(std::move(obj)),
-      memberName(member) {}
-
-FunctionDeclaration::FunctionDeclaration(
-    std::vector<std::string> param, std::string n, std::vector<Stmt *> b,
-    std::unique_ptr<ReturnStatement> retStmt)
-    : Stmt(NodeType::FunctionDeclaration), parameters(param), name(n), body(b),
-      returnStatement(std::move(retStmt)) {}
-
-FunctionDeclaration::~FunctionDeclaration() {
-  for (auto &stmt : body) {
-    delete stmt;
+NullLiteral::NullLiteral() : Expr(NodeType::Null) {}
+
+AssignmentExpr::AssignmentExpr(Expr *assigne, Expr *val)
+    : Expr(NodeType::AssignmentExpr), assigne(assigne), value(val) {}
+
+CallExpr::CallExpr(Expr *caller, NodeList<Expr> args)
+    : Expr(NodeType::CallExpr), caller(caller), args(args) {}
+
+MemberAccessExpr::MemberAccessExpr(Expr *obj, Symbol member)
+    : Expr(NodeType::MemberAccessExpr), object(obj), memberName(member) {}
+
+FunctionDeclaration::FunctionDeclaration(ArenaArray<Symbol> param, Symbol n,
+                                         NodeList<Stmt> b)
+    : Stmt(NodeType::FunctionDeclaration), parameters(param), name(n),
+      body(b) {}
+
+IfStatement::IfStatement(Expr *cond, NodeList<Stmt> ifB, NodeList<Stmt> elseB)
+    : Stmt(NodeType::IfStatement), condition(cond), ifBody(ifB),
+      elseBody(elseB) {}
+
+WhileLoop::WhileLoop(Expr *cond, NodeList<Stmt> bd)
+    : Stmt(NodeType::WhileLoop), condition(cond), loopBody(bd) {}
+
+ReturnStatement::ReturnStatement(Stmt *value)
+    : Stmt(NodeType::ReturnStatement), returnValue(value) {}
+
+StructDeclaration::StructDeclaration(Symbol name, NodeList<Stmt> body)
+    : Stmt(NodeType::StructDeclaration), structName(name), structBody(body) {}
+
+LogicalExpr::LogicalExpr(Expr *left, Expr *right, Operator logicalOperator)
+        : Expr(NodeType::LogicalExpr), left(left), right(right), logicalOperator(logicalOperator) {}
+
+const char *OperatorToString(Operator op) {
+  switch (op) {
+  case Operator::Add:
+    return "+";
+  case Operator::Subtract:
+  case Operator::Negate:
+    return "-";
+  case Operator::Multiply:
+    return "*";
+  case Operator::Divide:
+    return "/";
+  case Operator::Modulo:
+    return "%";
+  case Operator::Less:
+    return "<";
+  case Operator::LessEqual:
+    return "<=";
+  case Operator::Greater:
+    return ">";
+  case Operator::GreaterEqual:
+    return ">=";
+  case Operator::Equal:
+    return "==";
+  case Operator::NotEqual:
+    return "!=";
+  case Operator::And:
+    return "&&";
+  case Operator::Or:
+    return "||";
+  case Operator::Not:
+    return "!";
   }
+  return "?";
 }
 
-IfStatement::IfStatement(std::unique_ptr<Expr> cond,
-                         std::vector<std::unique_ptr<Stmt>> ifB,
-                         std::vector<std::unique_ptr<Stmt>> elseB)
-    : Stmt(NodeType::IfStatement), condition(std::move(cond)),
-      ifBody(std::move(ifB)), elseBody(std::move(elseB)) {}
-
-WhileLoop::WhileLoop(std::unique_ptr<Expr> cond,
-                     std::vector<std::unique_ptr<Stmt>> bd)
-    : Stmt(NodeType::WhileLoop), condition(std::move(cond)),
-      loopBody(std::move(bd)) {}
-
-ReturnStatement::ReturnStatement(std::unique_ptr<Stmt> value)
-    : Stmt(NodeType::ReturnStatement), returnValue(std::move(value)) {}
+bool isBuiltinName(Symbol name) {
+  static const std::unordered_set<Symbol> names = [] {
+    std::unordered_set<Symbol> symbols;
+    for (const char *builtin :
+         {"true", "false", "null", "print", "exit", "clear", "sqrt", "pow",
+          "round", "min", "max", "input", "num", "len", "floor", "type",
+          "concat", "sin", "cos", "tan", "log", "ceil"}) {
+      symbols.insert(SymbolTable::intern(builtin));
+    }
+    return symbols;
+  }();
+  return names.count(name) != 0;
+}
 
-StructDeclaration::StructDeclaration(const std::string &name,
-                                     std::vector<std::unique_ptr<Stmt>> body)
-    : Stmt(NodeType::StructDeclaration), structName(name),
-      structBody(std::move(body)) {}
+const std::vector<MathBuiltin> MATH_BUILTINS = {
+    {"sqrt", 1}, {"pow", 2}, {"round", 1}, {"floor", 1},
+    {"ceil", 1}, {"sin", 1}, {"cos", 1},   {"tan", 1},
+    {"log", 1},  {"min", -1}, {"max", -1},
+};
 
-LogicalExpr::LogicalExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, const std::string& logicalOperator)
-        : Expr(NodeType::LogicalExpr), left(std::move(left)), right(std::move(right)), logicalOperator(logicalOperator) {}
+const std::vector<const char *> PURE_BUILTINS = {
+    "sqrt", "pow", "round", "floor", "ceil", "sin",    "cos", "tan",
+    "log",  "min", "max",   "num",   "len",  "type",   "concat",
+};
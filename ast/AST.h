@@ -1,6 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include "../lexer/SymbolTable.h"
+#include "AstArena.h"
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -29,6 +32,31 @@ enum class NodeType {
   LogicalExpr,
 };
 
+// Operators are resolved by the parser, evaluation never compares strings.
+enum class Operator : uint8_t {
+  Add,          // +
+  Subtract,     // -
+  Multiply,     // *
+  Divide,       // /
+  Modulo,       // %
+  Less,         // <
+  LessEqual,    // <=
+  Greater,      // >
+  GreaterEqual, // >=
+  Equal,        // ==
+  NotEqual,     // !=
+  And,          // &&
+  Or,           // ||
+  Not,          // !
+  Negate,       // unary -
+};
+
+// Every node is allocated in the AstArena of its Program and refers to its
+// children with plain pointers into the same arena; nodes are never deleted
+// one by one. See AstArena for what node members may hold.
+//
+// The slot members are filled in by resolveProgram (ResolverAST.h) and stay
+// -1 for a name that is looked up by name at run time.
 class Node {
 public:
   NodeType kind;
@@ -42,78 +70,101 @@ public:
 
 class Expr : public Stmt {
 public:
+  // The expression always evaluates to a number, proven by inferTypes
+  // (TypesAST.h).
+  bool numeric = false;
   Expr(NodeType kind);
   virtual ~Expr() = default;
 };
 
 class Program : public Stmt {
 public:
-  std::vector<std::unique_ptr<Stmt>> body;
+  AstArena arena;
+  NodeList<Stmt> body;
+  // Name of every slot of the global environment, empty when globals are
+  // looked up by name.
+  ArenaArray<Symbol> slotNames;
   Program();
 };
 
 class AssignmentExpr : public Expr {
 public:
-  std::unique_ptr<Expr> assigne;
-  std::unique_ptr<Expr> value;
-  AssignmentExpr(std::unique_ptr<Expr> assigne, std::unique_ptr<Expr> value);
+  Expr *assigne;
+  Expr *value;
+  AssignmentExpr(Expr *assigne, Expr *value);
 };
 
 class VarDeclaration : public Stmt {
 public:
   bool constant;
-  std::string identifier;
-  std::unique_ptr<Expr> value;
-  VarDeclaration(bool isConst, const std::string &id,
-                 std::unique_ptr<Expr> val = nullptr);
+  Symbol identifier;
+  Expr *value;
+  int32_t slot = -1;
+  VarDeclaration(bool isConst, Symbol id, Expr *val = nullptr);
 };
 
 class ReturnStatement : public Stmt {
 public:
-  std::unique_ptr<Stmt> returnValue;
-  ReturnStatement(std::unique_ptr<Stmt> value);
+  Stmt *returnValue;
+  ReturnStatement(Stmt *value);
 };
 
 class FunctionDeclaration : public Stmt {
 public:
-  std::vector<std::string> parameters;
-  std::string name;
-  std::vector<Stmt *> body;
-  std::unique_ptr<ReturnStatement> returnStatement;
-  FunctionDeclaration(std::vector<std::string> param, std::string n,
-                      std::vector<Stmt *> b,
-                      std::unique_ptr<ReturnStatement> retStmt = nullptr);
-  ~FunctionDeclaration();
+  ArenaArray<Symbol> parameters;
+  Symbol name;
+  NodeList<Stmt> body;
+  int32_t slot = -1;
+  // Name of every slot of the environment of a call, parameters first.
+  ArenaArray<Symbol> slotNames;
+  // Whether calls may be answered from earlier ones with the same arguments,
+  // set under --memoize (see ast/PurityAST.h).
+  bool memoizable = false;
+  FunctionDeclaration(ArenaArray<Symbol> param, Symbol n, NodeList<Stmt> b);
+};
+
+// What the evaluator has seen a binary expression compute. A node that only
+// saw two numbers rewrites itself into the Numbers version, which skips the
+// checks for other values as long as its operands stay numbers. When they do
+// not, the node goes back to Generic for good (see
+// Interpreter::eval_binary_expr).
+enum class Specialization : uint8_t {
+  Uninitialized,
+  Numbers,
+  Generic,
 };
 
 class BinaryExpr : public Expr {
 public:
-  std::unique_ptr<Expr> left;
-  std::unique_ptr<Expr> right;
-  std::string binaryOperator;
-  BinaryExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right,
-             const std::string &op);
+  Expr *left;
+  Expr *right;
+  Operator binaryOperator;
+  Specialization specialization = Specialization::Uninitialized;
+  BinaryExpr(Expr *left, Expr *right, Operator op);
 };
 
 class UnaryExpr : public Expr {
 public:
-  std::unique_ptr<Expr> right;
-  std::string op;
-  UnaryExpr(std::unique_ptr<Expr> right, const std::string &op);
+  Expr *right;
+  Operator op;
+  UnaryExpr(Expr *right, Operator op);
 };
 
 class CallExpr : public Expr {
 public:
-  std::unique_ptr<Expr> caller;
-  std::vector<std::unique_ptr<Expr>> args;
-  CallExpr(std::unique_ptr<Expr> caller,
-           std::vector<std::unique_ptr<Expr>> args);
+  Expr *caller;
+  NodeList<Expr> args;
+  // The call of a return that may run in the frame of the function it
+  // returns from, set by the resolver (see ast/ResolverAST.h).
+  bool tailCall = false;
+  CallExpr(Expr *caller, NodeList<Expr> args);
 };
 
 class IdentifierExpr : public Expr {
 public:
-  std::string symbol;
-  IdentifierExpr(const std::string &symbol);
+  Symbol symbol;
+  int32_t slot = -1;
+  IdentifierExpr(Symbol symbol);
 };
 
 class NumericLiteral : public Expr {
@@ -124,8 +175,8 @@ public:
 
 class StrLiteral : public Expr {
 public:
-  std::string value;
-  StrLiteral(std::string value);
+  std::string_view value; // copied into the arena
+  StrLiteral(std::string_view value);
 };
 
 class FloatLiteral : public Expr {
@@ -136,53 +187,98 @@ public:
 
 class NullLiteral : public Expr {
 public:
-  std::string value;
-  NullLiteral(const std::string &value);
+  NullLiteral();
 };
 
 class IfStatement : public Stmt {
 public:
-  std::unique_ptr<Expr> condition;
-  std::vector<std::unique_ptr<Stmt>> ifBody;
-  std::vector<std::unique_ptr<Stmt>> elseBody;
-  IfStatement(std::unique_ptr<Expr> cond,
-              std::vector<std::unique_ptr<Stmt>> ifB,
-              std::vector<std::unique_ptr<Stmt>> elseB = {});
+  Expr *condition;
+  NodeList<Stmt> ifBody;
+  NodeList<Stmt> elseBody;
+  IfStatement(Expr *cond, NodeList<Stmt> ifB,
+              NodeList<Stmt> elseB = NodeList<Stmt>());
+};
+
+// A loop `while (i < bound) { ...; i = i + step; }` over a variable with a
+// slot, found by markCountedLoops (ast/InductionAST.h). The evaluator keeps
+// the counter in a double while running it.
+struct CountedLoop {
+  int32_t slot;
+  // Less, LessEqual, Greater, GreaterEqual or NotEqual.
+  Operator comparison;
+  // A NumericLiteral, or an IdentifierExpr the loop does not change.
+  Expr *bound;
+  double step;
+  // Whether anything but the increment may read the counter, which then is
+  // written to its slot before every iteration instead of after the loop.
+  bool counterRead;
 };
 
 class WhileLoop : public Stmt {
 public:
-  std::unique_ptr<Expr> condition;
-  std::vector<std::unique_ptr<Stmt>> loopBody;
-  WhileLoop(std::unique_ptr<Expr> cond, std::vector<std::unique_ptr<Stmt>> bd);
+  Expr *condition;
+  NodeList<Stmt> loopBody;
+  CountedLoop *counted = nullptr;
+  WhileLoop(Expr *cond, NodeList<Stmt> bd);
 };
 
 class StructDeclaration : public Stmt {
 public:
-  std::string structName;
-  std::vector<std::unique_ptr<Stmt>> structBody;
-  StructDeclaration(const std::string &name,
-                    std::vector<std::unique_ptr<Stmt>> body);
+  Symbol structName;
+  NodeList<Stmt> structBody;
+  int32_t slot = -1;
+  StructDeclaration(Symbol name, NodeList<Stmt> body);
+};
+
+class StructShape;
+
+// Shape of the last struct a field access saw and the slot of the field in
+// it. Structs of another shape are looked up again (see StructVal).
+struct FieldCache {
+  const StructShape *shape = nullptr;
+  uint32_t slot = 0;
 };
 
 class MemberAccessExpr : public Expr {
 public:
-  std::unique_ptr<Expr> object;
-  std::string memberName;
-  MemberAccessExpr(std::unique_ptr<Expr> obj, const std::string &member);
+  Expr *object;
+  Symbol memberName;
+  FieldCache cache;
+  MemberAccessExpr(Expr *obj, Symbol member);
 };
 
 class LogicalExpr : public Expr {
 public:
-    std::unique_ptr<Expr> left;
-    std::unique_ptr<Expr> right;
-    std::string logicalOperator;
+    Expr *left;
+    Expr *right;
+    Operator logicalOperator;
 
-    LogicalExpr(std::unique_ptr<Expr> left, std::unique_ptr<Expr> right, const std::string& logicalOperator);
+    LogicalExpr(Expr *left, Expr *right, Operator logicalOperator);
 };
 
 std::string NodeTypeToString(NodeType type);
 
+const char *OperatorToString(Operator op);
+
+// Whether name is held by the builtin scope of the evaluator (true, false,
+// null and the native functions), which nothing may declare or assign.
+// Calling one runs no code of the script.
+bool isBuiltinName(Symbol name);
+
+// Builtins whose result only depends on their numeric arguments and that
+// cannot fail on numbers. The ones with an argument count take exactly that
+// many, the others at least one.
+struct MathBuiltin {
+  const char *name;
+  int arguments;
+};
+
+extern const std::vector<MathBuiltin> MATH_BUILTINS;
+
+// Builtin functions whose result only depends on their arguments, so calling
+// one again with the same arguments gives the same value.
+extern const std::vector<const char *> PURE_BUILTINS;
+
 void printProgram(std::unique_ptr<Program> program, const std::string &indent);
 
 void printStatement(const Stmt &stmt, const std::string &indent);
@@ -0,0 +1,41 @@
+#include "AstArena.h"
+
+#include <cstring>
+
+AstArena::AstArena() : cursor(nullptr), limit(nullptr) {}
+
+void *AstArena::allocate(size_t size, size_t alignment) {
+  uintptr_t address = reinterpret_cast<uintptr_t>(cursor);
+  uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+
+  if (cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+    addBlock(size + alignment);
+    address = reinterpret_cast<uintptr_t>(cursor);
+    aligned = (address + alignment - 1) & ~(alignment - 1);
+  }
+
+  cursor = reinterpret_cast<char *>(aligned + size);
+  return reinterpret_cast<void *>(aligned);
+}
+
+void AstArena::addBlock(size_t minimumSize) {
+  size_t size = minimumSize > BLOCK_SIZE ? minimumSize : BLOCK_SIZE;
+  blocks.push_back(std::make_unique<char[]>(size));
+  cursor = blocks.back().get();
+  limit = cursor + size;
+}
+
+std::string_view AstArena::copyString(std::string_view text) {
+  if (text.empty()) {
+    return std::string_view();
+  }
+  char *memory = static_cast<char *>(allocate(text.size(), 1));
+  std::memcpy(memory, text.data(), text.size());
+  return std::string_view(memory, text.size());
+}
+
+void AstArena::reset() {
+  blocks.clear();
+  cursor = nullptr;
+  limit = nullptr;
+}
@@ -0,0 +1,78 @@
+#ifndef AST_ARENA_H
+#define AST_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Fixed size array living in an AstArena. It is only a view, the arena owns
+// the elements.
+template <typename T> class ArenaArray {
+public:
+  ArenaArray() : items(nullptr), count(0) {}
+  ArenaArray(T *items, uint32_t count) : items(items), count(count) {}
+
+  T *begin() const { return items; }
+  T *end() const { return items + count; }
+  uint32_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  T &operator[](size_t index) const { return items[index]; }
+  T &back() const { return items[count - 1]; }
+
+private:
+  T *items;
+  uint32_t count;
+};
+
+// Children of a node: pointers to other nodes of the same arena.
+template <typename T> using NodeList = ArenaArray<T *>;
+
+// Bump allocator that owns every node, child list and string literal of one
+// Program. Nodes are laid out next to each other in large blocks and are
+// never freed one by one, releasing the whole tree is a single reset().
+//
+// Destructors are not run, so everything allocated here must not own other
+// memory (no std::string, std::vector or unique_ptr members).
+class AstArena {
+public:
+  AstArena();
+  AstArena(const AstArena &) = delete;
+  AstArena &operator=(const AstArena &) = delete;
+
+  template <typename T, typename... Args> T *make(Args &&...args) {
+    void *memory = allocate(sizeof(T), alignof(T));
+    return new (memory) T(std::forward<Args>(args)...);
+  }
+
+  // Value initialized array of count elements.
+  template <typename T> ArenaArray<T> makeArray(size_t count) {
+    if (count == 0) {
+      return ArenaArray<T>();
+    }
+    T *memory = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    for (size_t i = 0; i < count; i++) {
+      new (memory + i) T();
+    }
+    return ArenaArray<T>(memory, static_cast<uint32_t>(count));
+  }
+
+  std::string_view copyString(std::string_view text);
+
+  void reset();
+
+private:
+  static const size_t BLOCK_SIZE = 64 * 1024;
+
+  void *allocate(size_t size, size_t alignment);
+  void addBlock(size_t minimumSize);
+
+  std::vector<std::unique_ptr<char[]>> blocks;
+  char *cursor;
+  char *limit;
+};
+
+#endif
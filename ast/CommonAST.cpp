@@ -0,0 +1,597 @@
+#include "CommonAST.h"
+#include "NamesAST.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+CommonStats totals;
+
+class Eliminator {
+public:
+  explicit Eliminator(Program &program) : arena(program.arena) {}
+
+  void eliminate(Program &program) {
+    programNames = collectProgramNames(program.body);
+    for (const char *builtin : PURE_BUILTINS) {
+      Symbol name = SymbolTable::intern(builtin);
+      if (programNames.isBuiltin(name)) {
+        pureBuiltins.insert(name);
+      }
+    }
+
+    Table available;
+    eliminateBody(program.body, available, nullptr);
+  }
+
+private:
+  // Where the variable of an expression is declared, before a statement of a
+  // body.
+  struct Site {
+    NodeList<Stmt> *body;
+    Stmt *before;
+  };
+
+  // An expression evaluated before.
+  struct Occurrence {
+    // Where it was, assigned to the variable once another occurrence reads
+    // it.
+    Expr **first;
+    Site site;
+    bool named = false;
+    Symbol variable = 0;
+    // What it reads.
+    std::vector<Symbol> names;
+    std::vector<Symbol> fields;
+  };
+
+  // The expressions that may be read from their variable, by their key.
+  typedef std::unordered_map<std::string, Occurrence *> Table;
+
+  // What running some statements may change.
+  struct Effects {
+    // Names they declare or assign.
+    std::unordered_set<Symbol> changed;
+    // Fields they assign.
+    std::unordered_set<Symbol> fields;
+    // Whether they call anything but a builtin.
+    bool callsScript = false;
+  };
+
+  AstArena &arena;
+  ProgramNames programNames;
+  std::unordered_set<Symbol> pureBuiltins;
+  std::deque<Occurrence> occurrences;
+  // The variables to declare in a body and the statements they go before.
+  std::unordered_map<NodeList<Stmt> *, std::vector<std::pair<Stmt *, Symbol>>>
+      declarations;
+
+  // Eliminates in the statements of body, which run one after another with
+  // the expressions of available evaluated before them. loop is the site of
+  // the outermost loop body is in, null outside of loops.
+  void eliminateBody(NodeList<Stmt> &body, Table &available,
+                     const Site *loop) {
+    for (Stmt *&stmt : body) {
+      Site site = loop != nullptr ? *loop : Site{&body, stmt};
+      eliminateStmt(stmt, available, site, loop != nullptr);
+    }
+    declare(body);
+  }
+
+  void eliminateStmt(Stmt *&stmt, Table &available, const Site &site,
+                     bool inLoop) {
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      if (declaration->value != nullptr) {
+        visit(declaration->value, available, site);
+      }
+      kill(available, declaration->identifier);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      // Its body runs in an environment of its own.
+      auto function = static_cast<FunctionDeclaration *>(stmt);
+      Table called;
+      eliminateBody(function->body, called, nullptr);
+      kill(available, function->name);
+      break;
+    }
+    case NodeType::StructDeclaration:
+      kill(available, static_cast<StructDeclaration *>(stmt)->structName);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      visit(ifStmt->condition, available, site);
+      Table ifAvailable = available;
+      eliminateBody(ifStmt->ifBody, ifAvailable, inLoop ? &site : nullptr);
+      Table elseAvailable = available;
+      eliminateBody(ifStmt->elseBody, elseAvailable, inLoop ? &site : nullptr);
+
+      Effects effects;
+      effectsOf(ifStmt->ifBody, effects);
+      effectsOf(ifStmt->elseBody, effects);
+      kill(available, effects);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      // What the loop keeps may be read on every iteration, the condition
+      // runs before the body each time.
+      auto loop = static_cast<WhileLoop *>(stmt);
+      Effects effects;
+      effectsOf(loop->condition, effects);
+      effectsOf(loop->loopBody, effects);
+      kill(available, effects);
+
+      Table loopAvailable = available;
+      visit(loop->condition, loopAvailable, site);
+      eliminateBody(loop->loopBody, loopAvailable, &site);
+      break;
+    }
+    case NodeType::ReturnStatement: {
+      // Nothing after it runs, so its value is not remembered.
+      auto returnStmt = static_cast<ReturnStatement *>(stmt);
+      if (returnStmt->returnValue != nullptr &&
+          returnStmt->returnValue->kind >= NodeType::AssignmentExpr) {
+        Expr *value = static_cast<Expr *>(returnStmt->returnValue);
+        visit(value, available, site, false);
+        returnStmt->returnValue = value;
+      }
+      break;
+    }
+    default:
+      if (stmt->kind >= NodeType::AssignmentExpr) {
+        visitParts(static_cast<Expr *>(stmt), available, site);
+      }
+      break;
+    }
+  }
+
+  // Reads expr from a variable when it was evaluated before, otherwise
+  // eliminates in its parts and, if remember, remembers it.
+  void visit(Expr *&expr, Table &available, const Site &site,
+             bool remember = true) {
+    std::string key;
+    std::vector<Symbol> names;
+    std::vector<Symbol> fields;
+    // A variable or literal alone is not worth one.
+    bool candidate = expr->kind != NodeType::Identifier &&
+                     expr->kind != NodeType::NumericLiteral &&
+                     expr->kind != NodeType::StrLiteral &&
+                     expr->kind != NodeType::Null &&
+                     keyOf(expr, key, names, fields);
+
+    if (candidate) {
+      auto found = available.find(key);
+      if (found != available.end()) {
+        reuse(found->second, expr);
+        return;
+      }
+    }
+
+    visitParts(expr, available, site);
+
+    if (candidate && remember) {
+      Occurrence &occurrence = occurrences.emplace_back();
+      occurrence.first = &expr;
+      occurrence.site = site;
+      occurrence.names = std::move(names);
+      occurrence.fields = std::move(fields);
+      available[key] = &occurrence;
+    }
+  }
+
+  // Eliminates in the parts of expr in the order they are evaluated.
+  void visitParts(Expr *expr, Table &available, const Site &site) {
+    switch (expr->kind) {
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(expr);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        Symbol name =
+            static_cast<IdentifierExpr *>(assignment->assigne)->symbol;
+        if (reads(assignment->value, name)) {
+          visitParts(assignment->value, available, site);
+        } else {
+          visit(assignment->value, available, site);
+        }
+        kill(available, name);
+      } else {
+        auto member = static_cast<MemberAccessExpr *>(assignment->assigne);
+        visit(member->object, available, site);
+        visit(assignment->value, available, site);
+        killField(available, member->memberName);
+      }
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(expr);
+      visit(binop->left, available, site);
+      visit(binop->right, available, site);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      // The right may not run.
+      auto logical = static_cast<LogicalExpr *>(expr);
+      visit(logical->left, available, site);
+      Table rightAvailable = available;
+      visit(logical->right, rightAvailable, site);
+
+      Effects effects;
+      effectsOf(logical->right, effects);
+      kill(available, effects);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      visit(static_cast<UnaryExpr *>(expr)->right, available, site);
+      break;
+    case NodeType::CallExpr: {
+      // Arguments are evaluated before the callee.
+      auto call = static_cast<CallExpr *>(expr);
+      for (Expr *&arg : call->args) {
+        visit(arg, available, site);
+      }
+      if (call->caller->kind != NodeType::Identifier) {
+        visit(call->caller, available, site);
+        killCalls(available);
+      } else if (!programNames.isBuiltin(
+                     static_cast<IdentifierExpr *>(call->caller)->symbol)) {
+        killCalls(available);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      visit(static_cast<MemberAccessExpr *>(expr)->object, available, site);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Replaces expr by the variable of occurrence, assigning it where it was
+  // first evaluated if no occurrence read it yet.
+  void reuse(Occurrence *occurrence, Expr *&expr) {
+    if (!occurrence->named) {
+      occurrence->variable =
+          SymbolTable::intern("common " + std::to_string(totals.variables++));
+      occurrence->named = true;
+
+      Expr *first = *occurrence->first;
+      auto assignment = arena.make<AssignmentExpr>(
+          arena.make<IdentifierExpr>(occurrence->variable), first);
+      assignment->numeric = first->numeric;
+      *occurrence->first = assignment;
+      declarations[occurrence->site.body].emplace_back(occurrence->site.before,
+                                                       occurrence->variable);
+    }
+
+    auto variable = arena.make<IdentifierExpr>(occurrence->variable);
+    variable->numeric = expr->numeric;
+    expr = variable;
+    totals.expressions++;
+  }
+
+  // Declares the variables of the expressions first evaluated in body.
+  void declare(NodeList<Stmt> &body) {
+    auto pending = declarations.find(&body);
+    if (pending == declarations.end()) {
+      return;
+    }
+
+    std::vector<Stmt *> statements;
+    for (Stmt *stmt : body) {
+      for (const auto &variable : pending->second) {
+        if (variable.first == stmt) {
+          statements.push_back(arena.make<VarDeclaration>(
+              false, variable.second, arena.make<NullLiteral>()));
+        }
+      }
+      statements.push_back(stmt);
+    }
+    declarations.erase(pending);
+
+    body = arena.makeArray<Stmt *>(statements.size());
+    std::copy(statements.begin(), statements.end(), body.begin());
+  }
+
+  // Appends to key what identifies the value of expr, and the names and
+  // fields it reads to names and fields. False when expr may do anything
+  // but compute a value.
+  bool keyOf(const Expr *expr, std::string &key, std::vector<Symbol> &names,
+             std::vector<Symbol> &fields) const {
+    switch (expr->kind) {
+    case NodeType::NumericLiteral: {
+      double value = static_cast<const NumericLiteral *>(expr)->value;
+      key += 'n';
+      key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+      return true;
+    }
+    case NodeType::StrLiteral: {
+      std::string_view value = static_cast<const StrLiteral *>(expr)->value;
+      key += 's';
+      key += std::to_string(value.size());
+      key += ':';
+      key.append(value);
+      return true;
+    }
+    case NodeType::Null:
+      key += '0';
+      return true;
+    case NodeType::Identifier: {
+      Symbol name = static_cast<const IdentifierExpr *>(expr)->symbol;
+      key += 'i';
+      appendSymbol(key, name);
+      names.push_back(name);
+      return true;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(expr);
+      key += 'b';
+      key += static_cast<char>(binop->binaryOperator);
+      return keyOf(binop->left, key, names, fields) &&
+             keyOf(binop->right, key, names, fields);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(expr);
+      key += 'l';
+      key += static_cast<char>(logical->logicalOperator);
+      return keyOf(logical->left, key, names, fields) &&
+             keyOf(logical->right, key, names, fields);
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<const UnaryExpr *>(expr);
+      key += 'u';
+      key += static_cast<char>(unary->op);
+      return keyOf(unary->right, key, names, fields);
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<const MemberAccessExpr *>(expr);
+      key += 'm';
+      appendSymbol(key, member->memberName);
+      fields.push_back(member->memberName);
+      return keyOf(member->object, key, names, fields);
+    }
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(expr);
+      if (call->caller->kind != NodeType::Identifier) {
+        return false;
+      }
+      Symbol callee = static_cast<const IdentifierExpr *>(call->caller)->symbol;
+      if (pureBuiltins.count(callee) == 0) {
+        return false;
+      }
+      key += 'c';
+      appendSymbol(key, callee);
+      key += std::to_string(call->args.size());
+      key += ':';
+      for (const Expr *arg : call->args) {
+        if (!keyOf(arg, key, names, fields)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+
+  static void appendSymbol(std::string &key, Symbol symbol) {
+    key.append(reinterpret_cast<const char *>(&symbol), sizeof(symbol));
+  }
+
+  // Whether expr reads the variable name.
+  static bool reads(const Expr *expr, Symbol name) {
+    switch (expr->kind) {
+    case NodeType::Identifier:
+      return static_cast<const IdentifierExpr *>(expr)->symbol == name;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(expr);
+      return reads(assignment->assigne, name) ||
+             reads(assignment->value, name);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(expr);
+      return reads(binop->left, name) || reads(binop->right, name);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(expr);
+      return reads(logical->left, name) || reads(logical->right, name);
+    }
+    case NodeType::UnaryExpr:
+      return reads(static_cast<const UnaryExpr *>(expr)->right, name);
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(expr);
+      if (reads(call->caller, name)) {
+        return true;
+      }
+      for (const Expr *arg : call->args) {
+        if (reads(arg, name)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case NodeType::MemberAccessExpr:
+      return reads(static_cast<const MemberAccessExpr *>(expr)->object, name);
+    default:
+      return false;
+    }
+  }
+
+  template <typename Changes>
+  static void forget(Table &available, Changes changes) {
+    for (auto it = available.begin(); it != available.end();) {
+      if (changes(*it->second)) {
+        it = available.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  static bool contains(const std::vector<Symbol> &symbols, Symbol symbol) {
+    return std::find(symbols.begin(), symbols.end(), symbol) != symbols.end();
+  }
+
+  static void kill(Table &available, Symbol name) {
+    forget(available, [name](const Occurrence &occurrence) {
+      return contains(occurrence.names, name);
+    });
+  }
+
+  static void killField(Table &available, Symbol field) {
+    forget(available, [field](const Occurrence &occurrence) {
+      return contains(occurrence.fields, field);
+    });
+  }
+
+  // Forgets what a call of a function might change.
+  void killCalls(Table &available) const {
+    forget(available, [this](const Occurrence &occurrence) {
+      for (Symbol name : occurrence.names) {
+        if (programNames.assignedByFunctions.count(name) != 0) {
+          return true;
+        }
+      }
+      for (Symbol field : occurrence.fields) {
+        if (programNames.fieldsAssignedByFunctions.count(field) != 0) {
+          return true;
+        }
+      }
+      return false;
+    });
+  }
+
+  void kill(Table &available, const Effects &effects) const {
+    forget(available, [&](const Occurrence &occurrence) {
+      for (Symbol name : occurrence.names) {
+        if (effects.changed.count(name) != 0) {
+          return true;
+        }
+      }
+      for (Symbol field : occurrence.fields) {
+        if (effects.fields.count(field) != 0) {
+          return true;
+        }
+      }
+      return false;
+    });
+    if (effects.callsScript) {
+      killCalls(available);
+    }
+  }
+
+  void effectsOf(const NodeList<Stmt> &body, Effects &effects) const {
+    for (const Stmt *stmt : body) {
+      effectsOf(stmt, effects);
+    }
+  }
+
+  void effectsOf(const Stmt *stmt, Effects &effects) const {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      effects.changed.insert(declaration->identifier);
+      effectsOf(declaration->value, effects);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      // Its body runs when it is called, which counts as calling the script.
+      effects.changed.insert(
+          static_cast<const FunctionDeclaration *>(stmt)->name);
+      break;
+    case NodeType::StructDeclaration:
+      effects.changed.insert(
+          static_cast<const StructDeclaration *>(stmt)->structName);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      effectsOf(ifStmt->condition, effects);
+      effectsOf(ifStmt->ifBody, effects);
+      effectsOf(ifStmt->elseBody, effects);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      effectsOf(loop->condition, effects);
+      effectsOf(loop->loopBody, effects);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      effectsOf(static_cast<const ReturnStatement *>(stmt)->returnValue,
+                effects);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        effects.changed.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      } else if (assignment->assigne->kind == NodeType::MemberAccessExpr) {
+        effects.fields.insert(
+            static_cast<const MemberAccessExpr *>(assignment->assigne)
+                ->memberName);
+      }
+      effectsOf(assignment->assigne, effects);
+      effectsOf(assignment->value, effects);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      effectsOf(binop->left, effects);
+      effectsOf(binop->right, effects);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      effectsOf(logical->left, effects);
+      effectsOf(logical->right, effects);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      effectsOf(static_cast<const UnaryExpr *>(stmt)->right, effects);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      if (call->caller->kind != NodeType::Identifier ||
+          !programNames.isBuiltin(
+              static_cast<const IdentifierExpr *>(call->caller)->symbol)) {
+        effects.callsScript = true;
+      }
+      effectsOf(call->caller, effects);
+      for (const Expr *arg : call->args) {
+        effectsOf(arg, effects);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      effectsOf(static_cast<const MemberAccessExpr *>(stmt)->object, effects);
+      break;
+    default:
+      break;
+    }
+  }
+};
+
+} // namespace
+
+void eliminateCommonSubexpressions(Program &program) {
+  Eliminator(program).eliminate(program);
+}
+
+CommonStats commonStats() { return totals; }
+
+void printCommonStats(std::ostream &out) {
+  out << "Eliminated: " << totals.expressions
+      << " repeated expressions with " << totals.variables << " variables"
+      << std::endl;
+}
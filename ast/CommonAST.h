@@ -0,0 +1,44 @@
+#ifndef COMMON_AST_H
+#define COMMON_AST_H
+
+#include "AST.h"
+
+#include <cstdint>
+#include <ostream>
+
+// Computes an expression that a sequence of statements evaluates more than
+// once with the same operands only the first time, so that in
+// `sqrt(pow(b.x - a.x, 2) + pow(b.y - a.y, 2)) + (b.x - a.x)` the second
+// `b.x - a.x` reads a variable instead. The first occurrence becomes an
+// assignment of that variable, `(t = b.x - a.x)`, and is evaluated where and
+// when it was, so it prints and fails as it did.
+//
+// An expression is reused when it is made of literals, variables, fields,
+// operators and calls of the builtins that only compute a value (sqrt, pow,
+// len and the like), and nothing that ran between the two changed what it
+// reads: no assignment or declaration of one of its variables, no
+// assignment of a field of the same name in any struct, and, as scoping is
+// dynamic, no call of a function that assigns either. An occurrence that
+// might not have run, in a branch of an if or the right of && or ||, is only
+// reused inside that branch, and a loop only reuses what it does not change
+// itself. `i = i + 1` keeps its value, which markCountedLoops and the bytecode
+// compiler recognize.
+//
+// The variables are named so that no script can name them, and declared
+// before the statement of the first occurrence, or before the outermost
+// loop when it is in one, like those of hoistInvariants.
+//
+// Runs after hoistInvariants and before resolveProgram, on whole scripts
+// only.
+void eliminateCommonSubexpressions(Program &program);
+
+// What eliminateCommonSubexpressions did to every program of a run.
+struct CommonStats {
+  uint64_t expressions = 0;
+  uint64_t variables = 0;
+};
+
+CommonStats commonStats();
+void printCommonStats(std::ostream &out);
+
+#endif
@@ -0,0 +1,553 @@
+#include "FoldAST.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+FoldStats totals;
+
+class Folder {
+public:
+  explicit Folder(Program &program) : arena(program.arena) {}
+
+  void fold(Program &program) {
+    collectNames(program.body);
+    for (const MathBuiltin &builtin : MATH_BUILTINS) {
+      Symbol name = SymbolTable::intern(builtin.name);
+      if (declaredNames.count(name) == 0) {
+        mathBuiltins.emplace(name, &builtin);
+      }
+    }
+
+    std::unordered_map<Symbol, double> constants;
+    foldBody(program.body, constants);
+  }
+
+private:
+  AstArena &arena;
+  // Every name the program declares anywhere, with let, const, func,
+  // struct or as a parameter.
+  std::unordered_set<Symbol> declaredNames;
+  // Every name the program assigns anywhere. The evaluator lets a function
+  // assign a const of its caller, so no const with one of these names is
+  // propagated.
+  std::unordered_set<Symbol> assignedNames;
+  std::unordered_map<Symbol, const MathBuiltin *> mathBuiltins;
+
+  void collectNames(const NodeList<Stmt> &body) {
+    for (const Stmt *stmt : body) {
+      collectNames(stmt);
+    }
+  }
+
+  void collectNames(const Stmt *stmt) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      declaredNames.insert(declaration->identifier);
+      collectNames(declaration->value);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      auto function = static_cast<const FunctionDeclaration *>(stmt);
+      declaredNames.insert(function->name);
+      for (Symbol parameter : function->parameters) {
+        declaredNames.insert(parameter);
+      }
+      collectNames(function->body);
+      break;
+    }
+    case NodeType::StructDeclaration: {
+      auto structDecl = static_cast<const StructDeclaration *>(stmt);
+      declaredNames.insert(structDecl->structName);
+      collectNames(structDecl->structBody);
+      break;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      collectNames(ifStmt->condition);
+      collectNames(ifStmt->ifBody);
+      collectNames(ifStmt->elseBody);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      collectNames(loop->condition);
+      collectNames(loop->loopBody);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      collectNames(static_cast<const ReturnStatement *>(stmt)->returnValue);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        assignedNames.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      }
+      collectNames(assignment->assigne);
+      collectNames(assignment->value);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      collectNames(binop->left);
+      collectNames(binop->right);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      collectNames(logical->left);
+      collectNames(logical->right);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      collectNames(static_cast<const UnaryExpr *>(stmt)->right);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      collectNames(call->caller);
+      for (const Expr *arg : call->args) {
+        collectNames(arg);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      collectNames(static_cast<const MemberAccessExpr *>(stmt)->object);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Folds the statements of body in place. constants holds the consts that
+  // are declared wherever body runs, the ones body declares are added for
+  // the statements after them.
+  void foldBody(NodeList<Stmt> &body,
+                std::unordered_map<Symbol, double> &constants) {
+    bool spliced = false;
+    std::vector<Stmt *> statements;
+
+    for (uint32_t i = 0; i < body.size(); i++) {
+      Stmt *stmt = body[i];
+      if (stmt->kind == NodeType::IfStatement) {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        ifStmt->condition = foldExpr(ifStmt->condition, constants);
+        if (ifStmt->condition->kind == NodeType::NumericLiteral) {
+          // There is no block scope: the branch that runs can take the
+          // place of the if, and its declarations stay where they were.
+          bool taken =
+              static_cast<NumericLiteral *>(ifStmt->condition)->value != 0;
+          NodeList<Stmt> &branch = taken ? ifStmt->ifBody : ifStmt->elseBody;
+          NodeList<Stmt> &dropped = taken ? ifStmt->elseBody : ifStmt->ifBody;
+          totals.branches++;
+          totals.nodesRemoved += 2 + countNodes(dropped);
+
+          foldBody(branch, constants);
+          statements.insert(statements.end(), branch.begin(), branch.end());
+          // An if evaluates to null when its branch is empty, which only
+          // matters to the last statement of a body.
+          if (branch.empty() && i + 1 == body.size()) {
+            statements.push_back(arena.make<NullLiteral>());
+            totals.nodesRemoved--;
+          }
+          spliced = true;
+          continue;
+        }
+      }
+
+      if (stmt->kind >= NodeType::AssignmentExpr) {
+        stmt = foldExpr(static_cast<Expr *>(stmt), constants);
+        body[i] = stmt;
+      } else {
+        foldStmt(stmt, constants);
+      }
+      statements.push_back(stmt);
+    }
+
+    if (spliced) {
+      body = arena.makeArray<Stmt *>(statements.size());
+      std::copy(statements.begin(), statements.end(), body.begin());
+    }
+  }
+
+  void foldStmt(Stmt *stmt, std::unordered_map<Symbol, double> &constants) {
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      if (declaration->value != nullptr) {
+        declaration->value = foldExpr(declaration->value, constants);
+      }
+      if (declaration->constant && declaration->value != nullptr &&
+          declaration->value->kind == NodeType::NumericLiteral &&
+          assignedNames.count(declaration->identifier) == 0) {
+        constants[declaration->identifier] =
+            static_cast<NumericLiteral *>(declaration->value)->value;
+      } else {
+        constants.erase(declaration->identifier);
+      }
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      // A function reads the names it does not declare in its callers.
+      auto function = static_cast<FunctionDeclaration *>(stmt);
+      std::unordered_map<Symbol, double> locals;
+      foldBody(function->body, locals);
+      constants.erase(function->name);
+      break;
+    }
+    case NodeType::StructDeclaration: {
+      auto structDecl = static_cast<StructDeclaration *>(stmt);
+      for (Stmt *field : structDecl->structBody) {
+        if (field->kind == NodeType::VarDeclaration) {
+          auto declaration = static_cast<VarDeclaration *>(field);
+          if (declaration->value != nullptr) {
+            declaration->value = foldExpr(declaration->value, constants);
+          }
+        }
+      }
+      constants.erase(structDecl->structName);
+      break;
+    }
+    case NodeType::IfStatement: {
+      // Consts declared in a branch may not be declared after the if.
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      std::unordered_map<Symbol, double> ifConstants = constants;
+      std::unordered_map<Symbol, double> elseConstants = constants;
+      foldBody(ifStmt->ifBody, ifConstants);
+      foldBody(ifStmt->elseBody, elseConstants);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<WhileLoop *>(stmt);
+      loop->condition = foldExpr(loop->condition, constants);
+      std::unordered_map<Symbol, double> bodyConstants = constants;
+      foldBody(loop->loopBody, bodyConstants);
+      break;
+    }
+    case NodeType::ReturnStatement: {
+      auto returnStmt = static_cast<ReturnStatement *>(stmt);
+      if (returnStmt->returnValue != nullptr) {
+        if (returnStmt->returnValue->kind >= NodeType::AssignmentExpr) {
+          returnStmt->returnValue = foldExpr(
+              static_cast<Expr *>(returnStmt->returnValue), constants);
+        } else {
+          foldStmt(returnStmt->returnValue, constants);
+        }
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  // Folds expr and returns what takes its place.
+  Expr *foldExpr(Expr *expr, std::unordered_map<Symbol, double> &constants) {
+    if (expr->kind == NodeType::Identifier) {
+      auto found = constants.find(static_cast<IdentifierExpr *>(expr)->symbol);
+      if (found != constants.end()) {
+        totals.expressions++;
+        return literal(found->second, 0);
+      }
+      return expr;
+    }
+
+    foldOperands(expr, constants);
+
+    double value;
+    if (!evaluate(expr, value)) {
+      return expr;
+    }
+    totals.expressions++;
+    return literal(value, countNodes(expr) - 1);
+  }
+
+  void foldOperands(Expr *expr, std::unordered_map<Symbol, double> &constants) {
+    switch (expr->kind) {
+    case NodeType::AssignmentExpr: {
+      // The variable assigned is not read.
+      auto assignment = static_cast<AssignmentExpr *>(expr);
+      if (assignment->assigne->kind != NodeType::Identifier) {
+        assignment->assigne = foldExpr(assignment->assigne, constants);
+      }
+      assignment->value = foldExpr(assignment->value, constants);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(expr);
+      binop->left = foldExpr(binop->left, constants);
+      binop->right = foldExpr(binop->right, constants);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(expr);
+      logical->left = foldExpr(logical->left, constants);
+      logical->right = foldExpr(logical->right, constants);
+      break;
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<UnaryExpr *>(expr);
+      unary->right = foldExpr(unary->right, constants);
+      break;
+    }
+    case NodeType::CallExpr: {
+      auto call = static_cast<CallExpr *>(expr);
+      for (Expr *&arg : call->args) {
+        arg = foldExpr(arg, constants);
+      }
+      if (call->caller->kind != NodeType::Identifier) {
+        call->caller = foldExpr(call->caller, constants);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<MemberAccessExpr *>(expr);
+      member->object = foldExpr(member->object, constants);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  // Value of expr when its operands are numeric literals and computing it
+  // cannot fail, what the evaluator computes for it.
+  bool evaluate(Expr *expr, double &value) const {
+    switch (expr->kind) {
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(expr);
+      double left, right;
+      if (!number(binop->left, left) || !number(binop->right, right)) {
+        return false;
+      }
+      return binary(binop->binaryOperator, left, right, value);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(expr);
+      double left, right;
+      if (!number(logical->left, left) || !number(logical->right, right)) {
+        return false;
+      }
+      if (logical->logicalOperator == Operator::And) {
+        value = left && right ? 1.0 : 0.0;
+      } else if (logical->logicalOperator == Operator::Or) {
+        value = left || right ? 1.0 : 0.0;
+      } else {
+        return false;
+      }
+      return true;
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<UnaryExpr *>(expr);
+      double operand;
+      if (!number(unary->right, operand)) {
+        return false;
+      }
+      if (unary->op == Operator::Not) {
+        value = operand == 0 ? 1.0 : 0.0;
+      } else if (unary->op == Operator::Negate) {
+        value = -operand;
+      } else {
+        return false;
+      }
+      return true;
+    }
+    case NodeType::CallExpr:
+      return call(static_cast<CallExpr *>(expr), value);
+    default:
+      return false;
+    }
+  }
+
+  static bool number(const Expr *expr, double &value) {
+    if (expr->kind != NodeType::NumericLiteral) {
+      return false;
+    }
+    value = static_cast<const NumericLiteral *>(expr)->value;
+    return true;
+  }
+
+  static bool binary(Operator op, double left, double right, double &value) {
+    switch (op) {
+    case Operator::Add:
+      value = left + right;
+      return true;
+    case Operator::Subtract:
+      value = left - right;
+      return true;
+    case Operator::Multiply:
+      value = left * right;
+      return true;
+    case Operator::Divide:
+      value = left / right;
+      return right != 0;
+    case Operator::Modulo:
+      value = std::fmod(left, right);
+      return right != 0;
+    case Operator::Less:
+      value = left < right ? 1.0 : 0.0;
+      return true;
+    case Operator::LessEqual:
+      value = left <= right ? 1.0 : 0.0;
+      return true;
+    case Operator::Greater:
+      value = left > right ? 1.0 : 0.0;
+      return true;
+    case Operator::GreaterEqual:
+      value = left >= right ? 1.0 : 0.0;
+      return true;
+    case Operator::Equal:
+      value = left == right ? 1.0 : 0.0;
+      return true;
+    case Operator::NotEqual:
+      value = left != right ? 1.0 : 0.0;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  bool call(CallExpr *call, double &value) const {
+    if (call->caller->kind != NodeType::Identifier) {
+      return false;
+    }
+    auto found =
+        mathBuiltins.find(static_cast<IdentifierExpr *>(call->caller)->symbol);
+    if (found == mathBuiltins.end()) {
+      return false;
+    }
+    const MathBuiltin &builtin = *found->second;
+    size_t count = call->args.size();
+    if (builtin.arguments < 0 ? count == 0
+                              : count != static_cast<size_t>(builtin.arguments)) {
+      return false;
+    }
+    std::vector<double> args(count);
+    for (size_t i = 0; i < count; i++) {
+      if (!number(call->args[i], args[i])) {
+        return false;
+      }
+    }
+
+    const char *name = builtin.name;
+    if (std::strcmp(name, "sqrt") == 0) {
+      value = std::sqrt(args[0]);
+    } else if (std::strcmp(name, "pow") == 0) {
+      value = std::pow(args[0], args[1]);
+    } else if (std::strcmp(name, "round") == 0) {
+      value = std::round(args[0]);
+    } else if (std::strcmp(name, "floor") == 0) {
+      value = std::floor(args[0]);
+    } else if (std::strcmp(name, "ceil") == 0) {
+      value = std::ceil(args[0]);
+    } else if (std::strcmp(name, "sin") == 0) {
+      value = std::sin(args[0]);
+    } else if (std::strcmp(name, "cos") == 0) {
+      value = std::cos(args[0]);
+    } else if (std::strcmp(name, "tan") == 0) {
+      value = std::tan(args[0]);
+    } else if (std::strcmp(name, "log") == 0) {
+      value = std::log(args[0]);
+    } else {
+      // min and max keep the first of equal arguments, as the builtins do.
+      bool minimum = std::strcmp(name, "min") == 0;
+      value = args[0];
+      for (size_t i = 1; i < count; i++) {
+        if (minimum ? args[i] < value : args[i] > value) {
+          value = args[i];
+        }
+      }
+    }
+    return true;
+  }
+
+  NumericLiteral *literal(double value, uint64_t removed) {
+    totals.nodesRemoved += removed;
+    return arena.make<NumericLiteral>(value);
+  }
+
+  static uint64_t countNodes(const NodeList<Stmt> &body) {
+    uint64_t count = 0;
+    for (const Stmt *stmt : body) {
+      count += countNodes(stmt);
+    }
+    return count;
+  }
+
+  static uint64_t countNodes(const Stmt *stmt) {
+    if (stmt == nullptr) {
+      return 0;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration:
+      return 1 + countNodes(static_cast<const VarDeclaration *>(stmt)->value);
+    case NodeType::FunctionDeclaration:
+      return 1 + countNodes(static_cast<const FunctionDeclaration *>(stmt)->body);
+    case NodeType::StructDeclaration:
+      return 1 +
+             countNodes(static_cast<const StructDeclaration *>(stmt)->structBody);
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      return 1 + countNodes(ifStmt->condition) + countNodes(ifStmt->ifBody) +
+             countNodes(ifStmt->elseBody);
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      return 1 + countNodes(loop->condition) + countNodes(loop->loopBody);
+    }
+    case NodeType::ReturnStatement:
+      return 1 +
+             countNodes(static_cast<const ReturnStatement *>(stmt)->returnValue);
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      return 1 + countNodes(assignment->assigne) + countNodes(assignment->value);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      return 1 + countNodes(binop->left) + countNodes(binop->right);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      return 1 + countNodes(logical->left) + countNodes(logical->right);
+    }
+    case NodeType::UnaryExpr:
+      return 1 + countNodes(static_cast<const UnaryExpr *>(stmt)->right);
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      uint64_t count = 1 + countNodes(call->caller);
+      for (const Expr *arg : call->args) {
+        count += countNodes(arg);
+      }
+      return count;
+    }
+    case NodeType::MemberAccessExpr:
+      return 1 +
+             countNodes(static_cast<const MemberAccessExpr *>(stmt)->object);
+    default:
+      return 1;
+    }
+  }
+};
+
+} // namespace
+
+void foldConstants(Program &program) { Folder(program).fold(program); }
+
+FoldStats foldStats() { return totals; }
+
+void printFoldStats(std::ostream &out) {
+  out << "Folded: " << totals.expressions << " expressions, "
+      << totals.branches << " branches, " << totals.nodesRemoved
+      << " nodes removed" << std::endl;
+}
@@ -0,0 +1,36 @@
+#ifndef FOLD_AST_H
+#define FOLD_AST_H
+
+#include "AST.h"
+
+#include <cstdint>
+#include <ostream>
+
+// Computes what a program can compute before it runs, with the same results
+// it would get running it:
+//  - arithmetic, comparisons, logical and unary operators on numeric
+//    literals become one literal, unless they divide by zero and fail,
+//  - calls of the math builtins (sqrt, pow, round, floor, ceil, min, max,
+//    sin, cos, tan and log) on numeric literals become their result, when
+//    the program declares no other name like them,
+//  - a const holding a number is replaced by it where the function or top
+//    level that declared it reads it after its declaration, unless the
+//    program assigns its name somewhere; scoping is dynamic, so functions
+//    it calls may still read the const,
+//  - an if whose condition is a number is replaced by the branch it runs.
+//
+// Only whole scripts are folded: a later line of the REPL may declare any
+// name. Runs before resolveProgram, which assigns slots to what is left.
+void foldConstants(Program &program);
+
+// What foldConstants did to every program of a run.
+struct FoldStats {
+  uint64_t expressions = 0;
+  uint64_t branches = 0;
+  uint64_t nodesRemoved = 0;
+};
+
+FoldStats foldStats();
+void printFoldStats(std::ostream &out);
+
+#endif
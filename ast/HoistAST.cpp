@@ -0,0 +1,382 @@
+#include "HoistAST.h"
+#include "NamesAST.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace {
+
+HoistStats totals;
+
+// An expression moved out of a loop and the variable that holds it.
+typedef std::vector<std::pair<Symbol, Expr *>> Moved;
+
+class Hoister {
+public:
+  explicit Hoister(Program &program) : arena(program.arena) {}
+
+  void hoist(Program &program) {
+    names = collectProgramNames(program.body);
+    for (const MathBuiltin &builtin : MATH_BUILTINS) {
+      Symbol name = SymbolTable::intern(builtin.name);
+      if (names.isBuiltin(name)) {
+        mathBuiltins.emplace(name, builtin.arguments);
+      }
+    }
+
+    hoistBody(program.body, nullptr);
+  }
+
+private:
+  // What running a loop may change.
+  struct LoopEffects {
+    // Names the loop declares or assigns.
+    std::unordered_set<Symbol> changed;
+    // Whether it calls anything but a builtin.
+    bool callsScript = false;
+  };
+
+  AstArena &arena;
+  ProgramNames names;
+  std::unordered_map<Symbol, int> mathBuiltins;
+
+  // Hoists out of every loop in body. declarations is where a loop in a loop
+  // declares its variables, null outside of loops.
+  void hoistBody(NodeList<Stmt> &body, std::vector<Stmt *> *declarations) {
+    std::vector<Stmt *> statements;
+    bool inserted = false;
+
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::FunctionDeclaration:
+        hoistBody(static_cast<FunctionDeclaration *>(stmt)->body, nullptr);
+        break;
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        hoistBody(ifStmt->ifBody, declarations);
+        hoistBody(ifStmt->elseBody, declarations);
+        break;
+      }
+      case NodeType::WhileLoop: {
+        // Loops in this one first, so what they moved out of themselves may
+        // move out of this one as well.
+        auto loop = static_cast<WhileLoop *>(stmt);
+        std::vector<Stmt *> inner;
+        hoistBody(loop->loopBody,
+                  declarations != nullptr ? declarations : &inner);
+        Moved moved = hoistLoop(loop);
+
+        statements.insert(statements.end(), inner.begin(), inner.end());
+        for (const auto &variable : moved) {
+          if (declarations == nullptr) {
+            statements.push_back(arena.make<VarDeclaration>(
+                false, variable.first, variable.second));
+          } else {
+            declarations->push_back(arena.make<VarDeclaration>(
+                false, variable.first, arena.make<NullLiteral>()));
+            auto assignment = arena.make<AssignmentExpr>(
+                arena.make<IdentifierExpr>(variable.first), variable.second);
+            assignment->numeric = true;
+            statements.push_back(assignment);
+          }
+        }
+        inserted = inserted || !inner.empty() || !moved.empty();
+        break;
+      }
+      default:
+        break;
+      }
+      statements.push_back(stmt);
+    }
+
+    if (inserted) {
+      body = arena.makeArray<Stmt *>(statements.size());
+      std::copy(statements.begin(), statements.end(), body.begin());
+    }
+  }
+
+  Moved hoistLoop(WhileLoop *loop) {
+    LoopEffects effects;
+    effectsOf(loop->condition, effects);
+    effectsOf(loop->loopBody, effects);
+
+    Moved moved;
+    loop->condition = hoistExpr(loop->condition, effects, moved);
+    hoistStatements(loop->loopBody, effects, moved);
+    if (!moved.empty()) {
+      totals.loops++;
+    }
+    return moved;
+  }
+
+  void effectsOf(const NodeList<Stmt> &body, LoopEffects &effects) {
+    for (const Stmt *stmt : body) {
+      effectsOf(stmt, effects);
+    }
+  }
+
+  void effectsOf(const Stmt *stmt, LoopEffects &effects) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      effects.changed.insert(declaration->identifier);
+      effectsOf(declaration->value, effects);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      // Its body runs when it is called, which counts as calling the script.
+      effects.changed.insert(
+          static_cast<const FunctionDeclaration *>(stmt)->name);
+      break;
+    case NodeType::StructDeclaration:
+      effects.changed.insert(
+          static_cast<const StructDeclaration *>(stmt)->structName);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      effectsOf(ifStmt->condition, effects);
+      effectsOf(ifStmt->ifBody, effects);
+      effectsOf(ifStmt->elseBody, effects);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      effectsOf(loop->condition, effects);
+      effectsOf(loop->loopBody, effects);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      effectsOf(static_cast<const ReturnStatement *>(stmt)->returnValue,
+                effects);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        effects.changed.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      }
+      effectsOf(assignment->assigne, effects);
+      effectsOf(assignment->value, effects);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      effectsOf(binop->left, effects);
+      effectsOf(binop->right, effects);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      effectsOf(logical->left, effects);
+      effectsOf(logical->right, effects);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      effectsOf(static_cast<const UnaryExpr *>(stmt)->right, effects);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      if (call->caller->kind != NodeType::Identifier ||
+          !names.isBuiltin(
+              static_cast<const IdentifierExpr *>(call->caller)->symbol)) {
+        effects.callsScript = true;
+      }
+      effectsOf(call->caller, effects);
+      for (const Expr *arg : call->args) {
+        effectsOf(arg, effects);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      effectsOf(static_cast<const MemberAccessExpr *>(stmt)->object, effects);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Hoists out of the statements of a loop body. Loops in it already moved
+  // what they could out of themselves, into this body.
+  void hoistStatements(NodeList<Stmt> &body, const LoopEffects &effects,
+                       Moved &moved) {
+    for (Stmt *&stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::VarDeclaration: {
+        auto declaration = static_cast<VarDeclaration *>(stmt);
+        declaration->value = hoistExpr(declaration->value, effects, moved);
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        ifStmt->condition = hoistExpr(ifStmt->condition, effects, moved);
+        hoistStatements(ifStmt->ifBody, effects, moved);
+        hoistStatements(ifStmt->elseBody, effects, moved);
+        break;
+      }
+      case NodeType::ReturnStatement: {
+        auto returnStmt = static_cast<ReturnStatement *>(stmt);
+        if (returnStmt->returnValue != nullptr &&
+            returnStmt->returnValue->kind >= NodeType::AssignmentExpr) {
+          returnStmt->returnValue = hoistExpr(
+              static_cast<Expr *>(returnStmt->returnValue), effects, moved);
+        }
+        break;
+      }
+      case NodeType::FunctionDeclaration:
+      case NodeType::StructDeclaration:
+      case NodeType::WhileLoop:
+        break;
+      default:
+        if (stmt->kind >= NodeType::AssignmentExpr) {
+          stmt = hoistExpr(static_cast<Expr *>(stmt), effects, moved);
+        }
+        break;
+      }
+    }
+  }
+
+  // Replaces the largest invariant expressions in expr by the variables that
+  // will hold them.
+  Expr *hoistExpr(Expr *expr, const LoopEffects &effects, Moved &moved) {
+    if (expr == nullptr) {
+      return nullptr;
+    }
+
+    // A variable or literal alone is not worth one.
+    if (expr->kind != NodeType::NumericLiteral &&
+        expr->kind != NodeType::Identifier && isInvariant(expr, effects)) {
+      Symbol name = SymbolTable::intern("invariant " +
+                                        std::to_string(totals.expressions++));
+      moved.emplace_back(name, expr);
+      auto variable = arena.make<IdentifierExpr>(name);
+      variable->numeric = true;
+      return variable;
+    }
+
+    switch (expr->kind) {
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(expr);
+      if (assignment->assigne->kind != NodeType::Identifier) {
+        assignment->assigne = hoistExpr(assignment->assigne, effects, moved);
+      }
+      assignment->value = hoistExpr(assignment->value, effects, moved);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(expr);
+      binop->left = hoistExpr(binop->left, effects, moved);
+      binop->right = hoistExpr(binop->right, effects, moved);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(expr);
+      logical->left = hoistExpr(logical->left, effects, moved);
+      logical->right = hoistExpr(logical->right, effects, moved);
+      break;
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<UnaryExpr *>(expr);
+      unary->right = hoistExpr(unary->right, effects, moved);
+      break;
+    }
+    case NodeType::CallExpr: {
+      auto call = static_cast<CallExpr *>(expr);
+      if (call->caller->kind != NodeType::Identifier) {
+        call->caller = hoistExpr(call->caller, effects, moved);
+      }
+      for (Expr *&arg : call->args) {
+        arg = hoistExpr(arg, effects, moved);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<MemberAccessExpr *>(expr);
+      member->object = hoistExpr(member->object, effects, moved);
+      break;
+    }
+    default:
+      break;
+    }
+    return expr;
+  }
+
+  // Whether expr computes the same number on every iteration of the loop and
+  // cannot fail.
+  bool isInvariant(const Expr *expr, const LoopEffects &effects) const {
+    if (!expr->numeric) {
+      return false;
+    }
+
+    switch (expr->kind) {
+    case NodeType::NumericLiteral:
+      return true;
+    case NodeType::Identifier: {
+      Symbol name = static_cast<const IdentifierExpr *>(expr)->symbol;
+      return effects.changed.count(name) == 0 &&
+             !(effects.callsScript &&
+               names.assignedByFunctions.count(name) != 0);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(expr);
+      if ((binop->binaryOperator == Operator::Divide ||
+           binop->binaryOperator == Operator::Modulo) &&
+          (binop->right->kind != NodeType::NumericLiteral ||
+           static_cast<const NumericLiteral *>(binop->right)->value == 0)) {
+        return false;
+      }
+      return isInvariant(binop->left, effects) &&
+             isInvariant(binop->right, effects);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(expr);
+      return isInvariant(logical->left, effects) &&
+             isInvariant(logical->right, effects);
+    }
+    case NodeType::UnaryExpr:
+      return isInvariant(static_cast<const UnaryExpr *>(expr)->right, effects);
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(expr);
+      if (call->caller->kind != NodeType::Identifier) {
+        return false;
+      }
+      auto builtin = mathBuiltins.find(
+          static_cast<const IdentifierExpr *>(call->caller)->symbol);
+      if (builtin == mathBuiltins.end()) {
+        return false;
+      }
+      if (builtin->second < 0 ? call->args.empty()
+                              : call->args.size() !=
+                                    static_cast<size_t>(builtin->second)) {
+        return false;
+      }
+      for (const Expr *arg : call->args) {
+        if (!isInvariant(arg, effects)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+};
+
+} // namespace
+
+void hoistInvariants(Program &program) { Hoister(program).hoist(program); }
+
+HoistStats hoistStats() { return totals; }
+
+void printHoistStats(std::ostream &out) {
+  out << "Hoisted: " << totals.expressions << " expressions out of "
+      << totals.loops << " loops" << std::endl;
+}
@@ -0,0 +1,41 @@
+#ifndef HOIST_AST_H
+#define HOIST_AST_H
+
+#include "AST.h"
+
+#include <cstdint>
+#include <ostream>
+
+// Moves the expressions of a while loop that compute the same number on
+// every iteration out of it, so that `while (i <= sqrt(number))` calls sqrt
+// once. Each one is stored in a variable of its own before the loop, which
+// the loop reads instead.
+//
+// An expression is moved when inferTypes (TypesAST.h) proved it and every
+// expression in it a number, and it cannot fail, so running it once before
+// the loop, even when the loop runs zero times, prints and fails exactly as
+// running it in the loop does. It may use numeric literals, arithmetic,
+// comparisons, logical and unary operators, divisions by a literal other
+// than 0, the math builtins (sqrt, pow, floor and the like) and variables
+// that the loop neither declares nor assigns. Scoping is dynamic, so when
+// the loop calls anything but a builtin, a variable that any function
+// assigns is not used either. Fields of structs are never read by a moved
+// expression, they may be written anywhere.
+//
+// The variables are named so that no script can name them. As a loop in a
+// loop cannot declare them on every iteration, they are declared before the
+// outermost loop and assigned before the loop they were moved out of.
+//
+// Runs after inferTypes and before resolveProgram, on whole scripts only.
+void hoistInvariants(Program &program);
+
+// What hoistInvariants did to every program of a run.
+struct HoistStats {
+  uint64_t expressions = 0;
+  uint64_t loops = 0;
+};
+
+HoistStats hoistStats();
+void printHoistStats(std::ostream &out);
+
+#endif
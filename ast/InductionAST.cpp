@@ -0,0 +1,250 @@
+#include "InductionAST.h"
+#include "NamesAST.h"
+
+#include <unordered_set>
+
+namespace {
+
+class InductionFinder {
+public:
+  explicit InductionFinder(Program &program) : arena(program.arena) {}
+
+  void mark(Program &program) {
+    names = collectProgramNames(program.body);
+    markBody(program.body);
+  }
+
+private:
+  // What the statements of a loop other than the increment may do.
+  struct LoopEffects {
+    // Names they declare or assign.
+    std::unordered_set<Symbol> changed;
+    // Names they read.
+    std::unordered_set<Symbol> read;
+    // Whether they call anything but a builtin, or declare a function.
+    bool callsScript = false;
+  };
+
+  AstArena &arena;
+  ProgramNames names;
+
+  void markBody(const NodeList<Stmt> &body) {
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::FunctionDeclaration:
+        markBody(static_cast<FunctionDeclaration *>(stmt)->body);
+        break;
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        markBody(ifStmt->ifBody);
+        markBody(ifStmt->elseBody);
+        break;
+      }
+      case NodeType::WhileLoop: {
+        auto loop = static_cast<WhileLoop *>(stmt);
+        markBody(loop->loopBody);
+        markLoop(loop);
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+
+  void markLoop(WhileLoop *loop) {
+    if (!loop->condition->numeric ||
+        loop->condition->kind != NodeType::BinaryExpr ||
+        loop->loopBody.empty()) {
+      return;
+    }
+    auto condition = static_cast<BinaryExpr *>(loop->condition);
+    switch (condition->binaryOperator) {
+    case Operator::Less:
+    case Operator::LessEqual:
+    case Operator::Greater:
+    case Operator::GreaterEqual:
+    case Operator::NotEqual:
+      break;
+    default:
+      return;
+    }
+    if (condition->left->kind != NodeType::Identifier) {
+      return;
+    }
+    auto counter = static_cast<IdentifierExpr *>(condition->left);
+    if (counter->slot < 0) {
+      return;
+    }
+
+    double step;
+    if (!isIncrement(loop->loopBody.back(), counter, step)) {
+      return;
+    }
+
+    LoopEffects effects;
+    for (uint32_t i = 0; i + 1 < loop->loopBody.size(); i++) {
+      effectsOf(loop->loopBody[i], effects);
+    }
+    if (changes(effects, counter->symbol)) {
+      return;
+    }
+
+    Expr *bound = condition->right;
+    if (bound->kind == NodeType::Identifier) {
+      Symbol name = static_cast<IdentifierExpr *>(bound)->symbol;
+      if (name == counter->symbol || changes(effects, name)) {
+        return;
+      }
+    } else if (bound->kind != NodeType::NumericLiteral) {
+      return;
+    }
+
+    loop->counted = arena.make<CountedLoop>();
+    loop->counted->slot = counter->slot;
+    loop->counted->comparison = condition->binaryOperator;
+    loop->counted->bound = bound;
+    loop->counted->step = step;
+    loop->counted->counterRead =
+        effects.callsScript || effects.read.count(counter->symbol) != 0;
+  }
+
+  // Whether stmt is `counter = counter + step` or `counter = counter - step`
+  // with a numeric literal step, which is negated for the latter.
+  static bool isIncrement(const Stmt *stmt, const IdentifierExpr *counter,
+                          double &step) {
+    if (stmt->kind != NodeType::AssignmentExpr) {
+      return false;
+    }
+    auto assignment = static_cast<const AssignmentExpr *>(stmt);
+    if (assignment->assigne->kind != NodeType::Identifier ||
+        static_cast<const IdentifierExpr *>(assignment->assigne)->slot !=
+            counter->slot ||
+        assignment->value->kind != NodeType::BinaryExpr) {
+      return false;
+    }
+    auto value = static_cast<const BinaryExpr *>(assignment->value);
+    if ((value->binaryOperator != Operator::Add &&
+         value->binaryOperator != Operator::Subtract) ||
+        value->left->kind != NodeType::Identifier ||
+        static_cast<const IdentifierExpr *>(value->left)->slot !=
+            counter->slot ||
+        value->right->kind != NodeType::NumericLiteral) {
+      return false;
+    }
+    step = static_cast<const NumericLiteral *>(value->right)->value;
+    if (value->binaryOperator == Operator::Subtract) {
+      step = -step;
+    }
+    return true;
+  }
+
+  bool changes(const LoopEffects &effects, Symbol name) const {
+    return effects.changed.count(name) != 0 ||
+           (effects.callsScript &&
+            names.assignedByFunctions.count(name) != 0);
+  }
+
+  void effectsOf(const NodeList<Stmt> &body, LoopEffects &effects) {
+    for (const Stmt *stmt : body) {
+      effectsOf(stmt, effects);
+    }
+  }
+
+  void effectsOf(const Stmt *stmt, LoopEffects &effects) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      effects.changed.insert(declaration->identifier);
+      effectsOf(declaration->value, effects);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      // Its body may run whenever it is called, before or after the loop.
+      effects.changed.insert(
+          static_cast<const FunctionDeclaration *>(stmt)->name);
+      effects.callsScript = true;
+      break;
+    case NodeType::StructDeclaration:
+      effects.changed.insert(
+          static_cast<const StructDeclaration *>(stmt)->structName);
+      effectsOf(static_cast<const StructDeclaration *>(stmt)->structBody,
+                effects);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      effectsOf(ifStmt->condition, effects);
+      effectsOf(ifStmt->ifBody, effects);
+      effectsOf(ifStmt->elseBody, effects);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      effectsOf(loop->condition, effects);
+      effectsOf(loop->loopBody, effects);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      effectsOf(static_cast<const ReturnStatement *>(stmt)->returnValue,
+                effects);
+      break;
+    case NodeType::Identifier:
+      effects.read.insert(static_cast<const IdentifierExpr *>(stmt)->symbol);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        effects.changed.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      } else {
+        effectsOf(assignment->assigne, effects);
+      }
+      effectsOf(assignment->value, effects);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      effectsOf(binop->left, effects);
+      effectsOf(binop->right, effects);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      effectsOf(logical->left, effects);
+      effectsOf(logical->right, effects);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      effectsOf(static_cast<const UnaryExpr *>(stmt)->right, effects);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      if (call->caller->kind != NodeType::Identifier ||
+          !names.isBuiltin(
+              static_cast<const IdentifierExpr *>(call->caller)->symbol)) {
+        effects.callsScript = true;
+      }
+      effectsOf(call->caller, effects);
+      for (const Expr *arg : call->args) {
+        effectsOf(arg, effects);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      effectsOf(static_cast<const MemberAccessExpr *>(stmt)->object, effects);
+      break;
+    default:
+      break;
+    }
+  }
+};
+
+} // namespace
+
+void markCountedLoops(Program &program) {
+  InductionFinder(program).mark(program);
+}
@@ -0,0 +1,25 @@
+#ifndef INDUCTION_AST_H
+#define INDUCTION_AST_H
+
+#include "AST.h"
+
+// Sets WhileLoop::counted of the loops that count a variable up or down to
+// a bound, `let i = 0; while (i < n) { ...; i = i + 1; }`, which the tree
+// walking evaluator then runs without boxing the counter, evaluating the
+// condition or assigning the increment.
+//
+// Such a loop
+//  - compares a variable with a slot to a numeric literal or to a variable
+//    it does not change, and inferTypes (TypesAST.h) proved both numbers,
+//  - ends its body with `i = i + step` or `i = i - step` for a numeric
+//    literal step, and assigns or declares the counter nowhere else,
+//  - when it calls anything but a builtin, counts a variable that no
+//    function assigns, as scoping is dynamic.
+// The counter is only written back to its slot before every iteration when
+// the body reads it or calls a function that might; otherwise once the loop
+// ends or returns.
+//
+// Runs after resolveProgram, which assigns the slots.
+void markCountedLoops(Program &program);
+
+#endif
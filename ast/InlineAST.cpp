@@ -0,0 +1,457 @@
+#include "InlineAST.h"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+InlineStats totals;
+
+// Most nodes the expression of an inlined function may have.
+const uint64_t INLINE_BUDGET = 24;
+
+class Inliner {
+public:
+  explicit Inliner(Program &program) : arena(program.arena) {}
+
+  void inlineProgram(Program &program) {
+    collectNames(program.body);
+    for (Stmt *stmt : program.body) {
+      if (stmt->kind == NodeType::FunctionDeclaration) {
+        addCandidate(static_cast<FunctionDeclaration *>(stmt));
+      }
+    }
+    if (candidates.empty()) {
+      return;
+    }
+
+    Scope scope;
+    inlineBody(program.body, scope);
+    totals.functions += inlined.size();
+  }
+
+private:
+  // Names declared for sure at some point of a body.
+  struct Scope {
+    std::unordered_set<Symbol> declared;
+    // In a function, the names the top level declared for sure before the
+    // function was declared; null at the top level.
+    const std::unordered_set<Symbol> *globals = nullptr;
+  };
+
+  AstArena &arena;
+  // How many times the program declares every name, anywhere.
+  std::unordered_map<Symbol, int> declarations;
+  // Names declared by struct declarations only.
+  std::unordered_set<Symbol> structNames;
+  std::unordered_set<Symbol> nonStructNames;
+  // Every name the program assigns.
+  std::unordered_set<Symbol> assignedNames;
+  std::unordered_map<Symbol, FunctionDeclaration *> candidates;
+  std::unordered_set<Symbol> inlined;
+
+  void declare(Symbol name, bool isStruct) {
+    declarations[name]++;
+    (isStruct ? structNames : nonStructNames).insert(name);
+  }
+
+  void collectNames(const NodeList<Stmt> &body) {
+    for (const Stmt *stmt : body) {
+      collectNames(stmt);
+    }
+  }
+
+  void collectNames(const Stmt *stmt) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      declare(declaration->identifier, false);
+      collectNames(declaration->value);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      auto function = static_cast<const FunctionDeclaration *>(stmt);
+      declare(function->name, false);
+      for (Symbol parameter : function->parameters) {
+        declare(parameter, false);
+      }
+      collectNames(function->body);
+      break;
+    }
+    case NodeType::StructDeclaration: {
+      auto structDecl = static_cast<const StructDeclaration *>(stmt);
+      declare(structDecl->structName, true);
+      for (const Stmt *field : structDecl->structBody) {
+        if (field->kind == NodeType::VarDeclaration) {
+          collectNames(static_cast<const VarDeclaration *>(field)->value);
+        }
+      }
+      break;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      collectNames(ifStmt->condition);
+      collectNames(ifStmt->ifBody);
+      collectNames(ifStmt->elseBody);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      collectNames(loop->condition);
+      collectNames(loop->loopBody);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      collectNames(static_cast<const ReturnStatement *>(stmt)->returnValue);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        assignedNames.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      }
+      collectNames(assignment->assigne);
+      collectNames(assignment->value);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      collectNames(binop->left);
+      collectNames(binop->right);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      collectNames(logical->left);
+      collectNames(logical->right);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      collectNames(static_cast<const UnaryExpr *>(stmt)->right);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      collectNames(call->caller);
+      for (const Expr *arg : call->args) {
+        collectNames(arg);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      collectNames(static_cast<const MemberAccessExpr *>(stmt)->object);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void addCandidate(FunctionDeclaration *function) {
+    if (declarations[function->name] != 1 ||
+        assignedNames.count(function->name) != 0 ||
+        function->body.size() != 1 ||
+        function->body[0]->kind != NodeType::ReturnStatement) {
+      return;
+    }
+    Stmt *value =
+        static_cast<ReturnStatement *>(function->body[0])->returnValue;
+    if (value == nullptr || value->kind < NodeType::AssignmentExpr) {
+      return;
+    }
+
+    // Declaring a parameter fails for a builtin name in the evaluator.
+    std::unordered_set<Symbol> parameters;
+    for (Symbol parameter : function->parameters) {
+      if (isBuiltinName(parameter) || !parameters.insert(parameter).second) {
+        return;
+      }
+    }
+
+    uint64_t nodes = 0;
+    if (isInlinable(static_cast<Expr *>(value), nodes) &&
+        nodes <= INLINE_BUDGET) {
+      candidates.emplace(function->name, function);
+    }
+  }
+
+  // Whether expr may be evaluated where the function is called instead of
+  // in it. Counts its nodes into nodes.
+  bool isInlinable(const Expr *expr, uint64_t &nodes) const {
+    nodes++;
+    switch (expr->kind) {
+    case NodeType::NumericLiteral:
+    case NodeType::StrLiteral:
+    case NodeType::Null:
+    case NodeType::Identifier:
+      return true;
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(expr);
+      return isInlinable(binop->left, nodes) &&
+             isInlinable(binop->right, nodes);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(expr);
+      return isInlinable(logical->left, nodes) &&
+             isInlinable(logical->right, nodes);
+    }
+    case NodeType::UnaryExpr:
+      return isInlinable(static_cast<const UnaryExpr *>(expr)->right, nodes);
+    case NodeType::MemberAccessExpr:
+      return isInlinable(static_cast<const MemberAccessExpr *>(expr)->object,
+                         nodes);
+    case NodeType::CallExpr: {
+      // A builtin or a struct runs no code of the script.
+      auto call = static_cast<const CallExpr *>(expr);
+      if (call->caller->kind != NodeType::Identifier) {
+        return false;
+      }
+      Symbol name = static_cast<const IdentifierExpr *>(call->caller)->symbol;
+      bool builtin = isBuiltinName(name) && declarations.count(name) == 0;
+      bool structure = structNames.count(name) != 0 &&
+                       nonStructNames.count(name) == 0 &&
+                       assignedNames.count(name) == 0;
+      if (!builtin && !structure) {
+        return false;
+      }
+      nodes++;
+      for (const Expr *arg : call->args) {
+        if (!isInlinable(arg, nodes)) {
+          return false;
+        }
+      }
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+
+  bool isDeclared(Symbol name, const Scope &scope) const {
+    if (scope.declared.count(name) != 0 ||
+        (isBuiltinName(name) && declarations.count(name) == 0)) {
+      return true;
+    }
+    // Declared once, so no caller of the function holds another one.
+    auto found = declarations.find(name);
+    return scope.globals != nullptr && scope.globals->count(name) != 0 &&
+           found != declarations.end() && found->second == 1;
+  }
+
+  void inlineBody(NodeList<Stmt> &body, Scope &scope) {
+    for (Stmt *&stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::VarDeclaration: {
+        auto declaration = static_cast<VarDeclaration *>(stmt);
+        if (declaration->value != nullptr) {
+          declaration->value = inlineExpr(declaration->value, scope);
+        }
+        scope.declared.insert(declaration->identifier);
+        break;
+      }
+      case NodeType::FunctionDeclaration: {
+        auto function = static_cast<FunctionDeclaration *>(stmt);
+        const std::unordered_set<Symbol> &globals =
+            scope.globals != nullptr ? *scope.globals : scope.declared;
+        Scope functionScope;
+        functionScope.globals = &globals;
+        functionScope.declared.insert(function->parameters.begin(),
+                                      function->parameters.end());
+        inlineBody(function->body, functionScope);
+        scope.declared.insert(function->name);
+        break;
+      }
+      case NodeType::StructDeclaration: {
+        auto structDecl = static_cast<StructDeclaration *>(stmt);
+        for (Stmt *field : structDecl->structBody) {
+          if (field->kind == NodeType::VarDeclaration) {
+            auto declaration = static_cast<VarDeclaration *>(field);
+            if (declaration->value != nullptr) {
+              declaration->value = inlineExpr(declaration->value, scope);
+            }
+          }
+        }
+        scope.declared.insert(structDecl->structName);
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        ifStmt->condition = inlineExpr(ifStmt->condition, scope);
+        Scope ifScope = scope;
+        inlineBody(ifStmt->ifBody, ifScope);
+        Scope elseScope = scope;
+        inlineBody(ifStmt->elseBody, elseScope);
+        break;
+      }
+      case NodeType::WhileLoop: {
+        auto loop = static_cast<WhileLoop *>(stmt);
+        loop->condition = inlineExpr(loop->condition, scope);
+        Scope bodyScope = scope;
+        inlineBody(loop->loopBody, bodyScope);
+        break;
+      }
+      case NodeType::ReturnStatement: {
+        auto returnStmt = static_cast<ReturnStatement *>(stmt);
+        if (returnStmt->returnValue != nullptr &&
+            returnStmt->returnValue->kind >= NodeType::AssignmentExpr) {
+          returnStmt->returnValue =
+              inlineExpr(static_cast<Expr *>(returnStmt->returnValue), scope);
+        }
+        break;
+      }
+      default:
+        if (stmt->kind >= NodeType::AssignmentExpr) {
+          stmt = inlineExpr(static_cast<Expr *>(stmt), scope);
+        }
+        break;
+      }
+    }
+  }
+
+  Expr *inlineExpr(Expr *expr, const Scope &scope) {
+    switch (expr->kind) {
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(expr);
+      assignment->assigne = inlineExpr(assignment->assigne, scope);
+      assignment->value = inlineExpr(assignment->value, scope);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(expr);
+      binop->left = inlineExpr(binop->left, scope);
+      binop->right = inlineExpr(binop->right, scope);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(expr);
+      logical->left = inlineExpr(logical->left, scope);
+      logical->right = inlineExpr(logical->right, scope);
+      break;
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<UnaryExpr *>(expr);
+      unary->right = inlineExpr(unary->right, scope);
+      break;
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<MemberAccessExpr *>(expr);
+      member->object = inlineExpr(member->object, scope);
+      break;
+    }
+    case NodeType::CallExpr: {
+      auto call = static_cast<CallExpr *>(expr);
+      call->caller = inlineExpr(call->caller, scope);
+      for (Expr *&arg : call->args) {
+        arg = inlineExpr(arg, scope);
+      }
+      return inlineCall(call, scope);
+    }
+    default:
+      break;
+    }
+    return expr;
+  }
+
+  Expr *inlineCall(CallExpr *call, const Scope &scope) {
+    if (call->caller->kind != NodeType::Identifier) {
+      return call;
+    }
+    Symbol name = static_cast<IdentifierExpr *>(call->caller)->symbol;
+    auto candidate = candidates.find(name);
+    if (candidate == candidates.end() || !isDeclared(name, scope)) {
+      return call;
+    }
+    FunctionDeclaration *function = candidate->second;
+    if (call->args.size() != function->parameters.size()) {
+      return call;
+    }
+    for (Expr *arg : call->args) {
+      bool literal = arg->kind == NodeType::NumericLiteral ||
+                     arg->kind == NodeType::StrLiteral ||
+                     arg->kind == NodeType::Null;
+      if (!literal &&
+          !(arg->kind == NodeType::Identifier &&
+            isDeclared(static_cast<IdentifierExpr *>(arg)->symbol, scope))) {
+        return call;
+      }
+    }
+
+    std::unordered_map<Symbol, Expr *> arguments;
+    for (uint32_t i = 0; i < call->args.size(); i++) {
+      arguments.emplace(function->parameters[i], call->args[i]);
+    }
+    totals.calls++;
+    inlined.insert(name);
+    return copy(
+        static_cast<Expr *>(
+            static_cast<ReturnStatement *>(function->body[0])->returnValue),
+        arguments);
+  }
+
+  // Fresh nodes for expr, with the parameters replaced by copies of the
+  // arguments. Nodes keep what the evaluator learns about them, so no two
+  // call sites share one.
+  Expr *copy(const Expr *expr,
+             const std::unordered_map<Symbol, Expr *> &arguments) {
+    switch (expr->kind) {
+    case NodeType::NumericLiteral:
+      return arena.make<NumericLiteral>(
+          static_cast<const NumericLiteral *>(expr)->value);
+    case NodeType::StrLiteral:
+      return arena.make<StrLiteral>(
+          static_cast<const StrLiteral *>(expr)->value);
+    case NodeType::Null:
+      return arena.make<NullLiteral>();
+    case NodeType::Identifier: {
+      Symbol name = static_cast<const IdentifierExpr *>(expr)->symbol;
+      auto argument = arguments.find(name);
+      if (argument != arguments.end()) {
+        return copy(argument->second, {});
+      }
+      return arena.make<IdentifierExpr>(name);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(expr);
+      return arena.make<BinaryExpr>(copy(binop->left, arguments),
+                                    copy(binop->right, arguments),
+                                    binop->binaryOperator);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(expr);
+      return arena.make<LogicalExpr>(copy(logical->left, arguments),
+                                     copy(logical->right, arguments),
+                                     logical->logicalOperator);
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<const UnaryExpr *>(expr);
+      return arena.make<UnaryExpr>(copy(unary->right, arguments), unary->op);
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<const MemberAccessExpr *>(expr);
+      return arena.make<MemberAccessExpr>(copy(member->object, arguments),
+                                          member->memberName);
+    }
+    default: {
+      auto call = static_cast<const CallExpr *>(expr);
+      NodeList<Expr> args = arena.makeArray<Expr *>(call->args.size());
+      for (uint32_t i = 0; i < call->args.size(); i++) {
+        args[i] = copy(call->args[i], arguments);
+      }
+      return arena.make<CallExpr>(copy(call->caller, arguments), args);
+    }
+    }
+  }
+};
+
+} // namespace
+
+void inlineCalls(Program &program) { Inliner(program).inlineProgram(program); }
+
+InlineStats inlineStats() { return totals; }
+
+void printInlineStats(std::ostream &out) {
+  out << "Inlined: " << totals.calls << " calls of " << totals.functions
+      << " functions" << std::endl;
+}
@@ -0,0 +1,39 @@
+#ifndef INLINE_AST_H
+#define INLINE_AST_H
+
+#include "AST.h"
+
+#include <cstdint>
+#include <ostream>
+
+// Replaces calls of small functions by the expression they return, so
+// `add(x, y)` of `func add(num1, num2) { return num1 + num2; }` becomes
+// `x + y` and makes no call at all.
+//
+// A function is inlined when
+//  - it is declared once, at the top level, and never assigned, so its
+//    name always holds it (functions are constant),
+//  - its body is a single return of an expression of at most INLINE_BUDGET
+//    nodes that assigns nothing and calls only builtins and structs. A
+//    function it called could read its parameters, as scoping is dynamic,
+//    which the inlined expression has no more,
+// and a call of it is replaced when it passes every parameter, and its
+// arguments are literals or variables declared for sure where it is made,
+// as is the function. Evaluating the arguments then cannot fail, and the
+// expression reads the other names it uses in the same environments at the
+// same time as the call would.
+//
+// Runs first, before foldConstants, which may fold what was inlined. Only
+// whole scripts are inlined: a later line of the REPL may declare any name.
+void inlineCalls(Program &program);
+
+// What inlineCalls did to every program of a run.
+struct InlineStats {
+  uint64_t calls = 0;
+  uint64_t functions = 0;
+};
+
+InlineStats inlineStats();
+void printInlineStats(std::ostream &out);
+
+#endif
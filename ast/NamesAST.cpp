@@ -0,0 +1,120 @@
+#include "NamesAST.h"
+
+namespace {
+
+class NameCollector {
+public:
+  explicit NameCollector(ProgramNames &names) : names(names) {}
+
+  void collect(const NodeList<Stmt> &body, bool inFunction) {
+    for (const Stmt *stmt : body) {
+      collect(stmt, inFunction);
+    }
+  }
+
+  void collect(const Stmt *stmt, bool inFunction) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<const VarDeclaration *>(stmt);
+      names.declared.insert(declaration->identifier);
+      collect(declaration->value, inFunction);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      auto function = static_cast<const FunctionDeclaration *>(stmt);
+      names.declared.insert(function->name);
+      for (Symbol parameter : function->parameters) {
+        names.declared.insert(parameter);
+      }
+      collect(function->body, true);
+      break;
+    }
+    case NodeType::StructDeclaration: {
+      auto structDecl = static_cast<const StructDeclaration *>(stmt);
+      names.declared.insert(structDecl->structName);
+      collect(structDecl->structBody, inFunction);
+      break;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<const IfStatement *>(stmt);
+      collect(ifStmt->condition, inFunction);
+      collect(ifStmt->ifBody, inFunction);
+      collect(ifStmt->elseBody, inFunction);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<const WhileLoop *>(stmt);
+      collect(loop->condition, inFunction);
+      collect(loop->loopBody, inFunction);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      collect(static_cast<const ReturnStatement *>(stmt)->returnValue,
+              inFunction);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      if (inFunction && assignment->assigne->kind == NodeType::Identifier) {
+        names.assignedByFunctions.insert(
+            static_cast<const IdentifierExpr *>(assignment->assigne)->symbol);
+      } else if (inFunction &&
+                 assignment->assigne->kind == NodeType::MemberAccessExpr) {
+        names.fieldsAssignedByFunctions.insert(
+            static_cast<const MemberAccessExpr *>(assignment->assigne)
+                ->memberName);
+      }
+      collect(assignment->assigne, inFunction);
+      collect(assignment->value, inFunction);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      collect(binop->left, inFunction);
+      collect(binop->right, inFunction);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      collect(logical->left, inFunction);
+      collect(logical->right, inFunction);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      collect(static_cast<const UnaryExpr *>(stmt)->right, inFunction);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      collect(call->caller, inFunction);
+      for (const Expr *arg : call->args) {
+        collect(arg, inFunction);
+      }
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      collect(static_cast<const MemberAccessExpr *>(stmt)->object,
+              inFunction);
+      break;
+    default:
+      break;
+    }
+  }
+
+private:
+  ProgramNames &names;
+};
+
+} // namespace
+
+bool ProgramNames::isBuiltin(Symbol name) const {
+  return isBuiltinName(name) && declared.count(name) == 0;
+}
+
+ProgramNames collectProgramNames(const NodeList<Stmt> &program) {
+  ProgramNames names;
+  NameCollector(names).collect(program, false);
+  return names;
+}
@@ -0,0 +1,28 @@
+#ifndef NAMES_AST_H
+#define NAMES_AST_H
+
+#include "AST.h"
+
+#include <unordered_set>
+
+// The names of a whole script that the passes moving or reusing expressions
+// (hoistInvariants, markCountedLoops, eliminateCommonSubexpressions) check
+// what running some of it may change against. Scoping is dynamic, so a
+// function may assign a variable of whichever function called it.
+struct ProgramNames {
+  // Every name the program declares anywhere.
+  std::unordered_set<Symbol> declared;
+  // Every name assigned in the body of a function, which may be a variable of
+  // whichever function called it.
+  std::unordered_set<Symbol> assignedByFunctions;
+  // Every field assigned in the body of a function, of whichever struct.
+  std::unordered_set<Symbol> fieldsAssignedByFunctions;
+
+  // Whether name holds its builtin wherever it is read. A parameter of the VM
+  // may hide a builtin, so no name the program declares does.
+  bool isBuiltin(Symbol name) const;
+};
+
+ProgramNames collectProgramNames(const NodeList<Stmt> &program);
+
+#endif
@@ -22,7 +22,7 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
   switch (stmt.kind) {
   case NodeType::Identifier: {
     const auto &id = static_cast<const IdentifierExpr &>(stmt);
-    std::cout << indent << "  \"Symbol\": \"" << id.symbol << "\"";
+    std::cout << indent << "  \"Symbol\": \"" << SymbolTable::name(id.symbol) << "\"";
     break;
   }
   case NodeType::NumericLiteral: {
@@ -38,7 +38,7 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
   case NodeType::BinaryExpr: {
     const auto &binaryExpr = static_cast<const BinaryExpr &>(stmt);
     std::cout << indent << "  \"BinaryOperator\": \""
-              << binaryExpr.binaryOperator << "\",\n";
+              << OperatorToString(binaryExpr.binaryOperator) << "\",\n";
     std::cout << indent << "  \"Left\": ";
     printStatement(*binaryExpr.left, indent + "    ");
     std::cout << ",\n";
@@ -51,7 +51,7 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
     std::cout << indent
               << "  \"Constant\": " << (varDecl.constant ? "true" : "false")
               << ",\n";
-    std::cout << indent << "  \"Identifier\": \"" << varDecl.identifier
+    std::cout << indent << "  \"Identifier\": \"" << SymbolTable::name(varDecl.identifier)
               << "\",\n";
     std::cout << indent << "  \"Value\": ";
     if (varDecl.value) {
@@ -79,10 +79,11 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
   }
   case NodeType::FunctionDeclaration: {
     const auto &funcDecl = static_cast<const FunctionDeclaration &>(stmt);
-    std::cout << indent << "  \"Name\": \"" << funcDecl.name << "\",\n";
+    std::cout << indent << "  \"Name\": \"" << SymbolTable::name(funcDecl.name)
+              << "\",\n";
     std::cout << indent << "  \"Parameters\": [\n";
     for (const auto &param : funcDecl.parameters) {
-      std::cout << indent << "    \"" << param << "\"";
+      std::cout << indent << "    \"" << SymbolTable::name(param) << "\"";
       if (&param != &funcDecl.parameters.back()) {
         std::cout << ",";
       }
@@ -144,7 +145,7 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
   case NodeType::StructDeclaration: {
     const StructDeclaration &structDecl =
         static_cast<const StructDeclaration &>(stmt);
-    std::cout << indent << "  \"StructName\": \"" << structDecl.structName
+    std::cout << indent << "  \"StructName\": \"" << SymbolTable::name(structDecl.structName)
               << "\"";
     for (const auto &stmt : structDecl.structBody) {
       printStatement(*stmt, indent + "  ");
@@ -156,13 +157,13 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
     std::cout << indent << "  \"Object\": ";
     printStatement(*memberAccessExpr.object, indent + "    ");
     std::cout << ",\n";
-    std::cout << indent << "  \"MemberName\": \"" << memberAccessExpr.memberName
+    std::cout << indent << "  \"MemberName\": \"" << SymbolTable::name(memberAccessExpr.memberName)
               << "\"";
     break;
   }
   case NodeType::LogicalExpr: {
 	const auto &logicalExpr = static_cast<const LogicalExpr &>(stmt);
-	std::cout << indent << "  \"LogicalOperator\": \"" << logicalExpr.logicalOperator << "\",\n";
+	std::cout << indent << "  \"LogicalOperator\": \"" << OperatorToString(logicalExpr.logicalOperator) << "\",\n";
 	std::cout << indent << "  \"Left\": ";
 	printStatement(*logicalExpr.left, indent + "    ");
 	std::cout << ",\n";
@@ -199,13 +200,12 @@ void printStatement(const Stmt &stmt, const std::string &indent) {
     break;
   }
   case NodeType::Null: {
-    const auto &nullNode = static_cast<const NullLiteral &>(stmt);
-    std::cout << indent << "  \"Value\": \"" << nullNode.value << "\"";
+    std::cout << indent << "  \"Value\": \"null\"";
     break;
   }
   case NodeType::UnaryExpr: {
     const auto &unaryExpr = static_cast<const UnaryExpr &>(stmt);
-    std::cout << indent << "  \"Operator\": \"" << unaryExpr.op << "\",\n";
+    std::cout << indent << "  \"Operator\": \"" << OperatorToString(unaryExpr.op) << "\",\n";
     std::cout << indent << "  \"Right\": ";
     printStatement(*unaryExpr.right, indent + "    ");
     break;
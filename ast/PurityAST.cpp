@@ -0,0 +1,224 @@
+#include "PurityAST.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+class Purity {
+public:
+  void analyze(const NodeList<Stmt> &program) {
+    collectDeclarations(program);
+    for (const char *name : PURE_BUILTINS) {
+      Symbol symbol = SymbolTable::intern(name);
+      if (isBuiltin(symbol)) {
+        pureBuiltins.insert(symbol);
+      }
+    }
+
+    // Every function starts out memoizable and loses it once it breaks a
+    // rule, calls of functions that lost it included, until nothing changes.
+    for (FunctionDeclaration *function : functions) {
+      function->memoizable = true;
+    }
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (FunctionDeclaration *function : functions) {
+        if (function->memoizable && !isPure(function)) {
+          function->memoizable = false;
+          changed = true;
+        }
+      }
+    }
+  }
+
+private:
+  std::vector<FunctionDeclaration *> functions;
+  std::unordered_multimap<Symbol, FunctionDeclaration *> functionsByName;
+  // Names of lets, consts, parameters and structs.
+  std::unordered_set<Symbol> otherNames;
+  std::unordered_set<Symbol> pureBuiltins;
+
+  // Variables of the function being checked that are declared wherever the
+  // code being checked runs.
+  std::vector<Symbol> declared;
+
+  void collectDeclarations(const NodeList<Stmt> &body) {
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::VarDeclaration:
+        otherNames.insert(static_cast<VarDeclaration *>(stmt)->identifier);
+        break;
+      case NodeType::StructDeclaration:
+        otherNames.insert(static_cast<StructDeclaration *>(stmt)->structName);
+        break;
+      case NodeType::FunctionDeclaration: {
+        auto function = static_cast<FunctionDeclaration *>(stmt);
+        functions.push_back(function);
+        functionsByName.emplace(function->name, function);
+        for (Symbol parameter : function->parameters) {
+          otherNames.insert(parameter);
+        }
+        collectDeclarations(function->body);
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        collectDeclarations(ifStmt->ifBody);
+        collectDeclarations(ifStmt->elseBody);
+        break;
+      }
+      case NodeType::WhileLoop:
+        collectDeclarations(static_cast<WhileLoop *>(stmt)->loopBody);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  bool isPure(FunctionDeclaration *function) {
+    declared.clear();
+    for (Symbol parameter : function->parameters) {
+      if (isDeclared(parameter)) {
+        return false;
+      }
+      declared.push_back(parameter);
+    }
+    return isPureBody(function->body);
+  }
+
+  // A name that holds its builtin, one the script declares nowhere. Reading
+  // one is pure, calling it only when it is in PURE_BUILTINS.
+  bool isBuiltin(Symbol name) const {
+    return isBuiltinName(name) && functionsByName.count(name) == 0 &&
+           otherNames.count(name) == 0;
+  }
+
+  bool isDeclared(Symbol name) const {
+    return std::find(declared.begin(), declared.end(), name) !=
+           declared.end();
+  }
+
+  // A function of the program whose every declaration is memoizable.
+  bool isPureFunction(Symbol name) const {
+    if (otherNames.count(name) != 0) {
+      return false;
+    }
+    auto declarations = functionsByName.equal_range(name);
+    if (declarations.first == declarations.second) {
+      return false;
+    }
+    for (auto it = declarations.first; it != declarations.second; ++it) {
+      if (!it->second->memoizable) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool isPureBody(const NodeList<Stmt> &body) {
+    size_t mark = declared.size();
+    for (Stmt *stmt : body) {
+      if (!isPureStmt(stmt)) {
+        return false;
+      }
+    }
+    declared.resize(mark);
+    return true;
+  }
+
+  bool isPureStmt(Stmt *stmt) {
+    if (stmt == nullptr) {
+      return true;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::NumericLiteral:
+    case NodeType::Null:
+    case NodeType::StrLiteral:
+      return true;
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      if (!isPureStmt(declaration->value)) {
+        return false;
+      }
+      declared.push_back(declaration->identifier);
+      return true;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      return isPureStmt(ifStmt->condition) && isPureBody(ifStmt->ifBody) &&
+             isPureBody(ifStmt->elseBody);
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<WhileLoop *>(stmt);
+      return isPureStmt(loop->condition) && isPureBody(loop->loopBody);
+    }
+    case NodeType::ReturnStatement:
+      return isPureStmt(static_cast<ReturnStatement *>(stmt)->returnValue);
+    case NodeType::Identifier: {
+      Symbol name = static_cast<IdentifierExpr *>(stmt)->symbol;
+      return isDeclared(name) || isPureFunction(name) || isBuiltin(name);
+    }
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(stmt);
+      return assignment->assigne->kind == NodeType::Identifier &&
+             isDeclared(
+                 static_cast<IdentifierExpr *>(assignment->assigne)->symbol) &&
+             isPureStmt(assignment->value);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(stmt);
+      return isPureStmt(binop->left) && isPureStmt(binop->right);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(stmt);
+      return isPureStmt(logical->left) && isPureStmt(logical->right);
+    }
+    case NodeType::UnaryExpr:
+      return isPureStmt(static_cast<UnaryExpr *>(stmt)->right);
+    case NodeType::MemberAccessExpr:
+      return isPureStmt(static_cast<MemberAccessExpr *>(stmt)->object);
+    case NodeType::CallExpr:
+      return isPureCall(static_cast<CallExpr *>(stmt));
+    default:
+      // Declarations of functions and structs.
+      return false;
+    }
+  }
+
+  bool isPureCall(CallExpr *call) {
+    for (Expr *arg : call->args) {
+      if (!isPureStmt(arg)) {
+        return false;
+      }
+    }
+    if (call->caller->kind != NodeType::Identifier) {
+      return false;
+    }
+
+    Symbol name = static_cast<IdentifierExpr *>(call->caller)->symbol;
+    if (pureBuiltins.count(name) != 0) {
+      return true;
+    }
+    if (isDeclared(name) || !isPureFunction(name)) {
+      return false;
+    }
+    // A parameter without an argument is looked up in the callers.
+    auto declarations = functionsByName.equal_range(name);
+    for (auto it = declarations.first; it != declarations.second; ++it) {
+      if (call->args.size() < it->second->parameters.size()) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+} // namespace
+
+void markMemoizable(Program &program) { Purity().analyze(program.body); }
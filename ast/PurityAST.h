@@ -0,0 +1,22 @@
+#ifndef PURITY_AST_H
+#define PURITY_AST_H
+
+#include "AST.h"
+
+// Marks the functions of a program whose calls may be memoized: their result
+// only depends on their arguments and they change nothing but their own
+// variables. Such a function
+//  - reads and assigns only its parameters and the variables it declared
+//    before, never a name its callers could hold (scoping is dynamic),
+//  - assigns no struct field and declares no function or struct,
+//  - calls only functions of the program that are memoizable themselves,
+//    with all of their arguments, and builtins without side effects, so not
+//    print, input or clear.
+// A name counts as a function of the program only when nothing but function
+// declarations declares it.
+//
+// Only whole scripts can be analyzed: a later line of the REPL may declare
+// any name.
+void markMemoizable(Program &program);
+
+#endif
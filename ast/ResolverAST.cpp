@@ -0,0 +1,459 @@
+#include "ResolverAST.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Slots of the function or top level being resolved. A disabled scope has
+// none and leaves every name to the lookup by name.
+class Scope {
+public:
+  explicit Scope(bool enabled) : enabled(enabled) {}
+
+  int32_t find(Symbol name) const {
+    if (!enabled) {
+      return -1;
+    }
+    for (size_t i = 0; i < names.size(); i++) {
+      if (names[i] == name) {
+        return static_cast<int32_t>(i);
+      }
+    }
+    return -1;
+  }
+
+  void add(Symbol name) {
+    if (enabled && find(name) < 0) {
+      names.push_back(name);
+    }
+  }
+
+  const std::vector<Symbol> &symbols() const { return names; }
+
+  void disable() {
+    enabled = false;
+    names.clear();
+  }
+
+  ArenaArray<Symbol> copyTo(AstArena &arena) const {
+    ArenaArray<Symbol> copy = arena.makeArray<Symbol>(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+      copy[i] = names[i];
+    }
+    return copy;
+  }
+
+private:
+  bool enabled;
+  std::vector<Symbol> names;
+};
+
+void collectLocals(const NodeList<Stmt> &body, Scope &scope) {
+  for (Stmt *stmt : body) {
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration:
+      scope.add(static_cast<VarDeclaration *>(stmt)->identifier);
+      break;
+    case NodeType::FunctionDeclaration:
+      scope.add(static_cast<FunctionDeclaration *>(stmt)->name);
+      break;
+    case NodeType::StructDeclaration:
+      scope.add(static_cast<StructDeclaration *>(stmt)->structName);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      collectLocals(ifStmt->ifBody, scope);
+      collectLocals(ifStmt->elseBody, scope);
+      break;
+    }
+    case NodeType::WhileLoop:
+      collectLocals(static_cast<WhileLoop *>(stmt)->loopBody, scope);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void resolveStmt(Stmt *stmt, const Scope &scope, AstArena &arena);
+
+void resolveBody(const NodeList<Stmt> &body, const Scope &scope,
+                 AstArena &arena) {
+  for (Stmt *stmt : body) {
+    resolveStmt(stmt, scope, arena);
+  }
+}
+
+void resolveFunction(FunctionDeclaration *declaration, AstArena &arena) {
+  Scope scope(true);
+
+  for (Symbol parameter : declaration->parameters) {
+    if (scope.find(parameter) >= 0) {
+      // The second declaration of the name fails when the function is
+      // called, which the lookup by name reports on its own.
+      scope.disable();
+      break;
+    }
+    scope.add(parameter);
+  }
+  collectLocals(declaration->body, scope);
+
+  resolveBody(declaration->body, scope, arena);
+  declaration->slotNames = scope.copyTo(arena);
+}
+
+void resolveStmt(Stmt *stmt, const Scope &scope, AstArena &arena) {
+  if (stmt == nullptr) {
+    return;
+  }
+
+  switch (stmt->kind) {
+  case NodeType::VarDeclaration: {
+    auto declaration = static_cast<VarDeclaration *>(stmt);
+    resolveStmt(declaration->value, scope, arena);
+    declaration->slot = scope.find(declaration->identifier);
+    break;
+  }
+  case NodeType::FunctionDeclaration: {
+    auto declaration = static_cast<FunctionDeclaration *>(stmt);
+    declaration->slot = scope.find(declaration->name);
+    resolveFunction(declaration, arena);
+    break;
+  }
+  case NodeType::StructDeclaration: {
+    auto declaration = static_cast<StructDeclaration *>(stmt);
+    declaration->slot = scope.find(declaration->structName);
+    // The lets of a struct are its fields, only their values are code.
+    for (Stmt *field : declaration->structBody) {
+      if (field->kind == NodeType::VarDeclaration) {
+        resolveStmt(static_cast<VarDeclaration *>(field)->value, scope, arena);
+      }
+    }
+    break;
+  }
+  case NodeType::IfStatement: {
+    auto ifStmt = static_cast<IfStatement *>(stmt);
+    resolveStmt(ifStmt->condition, scope, arena);
+    resolveBody(ifStmt->ifBody, scope, arena);
+    resolveBody(ifStmt->elseBody, scope, arena);
+    break;
+  }
+  case NodeType::WhileLoop: {
+    auto loop = static_cast<WhileLoop *>(stmt);
+    resolveStmt(loop->condition, scope, arena);
+    resolveBody(loop->loopBody, scope, arena);
+    break;
+  }
+  case NodeType::ReturnStatement:
+    resolveStmt(static_cast<ReturnStatement *>(stmt)->returnValue, scope,
+                arena);
+    break;
+  case NodeType::Identifier: {
+    auto ident = static_cast<IdentifierExpr *>(stmt);
+    ident->slot = scope.find(ident->symbol);
+    break;
+  }
+  case NodeType::AssignmentExpr: {
+    auto assignment = static_cast<AssignmentExpr *>(stmt);
+    resolveStmt(assignment->assigne, scope, arena);
+    resolveStmt(assignment->value, scope, arena);
+    break;
+  }
+  case NodeType::BinaryExpr: {
+    auto binop = static_cast<BinaryExpr *>(stmt);
+    resolveStmt(binop->left, scope, arena);
+    resolveStmt(binop->right, scope, arena);
+    break;
+  }
+  case NodeType::LogicalExpr: {
+    auto logical = static_cast<LogicalExpr *>(stmt);
+    resolveStmt(logical->left, scope, arena);
+    resolveStmt(logical->right, scope, arena);
+    break;
+  }
+  case NodeType::UnaryExpr:
+    resolveStmt(static_cast<UnaryExpr *>(stmt)->right, scope, arena);
+    break;
+  case NodeType::CallExpr: {
+    auto call = static_cast<CallExpr *>(stmt);
+    resolveStmt(call->caller, scope, arena);
+    for (Expr *arg : call->args) {
+      resolveStmt(arg, scope, arena);
+    }
+    break;
+  }
+  case NodeType::MemberAccessExpr:
+    resolveStmt(static_cast<MemberAccessExpr *>(stmt)->object, scope, arena);
+    break;
+  default:
+    break;
+  }
+}
+
+// Finds the returns whose call can take over the frame of the function they
+// return from. Nothing may look a name up in that frame afterwards, which
+// with dynamic scoping rules out every function one of whose variables is
+// ever found by name from outside its own code:
+//  - names a function reads or assigns without declaring them are searched
+//    for in its callers,
+//  - a variable read before its declaration has surely run falls back to its
+//    callers as well,
+//  - and so does a parameter a call leaves without an argument.
+// The names of the first two kinds are collected function by function, the
+// third from every call of the program, which names its callee or, when it
+// cannot tell, stands for a call of every function.
+class TailCalls {
+public:
+  void analyze(const NodeList<Stmt> &program) {
+    collectDeclarations(program);
+    inFunction = false;
+    visitBody(program);
+    for (FunctionDeclaration *function : functions) {
+      visitFunction(function);
+    }
+    for (FunctionDeclaration *function : functions) {
+      markReturns(function->body, canTailCall(function));
+    }
+  }
+
+private:
+  std::vector<FunctionDeclaration *> functions;
+  std::unordered_multimap<Symbol, FunctionDeclaration *> functionsByName;
+  // Names of lets, consts and parameters, which may hold any function.
+  std::unordered_set<Symbol> variableNames;
+  // Names that may be looked up in the frame of another function.
+  std::unordered_set<Symbol> dynamicNames;
+
+  // Whether the code being visited is a function body, the names of the top
+  // level are never the ones of a function frame. The variables of that
+  // function which are declared wherever the code is reached.
+  bool inFunction = false;
+  std::vector<Symbol> declared;
+
+  void collectDeclarations(const NodeList<Stmt> &body) {
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::VarDeclaration:
+        variableNames.insert(static_cast<VarDeclaration *>(stmt)->identifier);
+        break;
+      case NodeType::FunctionDeclaration: {
+        auto function = static_cast<FunctionDeclaration *>(stmt);
+        functions.push_back(function);
+        functionsByName.emplace(function->name, function);
+        for (Symbol parameter : function->parameters) {
+          variableNames.insert(parameter);
+        }
+        collectDeclarations(function->body);
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        collectDeclarations(ifStmt->ifBody);
+        collectDeclarations(ifStmt->elseBody);
+        break;
+      }
+      case NodeType::WhileLoop:
+        collectDeclarations(static_cast<WhileLoop *>(stmt)->loopBody);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  void visitFunction(FunctionDeclaration *function) {
+    inFunction = true;
+    declared.assign(function->parameters.begin(), function->parameters.end());
+    visitBody(function->body);
+  }
+
+  void visitBody(const NodeList<Stmt> &body) {
+    size_t mark = declared.size();
+    for (Stmt *stmt : body) {
+      visit(stmt);
+    }
+    declared.resize(mark);
+  }
+
+  void declare(Symbol name) {
+    if (inFunction) {
+      declared.push_back(name);
+    }
+  }
+
+  void use(Symbol name) {
+    if (inFunction &&
+        std::find(declared.begin(), declared.end(), name) == declared.end()) {
+      dynamicNames.insert(name);
+    }
+  }
+
+  void visit(Stmt *stmt) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      visit(declaration->value);
+      declare(declaration->identifier);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      declare(static_cast<FunctionDeclaration *>(stmt)->name);
+      break;
+    case NodeType::StructDeclaration: {
+      auto declaration = static_cast<StructDeclaration *>(stmt);
+      for (Stmt *field : declaration->structBody) {
+        if (field->kind == NodeType::VarDeclaration) {
+          visit(static_cast<VarDeclaration *>(field)->value);
+        }
+      }
+      declare(declaration->structName);
+      break;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      visit(ifStmt->condition);
+      visitBody(ifStmt->ifBody);
+      visitBody(ifStmt->elseBody);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<WhileLoop *>(stmt);
+      visit(loop->condition);
+      visitBody(loop->loopBody);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      visit(static_cast<ReturnStatement *>(stmt)->returnValue);
+      break;
+    case NodeType::Identifier:
+      use(static_cast<IdentifierExpr *>(stmt)->symbol);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(stmt);
+      visit(assignment->assigne);
+      visit(assignment->value);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(stmt);
+      visit(binop->left);
+      visit(binop->right);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(stmt);
+      visit(logical->left);
+      visit(logical->right);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      visit(static_cast<UnaryExpr *>(stmt)->right);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<CallExpr *>(stmt);
+      visit(call->caller);
+      for (Expr *arg : call->args) {
+        visit(arg);
+      }
+      visitCall(call);
+      break;
+    }
+    case NodeType::MemberAccessExpr:
+      visit(static_cast<MemberAccessExpr *>(stmt)->object);
+      break;
+    default:
+      break;
+    }
+  }
+
+  void visitCall(CallExpr *call) {
+    size_t count = call->args.size();
+
+    if (call->caller->kind == NodeType::Identifier) {
+      Symbol name = static_cast<IdentifierExpr *>(call->caller)->symbol;
+      // Calling any other name calls the functions declared with it, a
+      // struct or a builtin.
+      if (variableNames.count(name) == 0) {
+        auto callees = functionsByName.equal_range(name);
+        for (auto it = callees.first; it != callees.second; ++it) {
+          missingArguments(it->second, count);
+        }
+        return;
+      }
+    }
+
+    for (FunctionDeclaration *function : functions) {
+      missingArguments(function, count);
+    }
+  }
+
+  void missingArguments(FunctionDeclaration *function, size_t count) {
+    for (size_t i = count; i < function->parameters.size(); i++) {
+      dynamicNames.insert(function->parameters[i]);
+    }
+  }
+
+  bool canTailCall(FunctionDeclaration *function) const {
+    Scope scope(true);
+    for (Symbol parameter : function->parameters) {
+      if (scope.find(parameter) >= 0) {
+        return false;
+      }
+      scope.add(parameter);
+    }
+    collectLocals(function->body, scope);
+
+    for (Symbol name : scope.symbols()) {
+      if (dynamicNames.count(name) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void markReturns(const NodeList<Stmt> &body, bool tailCall) {
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::ReturnStatement: {
+        Stmt *value = static_cast<ReturnStatement *>(stmt)->returnValue;
+        if (value != nullptr && value->kind == NodeType::CallExpr) {
+          static_cast<CallExpr *>(value)->tailCall = tailCall;
+        }
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        markReturns(ifStmt->ifBody, tailCall);
+        markReturns(ifStmt->elseBody, tailCall);
+        break;
+      }
+      case NodeType::WhileLoop:
+        markReturns(static_cast<WhileLoop *>(stmt)->loopBody, tailCall);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+};
+
+} // namespace
+
+void resolveProgram(Program &program, bool globalSlots) {
+  Scope scope(globalSlots);
+  collectLocals(program.body, scope);
+
+  resolveBody(program.body, scope, program.arena);
+  program.slotNames = scope.copyTo(program.arena);
+
+  if (globalSlots) {
+    TailCalls().analyze(program.body);
+  }
+}
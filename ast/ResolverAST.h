@@ -0,0 +1,29 @@
+#ifndef RESOLVER_AST_H
+#define RESOLVER_AST_H
+
+#include "AST.h"
+
+// Gives every variable a function declares a slot in the environment of its
+// calls and points the identifiers, declarations and assignments naming it at
+// that slot, so the evaluator reads and writes it by index.
+//
+// Scoping is dynamic: a name a function does not declare is found in the
+// environments of its callers, which differ from call to call. Only the
+// function's own variables (its parameters and every let, const, func and
+// struct in its body, blocks included) get a slot, the hop count of a slot is
+// always zero, and every other name keeps its lookup by name. A slot that is
+// not declared yet falls back to the lookup by name as well.
+//
+// With globalSlots the top level variables get slots in the global
+// environment too. The REPL passes false, its globals outlive the program
+// that declares them and are looked up by name.
+//
+// Programs resolved with globalSlots also get the calls of their returns
+// marked as tail calls, in every function none of whose variables can be
+// looked up from another one. The evaluator, the closures, the VM and the
+// transpiled C++ run such a call in place of the function that makes it,
+// so a function that returns a call of itself or of another one loops in
+// constant space instead of growing the stack.
+void resolveProgram(Program &program, bool globalSlots);
+
+#endif
@@ -0,0 +1,406 @@
+#include "SerializerAST.h"
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+const char MAGIC[4] = {'R', 'C', 'C', '\0'};
+const uint8_t NO_NODE = 0xFF;
+
+class Writer {
+public:
+  std::string body;
+
+  template <typename T> void put(T value) {
+    body.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void putSymbol(Symbol symbol) {
+    auto found = indices.find(symbol);
+    if (found != indices.end()) {
+      put<uint32_t>(found->second);
+      return;
+    }
+    uint32_t index = static_cast<uint32_t>(symbols.size()) + 1;
+    indices.emplace(symbol, index);
+    symbols.push_back(symbol);
+    put<uint32_t>(index);
+  }
+
+  void putString(std::string_view text) {
+    put<uint32_t>(static_cast<uint32_t>(text.size()));
+    body.append(text.data(), text.size());
+  }
+
+  template <typename T> void putList(const NodeList<T> &list) {
+    put<uint32_t>(list.size());
+    for (const T *node : list) {
+      putNode(node);
+    }
+  }
+
+  void putNode(const Stmt *node);
+
+  std::string finish(uint64_t sourceHash, uint64_t sourceSize) {
+    std::string out;
+    out.reserve(sizeof(SerializedHeader) + body.size() + symbols.size() * 12);
+
+    SerializedHeader header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = AST_FORMAT_VERSION;
+    header.sourceHash = sourceHash;
+    header.sourceSize = sourceSize;
+
+    // The symbol table goes before the nodes but is only known once they
+    // are written, so it is encoded into the emptied body buffer.
+    std::string nodes;
+    std::swap(nodes, body);
+    put<uint32_t>(static_cast<uint32_t>(symbols.size()));
+    for (Symbol symbol : symbols) {
+      putString(SymbolTable::name(symbol));
+    }
+    body += nodes;
+    header.bodyHash = hashBody(body);
+
+    out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out += body;
+    return out;
+  }
+
+private:
+  // Symbol 0 is the empty name in every process and keeps index 0.
+  std::unordered_map<Symbol, uint32_t> indices = {{0, 0}};
+  std::vector<Symbol> symbols;
+};
+
+void Writer::putNode(const Stmt *node) {
+  if (node == nullptr) {
+    put<uint8_t>(NO_NODE);
+    return;
+  }
+
+  put<uint8_t>(static_cast<uint8_t>(node->kind));
+
+  switch (node->kind) {
+  case NodeType::VarDeclaration: {
+    auto var = static_cast<const VarDeclaration *>(node);
+    put<uint8_t>(var->constant);
+    putSymbol(var->identifier);
+    putNode(var->value);
+    break;
+  }
+  case NodeType::FunctionDeclaration: {
+    auto fn = static_cast<const FunctionDeclaration *>(node);
+    putSymbol(fn->name);
+    put<uint32_t>(fn->parameters.size());
+    for (Symbol parameter : fn->parameters) {
+      putSymbol(parameter);
+    }
+    putList(fn->body);
+    break;
+  }
+  case NodeType::StructDeclaration: {
+    auto structDecl = static_cast<const StructDeclaration *>(node);
+    putSymbol(structDecl->structName);
+    putList(structDecl->structBody);
+    break;
+  }
+  case NodeType::IfStatement: {
+    auto ifStmt = static_cast<const IfStatement *>(node);
+    putNode(ifStmt->condition);
+    putList(ifStmt->ifBody);
+    putList(ifStmt->elseBody);
+    break;
+  }
+  case NodeType::WhileLoop: {
+    auto loop = static_cast<const WhileLoop *>(node);
+    putNode(loop->condition);
+    putList(loop->loopBody);
+    break;
+  }
+  case NodeType::ReturnStatement:
+    putNode(static_cast<const ReturnStatement *>(node)->returnValue);
+    break;
+  case NodeType::AssignmentExpr: {
+    auto assignment = static_cast<const AssignmentExpr *>(node);
+    putNode(assignment->assigne);
+    putNode(assignment->value);
+    break;
+  }
+  case NodeType::NumericLiteral:
+    put<double>(static_cast<const NumericLiteral *>(node)->value);
+    break;
+  case NodeType::StrLiteral:
+    putString(static_cast<const StrLiteral *>(node)->value);
+    break;
+  case NodeType::Null:
+    break;
+  case NodeType::Identifier:
+    putSymbol(static_cast<const IdentifierExpr *>(node)->symbol);
+    break;
+  case NodeType::BinaryExpr: {
+    auto binary = static_cast<const BinaryExpr *>(node);
+    put<uint8_t>(static_cast<uint8_t>(binary->binaryOperator));
+    putNode(binary->left);
+    putNode(binary->right);
+    break;
+  }
+  case NodeType::CallExpr: {
+    auto call = static_cast<const CallExpr *>(node);
+    putNode(call->caller);
+    putList(call->args);
+    break;
+  }
+  case NodeType::MemberAccessExpr: {
+    auto member = static_cast<const MemberAccessExpr *>(node);
+    putNode(member->object);
+    putSymbol(member->memberName);
+    break;
+  }
+  case NodeType::UnaryExpr: {
+    auto unary = static_cast<const UnaryExpr *>(node);
+    put<uint8_t>(static_cast<uint8_t>(unary->op));
+    putNode(unary->right);
+    break;
+  }
+  case NodeType::LogicalExpr: {
+    auto logical = static_cast<const LogicalExpr *>(node);
+    put<uint8_t>(static_cast<uint8_t>(logical->logicalOperator));
+    putNode(logical->left);
+    putNode(logical->right);
+    break;
+  }
+  default:
+    throw SerializerError("Cannot serialize node " +
+                          NodeTypeToString(node->kind));
+  }
+}
+
+class Reader {
+public:
+  Reader(const char *data, size_t size, AstArena &arena)
+      : cursor(data), end(data + size), arena(arena) {}
+
+  template <typename T> T get() {
+    need(sizeof(T));
+    T value;
+    std::memcpy(&value, cursor, sizeof(T));
+    cursor += sizeof(T);
+    return value;
+  }
+
+  std::string_view getString() {
+    uint32_t length = get<uint32_t>();
+    need(length);
+    std::string_view text(cursor, length);
+    cursor += length;
+    return text;
+  }
+
+  void readSymbols() {
+    uint32_t count = get<uint32_t>();
+    need(static_cast<size_t>(count) * sizeof(uint32_t));
+    symbols.reserve(count + 1);
+    symbols.push_back(0);
+    for (uint32_t i = 0; i < count; i++) {
+      symbols.push_back(SymbolTable::intern(getString()));
+    }
+  }
+
+  Symbol getSymbol() {
+    uint32_t index = get<uint32_t>();
+    if (index >= symbols.size()) {
+      throw SerializerError("Symbol index out of range");
+    }
+    return symbols[index];
+  }
+
+  Operator getOperator() {
+    uint8_t op = get<uint8_t>();
+    if (op > static_cast<uint8_t>(Operator::Negate)) {
+      throw SerializerError("Unknown operator");
+    }
+    return static_cast<Operator>(op);
+  }
+
+  template <typename T> NodeList<T> getList() {
+    uint32_t count = get<uint32_t>();
+    // Every node takes at least one byte, a larger count is corrupt and
+    // must not reach the allocation below.
+    need(count);
+    NodeList<T> list = arena.makeArray<T *>(count);
+    for (uint32_t i = 0; i < count; i++) {
+      list[i] = getNodeAs<T>();
+    }
+    return list;
+  }
+
+  template <typename T> T *getNodeAs();
+
+  Stmt *getNode();
+
+  bool atEnd() const { return cursor == end; }
+
+private:
+  void need(size_t bytes) {
+    if (static_cast<size_t>(end - cursor) < bytes) {
+      throw SerializerError("Unexpected end of serialized program");
+    }
+  }
+
+  const char *cursor;
+  const char *end;
+  AstArena &arena;
+  std::vector<Symbol> symbols;
+};
+
+template <> Stmt *Reader::getNodeAs<Stmt>() { return getNode(); }
+
+template <> Expr *Reader::getNodeAs<Expr>() {
+  Stmt *node = getNode();
+  if (node != nullptr && node->kind < NodeType::AssignmentExpr) {
+    throw SerializerError("Expected an expression, found " +
+                          NodeTypeToString(node->kind));
+  }
+  return static_cast<Expr *>(node);
+}
+
+Stmt *Reader::getNode() {
+  uint8_t tag = get<uint8_t>();
+  if (tag == NO_NODE) {
+    return nullptr;
+  }
+
+  switch (static_cast<NodeType>(tag)) {
+  case NodeType::VarDeclaration: {
+    bool constant = get<uint8_t>() != 0;
+    Symbol identifier = getSymbol();
+    return arena.make<VarDeclaration>(constant, identifier, getNodeAs<Expr>());
+  }
+  case NodeType::FunctionDeclaration: {
+    Symbol name = getSymbol();
+    uint32_t count = get<uint32_t>();
+    need(static_cast<size_t>(count) * sizeof(uint32_t));
+    ArenaArray<Symbol> parameters = arena.makeArray<Symbol>(count);
+    for (uint32_t i = 0; i < count; i++) {
+      parameters[i] = getSymbol();
+    }
+    return arena.make<FunctionDeclaration>(parameters, name, getList<Stmt>());
+  }
+  case NodeType::StructDeclaration: {
+    Symbol name = getSymbol();
+    return arena.make<StructDeclaration>(name, getList<Stmt>());
+  }
+  case NodeType::IfStatement: {
+    Expr *condition = getNodeAs<Expr>();
+    NodeList<Stmt> ifBody = getList<Stmt>();
+    return arena.make<IfStatement>(condition, ifBody, getList<Stmt>());
+  }
+  case NodeType::WhileLoop: {
+    Expr *condition = getNodeAs<Expr>();
+    return arena.make<WhileLoop>(condition, getList<Stmt>());
+  }
+  case NodeType::ReturnStatement:
+    return arena.make<ReturnStatement>(getNode());
+  case NodeType::AssignmentExpr: {
+    Expr *assigne = getNodeAs<Expr>();
+    return arena.make<AssignmentExpr>(assigne, getNodeAs<Expr>());
+  }
+  case NodeType::NumericLiteral:
+    return arena.make<NumericLiteral>(get<double>());
+  case NodeType::StrLiteral:
+    return arena.make<StrLiteral>(arena.copyString(getString()));
+  case NodeType::Null:
+    return arena.make<NullLiteral>();
+  case NodeType::Identifier:
+    return arena.make<IdentifierExpr>(getSymbol());
+  case NodeType::BinaryExpr: {
+    Operator op = getOperator();
+    Expr *left = getNodeAs<Expr>();
+    return arena.make<BinaryExpr>(left, getNodeAs<Expr>(), op);
+  }
+  case NodeType::CallExpr: {
+    Expr *caller = getNodeAs<Expr>();
+    return arena.make<CallExpr>(caller, getList<Expr>());
+  }
+  case NodeType::MemberAccessExpr: {
+    Expr *object = getNodeAs<Expr>();
+    return arena.make<MemberAccessExpr>(object, getSymbol());
+  }
+  case NodeType::UnaryExpr: {
+    Operator op = getOperator();
+    return arena.make<UnaryExpr>(getNodeAs<Expr>(), op);
+  }
+  case NodeType::LogicalExpr: {
+    Operator op = getOperator();
+    Expr *left = getNodeAs<Expr>();
+    return arena.make<LogicalExpr>(left, getNodeAs<Expr>(), op);
+  }
+  default:
+    throw SerializerError("Unknown node tag " + std::to_string(tag));
+  }
+}
+
+} // namespace
+
+namespace {
+
+uint64_t fnv1a(std::string_view bytes) {
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char c : bytes) {
+    hash ^= c;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+} // namespace
+
+uint64_t hashSource(std::string_view source) { return fnv1a(source); }
+
+uint64_t hashBody(std::string_view body) { return fnv1a(body); }
+
+std::string serializeProgram(const Program &program, uint64_t sourceHash,
+                             uint64_t sourceSize) {
+  Writer writer;
+  writer.putList(program.body);
+  return writer.finish(sourceHash, sourceSize);
+}
+
+std::unique_ptr<Program> deserializeProgram(const char *data, size_t size,
+                                            uint64_t sourceHash,
+                                            uint64_t sourceSize) {
+  if (size < sizeof(SerializedHeader)) {
+    throw SerializerError("Serialized program is too short");
+  }
+
+  SerializedHeader header;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+    throw SerializerError("Not a serialized program");
+  }
+  if (header.version != AST_FORMAT_VERSION) {
+    throw SerializerError("Unsupported format version " +
+                          std::to_string(header.version));
+  }
+  if (header.sourceHash != sourceHash || header.sourceSize != sourceSize) {
+    throw SerializerError("Serialized program is out of date");
+  }
+  if (hashBody(std::string_view(data + sizeof(header),
+                                size - sizeof(header))) != header.bodyHash) {
+    throw SerializerError("Serialized program is corrupted");
+  }
+
+  std::unique_ptr<Program> program = std::make_unique<Program>();
+  Reader reader(data + sizeof(header), size - sizeof(header), program->arena);
+  reader.readSymbols();
+  program->body = reader.getList<Stmt>();
+
+  if (!reader.atEnd()) {
+    throw SerializerError("Trailing data after serialized program");
+  }
+
+  return program;
+}
@@ -0,0 +1,57 @@
+#ifndef SERIALIZER_AST_H
+#define SERIALIZER_AST_H
+
+#include "AST.h"
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Binary form of a parsed Program, used by the precompiled program cache.
+//
+//   header   magic "RCC\0", format version, hash and size of the source,
+//            hash of everything after the header
+//   symbols  every name used by the tree, Symbols are process local so the
+//            tree refers to them by their index in this table (0 is "")
+//   body     the statements in pre-order, each node is its NodeType byte
+//            followed by its fields, 0xFF stands for a missing node
+//
+// Integers and doubles are stored in host byte order, a file written on a
+// machine with a different one is rejected by the magic check.
+const uint32_t AST_FORMAT_VERSION = 2;
+
+struct SerializedHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  // Checked before the body is read, so a corrupted entry is rejected
+  // instead of running some other program.
+  uint64_t bodyHash;
+};
+
+// 64-bit FNV-1a of the source text.
+uint64_t hashSource(std::string_view source);
+
+// 64-bit FNV-1a of a serialized body.
+uint64_t hashBody(std::string_view body);
+
+// sourceHash and sourceSize describe the source the program was parsed from
+// and are checked again when it is read back.
+std::string serializeProgram(const Program &program, uint64_t sourceHash,
+                             uint64_t sourceSize);
+
+// Rebuilds the tree into a new Program. Throws SerializerError when the data
+// is truncated, malformed, corrupted, or was not produced from the given
+// source.
+std::unique_ptr<Program> deserializeProgram(const char *data, size_t size,
+                                            uint64_t sourceHash,
+                                            uint64_t sourceSize);
+
+class SerializerError : public std::runtime_error {
+public:
+  SerializerError(const std::string &message) : std::runtime_error(message) {}
+};
+
+#endif
@@ -0,0 +1,669 @@
+#include "TypesAST.h"
+
+#include <algorithm>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// Builtins that return a number whenever they return.
+const char *const NUMERIC_BUILTINS[] = {
+    "sqrt", "pow", "round", "floor", "ceil", "num",
+    "len",  "sin", "cos",   "tan",   "log",
+};
+
+// Builtins that return a number when they get at least one argument.
+const char *const NUMERIC_VARIADIC_BUILTINS[] = {"min", "max"};
+
+// Variables of the code being analyzed at one point of it. Both lists are
+// short, a function seldom has more than a handful of locals.
+struct State {
+  bool reachable = true;
+  std::vector<Symbol> declared;
+  std::vector<Symbol> numbers;
+
+  bool isDeclared(Symbol name) const { return contains(declared, name); }
+  bool isNumber(Symbol name) const { return contains(numbers, name); }
+
+  void declare(Symbol name) {
+    if (!isDeclared(name)) {
+      declared.push_back(name);
+    }
+  }
+
+  void setNumber(Symbol name, bool number) {
+    auto it = std::find(numbers.begin(), numbers.end(), name);
+    if (number && it == numbers.end()) {
+      numbers.push_back(name);
+    } else if (!number && it != numbers.end()) {
+      numbers.erase(it);
+    }
+  }
+
+  // What holds on both of two paths that meet.
+  void join(const State &other) {
+    if (!other.reachable) {
+      return;
+    }
+    if (!reachable) {
+      *this = other;
+      return;
+    }
+    keepCommon(declared, other.declared);
+    keepCommon(numbers, other.numbers);
+  }
+
+  bool operator==(const State &other) const {
+    return reachable == other.reachable &&
+           sameSymbols(declared, other.declared) &&
+           sameSymbols(numbers, other.numbers);
+  }
+
+private:
+  static bool contains(const std::vector<Symbol> &symbols, Symbol name) {
+    return std::find(symbols.begin(), symbols.end(), name) != symbols.end();
+  }
+
+  static void keepCommon(std::vector<Symbol> &symbols,
+                         const std::vector<Symbol> &other) {
+    symbols.erase(std::remove_if(symbols.begin(), symbols.end(),
+                                 [&other](Symbol name) {
+                                   return !contains(other, name);
+                                 }),
+                  symbols.end());
+  }
+
+  static bool sameSymbols(const std::vector<Symbol> &a,
+                          const std::vector<Symbol> &b) {
+    if (a.size() != b.size()) {
+      return false;
+    }
+    for (Symbol name : a) {
+      if (!contains(b, name)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+class TypeInference {
+public:
+  void analyze(Program &program) {
+    collectDeclarations(program.body);
+    findEscapes(program.body);
+    for (const char *name : NUMERIC_BUILTINS) {
+      addBuiltin(numericBuiltins, name);
+    }
+    for (const char *name : NUMERIC_VARIADIC_BUILTINS) {
+      addBuiltin(variadicBuiltins, name);
+    }
+
+    // Parameters start out numbers and stop being ones once a call passes
+    // something else, and names start out assigned by no other function,
+    // until an analysis of the whole program changes neither.
+    for (FunctionDeclaration *function : functions) {
+      numericParameters[function] =
+          std::vector<bool>(function->parameters.size(), isEligible(function));
+    }
+    bool changed = true;
+    while (changed) {
+      for (FunctionDeclaration *function : functions) {
+        passed[function] =
+            std::vector<bool>(function->parameters.size(), true);
+      }
+      size_t dynamicCount = dynamicallyAssigned.size();
+
+      for (FunctionDeclaration *function : functions) {
+        analyzeFunction(function);
+      }
+      inFunction = false;
+      State state;
+      analyzeBody(program.body, state);
+
+      changed = dynamicallyAssigned.size() != dynamicCount;
+      for (FunctionDeclaration *function : functions) {
+        std::vector<bool> &numeric = numericParameters[function];
+        for (size_t i = 0; i < numeric.size(); i++) {
+          if (numeric[i] && !passed[function][i]) {
+            numeric[i] = false;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  void dump(const Program &program, std::ostream &out) {
+    for (const FunctionDeclaration *function : functions) {
+      out << "func " << SymbolTable::name(function->name) << "(";
+      const std::vector<bool> &numeric = numericParameters[function];
+      for (size_t i = 0; i < function->parameters.size(); i++) {
+        out << (i > 0 ? ", " : "")
+            << SymbolTable::name(function->parameters[i])
+            << (numeric[i] ? ": number" : ": unknown");
+      }
+      out << ")\n";
+      dumpBody(function->body, 1, out);
+    }
+    if (!functions.empty()) {
+      out << "top level\n";
+    }
+    dumpBody(program.body, 1, out);
+  }
+
+private:
+  std::vector<FunctionDeclaration *> functions;
+  std::unordered_multimap<Symbol, FunctionDeclaration *> functionsByName;
+  // Names of lets, consts, parameters and structs.
+  std::unordered_set<Symbol> otherNames;
+  // Functions whose callers are not all known: their name is read as a
+  // value, or is also the name of a variable that may hold another one.
+  std::unordered_set<Symbol> escaped;
+  // Fewest arguments any call of a function name passes.
+  std::unordered_map<Symbol, size_t> fewestArguments;
+  // Names some function assigns while it has not declared them, which may
+  // be the variables of any of its callers.
+  std::unordered_set<Symbol> dynamicallyAssigned;
+  std::unordered_set<Symbol> numericBuiltins;
+  std::unordered_set<Symbol> variadicBuiltins;
+
+  // Parameters assumed to be numbers, and those every call seen in the
+  // current round of the analysis passed a number for.
+  std::unordered_map<const FunctionDeclaration *, std::vector<bool>>
+      numericParameters;
+  std::unordered_map<const FunctionDeclaration *, std::vector<bool>> passed;
+
+  bool inFunction = false;
+
+  void collectDeclarations(const NodeList<Stmt> &body) {
+    for (Stmt *stmt : body) {
+      switch (stmt->kind) {
+      case NodeType::VarDeclaration:
+        otherNames.insert(static_cast<VarDeclaration *>(stmt)->identifier);
+        break;
+      case NodeType::StructDeclaration:
+        otherNames.insert(static_cast<StructDeclaration *>(stmt)->structName);
+        break;
+      case NodeType::FunctionDeclaration: {
+        auto function = static_cast<FunctionDeclaration *>(stmt);
+        functions.push_back(function);
+        functionsByName.emplace(function->name, function);
+        for (Symbol parameter : function->parameters) {
+          otherNames.insert(parameter);
+        }
+        collectDeclarations(function->body);
+        break;
+      }
+      case NodeType::IfStatement: {
+        auto ifStmt = static_cast<IfStatement *>(stmt);
+        collectDeclarations(ifStmt->ifBody);
+        collectDeclarations(ifStmt->elseBody);
+        break;
+      }
+      case NodeType::WhileLoop:
+        collectDeclarations(static_cast<WhileLoop *>(stmt)->loopBody);
+        break;
+      default:
+        break;
+      }
+    }
+  }
+
+  void addBuiltin(std::unordered_set<Symbol> &builtins, const char *name) {
+    Symbol symbol = SymbolTable::intern(name);
+    if (functionsByName.count(symbol) == 0 && otherNames.count(symbol) == 0) {
+      builtins.insert(symbol);
+    }
+  }
+
+  void findEscapes(const NodeList<Stmt> &body) {
+    for (Stmt *stmt : body) {
+      findEscapes(stmt);
+    }
+  }
+
+  void findEscapes(Stmt *stmt) {
+    if (stmt == nullptr) {
+      return;
+    }
+
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration:
+      findEscapes(static_cast<VarDeclaration *>(stmt)->value);
+      break;
+    case NodeType::FunctionDeclaration: {
+      auto function = static_cast<FunctionDeclaration *>(stmt);
+      if (otherNames.count(function->name) != 0) {
+        escaped.insert(function->name);
+      }
+      findEscapes(function->body);
+      break;
+    }
+    case NodeType::StructDeclaration:
+      findEscapes(static_cast<StructDeclaration *>(stmt)->structBody);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      findEscapes(ifStmt->condition);
+      findEscapes(ifStmt->ifBody);
+      findEscapes(ifStmt->elseBody);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<WhileLoop *>(stmt);
+      findEscapes(loop->condition);
+      findEscapes(loop->loopBody);
+      break;
+    }
+    case NodeType::ReturnStatement:
+      findEscapes(static_cast<ReturnStatement *>(stmt)->returnValue);
+      break;
+    case NodeType::Identifier:
+      escaped.insert(static_cast<IdentifierExpr *>(stmt)->symbol);
+      break;
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(stmt);
+      findEscapes(assignment->assigne);
+      findEscapes(assignment->value);
+      break;
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<BinaryExpr *>(stmt);
+      findEscapes(binop->left);
+      findEscapes(binop->right);
+      break;
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<LogicalExpr *>(stmt);
+      findEscapes(logical->left);
+      findEscapes(logical->right);
+      break;
+    }
+    case NodeType::UnaryExpr:
+      findEscapes(static_cast<UnaryExpr *>(stmt)->right);
+      break;
+    case NodeType::MemberAccessExpr:
+      findEscapes(static_cast<MemberAccessExpr *>(stmt)->object);
+      break;
+    case NodeType::CallExpr: {
+      auto call = static_cast<CallExpr *>(stmt);
+      if (call->caller->kind == NodeType::Identifier) {
+        Symbol name = static_cast<IdentifierExpr *>(call->caller)->symbol;
+        auto fewest = fewestArguments.find(name);
+        if (fewest == fewestArguments.end()) {
+          fewestArguments[name] = call->args.size();
+        } else {
+          fewest->second = std::min<size_t>(fewest->second, call->args.size());
+        }
+      } else {
+        findEscapes(call->caller);
+      }
+      for (Expr *arg : call->args) {
+        findEscapes(arg);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  // Whether the parameters of function may be proven at all: every caller
+  // is known and every parameter has its own variable.
+  bool isEligible(const FunctionDeclaration *function) const {
+    if (escaped.count(function->name) != 0) {
+      return false;
+    }
+    const ArenaArray<Symbol> &parameters = function->parameters;
+    for (size_t i = 0; i < parameters.size(); i++) {
+      for (size_t j = 0; j < i; j++) {
+        if (parameters[i] == parameters[j]) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Parameters that every call of function passes an argument for. The
+  // others are looked up in the callers, as the evaluator does.
+  size_t passedParameters(const FunctionDeclaration *function) const {
+    if (escaped.count(function->name) != 0) {
+      return 0;
+    }
+    auto fewest = fewestArguments.find(function->name);
+    if (fewest == fewestArguments.end()) {
+      return function->parameters.size();
+    }
+    return std::min<size_t>(fewest->second, function->parameters.size());
+  }
+
+  void analyzeFunction(FunctionDeclaration *function) {
+    inFunction = true;
+    State state;
+    size_t count = passedParameters(function);
+    const std::vector<bool> &numeric = numericParameters[function];
+    for (size_t i = 0; i < count; i++) {
+      Symbol parameter = function->parameters[i];
+      state.declare(parameter);
+      state.setNumber(parameter, numeric[i] &&
+                                     dynamicallyAssigned.count(parameter) == 0);
+    }
+    analyzeBody(function->body, state);
+  }
+
+  void analyzeBody(const NodeList<Stmt> &body, State &state) {
+    for (Stmt *stmt : body) {
+      analyzeStmt(stmt, state);
+    }
+  }
+
+  void assign(Symbol name, bool number, State &state) {
+    if (state.isDeclared(name)) {
+      state.setNumber(name,
+                      number && dynamicallyAssigned.count(name) == 0);
+    } else if (inFunction) {
+      dynamicallyAssigned.insert(name);
+    }
+  }
+
+  void analyzeStmt(Stmt *stmt, State &state) {
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      bool number = analyzeExpr(declaration->value, state);
+      state.declare(declaration->identifier);
+      assign(declaration->identifier, number, state);
+      break;
+    }
+    case NodeType::FunctionDeclaration: {
+      Symbol name = static_cast<FunctionDeclaration *>(stmt)->name;
+      state.declare(name);
+      state.setNumber(name, false);
+      break;
+    }
+    case NodeType::StructDeclaration: {
+      // Field values are evaluated where the struct is declared.
+      auto structDecl = static_cast<StructDeclaration *>(stmt);
+      for (Stmt *field : structDecl->structBody) {
+        if (field->kind == NodeType::VarDeclaration) {
+          analyzeExpr(static_cast<VarDeclaration *>(field)->value, state);
+        }
+      }
+      state.declare(structDecl->structName);
+      state.setNumber(structDecl->structName, false);
+      break;
+    }
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      analyzeExpr(ifStmt->condition, state);
+      State elseState = state;
+      analyzeBody(ifStmt->ifBody, state);
+      analyzeBody(ifStmt->elseBody, elseState);
+      state.join(elseState);
+      break;
+    }
+    case NodeType::WhileLoop: {
+      // The state at the condition is the one before the loop joined with
+      // the one after its body, until another pass changes nothing.
+      auto loop = static_cast<WhileLoop *>(stmt);
+      State head = state;
+      while (true) {
+        State body = head;
+        analyzeExpr(loop->condition, body);
+        State exit = body;
+        analyzeBody(loop->loopBody, body);
+        State next = state;
+        next.join(body);
+        if (next == head) {
+          state = exit;
+          break;
+        }
+        head = next;
+      }
+      break;
+    }
+    case NodeType::ReturnStatement:
+      analyzeExpr(static_cast<ReturnStatement *>(stmt)->returnValue, state);
+      state.reachable = false;
+      break;
+    default:
+      analyzeExpr(stmt, state);
+      break;
+    }
+  }
+
+  // Sets Expr::numeric of expr and of every expression in it.
+  bool analyzeExpr(Stmt *stmt, State &state) {
+    if (stmt == nullptr) {
+      return false;
+    }
+    auto expr = static_cast<Expr *>(stmt);
+    expr->numeric = isNumber(expr, state);
+    return expr->numeric;
+  }
+
+  bool isNumber(Expr *expr, State &state) {
+    switch (expr->kind) {
+    case NodeType::NumericLiteral:
+      return true;
+    case NodeType::Identifier:
+      return state.isNumber(static_cast<IdentifierExpr *>(expr)->symbol);
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<AssignmentExpr *>(expr);
+      if (assignment->assigne->kind == NodeType::Identifier) {
+        bool number = analyzeExpr(assignment->value, state);
+        assign(static_cast<IdentifierExpr *>(assignment->assigne)->symbol,
+               number, state);
+        return number;
+      }
+      analyzeExpr(assignment->assigne, state);
+      return analyzeExpr(assignment->value, state);
+    }
+    case NodeType::BinaryExpr: {
+      // Arithmetic and comparisons of two numbers, which are all operators
+      // of a BinaryExpr.
+      auto binop = static_cast<BinaryExpr *>(expr);
+      bool left = analyzeExpr(binop->left, state);
+      bool right = analyzeExpr(binop->right, state);
+      return left && right;
+    }
+    case NodeType::LogicalExpr: {
+      // Fails unless both operands are numbers.
+      auto logical = static_cast<LogicalExpr *>(expr);
+      analyzeExpr(logical->left, state);
+      analyzeExpr(logical->right, state);
+      return true;
+    }
+    case NodeType::UnaryExpr:
+      analyzeExpr(static_cast<UnaryExpr *>(expr)->right, state);
+      return true;
+    case NodeType::MemberAccessExpr:
+      analyzeExpr(static_cast<MemberAccessExpr *>(expr)->object, state);
+      return false;
+    case NodeType::CallExpr:
+      return isNumericCall(static_cast<CallExpr *>(expr), state);
+    default:
+      return false;
+    }
+  }
+
+  bool isNumericCall(CallExpr *call, State &state) {
+    std::vector<bool> numbers;
+    for (Expr *arg : call->args) {
+      numbers.push_back(analyzeExpr(arg, state));
+    }
+    if (call->caller->kind != NodeType::Identifier) {
+      analyzeExpr(call->caller, state);
+      return false;
+    }
+    Symbol name = static_cast<IdentifierExpr *>(call->caller)->symbol;
+    if (otherNames.count(name) != 0) {
+      return false;
+    }
+
+    auto declarations = functionsByName.equal_range(name);
+    for (auto it = declarations.first; it != declarations.second; ++it) {
+      std::vector<bool> &arguments = passed[it->second];
+      for (size_t i = 0; i < arguments.size() && i < numbers.size(); i++) {
+        arguments[i] = arguments[i] && numbers[i];
+      }
+    }
+    if (declarations.first != declarations.second) {
+      return false;
+    }
+
+    return numericBuiltins.count(name) != 0 ||
+           (variadicBuiltins.count(name) != 0 && !call->args.empty());
+  }
+
+  void dumpBody(const NodeList<Stmt> &body, int depth, std::ostream &out) {
+    for (Stmt *stmt : body) {
+      dumpStmt(stmt, depth, out);
+    }
+  }
+
+  void dumpStmt(Stmt *stmt, int depth, std::ostream &out) {
+    std::string indent(depth * 2, ' ');
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      out << indent << (declaration->constant ? "const " : "let ")
+          << SymbolTable::name(declaration->identifier);
+      if (declaration->value != nullptr) {
+        out << " = " << source(declaration->value);
+      }
+      out << typeOf(declaration->value) << "\n";
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      out << indent << "func "
+          << SymbolTable::name(static_cast<FunctionDeclaration *>(stmt)->name)
+          << "\n";
+      break;
+    case NodeType::StructDeclaration:
+      out << indent << "struct "
+          << SymbolTable::name(
+                 static_cast<StructDeclaration *>(stmt)->structName)
+          << "\n";
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      out << indent << "if " << source(ifStmt->condition)
+          << typeOf(ifStmt->condition) << "\n";
+      dumpBody(ifStmt->ifBody, depth + 1, out);
+      if (!ifStmt->elseBody.empty()) {
+        out << indent << "else\n";
+        dumpBody(ifStmt->elseBody, depth + 1, out);
+      }
+      break;
+    }
+    case NodeType::WhileLoop: {
+      auto loop = static_cast<WhileLoop *>(stmt);
+      out << indent << "while " << source(loop->condition)
+          << typeOf(loop->condition) << "\n";
+      dumpBody(loop->loopBody, depth + 1, out);
+      break;
+    }
+    case NodeType::ReturnStatement: {
+      Stmt *value = static_cast<ReturnStatement *>(stmt)->returnValue;
+      out << indent << "return";
+      if (value != nullptr) {
+        out << " " << source(value);
+      }
+      out << typeOf(value) << "\n";
+      break;
+    }
+    default:
+      out << indent << source(stmt) << typeOf(stmt) << "\n";
+      break;
+    }
+  }
+
+  static std::string typeOf(const Stmt *expr) {
+    if (expr == nullptr) {
+      return "";
+    }
+    return static_cast<const Expr *>(expr)->numeric ? " : number"
+                                                    : " : unknown";
+  }
+
+  // The expression as it could be written in a script, with parentheses
+  // around nested operators.
+  static std::string source(const Stmt *stmt) {
+    switch (stmt->kind) {
+    case NodeType::NumericLiteral: {
+      std::ostringstream number;
+      number << static_cast<const NumericLiteral *>(stmt)->value;
+      return number.str();
+    }
+    case NodeType::StrLiteral:
+      return "\"" +
+             std::string(static_cast<const StrLiteral *>(stmt)->value) + "\"";
+    case NodeType::Null:
+      return "null";
+    case NodeType::Identifier:
+      return SymbolTable::name(static_cast<const IdentifierExpr *>(stmt)->symbol);
+    case NodeType::AssignmentExpr: {
+      auto assignment = static_cast<const AssignmentExpr *>(stmt);
+      return source(assignment->assigne) + " = " + source(assignment->value);
+    }
+    case NodeType::BinaryExpr: {
+      auto binop = static_cast<const BinaryExpr *>(stmt);
+      return operand(binop->left) + " " +
+             OperatorToString(binop->binaryOperator) + " " +
+             operand(binop->right);
+    }
+    case NodeType::LogicalExpr: {
+      auto logical = static_cast<const LogicalExpr *>(stmt);
+      return operand(logical->left) + " " +
+             OperatorToString(logical->logicalOperator) + " " +
+             operand(logical->right);
+    }
+    case NodeType::UnaryExpr: {
+      auto unary = static_cast<const UnaryExpr *>(stmt);
+      return std::string(unary->op == Operator::Not ? "!" : "-") +
+             operand(unary->right);
+    }
+    case NodeType::MemberAccessExpr: {
+      auto member = static_cast<const MemberAccessExpr *>(stmt);
+      return operand(member->object) + "." +
+             SymbolTable::name(member->memberName);
+    }
+    case NodeType::CallExpr: {
+      auto call = static_cast<const CallExpr *>(stmt);
+      std::string text = operand(call->caller) + "(";
+      for (size_t i = 0; i < call->args.size(); i++) {
+        text += (i > 0 ? ", " : "") + source(call->args[i]);
+      }
+      return text + ")";
+    }
+    default:
+      return NodeTypeToString(stmt->kind);
+    }
+  }
+
+  static std::string operand(const Stmt *stmt) {
+    switch (stmt->kind) {
+    case NodeType::AssignmentExpr:
+    case NodeType::BinaryExpr:
+    case NodeType::LogicalExpr:
+      return "(" + source(stmt) + ")";
+    default:
+      return source(stmt);
+    }
+  }
+};
+
+} // namespace
+
+void inferTypes(Program &program) { TypeInference().analyze(program); }
+
+void dumpTypes(Program &program, std::ostream &out) {
+  TypeInference inference;
+  inference.analyze(program);
+  inference.dump(program, out);
+}
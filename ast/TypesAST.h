@@ -0,0 +1,30 @@
+#ifndef TYPES_AST_H
+#define TYPES_AST_H
+
+#include "AST.h"
+
+#include <ostream>
+
+// Proves which expressions of a program always evaluate to a number and
+// sets their Expr::numeric, so the evaluator computes them on doubles
+// without checking the type of every operand.
+//
+// The analysis follows the statements of every function and of the top
+// level, tracking which of their variables are declared and hold a number
+// at each point: after a let or an assignment of a numeric expression, on
+// both branches of an if, and in a loop once its body no longer changes
+// that. Numbers come from literals, arithmetic and comparisons of numbers,
+// logical and unary operators, and builtins that return one (sqrt, pow,
+// floor and the like). A parameter holds a number when every call of its
+// function passes one; that is only known for functions that are called by
+// name and never used as a value.
+//
+// Scoping is dynamic, so a name a function reads without declaring it, or
+// a variable that any function may assign that way, is never proven.
+void inferTypes(Program &program);
+
+// Runs inferTypes on program and writes its statements to out with the
+// types it proved, for --dump-types.
+void dumpTypes(Program &program, std::ostream &out);
+
+#endif
@@ -0,0 +1,314 @@
+// Execution benchmark for the engines that run a parsed Program. For the
+// given .rc files (or a few built-in numeric scripts when none are given) it
+// compares the tree walking evaluator with compiling the Program to closures
+// and to bytecode for the VM, without and with the JIT, compilation included.
+// Parsing is not measured. Prints the best time of several runs in
+// milliseconds and the speedup over the tree walk. A script whose value is
+// not the same in every engine, or on the tree walk after inlineCalls, is
+// reported, and the exit status is then 1.
+//
+// The naive fib(30) makes 1.6 million calls and tracks the cost of a call.
+//
+//   make bench && ./bin/interpreter-bench [file.rc ...]
+//   ./bin/interpreter-bench docs/examples/*.rc
+
+#include "../ast/InlineAST.h"
+#include "../ast/ResolverAST.h"
+#include "../ast/TypesAST.h"
+#include "../lexer/Lexer.h"
+#include "../parser/Parser.h"
+#include "../runtime/closure/ClosureCompiler.h"
+#include "../runtime/environment/Environment.h"
+#include "../runtime/interpreter/Interpreter.h"
+#include "../runtime/jit/Jit.h"
+#include "../runtime/vm/Compiler.h"
+#include "../runtime/vm/VM.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static const char *RECURSION = R"(func fib(n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+
+fib(30)
+)";
+
+static const char *COUNTED_LOOP = R"(func count(limit) {
+  let total = 0;
+  let i = 0;
+  while (i < limit) {
+    if (i % 3 == 0) {
+      total = total + i;
+    }
+    i = i + 1;
+  }
+  return total;
+}
+
+count(200000)
+)";
+
+static const char *PRIMES = R"(func isPrime(number) {
+  let i = 2;
+  while (i * i <= number) {
+    if (number % i == 0) {
+      return 0;
+    }
+    i = i + 1;
+  }
+  return 1;
+}
+
+func countPrimes(limit) {
+  let found = 0;
+  let n = 2;
+  while (n < limit) {
+    found = found + isPrime(n);
+    n = n + 1;
+  }
+  return found;
+}
+
+countPrimes(5000)
+)";
+
+// Calls whose value goes straight into a builtin, which must get the number
+// and not what the call returned it in.
+static const char *CALL_ARGUMENTS = R"(func half(n) {
+  if (n < 1) {
+    return n;
+  }
+  return half(n - 1) + 0.5;
+}
+
+let total = 0;
+let i = 0;
+while (i < 2000) {
+  total = total + sqrt(half(i % 20)) + round(half(3));
+  i = i + 1;
+}
+total
+)";
+
+// Results of calls kept in variables and fields, which have to hold the
+// value and not what the call returned it in.
+static const char *STORED_RESULTS = R"(struct Point {
+  let y = 0;
+}
+
+func fact(n) {
+  if (n < 2) {
+    return 1;
+  }
+  return n * fact(n - 1);
+}
+
+func mk(v) {
+  let p = Point();
+  p.y = v;
+  return p;
+}
+
+let x = fact(3);
+let keep = mk(0);
+let sum = 0;
+let i = 0;
+while (i < 2000) {
+  x = fact(i % 10);
+  keep = mk(i);
+  keep.y = fact(5);
+  sum = sum + sqrt(x) + keep.y;
+  i = i + 1;
+}
+sum
+)";
+
+// Calls whose value is a condition, an operand of ! and - or the struct a
+// field is read from.
+static const char *CALL_CONDITIONS = R"(struct Point {
+  let y = 0;
+}
+
+func odd(n) {
+  if (n < 1) {
+    return 0;
+  }
+  return 1 - odd(n - 1);
+}
+
+func mk(v) {
+  let p = Point();
+  p.y = v;
+  return p;
+}
+
+let count = 0;
+let i = 0;
+while (odd(i % 7) || i < 2000) {
+  if (odd(i % 10)) {
+    count = count + mk(i).y;
+  }
+  if (!odd(i % 10)) {
+    count = count - (-odd(i % 10 + 1));
+  }
+  i = i + 1;
+}
+count
+)";
+
+// Small functions used like the calls above, which inlineCalls replaces by
+// the expression they return. Inlined or not, the script has one value.
+static const char *INLINED_CALLS = R"(func isOdd(n) {
+  return n % 2;
+}
+
+func half(n) {
+  return n / 2;
+}
+
+let total = 0;
+let i = 0;
+while (i < 2000) {
+  if (isOdd(i)) {
+    total = total + sqrt(half(i)) - (-isOdd(i));
+  }
+  if (!isOdd(i)) {
+    total = total + round(half(i));
+  }
+  i = i + 1;
+}
+total
+)";
+
+std::string readFile(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Cannot open " << path << std::endl;
+    std::exit(1);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+// Also sets result to what the script evaluated to in its first run.
+template <typename Run> double bestOf(Run run, std::string &result) {
+  const int runs = 5;
+  double best = 0;
+
+  for (int i = 0; i < runs; i++) {
+    // Every run gets fresh globals, a script must not see the declarations
+    // of the previous one.
+    Environment env;
+    auto start = std::chrono::steady_clock::now();
+    Value value = run(&env);
+    auto end = std::chrono::steady_clock::now();
+
+    if (i == 0) {
+      result = value.toString();
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if (i == 0 || ms < best) {
+      best = ms;
+    }
+  }
+
+  return best;
+}
+
+std::unique_ptr<Program> prepare(const std::string &source, bool inlining) {
+  Lexer lexer(source);
+  Parser parser;
+  std::unique_ptr<Program> program = parser.produceAST(lexer);
+  if (inlining) {
+    inlineCalls(*program);
+  }
+  resolveProgram(*program, true);
+  inferTypes(*program);
+  return program;
+}
+
+// Returns false when the engines disagree on the value of the script or one
+// of them fails. Inlining must not change the value either, which the tree
+// walk checks.
+bool measure(const std::string &name, const std::string &source) {
+  std::unique_ptr<Program> program = prepare(source, false);
+  std::unique_ptr<Program> inlined = prepare(source, true);
+
+  auto treeWalk = [&](Environment *env) {
+    return Interpreter::evaluate(program.get(), env);
+  };
+  auto closures = [&](Environment *env) {
+    std::unique_ptr<ClosureProgram> compiled =
+        ClosureCompiler::compile(*program);
+    return ClosureCompiler::execute(*compiled, env);
+  };
+  auto vm = [&](Environment *env) {
+    std::unique_ptr<CompiledProgram> compiled = Compiler::compile(*program);
+    return VM::execute(*compiled, env);
+  };
+  auto jit = [&](Environment *env) {
+    Jit::enable();
+    Value result = vm(env);
+    Jit::disable();
+    return result;
+  };
+
+  try {
+    std::string treeWalkResult, closuresResult, vmResult, jitResult;
+    double treeWalkMs = bestOf(treeWalk, treeWalkResult);
+    double closuresMs = bestOf(closures, closuresResult);
+    double vmMs = bestOf(vm, vmResult);
+    double jitMs = bestOf(jit, jitResult);
+
+    Environment inlinedEnv;
+    std::string inlinedResult =
+        Interpreter::evaluate(inlined.get(), &inlinedEnv).toString();
+
+    std::cout << name << ": tree walk " << treeWalkMs << " ms, closures "
+              << closuresMs << " ms (" << treeWalkMs / closuresMs
+              << "x), vm " << vmMs << " ms (" << treeWalkMs / vmMs
+              << "x), jit " << jitMs << " ms (" << treeWalkMs / jitMs << "x)"
+              << std::endl;
+
+    if (closuresResult != treeWalkResult || vmResult != treeWalkResult ||
+        jitResult != treeWalkResult || inlinedResult != treeWalkResult) {
+      std::cerr << name << ": results differ, tree walk " << treeWalkResult
+                << ", closures " << closuresResult << ", vm " << vmResult
+                << ", jit " << jitResult << ", inlined tree walk "
+                << inlinedResult << std::endl;
+      return false;
+    }
+    return true;
+  } catch (const std::exception &e) {
+    Jit::disable();
+    std::cerr << name << ": " << e.what() << std::endl;
+    return false;
+  }
+}
+
+int main(int argc, char **argv) {
+  bool same = true;
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      same = measure(argv[i], readFile(argv[i])) && same;
+    }
+  } else {
+    same = measure("recursion fib(30)", RECURSION) && same;
+    same = measure("counted loop", COUNTED_LOOP) && same;
+    same = measure("primes", PRIMES) && same;
+    same = measure("call arguments", CALL_ARGUMENTS) && same;
+    same = measure("stored results", STORED_RESULTS) && same;
+    same = measure("call conditions", CALL_CONDITIONS) && same;
+    same = measure("inlined calls", INLINED_CALLS) && same;
+  }
+  return same ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Lexer throughput benchmark. Lexes the given .rc files (or a generated
+// corpus of about 2 MB when none are given) with every scan level the CPU
+// supports and prints the best throughput of several runs in MB/s.
+//
+//   make bench && ./bin/lexer-bench [file.rc ...]
+
+#include "../lexer/Lexer.h"
+#include "../lexer/Scanner.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static const char *SAMPLE = R"(# struct for point
+struct Point2D {
+    let x = 0;
+    let y = 0;
+}
+
+func calculateDistance(point1, point2) {
+    return sqrt(pow(point2.x - point1.x, 2) + pow(point2.y - point1.y, 2));
+}
+
+func isPrime(number) {
+    if (number <= 1) {
+      return false;
+    }
+
+    let i = 2;
+
+    while (i <= sqrt(number)) {
+      if (number % i == 0) {
+          return false;
+      }
+
+      i = i + 1;
+    }
+
+    return true;
+}
+
+let pointA = Point2D(1.25, 2);
+let distance = calculateDistance(pointA, Point2D(4, 5.5));
+print("Distance between points A and B: ", distance)
+)";
+
+std::string generateCorpus(size_t size) {
+  std::string corpus;
+  corpus.reserve(size + 1024);
+  while (corpus.size() < size) {
+    corpus += SAMPLE;
+  }
+  return corpus;
+}
+
+std::string readFiles(int argc, char **argv) {
+  std::string corpus;
+  for (int i = 1; i < argc; i++) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file.is_open()) {
+      std::cerr << "Cannot open " << argv[i] << std::endl;
+      std::exit(1);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    corpus += buffer.str();
+    corpus += '\n';
+  }
+  return corpus;
+}
+
+double measure(const std::string &source, size_t &tokenCount) {
+  const int runs = 10;
+  double best = 0;
+
+  for (int i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    Lexer lexer(source);
+    tokenCount = 1;
+    while (lexer.nextToken().getType() != TokenType::EOFToken) {
+      tokenCount++;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double throughput = source.size() / seconds / (1024.0 * 1024.0);
+    if (throughput > best) {
+      best = throughput;
+    }
+  }
+
+  return best;
+}
+
+int main(int argc, char **argv) {
+  std::string source =
+      argc > 1 ? readFiles(argc, argv) : generateCorpus(2 * 1024 * 1024);
+
+  std::cout << "Lexing " << source.size() / 1024 << " KiB" << std::endl;
+
+  ScanLevel detected = detectScanLevel();
+  for (int level = 0; level <= static_cast<int>(detected); level++) {
+    setScanLevel(static_cast<ScanLevel>(level));
+    size_t tokenCount = 0;
+    double throughput = measure(source, tokenCount);
+    std::cout << scanLevelName(getScanLevel()) << ": " << throughput
+              << " MB/s (" << tokenCount << " tokens)" << std::endl;
+  }
+
+  return 0;
+}
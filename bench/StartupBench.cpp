@@ -0,0 +1,131 @@
+// Startup benchmark for the precompiled program cache. For the given .rc
+// files (or a generated script of about 2 MB when none are given) it compares
+// producing the Program cold, by lexing and parsing the source, against warm,
+// by hashing the source and loading its entry from the cache. Prints the best
+// time of several runs in milliseconds.
+//
+//   make bench && ./bin/startup-bench [file.rc ...]
+
+#include "../cache/ProgramCache.h"
+#include "../lexer/Lexer.h"
+#include "../parser/Parser.h"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+static const char *SAMPLE = R"(struct Point2D {
+    let x = 0;
+    let y = 0;
+}
+
+func calculateDistance(point1, point2) {
+    return sqrt(pow(point2.x - point1.x, 2) + pow(point2.y - point1.y, 2));
+}
+
+func isPrime(number) {
+    if (number <= 1) {
+      return false;
+    }
+
+    let i = 2;
+
+    while (i <= sqrt(number)) {
+      if (number % i == 0) {
+          return false;
+      }
+
+      i = i + 1;
+    }
+
+    return true;
+}
+
+let pointA = Point2D(1.25, 2);
+let distance = calculateDistance(pointA, Point2D(4, 5.5));
+print("Distance between points A and B: ", distance)
+)";
+
+std::string generateScript(size_t size) {
+  std::string script;
+  script.reserve(size + 1024);
+  while (script.size() < size) {
+    script += SAMPLE;
+  }
+  return script;
+}
+
+std::string readFile(const char *path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Cannot open " << path << std::endl;
+    std::exit(1);
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+template <typename Load> double bestOf(Load load) {
+  const int runs = 10;
+  double best = 0;
+
+  for (int i = 0; i < runs; i++) {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<Program> program = load();
+    auto end = std::chrono::steady_clock::now();
+
+    if (program == nullptr) {
+      std::cerr << "Cache entry could not be loaded" << std::endl;
+      std::exit(1);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    if (i == 0 || ms < best) {
+      best = ms;
+    }
+  }
+
+  return best;
+}
+
+void measure(const std::string &name, const std::string &source,
+             const std::string &directory) {
+  auto cold = [&]() {
+    Lexer lexer(source);
+    Parser parser;
+    return parser.produceAST(lexer);
+  };
+  auto warm = [&]() { return ProgramCache(directory, source).load(); };
+
+  ProgramCache(directory, source).store(*cold());
+
+  double coldMs = bestOf(cold);
+  double warmMs = bestOf(warm);
+
+  std::cout << name << " (" << source.size() / 1024 << " KiB): cold "
+            << coldMs << " ms, warm " << warmMs << " ms, " << coldMs / warmMs
+            << "x" << std::endl;
+}
+
+int main(int argc, char **argv) {
+  std::string directory =
+      (std::filesystem::temp_directory_path() /
+       ("rusted-c-bench-" + std::to_string(getpid())))
+          .string();
+
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      measure(argv[i], readFile(argv[i]), directory);
+    }
+  } else {
+    measure("generated", generateScript(2 * 1024 * 1024), directory);
+  }
+
+  std::filesystem::remove_all(directory);
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include "ProgramCache.h"
+#include "../ast/SerializerAST.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Read only mapping of a whole file, unmapped when it goes out of scope.
+class MappedFile {
+public:
+  MappedFile(const std::string &path) : data(nullptr), size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *mapping =
+          mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        data = static_cast<const char *>(mapping);
+        size = info.st_size;
+      }
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data != nullptr) {
+      munmap(const_cast<char *>(data), size);
+    }
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data;
+  size_t size;
+};
+
+} // namespace
+
+ProgramCache::ProgramCache(const std::string &directory,
+                           std::string_view source)
+    : sourceHash(hashSource(source)), sourceSize(source.size()) {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.rcc",
+                static_cast<unsigned long long>(sourceHash));
+  entryPath = (std::filesystem::path(directory) / name).string();
+}
+
+std::string ProgramCache::defaultDirectory() {
+  if (const char *dir = std::getenv("RUSTEDC_CACHE_DIR")) {
+    return dir;
+  }
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME")) {
+    return (std::filesystem::path(xdg) / "rusted-c").string();
+  }
+  if (const char *home = std::getenv("HOME")) {
+    return (std::filesystem::path(home) / ".cache" / "rusted-c").string();
+  }
+  return ".rusted-c-cache";
+}
+
+std::unique_ptr<Program> ProgramCache::load() const {
+  MappedFile file(entryPath);
+  if (file.data == nullptr) {
+    return nullptr;
+  }
+
+  try {
+    return deserializeProgram(file.data, file.size, sourceHash, sourceSize);
+  } catch (const SerializerError &) {
+    return nullptr;
+  }
+}
+
+bool ProgramCache::store(const Program &program) const {
+  std::string data;
+  try {
+    data = serializeProgram(program, sourceHash, sourceSize);
+  } catch (const SerializerError &) {
+    return false;
+  }
+
+  std::filesystem::path target(entryPath);
+  std::error_code error;
+  std::filesystem::create_directories(target.parent_path(), error);
+  if (error) {
+    return false;
+  }
+
+  // Written next to the entry and renamed over it, so a concurrent run never
+  // maps a half written file.
+  std::string temporary = entryPath + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    if (!output.is_open()) {
+      return false;
+    }
+    output.write(data.data(), data.size());
+    if (!output) {
+      output.close();
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,38 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include "../ast/AST.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Precompiled form of one script. Parsed programs are serialized into a
+// directory under a file named after the hash of their source, so running an
+// unchanged script again maps that file instead of lexing and parsing.
+//
+// The cache is best effort: a missing, stale, corrupted or unreadable entry
+// is a miss that is written again, and a failed write is ignored, neither
+// ever stops the script from running.
+class ProgramCache {
+public:
+  ProgramCache(const std::string &directory, std::string_view source);
+
+  // $RUSTEDC_CACHE_DIR, or rusted-c under $XDG_CACHE_HOME or ~/.cache.
+  static std::string defaultDirectory();
+
+  // The cached program, or nullptr when there is no valid entry.
+  std::unique_ptr<Program> load() const;
+
+  // Writes the entry, replacing any previous one. Returns false on failure.
+  bool store(const Program &program) const;
+
+  const std::string &path() const { return entryPath; }
+
+private:
+  uint64_t sourceHash;
+  uint64_t sourceSize;
+  std::string entryPath;
+};
+
+#endif
@@ -369,16 +369,16 @@ void DatabaseHandler::addNewStatistic(double execution_time,
                                       double memory_usage,
                                       std::string &errorMessage,
                                       std::string &errorType, std::string &type,
-                                      std::string &code, RuntimeVal *result) {
+                                      std::string &code, Value result) {
   bool isSucces = (errorMessage.empty()) ? true : false;
   int typeId = this->insertSourceType(type);
   int codeId = this->insertCode(code, typeId);
 
   int executionStat = -1;
 
-  if (result != nullptr) {
+  if (!result.isEmpty()) {
     executionStat = this->insertExecutionStat(codeId, isSucces, execution_time,
-                                              result->toString(), memory_usage);
+                                              result.toString(), memory_usage);
   } else {
     executionStat = this->insertExecutionStat(codeId, isSucces, execution_time,
                                               "", memory_usage);
@@ -58,7 +58,7 @@ class DatabaseHandler {
       std::string& errorType, 
       std::string& type,
       std::string& code,
-      RuntimeVal* result
+      Value result
     );
 
     void displayMenu();
@@ -1,240 +1,293 @@
 #include "Lexer.h"
+#include "Scanner.h"
+#include <algorithm>
+#include <array>
 #include <cctype>
+#include <charconv>
 #include <exception>
 #include <iostream>
-#include <unordered_map>
 
-std::unordered_map<std::string, TokenType> KEYWORDS = {
+namespace {
+
+struct Keyword {
+  std::string_view text;
+  TokenType type;
+};
+
+constexpr Keyword KEYWORDS[] = {
     {"null", Null},   {"let", Let},       {"const", Const},
     {"func", Func},   {"if", If},         {"else", Else},
     {"while", While}, {"return", Return}, {"struct", StructToken}};
 
-Token::Token(const std::string &value, TokenType type)
-    : value(value), type(type) {}
-
-std::string Token::getValue() const { return value; }
+constexpr size_t KEYWORD_COUNT = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+constexpr size_t KEYWORD_TABLE_SIZE = 16;
 
-TokenType Token::getType() const { return type; }
+// Length, first and last character are enough to tell all keywords apart, so
+// a lookup is one hash, one table load and one comparison.
+constexpr size_t keywordHash(std::string_view word) {
+  return (word.size() * 2 + static_cast<unsigned char>(word.front()) +
+          static_cast<unsigned char>(word.back()) * 3) %
+         KEYWORD_TABLE_SIZE;
+}
 
-Lexer::Lexer(const std::string &sourceCode)
-    : sourceCode(sourceCode), currentChar(sourceCode[0]) {
-  try {
-    this->tokenize();
+constexpr std::array<int, KEYWORD_TABLE_SIZE> buildKeywordTable() {
+  std::array<int, KEYWORD_TABLE_SIZE> table{};
+  for (size_t i = 0; i < KEYWORD_TABLE_SIZE; i++) {
+    table[i] = -1;
   }
-  catch (const std::exception& e) {
-      throw; // Ponowne rzucenie wyjątku, aby mógł być przechwycony na wyższym poziomie
+  for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+    table[keywordHash(KEYWORDS[i].text)] = static_cast<int>(i);
   }
+  return table;
 }
 
-void Lexer::createNumberToken() {
-  std::string num;
-  num += currentChar;
+constexpr bool keywordHashIsPerfect() {
+  for (size_t i = 0; i < KEYWORD_COUNT; i++) {
+    for (size_t j = i + 1; j < KEYWORD_COUNT; j++) {
+      if (keywordHash(KEYWORDS[i].text) == keywordHash(KEYWORDS[j].text)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  int amountOfDots = 0;
+static_assert(keywordHashIsPerfect(),
+              "Keyword hash has collisions, adjust keywordHash");
 
-  while (!this->src.empty() &&
-         (std::isdigit(this->peek()) || this->peek() == '.')) {
-    if (this->peek() == '.')
-      amountOfDots++;
-    if (amountOfDots > 1)
-      this->unrecognizedChar(currentChar);
-    num += this->eat();
-  }
-  if (amountOfDots == 0) {
-    tokens.push_back(Token(num, NumberLiteral));
-  } else {
-    tokens.push_back(Token(num, FloatLiteral));
+constexpr std::array<int, KEYWORD_TABLE_SIZE> KEYWORD_TABLE =
+    buildKeywordTable();
+
+const Keyword *findKeyword(std::string_view word) {
+  int index = KEYWORD_TABLE[keywordHash(word)];
+  if (index < 0 || KEYWORDS[index].text != word) {
+    return nullptr;
   }
+  return &KEYWORDS[index];
 }
 
-void Lexer::createStringToken() {
-  std::string stringLiteral;
+} // namespace
 
-  while (!src.empty() && peek() != '"') {
-    stringLiteral += eat();
-  }
+Token::Token() : Token(TokenType::EOFToken, 0, 0) {}
 
-  if (!src.empty() && peek() == '"') {
-    eat();
-    tokens.push_back(Token(stringLiteral, TokenType::StringLiteral));
-  } else {
-    this->unrecognizedChar(currentChar);
+Token::Token(TokenType type, uint32_t offset, uint32_t length, uint32_t id)
+    : offset(offset), length(length), id(id), type(type) {}
+
+TokenType Token::getType() const { return type; }
+
+uint32_t Token::getOffset() const { return offset; }
+
+uint32_t Token::getLength() const { return length; }
+
+Symbol Token::getSymbol() const { return type == Identifier ? id : 0; }
+
+Lexer::Lexer(std::string_view sourceCode)
+    : src(sourceCode), pos(0), tokenStart(0), currentChar('\0') {
+  if (src.size() > UINT32_MAX) {
+    throw LexerError("Source is too large, tokens address at most 4 GiB");
   }
 }
 
-void Lexer::createAndToken() {
-  if (!src.empty() && this->peek() == '&') {
-    tokens.push_back(Token("&&", TokenType::And));
-    this->eat();
-  } else {
+Token Lexer::createNumberToken() {
+  this->advanceTo(scanNumber(this->cursor(), this->sourceEnd()));
+
+  std::string_view num = this->lexeme();
+  long amountOfDots = std::count(num.begin(), num.end(), '.');
+  if (amountOfDots > 1) {
     this->unrecognizedChar(currentChar);
   }
+
+  double value = 0;
+  auto [end, ec] = std::from_chars(num.data(), num.data() + num.size(), value);
+  if (ec != std::errc()) {
+    throw LexerError("Invalid number literal: " + std::string(num));
+  }
+
+  numbers.push_back(value);
+  uint32_t index = static_cast<uint32_t>(numbers.size() - 1);
+
+  if (amountOfDots == 0) {
+    return makeToken(NumberLiteral, index);
+  }
+  return makeToken(FloatLiteral, index);
 }
 
-void Lexer::createOrToken() {
-  if (!src.empty() && this->peek() == '|') {
-    tokens.push_back(Token("||", TokenType::Or));
-    this->eat();
-  } else {
+Token Lexer::createStringToken() {
+  size_t end = src.find('"', pos);
+
+  if (end == std::string_view::npos) {
+    pos = src.size();
     this->unrecognizedChar(currentChar);
   }
-}
 
-void Lexer::createBinaryOperatorToken() {
-  tokens.push_back(Token(std::string(1, currentChar), BinaryOperator));
+  Token token(TokenType::StringLiteral, static_cast<uint32_t>(pos),
+              static_cast<uint32_t>(end - pos));
+  pos = end + 1;
+  return token;
 }
 
-void Lexer::createCompareToken(std::string firstChar, std::string secondChar,
-                               TokenType firstToken, TokenType secondToken) {
-  std::string z = firstChar + secondChar;
-  char c = secondChar[0];
-  if (!src.empty() && peek() == c) {
-    tokens.push_back(Token(z, firstToken));
+Token Lexer::createAndToken() {
+  if (!atEnd() && this->peek() == '&') {
     this->eat();
-  } else {
-    tokens.push_back(Token(firstChar, secondToken));
+    return makeToken(TokenType::And);
   }
+  this->unrecognizedChar(currentChar);
+  return makeToken(TokenType::And);
 }
 
-void Lexer::createOneCharToken(std::string tokenChar, TokenType charType) {
-  tokens.push_back(Token(tokenChar, charType));
+Token Lexer::createOrToken() {
+  if (!atEnd() && this->peek() == '|') {
+    this->eat();
+    return makeToken(TokenType::Or);
+  }
+  this->unrecognizedChar(currentChar);
+  return makeToken(TokenType::Or);
 }
 
-void Lexer::createIdentifierToken() {
-  std::string ident;
-  ident += currentChar;
-  while (!src.empty() && (std::isalnum(peek()) || peek() == '_')) {
-    ident += this->eat();
+Token Lexer::createCompareToken(char secondChar, TokenType firstToken,
+                                TokenType secondToken) {
+  if (!atEnd() && peek() == secondChar) {
+    this->eat();
+    return makeToken(firstToken);
   }
+  return makeToken(secondToken);
+}
 
-  auto it = KEYWORDS.find(ident);
-  if (it != KEYWORDS.end()) {
-    tokens.push_back(Token(ident, it->second));
-  } else {
-    tokens.push_back(Token(ident, Identifier));
+Token Lexer::createIdentifierToken() {
+  this->advanceTo(scanIdentifier(this->cursor(), this->sourceEnd()));
+
+  std::string_view ident = this->lexeme();
+  if (const Keyword *keyword = findKeyword(ident)) {
+    return makeToken(keyword->type);
   }
+  return makeToken(Identifier, SymbolTable::intern(ident));
 }
 
 void Lexer::skipComments() {
-    while (!src.empty() && peek() != '\n') {
-        this->eat();
-    }
+  size_t end = src.find('\n', pos);
+  pos = end == std::string_view::npos ? src.size() : end;
 }
 
 void Lexer::tokenize() {
-  src = std::vector<char>(sourceCode.begin(), sourceCode.end());
-
-  try {
+  pos = 0;
+  tokens.clear();
+  // Typical sources average about one token per four bytes, reserving up
+  // front avoids repeatedly growing and copying the vector on large inputs.
+  tokens.reserve(src.size() / 4 + 1);
+
+  do {
+    tokens.push_back(this->nextToken());
+  } while (tokens.back().getType() != TokenType::EOFToken);
+}
 
-  
-  while (!src.empty()) {
+Token Lexer::nextToken() {
+  while (!atEnd()) {
+    tokenStart = pos;
     currentChar = this->eat();
 
     if (this->isSkippable(currentChar)) {
+      this->advanceTo(skipWhitespace(this->cursor(), this->sourceEnd()));
       continue;
     }
-    if (std::isdigit(currentChar)) {
-      createNumberToken();
-    } else if (this->isAlpha(currentChar)) {
-      createIdentifierToken();
-    } else {
-      switch (currentChar) {
-      case '#':
-        skipComments();
-        break;
-      case '(':
-        createOneCharToken("(", TokenType::OpenParen);
-        break;
-      case ')':
-        createOneCharToken(")", TokenType::CloseParen);
-        break;
-      case '{':
-        createOneCharToken("{", TokenType::OpenBrace);
-        break;
-      case '}':
-        createOneCharToken("}", TokenType::CloseBrace);
-        break;
-      case '[':
-        createOneCharToken("[", TokenType::OpenBracket);
-        break;
-      case ']':
-        createOneCharToken("]", TokenType::CloseBracket);
-        break;
-      case ',':
-        createOneCharToken(",", TokenType::Comma);
-        break;
-      case '.':
-        createOneCharToken(".", TokenType::Dot);
-        break;
-      case '-':
-        if (std::isdigit(this->peek())) {
-          createNumberToken();
-        } else {
-          createBinaryOperatorToken();
-        }
-        break;
-      case '+':
-      case '*':
-      case '/':
-      case '%':
-        createBinaryOperatorToken();
-        break;
-      case ';':
-        createOneCharToken(";", TokenType::Semicolon);
-        break;
-      case '&':
-        createAndToken();
-        break;
-      case '|':
-        createOrToken();
-        break;
-      case '!':
-        createCompareToken("!", "=", TokenType::NotEqual, TokenType::Not);
-        break;
-      case '=':
-        createCompareToken("=", "=", TokenType::EqualEqual, TokenType::Equals);
-        break;
-      case '<':
-        createCompareToken("<", "=", TokenType::LessEqual, TokenType::LessThan);
-        break;
-      case '>':
-        createCompareToken(">", "=", TokenType::GreaterEqual,
-                           TokenType::GreaterThan);
-        break;
-      case '"':
-        if (isAlpha(this->peek())) {
-          createStringToken();
-        }
-        break;
-      default:
-        this->unrecognizedChar(currentChar);
-        break;
+    if (this->isInt(currentChar)) {
+      return createNumberToken();
+    }
+    if (this->isAlpha(currentChar)) {
+      return createIdentifierToken();
+    }
+
+    switch (currentChar) {
+    case '#':
+      skipComments();
+      continue;
+    case '(':
+      return makeToken(TokenType::OpenParen);
+    case ')':
+      return makeToken(TokenType::CloseParen);
+    case '{':
+      return makeToken(TokenType::OpenBrace);
+    case '}':
+      return makeToken(TokenType::CloseBrace);
+    case '[':
+      return makeToken(TokenType::OpenBracket);
+    case ']':
+      return makeToken(TokenType::CloseBracket);
+    case ',':
+      return makeToken(TokenType::Comma);
+    case '.':
+      return makeToken(TokenType::Dot);
+    case '-':
+      if (this->isInt(this->peek())) {
+        return createNumberToken();
+      }
+      return makeToken(TokenType::BinaryOperator);
+    case '+':
+    case '*':
+    case '/':
+    case '%':
+      return makeToken(TokenType::BinaryOperator);
+    case ';':
+      return makeToken(TokenType::Semicolon);
+    case '&':
+      return createAndToken();
+    case '|':
+      return createOrToken();
+    case '!':
+      return createCompareToken('=', TokenType::NotEqual, TokenType::Not);
+    case '=':
+      return createCompareToken('=', TokenType::EqualEqual, TokenType::Equals);
+    case '<':
+      return createCompareToken('=', TokenType::LessEqual,
+                                TokenType::LessThan);
+    case '>':
+      return createCompareToken('=', TokenType::GreaterEqual,
+                                TokenType::GreaterThan);
+    case '"':
+      if (isAlpha(this->peek())) {
+        return createStringToken();
       }
+      continue;
+    default:
+      this->unrecognizedChar(currentChar);
     }
   }
 
-  createOneCharToken("EndOfFile", TokenType::EOFToken);
-  }
-  catch (const std::exception& e) {        
-    throw;
-  }
+  tokenStart = pos;
+  return makeToken(TokenType::EOFToken);
 }
 
-char Lexer::eat() {
-  char currentChar = this->src[0];
-  this->src.erase(this->src.begin());
-  return currentChar;
+bool Lexer::atEnd() const { return pos >= src.size(); }
+
+char Lexer::eat() { return this->src[pos++]; }
+
+char Lexer::peek() const { return atEnd() ? '\0' : this->src[pos]; }
+
+const char *Lexer::cursor() const { return src.data() + pos; }
+
+const char *Lexer::sourceEnd() const { return src.data() + src.size(); }
+
+void Lexer::advanceTo(const char *position) { pos = position - src.data(); }
+
+std::string_view Lexer::lexeme() const {
+  return src.substr(tokenStart, pos - tokenStart);
 }
 
-char Lexer::peek() const { return this->src[0]; }
+Token Lexer::makeToken(TokenType type, uint32_t id) const {
+  return Token(type, static_cast<uint32_t>(tokenStart),
+               static_cast<uint32_t>(pos - tokenStart), id);
+}
 
-bool Lexer::isAlpha(char c) const { return std::isalpha(c) || c == '_'; }
+bool Lexer::isAlpha(char c) const {
+  return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
 
 bool Lexer::isSkippable(char c) const {
   return c == ' ' || c == '\n' || c == '\t';
 }
 
-bool Lexer::isInt(char c) const { return std::isdigit(c); }
+bool Lexer::isInt(char c) const {
+  return std::isdigit(static_cast<unsigned char>(c));
+}
 
 void Lexer::unrecognizedChar(char c) const {
   std::string message = "Unrecognized character found in source: ";
@@ -286,12 +339,29 @@ std::string Token::getTokeTypeName() {
   }
 }
 
-std::vector<Token> Lexer::getTokens() { return this->tokens; }
+const std::vector<Token> &Lexer::getTokens() const { return this->tokens; }
+
+std::string_view Lexer::getText(const Token &token) const {
+  return src.substr(token.offset, token.length);
+}
+
+double Lexer::getNumber(const Token &token) const {
+  if (token.type != NumberLiteral && token.type != FloatLiteral) {
+    return 0;
+  }
+  return numbers[token.id];
+}
 
 void Lexer::printTokens() {
+  if (tokens.empty()) {
+    this->tokenize();
+  }
+
   std::cout << "[ " << std::endl;
-  for (Token &token : this->getTokens()) {
+  for (Token token : this->getTokens()) {
     std::cout << token.getTokeTypeName() << ", " << std::endl;
   }
   std::cout << " ]" << std::endl;
 }
+
+static_assert(sizeof(Token) <= 16, "Token is expected to stay packed");
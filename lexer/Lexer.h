@@ -1,13 +1,16 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "SymbolTable.h"
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 
-enum TokenType {
+enum TokenType : uint8_t {
   // Name of variable, function itp ...
   Identifier,
 
@@ -61,47 +64,75 @@ enum TokenType {
   EOFToken,
 };
 
+// Packed 16 byte token. It does not own its text, offset and length locate it
+// in the lexed source (see Lexer::getText). id is the interned symbol of an
+// identifier or the index of a numeric literal in the lexer's number table.
 class Token {
 public:
-  Token(const std::string &value, TokenType type);
-  std::string getValue() const;
+  Token();
+  Token(TokenType type, uint32_t offset, uint32_t length, uint32_t id = 0);
   TokenType getType() const;
+  uint32_t getOffset() const;
+  uint32_t getLength() const;
+  Symbol getSymbol() const;
   std::string getTokeTypeName();
 
 private:
-  std::string value;
+  uint32_t offset;
+  uint32_t length;
+  uint32_t id;
   TokenType type;
+
+  friend class Lexer;
 };
 
+// Cursor based lexer. The source is not copied, so it has to outlive the lexer
+// and every token produced by it.
+//
+// Tokens are produced on demand by nextToken, which keeps returning EOFToken
+// once the source is exhausted. tokenize lexes the whole source up front into
+// the vector returned by getTokens, for callers that want all of it at once.
 class Lexer {
 public:
-  Lexer(const std::string &sourceCode);
+  Lexer(std::string_view sourceCode);
+  Lexer(const Lexer &) = delete;
+  Lexer &operator=(const Lexer &) = delete;
+
+  Token nextToken();
   void tokenize();
-  std::vector<Token> getTokens();
+  const std::vector<Token> &getTokens() const;
+  std::string_view getText(const Token &token) const;
+  double getNumber(const Token &token) const;
   void printTokens();
 
 private:
-  std::string sourceCode;
+  std::string_view src;
+  size_t pos;        // index of the next character to read
+  size_t tokenStart; // index of the first character of the current token
   char currentChar;
   std::vector<Token> tokens;
-  std::vector<char> src;
+  std::vector<double> numbers;
 
   bool isAlpha(char c) const;
   bool isSkippable(char c) const;
   bool isInt(char c) const;
   void unrecognizedChar(char c) const;
+  bool atEnd() const;
   char peek() const;
   char eat();
-
-  void createNumberToken();
-  void createStringToken();
-  void createAndToken();
-  void createOrToken();
-  void createBinaryOperatorToken();
-  void createCompareToken(std::string firstChar, std::string secondChar,
-                          TokenType firstToken, TokenType secondToken);
-  void createOneCharToken(std::string tokenChar, TokenType charType);
-  void createIdentifierToken();
+  std::string_view lexeme() const;
+  const char *cursor() const;
+  const char *sourceEnd() const;
+  void advanceTo(const char *position);
+  Token makeToken(TokenType type, uint32_t id = 0) const;
+
+  Token createNumberToken();
+  Token createStringToken();
+  Token createAndToken();
+  Token createOrToken();
+  Token createCompareToken(char secondChar, TokenType firstToken,
+                           TokenType secondToken);
+  Token createIdentifierToken();
 
   void skipComments();
 };
@@ -0,0 +1,206 @@
+#include "Scanner.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RUSTEDC_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef const char *(*ScanFunction)(const char *, const char *);
+
+struct ScanKernels {
+  ScanFunction whitespace;
+  ScanFunction identifier;
+  ScanFunction number;
+};
+
+bool isWhitespace(char c) { return c == ' ' || c == '\n' || c == '\t'; }
+
+bool isIdentifierChar(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+         (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool isNumberChar(char c) { return (c >= '0' && c <= '9') || c == '.'; }
+
+template <bool (*InClass)(char)>
+const char *scanScalar(const char *p, const char *end) {
+  while (p < end && InClass(*p)) {
+    ++p;
+  }
+  return p;
+}
+
+#ifdef RUSTEDC_X86_SIMD
+
+// The classifiers below return 0xFF in every byte that belongs to the class.
+// Byte comparisons are signed, which is fine: bytes >= 0x80 compare below
+// every bound used here and are never part of a class.
+
+__m128i whitespace128(__m128i v) {
+  __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+  __m128i newline = _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'));
+  __m128i tab = _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'));
+  return _mm_or_si128(_mm_or_si128(space, newline), tab);
+}
+
+__m128i inRange128(__m128i v, char low, char high) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(low - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(high + 1)));
+}
+
+__m128i identifier128(__m128i v) {
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i digit = inRange128(v, '0', '9');
+  __m128i alpha = inRange128(lower, 'a', 'z');
+  __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+  return _mm_or_si128(_mm_or_si128(digit, alpha), underscore);
+}
+
+__m128i number128(__m128i v) {
+  return _mm_or_si128(inRange128(v, '0', '9'),
+                      _mm_cmpeq_epi8(v, _mm_set1_epi8('.')));
+}
+
+template <__m128i (*Classify)(__m128i), bool (*InClass)(char)>
+const char *scanSSE2(const char *p, const char *end) {
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    unsigned outside = ~_mm_movemask_epi8(Classify(v)) & 0xFFFFu;
+    if (outside != 0) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 16;
+  }
+  return scanScalar<InClass>(p, end);
+}
+
+// AVX2 versions are spelled out instead of templated so that every helper
+// carries the target attribute and gets inlined into its caller.
+
+__attribute__((target("avx2"))) inline __m256i inRange256(__m256i v, char low,
+                                                          char high) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(low - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), v));
+}
+
+__attribute__((target("avx2"))) const char *
+skipWhitespaceAVX2(const char *p, const char *end) {
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    __m256i newline = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'));
+    __m256i tab = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'));
+    __m256i inside = _mm256_or_si256(_mm256_or_si256(space, newline), tab);
+    unsigned outside = ~static_cast<unsigned>(_mm256_movemask_epi8(inside));
+    if (outside != 0) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 32;
+  }
+  return scanSSE2<whitespace128, isWhitespace>(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+scanIdentifierAVX2(const char *p, const char *end) {
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i digit = inRange256(v, '0', '9');
+    __m256i alpha = inRange256(lower, 'a', 'z');
+    __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+    __m256i inside =
+        _mm256_or_si256(_mm256_or_si256(digit, alpha), underscore);
+    unsigned outside = ~static_cast<unsigned>(_mm256_movemask_epi8(inside));
+    if (outside != 0) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 32;
+  }
+  return scanSSE2<identifier128, isIdentifierChar>(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+scanNumberAVX2(const char *p, const char *end) {
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i inside = _mm256_or_si256(
+        inRange256(v, '0', '9'), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')));
+    unsigned outside = ~static_cast<unsigned>(_mm256_movemask_epi8(inside));
+    if (outside != 0) {
+      return p + __builtin_ctz(outside);
+    }
+    p += 32;
+  }
+  return scanSSE2<number128, isNumberChar>(p, end);
+}
+
+#endif
+
+ScanKernels kernelsFor(ScanLevel level) {
+  switch (level) {
+#ifdef RUSTEDC_X86_SIMD
+  case ScanLevel::AVX2:
+    return {skipWhitespaceAVX2, scanIdentifierAVX2, scanNumberAVX2};
+  case ScanLevel::SSE2:
+    return {scanSSE2<whitespace128, isWhitespace>,
+            scanSSE2<identifier128, isIdentifierChar>,
+            scanSSE2<number128, isNumberChar>};
+#endif
+  default:
+    return {scanScalar<isWhitespace>, scanScalar<isIdentifierChar>,
+            scanScalar<isNumberChar>};
+  }
+}
+
+ScanLevel activeLevel = detectScanLevel();
+ScanKernels kernels = kernelsFor(activeLevel);
+
+} // namespace
+
+const char *skipWhitespace(const char *begin, const char *end) {
+  return kernels.whitespace(begin, end);
+}
+
+const char *scanIdentifier(const char *begin, const char *end) {
+  return kernels.identifier(begin, end);
+}
+
+const char *scanNumber(const char *begin, const char *end) {
+  return kernels.number(begin, end);
+}
+
+ScanLevel detectScanLevel() {
+#ifdef RUSTEDC_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return ScanLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return ScanLevel::SSE2;
+  }
+#endif
+  return ScanLevel::Scalar;
+}
+
+ScanLevel getScanLevel() { return activeLevel; }
+
+void setScanLevel(ScanLevel level) {
+  ScanLevel supported = detectScanLevel();
+  activeLevel = static_cast<int>(level) > static_cast<int>(supported)
+                    ? supported
+                    : level;
+  kernels = kernelsFor(activeLevel);
+}
+
+const char *scanLevelName(ScanLevel level) {
+  switch (level) {
+  case ScanLevel::AVX2:
+    return "AVX2";
+  case ScanLevel::SSE2:
+    return "SSE2";
+  default:
+    return "scalar";
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <cstddef>
+
+// Bulk character scanning used by the lexer. Every function returns a pointer
+// to the first character in [begin, end) that does not belong to the run, or
+// end when the whole range does.
+//
+// On x86 the SSE2 or AVX2 implementation is picked once at startup from what
+// the CPU supports, other platforms always use the scalar one.
+
+enum class ScanLevel {
+  Scalar,
+  SSE2,
+  AVX2,
+};
+
+// Run of ' ', '\n' and '\t'.
+const char *skipWhitespace(const char *begin, const char *end);
+
+// Run of [A-Za-z0-9_].
+const char *scanIdentifier(const char *begin, const char *end);
+
+// Run of [0-9.].
+const char *scanNumber(const char *begin, const char *end);
+
+// Best level supported by the running CPU.
+ScanLevel detectScanLevel();
+
+ScanLevel getScanLevel();
+
+// Forces a level, e.g. to compare them in a benchmark. A level above what the
+// CPU supports falls back to the detected one.
+void setScanLevel(ScanLevel level);
+
+const char *scanLevelName(ScanLevel level);
+
+#endif
@@ -0,0 +1,29 @@
+#include "SymbolTable.h"
+
+SymbolTable::SymbolTable() {
+  names.emplace_back("");
+  ids.emplace(names.back(), 0);
+}
+
+SymbolTable &SymbolTable::instance() {
+  static SymbolTable table;
+  return table;
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+  SymbolTable &table = instance();
+
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) {
+    return it->second;
+  }
+
+  Symbol symbol = static_cast<Symbol>(table.names.size());
+  table.names.emplace_back(name);
+  table.ids.emplace(table.names.back(), symbol);
+  return symbol;
+}
+
+const std::string &SymbolTable::name(Symbol symbol) {
+  return instance().names.at(symbol);
+}
@@ -0,0 +1,30 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Interned identifier. Two names are equal exactly when their symbols are.
+typedef uint32_t Symbol;
+
+// Process wide interner shared by the lexer, the AST and the runtime.
+// Symbol 0 is the empty name and is used for tokens that carry no symbol.
+class SymbolTable {
+public:
+  static Symbol intern(std::string_view name);
+  static const std::string &name(Symbol symbol);
+
+private:
+  SymbolTable();
+  static SymbolTable &instance();
+
+  // deque never relocates its elements, so the keys of ids can safely view
+  // the strings stored in names.
+  std::deque<std::string> names;
+  std::unordered_map<std::string_view, Symbol> ids;
+};
+
+#endif
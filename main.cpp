@@ -1,10 +1,27 @@
+#include "ast/CommonAST.h"
+#include "ast/FoldAST.h"
+#include "ast/HoistAST.h"
+#include "ast/InlineAST.h"
+#include "ast/InductionAST.h"
+#include "ast/PurityAST.h"
+#include "ast/ResolverAST.h"
+#include "ast/TypesAST.h"
+#include "cache/ProgramCache.h"
 #include "database/DatabaseHandler.h"
 #include "lexer/Lexer.h"
 #include "parser/Parser.h"
+#include "runtime/aot/AotCompiler.h"
+#include "runtime/closure/ClosureCompiler.h"
 #include "runtime/environment/Environment.h"
+#include "runtime/gc/Heap.h"
 #include "runtime/interpreter/Interpreter.h"
+#include "runtime/jit/Jit.h"
+#include "runtime/memo/Memo.h"
 #include "runtime/values/Values.h"
+#include "runtime/vm/Compiler.h"
+#include "runtime/vm/VM.h"
 #include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <ctime>
 #include <filesystem>
@@ -14,6 +31,47 @@
 #include <ostream>
 #include <string>
 
+// How a program is run.
+enum class Engine {
+  // Compiled to register bytecode and run by the VM.
+  Bytecode,
+  // The tree walking evaluator, e.g. to compare it with the others on the
+  // same script.
+  TreeWalk,
+  // Compiled to closures, see runtime/closure/ClosureCompiler.h.
+  Closures,
+};
+
+struct RunOptions {
+  // Look the script up in the program cache before lexing it, and store it
+  // there after parsing on a miss.
+  bool useCache = true;
+  // Only parse the script and write its cache entry, without running it.
+  bool emitCache = false;
+  Engine engine = Engine::Bytecode;
+  // Print what the garbage collector did to stderr before exiting.
+  bool gcStats = false;
+  // Print how many calls were inlined, nodes folded and expressions hoisted
+  // out of loops before running, how many the tree walking evaluator
+  // specialized, and how many instruction sequences the compiler fused, to
+  // stderr before exiting.
+  bool nodeStats = false;
+  // Compile hot functions of the VM to machine code once they were called or
+  // looped this many times, 0 keeps the JIT off.
+  uint32_t jitThreshold = 0;
+  // Answer calls of pure functions from earlier ones with the same arguments
+  // and print how often that worked to stderr before exiting.
+  bool memoize = false;
+  // Replace calls of small functions by the expression they return, turned
+  // off by --no-inline to debug the calls as written.
+  bool inlining = true;
+  // Print the types inferTypes proved for the script instead of running it.
+  bool dumpTypes = false;
+  // Write the script as C++ to this file instead of running it.
+  std::string aotOutput;
+  std::string cacheDirectory = ProgramCache::defaultDirectory();
+};
+
 const char *hostName = "127.0.0.1";
 const char *dbName = "rusted-c";
 const char *user = "relow";
@@ -37,24 +95,74 @@ double process_mem_usage() {
   return vm_usage;
 }
 
-void run(std::string code, DatabaseHandler *db, std::string type) {
+std::unique_ptr<Program> parse_source(const std::string &code) {
+  Lexer lexer = Lexer(code);
+  Parser parser;
+  return parser.produceAST(lexer);
+}
+
+// Code compiled from the programs of a run. FnVals created while running
+// point into it, so it is kept until the run ends.
+struct CompiledCode {
+  std::vector<std::unique_ptr<CompiledProgram>> bytecode;
+  std::vector<std::unique_ptr<ClosureProgram>> closures;
+};
+
+Value execute(Program *program, Environment *env, const RunOptions &options,
+              CompiledCode &compiled) {
+  switch (options.engine) {
+  case Engine::TreeWalk:
+    return Interpreter::evaluate(program, env);
+  case Engine::Closures:
+    compiled.closures.push_back(ClosureCompiler::compile(*program));
+    return ClosureCompiler::execute(*compiled.closures.back(), env);
+  case Engine::Bytecode:
+    break;
+  }
+  compiled.bytecode.push_back(Compiler::compile(*program));
+  return VM::execute(*compiled.bytecode.back(), env);
+}
+
+void run(std::string code, DatabaseHandler *db, std::string type,
+         const RunOptions &options) {
   std::string errorMessage = "";
   std::string errorType = "";
 
   auto start = std::chrono::high_resolution_clock::now();
   double mem_before = process_mem_usage();
 
-  RuntimeVal *result = nullptr;
+  Value result;
+  CompiledCode compiled;
 
   try {
-    Lexer lexer = Lexer(code);
-    Parser parser;
-
-    std::unique_ptr<Program> program = parser.produceAST(lexer.getTokens());
+    std::unique_ptr<Program> program;
+
+    if (options.useCache) {
+      ProgramCache cache(options.cacheDirectory, code);
+      program = cache.load();
+      if (program == nullptr) {
+        program = parse_source(code);
+        cache.store(*program);
+      }
+    } else {
+      program = parse_source(code);
+    }
+    if (options.inlining) {
+      inlineCalls(*program);
+    }
+    foldConstants(*program);
+    inferTypes(*program);
+    hoistInvariants(*program);
+    eliminateCommonSubexpressions(*program);
+    resolveProgram(*program, true);
+    markCountedLoops(*program);
+    if (options.memoize) {
+      markMemoizable(*program);
+    }
 
     Environment *env = new Environment();
 
-    result = Interpreter::evaluate(program.get(), env);
+    result = execute(program.get(), env, options, compiled);
 
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
@@ -87,16 +195,19 @@ void run(std::string code, DatabaseHandler *db, std::string type) {
     db->addNewStatistic(execution_time, memory_usage, errorMessage, errorType,
                         type, code, result);
   }
-
-  delete result;
 }
 
-void repl(DatabaseHandler *db) {
+void repl(DatabaseHandler *db, const RunOptions &options) {
   std::string type = "REPL";
   Parser parser;
-  std::unique_ptr<Program> program;
-
-  RuntimeVal *val = nullptr;
+  // Functions declared on one line are called from later ones and point into
+  // the arena of the line that declared them, so every program is kept.
+  std::vector<std::unique_ptr<Program>> programs;
+  CompiledCode compiled;
+
+  // The result of the last line outlives the collections of the next one.
+  Value val;
+  GcRoot valRoot(val);
   Environment env;
 
   std::cout << "RustedC v0.1" << std::endl;
@@ -118,10 +229,12 @@ void repl(DatabaseHandler *db) {
     try {
       Lexer lexer = Lexer(input);
 
-      program = parser.produceAST(lexer.getTokens());
+      programs.push_back(parser.produceAST(lexer));
+      // Globals stay dynamic, later lines see the ones declared here.
+      resolveProgram(*programs.back(), false);
 
-      val = Interpreter::evaluate(program.get(), &env);
-      std::cout << val->toString() << std::endl;
+      val = execute(programs.back().get(), &env, options, compiled);
+      std::cout << val.toString() << std::endl;
     } catch (const std::exception &e) {
       std::cerr << e.what() << std::endl;
       if (const LexerError *lexErr = dynamic_cast<const LexerError *>(&e)) {
@@ -155,6 +268,68 @@ void repl(DatabaseHandler *db) {
   }
 }
 
+void emit_cache(const std::string &code, const RunOptions &options) {
+  ProgramCache cache(options.cacheDirectory, code);
+
+  try {
+    std::unique_ptr<Program> program = parse_source(code);
+    if (!cache.store(*program)) {
+      std::cerr << "Error: cannot write " << cache.path() << std::endl;
+      std::exit(1);
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::exit(1);
+  }
+
+  std::cout << cache.path() << std::endl;
+}
+
+void emit_cpp(const std::string &code, const std::string &source,
+              const RunOptions &options) {
+  std::ofstream out(options.aotOutput, std::ios::binary);
+  if (!out.is_open()) {
+    std::cerr << "Error: cannot write " << options.aotOutput << std::endl;
+    std::exit(1);
+  }
+
+  try {
+    std::unique_ptr<Program> program = parse_source(code);
+    if (options.inlining) {
+      inlineCalls(*program);
+    }
+    foldConstants(*program);
+    inferTypes(*program);
+    hoistInvariants(*program);
+    eliminateCommonSubexpressions(*program);
+    resolveProgram(*program, true);
+    std::unique_ptr<CompiledProgram> compiled = Compiler::compile(*program);
+    AotCompiler::transpile(*compiled, source, options.aotOutput, out);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::exit(1);
+  }
+
+  out.close();
+  if (!out) {
+    std::cerr << "Error: cannot write " << options.aotOutput << std::endl;
+    std::exit(1);
+  }
+  std::cout << AotCompiler::buildCommand(options.aotOutput) << std::endl;
+}
+
+void dump_types(const std::string &code) {
+  try {
+    std::unique_ptr<Program> program = parse_source(code);
+    foldConstants(*program);
+    resolveProgram(*program, true);
+    dumpTypes(*program, std::cout);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    std::exit(1);
+  }
+}
+
 std::string read_file(std::string filePath) {
   std::filesystem::path filePathObject(filePath);
 
@@ -178,7 +353,7 @@ std::string read_file(std::string filePath) {
     std::exit(1);
   }
 
-  std::ifstream inputFile(filePath);
+  std::ifstream inputFile(filePath, std::ios::binary);
 
   if (!inputFile.is_open()) {
     std::cerr << "Failed to open the file. Probably wrong file name"
@@ -186,14 +361,111 @@ std::string read_file(std::string filePath) {
     std::exit(1);
   }
 
-  std::stringstream buffer;
-  buffer << inputFile.rdbuf();
+  // Read straight into a buffer of the final size, the lexer works on a view
+  // of it so this is the only copy of the source that is ever made.
+  std::string source(std::filesystem::file_size(filePathObject), '\0');
+  inputFile.read(source.data(), source.size());
+  source.resize(inputFile.gcount());
 
   inputFile.close();
-  return buffer.str();
+  return source;
 }
 
 int main(int argc, char **argv) {
+  RunOptions options;
+  std::string target;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--no-cache") {
+      options.useCache = false;
+    } else if (arg == "--emit-cache") {
+      options.emitCache = true;
+    } else if (arg == "--tree-walk") {
+      options.engine = Engine::TreeWalk;
+    } else if (arg == "--closures") {
+      options.engine = Engine::Closures;
+    } else if (arg == "--gc-stats") {
+      options.gcStats = true;
+    } else if (arg == "--node-stats") {
+      options.nodeStats = true;
+    } else if (arg == "--aot") {
+      if (i + 1 >= argc) {
+        std::cout << "Error: --aot needs an output file" << std::endl;
+        return 1;
+      }
+      options.aotOutput = argv[++i];
+    } else if (arg == "--memoize") {
+      options.memoize = true;
+    } else if (arg == "--no-inline") {
+      options.inlining = false;
+    } else if (arg == "--dump-types") {
+      options.dumpTypes = true;
+    } else if (arg == "--jit") {
+      options.jitThreshold = Jit::DEFAULT_THRESHOLD;
+    } else if (arg == "--jit-threshold") {
+      char *end = nullptr;
+      unsigned long threshold =
+          i + 1 < argc ? std::strtoul(argv[i + 1], &end, 10) : 0;
+      if (end == nullptr || *end != '\0' || threshold == 0 ||
+          threshold > UINT32_MAX) {
+        std::cout << "Error: --jit-threshold needs a positive number"
+                  << std::endl;
+        return 1;
+      }
+      options.jitThreshold = static_cast<uint32_t>(threshold);
+      i++;
+    } else if (arg.rfind("--", 0) == 0) {
+      std::cout << "Error: unknown option " << arg << std::endl;
+      return 1;
+    } else if (target.empty()) {
+      target = arg;
+    } else {
+      std::cout << "Error: too many arguments" << std::endl;
+      return 1;
+    }
+  }
+
+  if (options.jitThreshold > 0) {
+    if (!Jit::supported()) {
+      std::cerr << "Warning: the JIT only supports x86-64 Linux, running "
+                   "without it"
+                << std::endl;
+    }
+    Jit::enable(options.jitThreshold);
+  }
+
+  if (options.memoize) {
+    Memo::enable();
+  }
+
+  if (options.emitCache) {
+    if (target.empty()) {
+      std::cout << "Error: --emit-cache needs a file" << std::endl;
+      return 1;
+    }
+    emit_cache(read_file(target), options);
+    return 0;
+  }
+
+  if (options.dumpTypes) {
+    if (target.empty()) {
+      std::cout << "Error: --dump-types needs a file" << std::endl;
+      return 1;
+    }
+    dump_types(read_file(target));
+    return 0;
+  }
+
+  if (!options.aotOutput.empty()) {
+    if (target.empty()) {
+      std::cout << "Error: --aot needs a file" << std::endl;
+      return 1;
+    }
+    emit_cpp(read_file(target), target, options);
+    return 0;
+  }
+
   DatabaseHandler *database = nullptr;
 
   try {
@@ -204,16 +476,27 @@ int main(int argc, char **argv) {
               << std::endl;
   }
 
-  if (argc == 1) {
-    repl(database);
+  if (target.empty()) {
+    repl(database, options);
+  } else if (target == "database") {
+    database->displayMenu();
+  } else {
+    run(read_file(target), database, "FILE", options);
   }
 
-  if (argc == 2) {
-    if (strcmp(argv[1], "database") == 0) {
-      database->displayMenu();
-    } else {
-      run(read_file(argv[1]), database, "FILE");
-    }
+  if (options.gcStats) {
+    Heap::printStats(std::cerr);
+  }
+  if (options.nodeStats) {
+    Interpreter::printNodeStats(std::cerr);
+    Compiler::printFuseStats(std::cerr);
+    printFoldStats(std::cerr);
+    printHoistStats(std::cerr);
+    printInlineStats(std::cerr);
+    printCommonStats(std::cerr);
+  }
+  if (options.memoize) {
+    Memo::printStats(std::cerr);
   }
 
   delete database;
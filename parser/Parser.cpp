@@ -1,40 +1,60 @@
 #include "Parser.h"
 #include <string>
 
-std::unique_ptr<Program> Parser::produceAST(std::vector<Token> tokens) {
-  this->tokens = tokens;
+std::unique_ptr<Program> Parser::produceAST(Lexer &lexer) {
+  this->lexer = &lexer;
+  this->bufferStart = 0;
+  this->bufferCount = 0;
 
   std::unique_ptr<Program> program = std::make_unique<Program>();
   program->kind = NodeType::Program;
+  this->arena = &program->arena;
+  this->pendingNodes.clear();
 
   while (!eof()) {
-    program->body.push_back(parse_stmt());
+    pendingNodes.push_back(parse_stmt());
   }
+  program->body = take_list<Stmt>(0);
 
   return program;
 }
 
-bool Parser::eof() { return tokens[0].getType() == TokenType::EOFToken; }
+bool Parser::eof() { return at().getType() == TokenType::EOFToken; }
 
-Token Parser::at() { return tokens[0]; }
+void Parser::fill(size_t count) {
+  while (bufferCount < count) {
+    lookaheadBuffer[(bufferStart + bufferCount) % LOOKAHEAD_SIZE] =
+        lexer->nextToken();
+    bufferCount++;
+  }
+}
+
+const Token &Parser::at() { return lookahead(0); }
 
 Token Parser::eat() {
-  Token prev = tokens[0];
-  tokens.erase(tokens.begin());
+  Token prev = at();
+  bufferStart = (bufferStart + 1) % LOOKAHEAD_SIZE;
+  bufferCount--;
   return prev;
 }
 
-Token Parser::lookahead(size_t num) {
-  if (num >= tokens.size()) {
-    return Token("", TokenType::EOFToken);
+const Token &Parser::lookahead(size_t num) {
+  if (num >= LOOKAHEAD_SIZE) {
+    throw ParserError("Parser cannot look ahead more than " +
+                      std::to_string(LOOKAHEAD_SIZE) + " tokens");
   }
-  return tokens[num];
+  fill(num + 1);
+  return lookaheadBuffer[(bufferStart + num) % LOOKAHEAD_SIZE];
+}
+
+std::string_view Parser::text(const Token &token) const {
+  return lexer->getText(token);
 }
 
-Token Parser::expect(TokenType type, const std::string &err) {
+Token Parser::expect(TokenType type, const char *err) {
   Token prev = this->eat();
   if (prev.getType() != type) {
-    throw ParserError(err + prev.getValue() + " - Expecting: " + std::to_string(static_cast<int>(type)));
+    throw ParserError(err + std::string(text(prev)) + " - Expecting: " + std::to_string(static_cast<int>(type)));
   }
   return prev;
 }
@@ -45,14 +65,54 @@ bool Parser::is_comparison_operator(TokenType type) {
          type == TokenType::EqualEqual || type == TokenType::NotEqual;
 }
 
-bool Parser::is_additive_operator(std::string value) {
+bool Parser::is_additive_operator(std::string_view value) {
   return value == "+" || value == "-";
 }
 
-bool Parser::is_multiplicative_operator(std::string value) {
+bool Parser::is_multiplicative_operator(std::string_view value) {
   return value == "*" || value == "/" || value == "%";
 }
 
 bool Parser::is_logical_operator(TokenType type) {
     return type == TokenType::And || type == TokenType::Or;
 }
+
+Operator Parser::to_operator(const Token &token) {
+  switch (token.getType()) {
+  case TokenType::LessThan:
+    return Operator::Less;
+  case TokenType::LessEqual:
+    return Operator::LessEqual;
+  case TokenType::GreaterThan:
+    return Operator::Greater;
+  case TokenType::GreaterEqual:
+    return Operator::GreaterEqual;
+  case TokenType::EqualEqual:
+    return Operator::Equal;
+  case TokenType::NotEqual:
+    return Operator::NotEqual;
+  case TokenType::And:
+    return Operator::And;
+  case TokenType::Or:
+    return Operator::Or;
+  case TokenType::Not:
+    return Operator::Not;
+  case TokenType::BinaryOperator:
+    switch (text(token)[0]) {
+    case '+':
+      return Operator::Add;
+    case '-':
+      return Operator::Subtract;
+    case '*':
+      return Operator::Multiply;
+    case '/':
+      return Operator::Divide;
+    case '%':
+      return Operator::Modulo;
+    }
+    break;
+  default:
+    break;
+  }
+  throw ParserError("Unexpected operator: " + std::string(text(token)));
+}
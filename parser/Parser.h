@@ -6,46 +6,74 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Parser {
 private:
-  std::vector<Token> tokens;
+  // Tokens are pulled from the lexer as the grammar needs them. Only the ones
+  // already peeked at but not yet consumed are kept, in a small ring buffer.
+  static const size_t LOOKAHEAD_SIZE = 4;
+
+  Lexer *lexer;
+  AstArena *arena;
+
+  // Elements of the lists still being parsed, nested lists stack on top of
+  // each other. A finished list is moved into the arena by take_list, so no
+  // temporary vector is allocated per block or argument list.
+  std::vector<Stmt *> pendingNodes;
+
+  template <typename T> NodeList<T> take_list(size_t mark) {
+    NodeList<T> list = arena->makeArray<T *>(pendingNodes.size() - mark);
+    for (size_t i = 0; i < list.size(); i++) {
+      list[i] = static_cast<T *>(pendingNodes[mark + i]);
+    }
+    pendingNodes.resize(mark);
+    return list;
+  }
+  Token lookaheadBuffer[LOOKAHEAD_SIZE];
+  size_t bufferStart;
+  size_t bufferCount;
+
   bool eof();
+  void fill(size_t count);
 
-  Token at();
+  const Token &at();
   Token eat();
-  Token expect(TokenType type, const std::string &err);
-  Token lookahead(size_t num);
-
-  std::unique_ptr<Stmt> parse_stmt();
-  std::unique_ptr<Stmt> parse_if_statement();
-  std::unique_ptr<Stmt> parse_while_statement();
-  std::unique_ptr<Stmt> parse_return_statement();
-  std::unique_ptr<Stmt> parse_var_declaration();
-  std::unique_ptr<Stmt> parse_function_declaration();
-  std::unique_ptr<Stmt> parse_struct_declaration();
-
-  std::unique_ptr<Expr> parse_expr();
-  std::unique_ptr<Expr> parse_additive_expr();
-  std::unique_ptr<Expr> parse_multiplicative_expr();
-  std::unique_ptr<Expr> parse_primary_expr();
-  std::unique_ptr<Expr> parse_assignment_expr();
-  std::unique_ptr<Expr> parse_comparision_expr();
-  std::unique_ptr<Expr> parse_logical_expr();
-  std::unique_ptr<Expr> parse_call_member_expr();
-  std::unique_ptr<Expr> parse_member_access(std::unique_ptr<Expr> left);
-
-  std::vector<std::unique_ptr<Expr>> parse_arguments_list();
-  std::vector<std::unique_ptr<Expr>> parse_args();
+  Token expect(TokenType type, const char *err);
+  const Token &lookahead(size_t num);
+  std::string_view text(const Token &token) const;
+
+  Stmt *parse_stmt();
+  Stmt *parse_if_statement();
+  Stmt *parse_while_statement();
+  Stmt *parse_return_statement();
+  Stmt *parse_var_declaration();
+  Stmt *parse_function_declaration();
+  Stmt *parse_struct_declaration();
+
+  Expr *parse_expr();
+  Expr *parse_additive_expr();
+  Expr *parse_multiplicative_expr();
+  Expr *parse_primary_expr();
+  Expr *parse_assignment_expr();
+  Expr *parse_comparision_expr();
+  Expr *parse_logical_expr();
+  Expr *parse_call_member_expr();
+  Expr *parse_member_access(Expr *left);
+
+  NodeList<Expr> parse_arguments_list();
+  NodeList<Expr> parse_args();
+
+  Operator to_operator(const Token &token);
 
   bool is_comparison_operator(TokenType type);
-  bool is_additive_operator(std::string type);
-  bool is_multiplicative_operator(std::string value);
+  bool is_additive_operator(std::string_view value);
+  bool is_multiplicative_operator(std::string_view value);
   bool is_logical_operator(TokenType type);
 
 public:
-  std::unique_ptr<Program> produceAST(std::vector<Token> tokens);
+  std::unique_ptr<Program> produceAST(Lexer &lexer);
 };
 
 class ParserError : public std::runtime_error {
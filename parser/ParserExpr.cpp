@@ -1,7 +1,7 @@
 ﻿#include "Parser.h"
 
-using ExprPtr = std::unique_ptr<Expr>;
-using StmtPtr = std::unique_ptr<Stmt>;
+using ExprPtr = Expr *;
+using StmtPtr = Stmt *;
 
 ExprPtr Parser::parse_expr() {
   try {
@@ -17,10 +17,9 @@ ExprPtr Parser::parse_logical_expr() {
     ExprPtr left = parse_comparision_expr();
 
     while (is_logical_operator(at().getType())) {
-      std::string logicalOperator = eat().getValue();
+      Operator logicalOperator = to_operator(eat());
       ExprPtr right = parse_comparision_expr();
-      left = std::make_unique<LogicalExpr>(std::move(left), std::move(right),
-                                           logicalOperator);
+      left = arena->make<LogicalExpr>(left, right, logicalOperator);
     }
 
     return left;
@@ -34,10 +33,9 @@ ExprPtr Parser::parse_comparision_expr() {
     ExprPtr left = parse_additive_expr();
 
     if (is_comparison_operator(at().getType())) {
-      std::string comparisonOperator = eat().getValue();
+      Operator comparisonOperator = to_operator(eat());
       ExprPtr right = parse_additive_expr();
-      left = std::make_unique<BinaryExpr>(std::move(left), std::move(right),
-                                          comparisonOperator);
+      left = arena->make<BinaryExpr>(left, right, comparisonOperator);
     }
 
     return left;
@@ -53,28 +51,28 @@ ExprPtr Parser::parse_primary_expr() {
 
     if (tk == TokenType::Not) {
       this->eat();
-      value = std::make_unique<UnaryExpr>(parse_primary_expr(), "!");
-    } else if (tk == TokenType::BinaryOperator && at().getValue() == "-") {
+      value = arena->make<UnaryExpr>(parse_primary_expr(), Operator::Not);
+    } else if (tk == TokenType::BinaryOperator && text(at()) == "-") {
       this->eat();
-      value = std::make_unique<UnaryExpr>(parse_primary_expr(), "-");
+      value = arena->make<UnaryExpr>(parse_primary_expr(), Operator::Negate);
     } else {
       switch (tk) {
       case TokenType::Identifier:
         value = parse_member_access(
-            std::make_unique<IdentifierExpr>(eat().getValue()));
+            arena->make<IdentifierExpr>(eat().getSymbol()));
         break;
       case TokenType::NumberLiteral:
-        value = std::make_unique<NumericLiteral>(std::stod(eat().getValue()));
+        value = arena->make<NumericLiteral>(lexer->getNumber(eat()));
         break;
       case TokenType::FloatLiteral:
-        value = std::make_unique<NumericLiteral>(std::stod(eat().getValue()));
+        value = arena->make<NumericLiteral>(lexer->getNumber(eat()));
         break;
       case TokenType::StringLiteral:
-        value = std::make_unique<StrLiteral>(eat().getValue());
+        value = arena->make<StrLiteral>(arena->copyString(text(eat())));
         break;
       case TokenType::Null:
         eat();
-        value = std::make_unique<NullLiteral>("null");
+        value = arena->make<NullLiteral>();
         break;
       case TokenType::OpenParen:
         eat();
@@ -87,7 +85,7 @@ ExprPtr Parser::parse_primary_expr() {
       default:
         value = nullptr;
         std::cerr << "Unexpected token found during parsing! "
-                  << at().getValue() << std::endl;
+                  << text(at()) << std::endl;
         std::exit(1);
       }
     }
@@ -103,11 +101,10 @@ ExprPtr Parser::parse_additive_expr() {
   try {
     ExprPtr left = parse_multiplicative_expr();
 
-    while (is_additive_operator(at().getValue())) {
-      std::string binaryOperator = eat().getValue();
+    while (is_additive_operator(text(at()))) {
+      Operator binaryOperator = to_operator(eat());
       ExprPtr right = parse_multiplicative_expr();
-      left = std::make_unique<BinaryExpr>(std::move(left), std::move(right),
-                                          binaryOperator);
+      left = arena->make<BinaryExpr>(left, right, binaryOperator);
     }
 
     return left;
@@ -120,11 +117,10 @@ ExprPtr Parser::parse_multiplicative_expr() {
   try {
     ExprPtr left = parse_call_member_expr();
 
-    while (is_multiplicative_operator(at().getValue())) {
-      std::string binaryOperator = eat().getValue();
+    while (is_multiplicative_operator(text(at()))) {
+      Operator binaryOperator = to_operator(eat());
       ExprPtr right = parse_primary_expr();
-      left = std::make_unique<BinaryExpr>(std::move(left), std::move(right),
-                                          binaryOperator);
+      left = arena->make<BinaryExpr>(left, right, binaryOperator);
     }
 
     return left;
@@ -142,8 +138,7 @@ ExprPtr Parser::parse_assignment_expr() {
       ExprPtr value = parse_assignment_expr();
       expect(TokenType::Semicolon,
              "Expected semicolon at the end of assignment expression");
-      return std::make_unique<AssignmentExpr>(std::move(left),
-                                              std::move(value));
+      return arena->make<AssignmentExpr>(left, value);
     }
 
     return left;
@@ -158,7 +153,7 @@ ExprPtr Parser::parse_call_member_expr() {
 
     while (at().getType() == TokenType::OpenParen) {
       eat();
-      std::vector<ExprPtr> arguments;
+      NodeList<Expr> arguments;
 
       if (at().getType() != TokenType::CloseParen) {
         arguments = parse_arguments_list();
@@ -166,8 +161,7 @@ ExprPtr Parser::parse_call_member_expr() {
 
       expect(TokenType::CloseParen,
              "Expected a closing parenthesis in the function call");
-      caller =
-          std::make_unique<CallExpr>(std::move(caller), std::move(arguments));
+      caller = arena->make<CallExpr>(caller, arguments);
     }
 
     return caller;
@@ -182,15 +176,13 @@ ExprPtr Parser::parse_member_access(ExprPtr left) {
            at().getType() == TokenType::OpenParen) {
       if (at().getType() == TokenType::Dot) {
         eat(); // Consume the '.'
-        std::string memberName =
+        Symbol memberName =
             expect(TokenType::Identifier, "Expected identifier after '.'")
-                .getValue();
-        left = std::make_unique<MemberAccessExpr>(std::move(left),
-                                                  std::move(memberName));
+                .getSymbol();
+        left = arena->make<MemberAccessExpr>(left, memberName);
       } else if (at().getType() == TokenType::OpenParen) {
-        std::vector<ExprPtr> arguments = parse_args();
-        left =
-            std::make_unique<CallExpr>(std::move(left), std::move(arguments));
+        NodeList<Expr> arguments = parse_args();
+        left = arena->make<CallExpr>(left, arguments);
       }
     }
     return left;
@@ -199,10 +191,10 @@ ExprPtr Parser::parse_member_access(ExprPtr left) {
   }
 }
 
-std::vector<ExprPtr> Parser::parse_args() {
+NodeList<Expr> Parser::parse_args() {
   try {
     expect(TokenType::OpenParen, "Expected open parenthesis");
-    std::vector<ExprPtr> args;
+    NodeList<Expr> args;
 
     if (at().getType() != TokenType::CloseParen) {
       args = parse_arguments_list();
@@ -216,17 +208,17 @@ std::vector<ExprPtr> Parser::parse_args() {
   }
 }
 
-std::vector<ExprPtr> Parser::parse_arguments_list() {
+NodeList<Expr> Parser::parse_arguments_list() {
   try {
-    std::vector<ExprPtr> args;
-    args.push_back(parse_assignment_expr());
+    size_t args = pendingNodes.size();
+    pendingNodes.push_back(parse_assignment_expr());
 
     while (at().getType() == TokenType::Comma) {
       eat();
-      args.push_back(parse_assignment_expr());
+      pendingNodes.push_back(parse_assignment_expr());
     }
 
-    return args;
+    return take_list<Expr>(args);
   } catch (const ParserError &e) {
     throw;
   }
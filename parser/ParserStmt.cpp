@@ -1,7 +1,7 @@
 #include "Parser.h"
 
-using ExprPtr = std::unique_ptr<Expr>;
-using StmtPtr = std::unique_ptr<Stmt>;
+using ExprPtr = Expr *;
+using StmtPtr = Stmt *;
 
 StmtPtr Parser::parse_stmt() {
   try {
@@ -48,14 +48,14 @@ StmtPtr Parser::parse_while_statement() {
 
     expect(TokenType::OpenBrace, "Expected '{' open 'while' body");
 
-    std::vector<StmtPtr> loopBody;
+    size_t loopBody = pendingNodes.size();
     while (at().getType() != TokenType::CloseBrace) {
-      loopBody.push_back(parse_stmt());
+      pendingNodes.push_back(parse_stmt());
     }
 
     expect(TokenType::CloseBrace, "Expected '}' close 'while' body");
 
-    return std::make_unique<WhileLoop>(std::move(condition), std::move(loopBody));
+    return arena->make<WhileLoop>(condition, take_list<Stmt>(loopBody));
   }
   catch (const ParserError& e) {
     throw;
@@ -69,12 +69,12 @@ StmtPtr Parser::parse_return_statement() {
     if (at().getType() == TokenType::Semicolon) {
       // Return statement without a value
       eat(); // Consume the semicolon
-      return std::make_unique<ReturnStatement>(nullptr);
+      return arena->make<ReturnStatement>(nullptr);
     } else {
       // Return statement with a value
-      std::unique_ptr<Stmt> value = parse_stmt();
+      StmtPtr value = parse_stmt();
       expect(TokenType::Semicolon, "Return statement must end with a semicolon.");
-      return std::make_unique<ReturnStatement>(std::move(value));
+      return arena->make<ReturnStatement>(value);
     }
   }
   catch (const ParserError& e) {
@@ -91,30 +91,32 @@ StmtPtr Parser::parse_if_statement() {
 
     expect(TokenType::CloseParen, "Expected ')' after 'if' condition");
 
-    std::vector<StmtPtr> ifBody;
+    size_t ifBodyStart = pendingNodes.size();
 
     expect(TokenType::OpenBrace, "Expected '{' open 'if' body");
 
     while (at().getType() != TokenType::CloseBrace) {
-      ifBody.push_back(parse_stmt());
+      pendingNodes.push_back(parse_stmt());
     }
 
     expect(TokenType::CloseBrace, "Expected '}' close 'if' body");
 
-    std::vector<StmtPtr> elseBody;
+    NodeList<Stmt> ifBody = take_list<Stmt>(ifBodyStart);
+    NodeList<Stmt> elseBody;
 
     if (at().getType() == TokenType::Else) {
       eat();
 
+      size_t elseBodyStart = pendingNodes.size();
       expect(TokenType::OpenBrace, "Expected '{' open 'else' body");
       while (at().getType() != TokenType::CloseBrace) {
-        elseBody.push_back(parse_stmt());
+        pendingNodes.push_back(parse_stmt());
       }
       expect(TokenType::CloseBrace, "Expected '}' close 'else' body");
+      elseBody = take_list<Stmt>(elseBodyStart);
     }
 
-    return std::make_unique<IfStatement>(std::move(condition), std::move(ifBody),
-                                         std::move(elseBody));
+    return arena->make<IfStatement>(condition, ifBody, elseBody);
   }
   catch (const ParserError& e) {
     throw;
@@ -125,10 +127,10 @@ StmtPtr Parser::parse_var_declaration() {
   try {
   bool isConstant = this->eat().getType() == TokenType::Const;
 
-  std::string identifier =
+  Symbol identifier =
       expect(TokenType::Identifier,
              "Expected identifier name following let | const keywords.")
-          .getValue();
+          .getSymbol();
 
   if (this->at().getType() == TokenType::Semicolon) {
     this->eat();
@@ -139,7 +141,7 @@ StmtPtr Parser::parse_var_declaration() {
       std::exit(1);
     }
 
-    return std::make_unique<VarDeclaration>(false, identifier);
+    return arena->make<VarDeclaration>(false, identifier);
   }
 
   expect(TokenType::Equals,
@@ -149,8 +151,7 @@ StmtPtr Parser::parse_var_declaration() {
 
   expect(TokenType::Semicolon, "Var declaration must end with a semicolon.");
 
-  return std::make_unique<VarDeclaration>(isConstant, identifier,
-                                          std::move(value));
+  return arena->make<VarDeclaration>(isConstant, identifier, value);
   }
   catch (const ParserError& e) {
     throw;
@@ -160,16 +161,16 @@ StmtPtr Parser::parse_var_declaration() {
 StmtPtr Parser::parse_function_declaration() {
   try {
     this->eat();
-    std::string name = this->expect(TokenType::Identifier,
-                                    "Expected function name following fn keyword")
-                           .getValue();
-    std::vector<ExprPtr> args = this->parse_args();
+    Symbol name = this->expect(TokenType::Identifier,
+                               "Expected function name following fn keyword")
+                      .getSymbol();
+    NodeList<Expr> args = this->parse_args();
 
-    std::vector<std::string> params;
+    ArenaArray<Symbol> params = arena->makeArray<Symbol>(args.size());
 
-    for (auto &arg : args) {
-      if (arg->kind == NodeType::Identifier) {
-        params.push_back(static_cast<IdentifierExpr *>(arg.get())->symbol);
+    for (size_t i = 0; i < args.size(); i++) {
+      if (args[i]->kind == NodeType::Identifier) {
+        params[i] = static_cast<IdentifierExpr *>(args[i])->symbol;
       } else {
         std::cerr << "Inside function declaration expected parameters to be of "
                      "type Identifier."
@@ -180,17 +181,18 @@ StmtPtr Parser::parse_function_declaration() {
 
     expect(TokenType::OpenBrace, "Expected function body following declaration");
 
-    std::vector<Stmt *> body;
+    size_t body = pendingNodes.size();
 
     while (this->at().getType() != TokenType::EOFToken &&
            this->at().getType() != TokenType::CloseBrace) {
-      body.push_back(parse_stmt().release());
+      pendingNodes.push_back(parse_stmt());
     }
 
     expect(TokenType::CloseBrace,
            "Closing brace expected inside function declaration");
 
-    return std::make_unique<FunctionDeclaration>(std::move(params), name, body);
+    return arena->make<FunctionDeclaration>(params, name,
+                                            take_list<Stmt>(body));
   }
   catch (const ParserError& e) {
     throw;
@@ -201,22 +203,23 @@ StmtPtr Parser::parse_struct_declaration() {
   try {
     eat(); // Consume the "struct" keyword
 
-    std::string structName =
+    Symbol structName =
         expect(TokenType::Identifier,
                "Expected struct name following 'struct' keyword")
-            .getValue();
+            .getSymbol();
 
     expect(TokenType::OpenBrace, "Expected '{' after struct name");
 
-    std::vector<std::unique_ptr<Stmt>> structBody;
+    size_t structBody = pendingNodes.size();
 
     while (at().getType() != TokenType::CloseBrace) {
-      structBody.push_back(parse_var_declaration());
+      pendingNodes.push_back(parse_var_declaration());
     }
 
     expect(TokenType::CloseBrace, "Expected '}' after struct body");
 
-    return std::make_unique<StructDeclaration>(structName, std::move(structBody));
+    return arena->make<StructDeclaration>(structName,
+                                          take_list<Stmt>(structBody));
   }
   catch (const ParserError& e) {
     throw;
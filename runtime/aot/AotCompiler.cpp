@@ -0,0 +1,356 @@
+#include "AotCompiler.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Writes one program. Symbols, strings and field caches used by the code are
+// gathered into tables while the functions are written, so the functions go
+// to a buffer first and the tables are printed above them.
+class SourceWriter {
+public:
+  explicit SourceWriter(const CompiledProgram &program) : program(program) {}
+
+  void write(const std::string &source, const std::string &path,
+             std::ostream &out);
+
+private:
+  void writeFunction(size_t index);
+  void writeInstruction(const FunctionProto &proto, uint32_t index,
+                        uint32_t fieldBase);
+  std::string constant(const FunctionProto &proto, uint32_t index);
+
+  std::string symbol(Symbol name);
+  std::string functionName(size_t index) const;
+
+  static std::string reg(uint32_t index) {
+    return "r[" + std::to_string(index) + "]";
+  }
+  static std::string quote(const std::string &text);
+
+  const CompiledProgram &program;
+  std::ostringstream body;
+
+  std::vector<Symbol> symbols;
+  std::unordered_map<Symbol, size_t> symbolIndices;
+  std::vector<std::string> strings;
+  size_t fieldCaches = 0;
+};
+
+void SourceWriter::write(const std::string &source, const std::string &path,
+                         std::ostream &out) {
+  for (size_t i = 0; i < program.functions.size(); i++) {
+    writeFunction(i);
+  }
+
+  out << "// Generated by rustedc --aot from " << source
+      << ", do not edit. Build with:\n"
+      << "//   " << AotCompiler::buildCommand(path) << "\n\n"
+      << "#include \"runtime/aot/AotRuntime.h\"\n\n"
+      << "namespace {\n\n";
+
+  if (!symbols.empty()) {
+    out << "Symbol S[" << symbols.size() << "];\n";
+  }
+  if (!strings.empty()) {
+    out << "Value STRINGS[" << strings.size() << "];\n";
+  }
+  if (fieldCaches > 0) {
+    out << "FieldCache FIELDS[" << fieldCaches << "];\n";
+  }
+  out << "AotFunction FUNCTIONS[" << program.functions.size() << "];\n\n";
+
+  for (size_t i = 0; i < program.functions.size(); i++) {
+    out << "Value " << functionName(i) << "(Value *r);\n";
+  }
+
+  out << "\nvoid initialize() {\n";
+  for (size_t i = 0; i < symbols.size(); i++) {
+    out << "  S[" << i << "] = SymbolTable::intern("
+        << quote(SymbolTable::name(symbols[i])) << ");\n";
+  }
+  for (size_t i = 0; i < strings.size(); i++) {
+    out << "  STRINGS[" << i << "] = AotRuntime::string(" << quote(strings[i])
+        << ", " << strings[i].size() << ");\n";
+  }
+  for (size_t i = 0; i < program.functions.size(); i++) {
+    const FunctionProto &proto = *program.functions[i];
+    out << "  FUNCTIONS[" << i << "].define(" << functionName(i) << ", "
+        << (i == 0 ? "0" : symbol(proto.name)) << ", " << proto.registerCount
+        << ", {";
+    for (uint32_t p = 0; p < proto.parameterCount; p++) {
+      out << (p > 0 ? ", " : "") << symbol(proto.parameters[p]);
+    }
+    out << "}, {";
+    for (size_t l = 0; l < proto.locals.size(); l++) {
+      out << (l > 0 ? ", " : "") << "{" << symbol(proto.locals[l].first)
+          << ", " << proto.locals[l].second << "}";
+    }
+    out << "});\n";
+  }
+  out << "}\n\n" << body.str() << "} // namespace\n\n"
+      << "int main() {\n"
+      << "  initialize();\n"
+      << "  return AotRuntime::run(FUNCTIONS[0]);\n"
+      << "}\n";
+}
+
+void SourceWriter::writeFunction(size_t index) {
+  const FunctionProto &proto = *program.functions[index];
+
+  // Every symbol initialize() needs gets its place in the table now, before
+  // the table is printed.
+  if (index > 0) {
+    symbol(proto.name);
+  }
+  for (Symbol parameter : proto.parameters) {
+    symbol(parameter);
+  }
+  for (const auto &local : proto.locals) {
+    symbol(local.first);
+  }
+
+  std::set<uint32_t> labels;
+  for (const Instruction &ins : proto.code) {
+    if (ins.op == Opcode::Jump || ins.op == Opcode::JumpIfFalse ||
+        ins.op == Opcode::JumpUnlessOne) {
+      labels.insert(ins.b);
+    }
+  }
+
+  uint32_t fieldBase = static_cast<uint32_t>(fieldCaches);
+  fieldCaches += proto.fieldSites.size();
+
+  body << "Value " << functionName(index) << "(Value *r) {\n";
+  for (uint32_t i = 0; i < proto.code.size(); i++) {
+    if (labels.count(i) > 0) {
+      body << "L" << i << ":\n";
+    }
+    writeInstruction(proto, i, fieldBase);
+  }
+  body << "}\n\n";
+}
+
+void SourceWriter::writeInstruction(const FunctionProto &proto,
+                                    uint32_t index, uint32_t fieldBase) {
+  const Instruction &ins = proto.code[index];
+  std::string a = reg(ins.a);
+  std::string b = reg(ins.b);
+  std::string c = reg(ins.c);
+  std::string line;
+
+  // Superinstructions are written as the instructions they stand in for, the
+  // C++ compiler does the rest.
+  switch (unfused(ins.op)) {
+  case Opcode::LoadConst:
+    line = a + " = " + constant(proto, ins.b) + ";";
+    break;
+  case Opcode::Move:
+    line = a + " = " + b + ";";
+    break;
+  case Opcode::GetLocal:
+    line = a + " = " + b + ".isEmpty() ? AotRuntime::lookupName(" +
+           symbol(ins.c) + ") : " + b + ";";
+    break;
+  case Opcode::SetLocal:
+    line = "if (!" + a + ".isEmpty()) { " + a + " = " + b +
+           "; } else { AotRuntime::assignName(" + symbol(ins.c) + ", " + b +
+           "); }";
+    break;
+  case Opcode::SetConstLocal:
+    line = "if (!" + a + ".isEmpty()) { AotRuntime::reassignConstant(" +
+           symbol(ins.c) + "); } AotRuntime::assignName(" + symbol(ins.c) +
+           ", " + b + ");";
+    break;
+  case Opcode::DeclareLocal:
+    line = "if (!" + a + ".isEmpty()) { AotRuntime::redeclare(" +
+           symbol(ins.c) + "); } " + a + " = " + b + ";";
+    break;
+  case Opcode::GetGlobal:
+    line = a + " = AotRuntime::lookupGlobal(" + symbol(ins.b) + ");";
+    break;
+  case Opcode::SetGlobal:
+    line = "AotRuntime::assignName(" + symbol(ins.b) + ", " + a + ");";
+    break;
+  case Opcode::DeclareGlobal:
+    line = "AotRuntime::declareGlobal(" + symbol(ins.b) + ", " + a + ", " +
+           (ins.c != 0 ? "true" : "false") + ");";
+    break;
+
+#define RUSTEDC_AOT_BINARY(name, function)                                     \
+  case Opcode::name:                                                           \
+    line = a + " = AotRuntime::" function "(" + b + ", " + c + ");";          \
+    break;
+    RUSTEDC_AOT_BINARY(Add, "add")
+    RUSTEDC_AOT_BINARY(Subtract, "subtract")
+    RUSTEDC_AOT_BINARY(Multiply, "multiply")
+    RUSTEDC_AOT_BINARY(Divide, "divide")
+    RUSTEDC_AOT_BINARY(Modulo, "modulo")
+    RUSTEDC_AOT_BINARY(Less, "less")
+    RUSTEDC_AOT_BINARY(LessEqual, "lessEqual")
+    RUSTEDC_AOT_BINARY(Greater, "greater")
+    RUSTEDC_AOT_BINARY(GreaterEqual, "greaterEqual")
+    RUSTEDC_AOT_BINARY(Equal, "equal")
+    RUSTEDC_AOT_BINARY(NotEqual, "notEqual")
+    RUSTEDC_AOT_BINARY(And, "logicalAnd")
+    RUSTEDC_AOT_BINARY(Or, "logicalOr")
+#undef RUSTEDC_AOT_BINARY
+
+  case Opcode::Not:
+    line = a + " = AotRuntime::logicalNot(" + b + ");";
+    break;
+  case Opcode::Negate:
+    line = a + " = AotRuntime::negate(" + b + ");";
+    break;
+  case Opcode::Jump:
+    // Loops give the garbage collector its chance, like the back edges of
+    // the VM do.
+    if (ins.b <= index) {
+      line = "AotRuntime::safepoint(r + " +
+             std::to_string(proto.registerCount) + "); ";
+    }
+    line += "goto L" + std::to_string(ins.b) + ";";
+    break;
+  case Opcode::JumpIfFalse:
+    line = "if (AotRuntime::isZero(" + a + ")) { goto L" +
+           std::to_string(ins.b) + "; }";
+    break;
+  case Opcode::JumpUnlessOne:
+    line = "if (!AotRuntime::isOne(" + a + ")) { goto L" +
+           std::to_string(ins.b) + "; }";
+    break;
+  case Opcode::GetField:
+    line = a + " = AotRuntime::getField(" + b + ", " +
+           symbol(proto.fieldSites[ins.c].name) + ", FIELDS[" +
+           std::to_string(fieldBase + ins.c) + "]);";
+    break;
+  case Opcode::SetField:
+    line = "AotRuntime::setField(" + a + ", " +
+           symbol(proto.fieldSites[ins.c].name) + ", " + b + ", FIELDS[" +
+           std::to_string(fieldBase + ins.c) + "]);";
+    break;
+  case Opcode::NewStruct:
+    line = a + " = AotRuntime::newStruct(" + symbol(ins.b) + ");";
+    break;
+  case Opcode::AddField:
+    line = a + ".as<StructVal>()->addField(" + symbol(ins.c) + ", " + b + ");";
+    break;
+  case Opcode::MakeFunction:
+    line = a + " = AotRuntime::makeFunction(FUNCTIONS[" +
+           std::to_string(ins.b) + "]);";
+    break;
+  case Opcode::Call:
+    line = a + " = AotRuntime::call(r, " +
+           std::to_string(proto.registerCount) + ", " +
+           std::to_string(ins.b) + ", " + std::to_string(ins.c) + ");";
+    break;
+  case Opcode::TailCall:
+    // The caller runs the callee once this function has returned.
+    line = "if (AotRuntime::tailCall(r, " + std::to_string(ins.b) + ", " +
+           std::to_string(ins.c) + ")) return Value();\n  " + a +
+           " = AotRuntime::call(r, " + std::to_string(proto.registerCount) +
+           ", " + std::to_string(ins.b) + ", " + std::to_string(ins.c) +
+           ");";
+    break;
+  case Opcode::Return:
+    line = "return " + a + ";";
+    break;
+  case Opcode::Throw:
+    line = "AotRuntime::fail(" + constant(proto, ins.b) + ");";
+    break;
+  default:
+    // Superinstructions, already replaced by unfused.
+    break;
+  }
+
+  body << "  " << line << "\n";
+}
+
+std::string SourceWriter::constant(const FunctionProto &proto,
+                                   uint32_t index) {
+  Value value = proto.constants[index];
+
+  if (value.isNumber()) {
+    double number = value.asNumber();
+    if (std::isfinite(number)) {
+      // Hexadecimal floating point literals are exact.
+      char literal[64];
+      std::snprintf(literal, sizeof(literal), "%a", number);
+      return std::string("Value(") + literal + ")";
+    }
+    char bits[32];
+    std::snprintf(bits, sizeof(bits), "0x%llxULL",
+                  static_cast<unsigned long long>(value.raw()));
+    return std::string("AotRuntime::number(") + bits + ")";
+  }
+
+  switch (value.type()) {
+  case ValueType::StringValue:
+    strings.push_back(value.as<StringVal>()->value);
+    return "STRINGS[" + std::to_string(strings.size() - 1) + "]";
+  case ValueType::BooleanValue:
+    return value.asBoolean() ? "Value::boolean(true)" : "Value::boolean(false)";
+  default:
+    return "Value::null()";
+  }
+}
+
+std::string SourceWriter::symbol(Symbol name) {
+  auto found = symbolIndices.find(name);
+  if (found == symbolIndices.end()) {
+    found = symbolIndices.emplace(name, symbols.size()).first;
+    symbols.push_back(name);
+  }
+  return "S[" + std::to_string(found->second) + "]";
+}
+
+std::string SourceWriter::functionName(size_t index) const {
+  if (index == 0) {
+    return "program";
+  }
+  return "f" + std::to_string(index) + "_" +
+         SymbolTable::name(program.functions[index]->name);
+}
+
+std::string SourceWriter::quote(const std::string &text) {
+  std::string quoted = "\"";
+  for (unsigned char ch : text) {
+    if (ch == '"' || ch == '\\') {
+      quoted += '\\';
+      quoted += static_cast<char>(ch);
+    } else if (ch >= 0x20 && ch < 0x7f) {
+      quoted += static_cast<char>(ch);
+    } else {
+      // Always three octal digits, so a digit that follows is not taken in.
+      char escape[8];
+      std::snprintf(escape, sizeof(escape), "\\%03o", ch);
+      quoted += escape;
+    }
+  }
+  return quoted + "\"";
+}
+
+} // namespace
+
+void AotCompiler::transpile(const CompiledProgram &program,
+                            const std::string &source, const std::string &path,
+                            std::ostream &out) {
+  SourceWriter(program).write(source, path, out);
+}
+
+std::string AotCompiler::buildCommand(const std::string &path) {
+  std::string executable = path;
+  size_t extension = executable.rfind(".cpp");
+  if (extension != std::string::npos &&
+      extension + 4 == executable.size()) {
+    executable.erase(extension);
+  }
+  return "g++ -std=c++17 -O2 -I. " + path + " bin/librustedc.a -o " +
+         executable;
+}
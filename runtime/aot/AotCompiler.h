@@ -0,0 +1,27 @@
+#ifndef AOT_COMPILER_H
+#define AOT_COMPILER_H
+
+#include "../vm/Bytecode.h"
+
+#include <ostream>
+#include <string>
+
+// Ahead of time compilation to C++, run with --aot out.cpp script.rc. The
+// bytecode of every function of a program becomes a C++ function whose
+// statements do what the VM does for each instruction, with its jumps as
+// gotos. Built against bin/librustedc.a, the source is a standalone
+// executable that runs the script without parsing or interpreting it (see
+// AotRuntime.h).
+class AotCompiler {
+public:
+  // Writes the C++ source of program, compiled from the script at source, to
+  // out, which will be the file at path.
+  static void transpile(const CompiledProgram &program,
+                        const std::string &source, const std::string &path,
+                        std::ostream &out);
+
+  // Command that builds the C++ at path into an executable.
+  static std::string buildCommand(const std::string &path);
+};
+
+#endif
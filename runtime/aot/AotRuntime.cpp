@@ -0,0 +1,254 @@
+#include "AotRuntime.h"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+static const double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+Environment *AotRuntime::env = nullptr;
+Value *AotRuntime::registerFile = nullptr;
+RootSpan AotRuntime::liveRegisters = {nullptr, nullptr};
+std::vector<AotRuntime::Frame> AotRuntime::frames;
+bool AotRuntime::tailCallPending = false;
+
+void AotFunction::define(Code code, Symbol functionName, uint32_t registers,
+                         std::vector<Symbol> parameterList,
+                         std::vector<std::pair<Symbol, uint32_t>> localList) {
+  run = code;
+  name = functionName;
+  registerCount = registers;
+  parameterNames = std::move(parameterList);
+  parameterCount = parameterNames.size();
+  parameters = ArenaArray<Symbol>(parameterNames.data(), parameterCount);
+
+  // Symbols are interned again by every executable, so the order the
+  // compiler sorted the locals in does not hold any more.
+  locals = std::move(localList);
+  std::sort(locals.begin(), locals.end());
+  for (const auto &local : locals) {
+    markFunctionLocal(local.first);
+  }
+}
+
+int AotRuntime::run(const AotFunction &program) {
+  // Not constructed, as in the VM: each function clears the registers it
+  // takes.
+  std::unique_ptr<Value, RawDelete> registers(static_cast<Value *>(
+      ::operator new(REGISTER_FILE_SIZE * sizeof(Value))));
+  Environment globals;
+
+  env = &globals;
+  registerFile = registers.get();
+  std::fill(registerFile, registerFile + program.registerCount, Value());
+  liveRegisters = {registerFile, registerFile};
+  Heap::addRootSpan(&liveRegisters);
+  frames.reserve(64);
+  frames.push_back({&program, registerFile});
+
+  try {
+    program.run(registerFile);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+Value AotRuntime::string(const char *value, size_t length) {
+  return Value(new (Generation::Permanent)
+                   StringVal(std::string(value, length)));
+}
+
+void AotRuntime::collect(Value *top) {
+  liveRegisters.end = top;
+  Heap::collect();
+}
+
+Value *AotRuntime::findInFrames(Symbol name) {
+  if (!isFunctionLocal(name)) {
+    return nullptr;
+  }
+
+  // The frame of the function asking is the last one and is skipped.
+  for (size_t i = frames.size() - 1; i-- > 0;) {
+    int64_t reg = frames[i].function->findLocal(name);
+    if (reg >= 0 && !frames[i].registers[reg].isEmpty()) {
+      return &frames[i].registers[reg];
+    }
+  }
+
+  return nullptr;
+}
+
+Value AotRuntime::lookupName(Symbol name) {
+  Value *slot = findInFrames(name);
+  if (slot != nullptr) {
+    return *slot;
+  }
+  return env->lookupVar(name);
+}
+
+void AotRuntime::assignName(Symbol name, Value value) {
+  Value *slot = findInFrames(name);
+  if (slot != nullptr) {
+    *slot = value;
+    return;
+  }
+  if (frames.size() > 1) {
+    env->assignOuterVar(name, value);
+  } else {
+    env->assignVar(name, value);
+  }
+}
+
+Value AotRuntime::lookupGlobal(Symbol name) {
+  return frames.size() > 1 ? lookupName(name) : env->lookupVar(name);
+}
+
+void AotRuntime::declareGlobal(Symbol name, Value value, bool constant) {
+  env->declareVar(name, value, constant);
+}
+
+void AotRuntime::reassignConstant(Symbol name) {
+  throw InterpreterError("Cannot reassign to variable " +
+                         SymbolTable::name(name) +
+                         " as it was declared constant.");
+}
+
+void AotRuntime::redeclare(Symbol name) {
+  throw InterpreterError("Cannot declare variable " + SymbolTable::name(name) +
+                         ". It is already defined.");
+}
+
+void AotRuntime::fail(Value message) {
+  throw InterpreterError(message.as<StringVal>()->value);
+}
+
+Value AotRuntime::makeFunction(const AotFunction &function) {
+  return Value(new FnVal(function.name, function.parameters, env,
+                         function.body, &function));
+}
+
+Value AotRuntime::newStruct(Symbol name) {
+  return Value(new StructVal(SymbolTable::name(name), true));
+}
+
+Value AotRuntime::getField(Value object, Symbol name, FieldCache &cache) {
+  if (object.type() != ValueType::StructValue) {
+    throw InterpreterError(
+        "Error: Member access is only supported for structs.");
+  }
+  return object.as<StructVal>()->getField(name, cache);
+}
+
+void AotRuntime::setField(Value object, Symbol name, Value value,
+                          FieldCache &cache) {
+  if (object.type() != ValueType::StructValue) {
+    throw InterpreterError(
+        "Error: Member access is only supported for structs.");
+  }
+  object.as<StructVal>()->setField(name, value, cache);
+}
+
+Value AotRuntime::modulo(Value lhs, Value rhs) {
+  if (!numbers(lhs, rhs)) {
+    return Value::null();
+  }
+  if (rhs.asNumber() == 0) {
+    throw InterpreterError("Modulo by zero error");
+  }
+  double left = lhs.asNumber();
+  double right = rhs.asNumber();
+  // Same integer fast path as the VM.
+  if (left >= 0 && left < MAX_EXACT_INTEGER &&
+      std::fabs(right) < MAX_EXACT_INTEGER && left == std::trunc(left) &&
+      right == std::trunc(right)) {
+    return Value(static_cast<double>(static_cast<int64_t>(left) %
+                                     static_cast<int64_t>(right)));
+  }
+  return Value(fmod(left, right));
+}
+
+Value AotRuntime::call(Value *registers, uint32_t frameSize, uint32_t callee,
+                       uint32_t count) {
+  Value value = registers[callee];
+  Value *args = registers + callee + 1;
+
+  switch (value.type()) {
+  case ValueType::Function:
+    return callFunction(value.as<FnVal>(), registers + frameSize, args, count);
+  case ValueType::NativeFunction:
+    return value.as<NativeFnVal>()->call(
+        std::vector<Value>(args, args + count), env);
+  case ValueType::StructValue:
+    return Value(value.as<StructVal>()->instantiate(
+        std::vector<Value>(args, args + count)));
+  default:
+    throw InterpreterError("Cannot call value that is not a function");
+  }
+}
+
+Value AotRuntime::callFunction(FnVal *fn, Value *registers, Value *args,
+                               uint32_t count) {
+  const AotFunction *function = static_cast<const AotFunction *>(fn->proto);
+  if (function == nullptr) {
+    throw InterpreterError("Function " + SymbolTable::name(fn->name) +
+                           " was not compiled ahead of time");
+  }
+  if (registers + function->registerCount >
+      registerFile + REGISTER_FILE_SIZE) {
+    throw InterpreterError("Stack overflow in function " +
+                           SymbolTable::name(fn->name));
+  }
+
+  // An empty value marks a local that is not declared yet.
+  std::fill(registers, registers + function->registerCount, Value());
+
+  uint32_t passed = std::min(count, function->parameterCount);
+  std::copy(args, args + passed, registers);
+
+  frames.push_back({function, registers});
+
+  // Parameters that got no argument are found in a caller, as in the VM.
+  for (uint32_t i = passed; i < function->parameterCount; i++) {
+    registers[i] = lookupName(function->parameters[i]);
+  }
+
+  safepoint(registers + function->registerCount);
+  Value result = function->run(registers);
+  while (tailCallPending) {
+    tailCallPending = false;
+    function = frames.back().function;
+    safepoint(registers + function->registerCount);
+    result = function->run(registers);
+  }
+  frames.pop_back();
+  return result;
+}
+
+bool AotRuntime::tailCall(Value *registers, uint32_t callee, uint32_t count) {
+  Value value = registers[callee];
+  if (value.type() != ValueType::Function) {
+    return false;
+  }
+  const AotFunction *function =
+      static_cast<const AotFunction *>(value.as<FnVal>()->proto);
+  if (function == nullptr || count < function->parameterCount) {
+    return false;
+  }
+  if (registers + function->registerCount >
+      registerFile + REGISTER_FILE_SIZE) {
+    throw InterpreterError("Stack overflow in function " +
+                           SymbolTable::name(function->name));
+  }
+
+  Value *args = registers + callee + 1;
+  std::copy(args, args + function->parameterCount, registers);
+  std::fill(registers + function->parameterCount,
+            registers + function->registerCount, Value());
+
+  frames.back().function = function;
+  tailCallPending = true;
+  return true;
+}
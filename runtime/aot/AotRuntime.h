@@ -0,0 +1,205 @@
+#ifndef AOT_RUNTIME_H
+#define AOT_RUNTIME_H
+
+#include "../environment/Environment.h"
+#include "../gc/Heap.h"
+#include "../values/Values.h"
+#include "../vm/Bytecode.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Runtime of the C++ that rustedc --aot writes (see AotCompiler.h), linked
+// into the executable from bin/librustedc.a.
+//
+// A transpiled program is its bytecode turned into one C++ function per
+// FunctionProto, with every instruction replaced by the statement that does
+// what the VM does for it. The functions work on windows of one register
+// file like the frames of the VM, and look names up in the frames of their
+// callers in the same order, so a program prints and fails exactly as it
+// does when it is interpreted. Values, structs and builtins are the ones of
+// the interpreter.
+
+// A FunctionProto whose code is a C++ function instead of bytecode. The FnVals
+// of a transpiled program point to these.
+struct AotFunction : FunctionProto {
+  typedef Value (*Code)(Value *registers);
+
+  Code run = nullptr;
+  std::vector<Symbol> parameterNames;
+
+  void define(Code code, Symbol functionName, uint32_t registers,
+              std::vector<Symbol> parameterList,
+              std::vector<std::pair<Symbol, uint32_t>> localList);
+};
+
+class AotRuntime {
+public:
+  // Runs the top level of a program, program.run, and prints the error that
+  // ended it, if any. Returns the exit status of the executable.
+  static int run(const AotFunction &program);
+
+  static Value number(uint64_t bits) {
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return Value(value);
+  }
+  static Value string(const char *value, size_t length);
+
+  // Names a function reads or assigns without declaring them, found in the
+  // frames of its callers first and in the global environment last.
+  static Value lookupName(Symbol name);
+  static void assignName(Symbol name, Value value);
+  static Value lookupGlobal(Symbol name);
+  static void declareGlobal(Symbol name, Value value, bool constant);
+
+  [[noreturn]] static void reassignConstant(Symbol name);
+  [[noreturn]] static void redeclare(Symbol name);
+  [[noreturn]] static void fail(Value message);
+
+  static Value makeFunction(const AotFunction &function);
+  static Value newStruct(Symbol name);
+  static Value getField(Value object, Symbol name, FieldCache &cache);
+  static void setField(Value object, Symbol name, Value value,
+                       FieldCache &cache);
+
+  // Calls the value in registers[callee] with the count registers after it as
+  // arguments. The frame of a called function starts at registers + frameSize.
+  static Value call(Value *registers, uint32_t frameSize, uint32_t callee,
+                    uint32_t count);
+
+  // Tail call of the value in registers[callee]. A transpiled function that
+  // gets all of its arguments takes over the frame of the caller, which
+  // then returns at once and leaves running it to the one that called it.
+  // Returns false for any other callee, which is called as usual.
+  static bool tailCall(Value *registers, uint32_t callee, uint32_t count);
+
+  // Collects if an allocation asked for it. Every register below top must
+  // hold the values still in use.
+  static void safepoint(Value *top) {
+    if (Heap::collectionPending()) {
+      collect(top);
+    }
+  }
+
+  static Value add(Value lhs, Value rhs) {
+    return numbers(lhs, rhs) ? Value(lhs.asNumber() + rhs.asNumber())
+                             : Value::null();
+  }
+  static Value subtract(Value lhs, Value rhs) {
+    return numbers(lhs, rhs) ? Value(lhs.asNumber() - rhs.asNumber())
+                             : Value::null();
+  }
+  static Value multiply(Value lhs, Value rhs) {
+    return numbers(lhs, rhs) ? Value(lhs.asNumber() * rhs.asNumber())
+                             : Value::null();
+  }
+  static Value divide(Value lhs, Value rhs) {
+    if (!numbers(lhs, rhs)) {
+      return Value::null();
+    }
+    if (rhs.asNumber() == 0) {
+      throw InterpreterError("Division by zero error");
+    }
+    return Value(lhs.asNumber() / rhs.asNumber());
+  }
+  static Value modulo(Value lhs, Value rhs);
+
+  // Comparisons produce the numbers 0 and 1, like the evaluator.
+  static Value less(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() < rhs.asNumber());
+  }
+  static Value lessEqual(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() <= rhs.asNumber());
+  }
+  static Value greater(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() > rhs.asNumber());
+  }
+  static Value greaterEqual(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() >= rhs.asNumber());
+  }
+  static Value equal(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() == rhs.asNumber());
+  }
+  static Value notEqual(Value lhs, Value rhs) {
+    return compare(lhs, rhs, lhs.asNumber() != rhs.asNumber());
+  }
+
+  static Value logicalAnd(Value lhs, Value rhs) {
+    logicalOperands(lhs, rhs);
+    return Value(lhs.asNumber() && rhs.asNumber() ? 1.0 : 0.0);
+  }
+  static Value logicalOr(Value lhs, Value rhs) {
+    logicalOperands(lhs, rhs);
+    return Value(lhs.asNumber() || rhs.asNumber() ? 1.0 : 0.0);
+  }
+  static Value logicalNot(Value operand) {
+    if (!operand.isNumber()) {
+      throw InterpreterError("Unsupported unary operator: !");
+    }
+    return Value(operand.asNumber() == 0 ? 1.0 : 0.0);
+  }
+  static Value negate(Value operand) {
+    if (!operand.isNumber()) {
+      throw InterpreterError("Unsupported unary operator: -");
+    }
+    return Value(-operand.asNumber());
+  }
+
+  // Conditions of JumpIfFalse and JumpUnlessOne.
+  static bool isZero(Value condition) {
+    if (!condition.isNumber()) {
+      throw InterpreterError(
+          "If statement condition must evaluate to a numeric value.");
+    }
+    return condition.asNumber() == 0;
+  }
+  static bool isOne(Value condition) {
+    if (!condition.isNumber()) {
+      throw InterpreterError(
+          "While loop condition must evaluate to a numeric value.");
+    }
+    return condition.asNumber() == 1;
+  }
+
+private:
+  struct Frame {
+    const AotFunction *function;
+    Value *registers;
+  };
+
+  static const size_t REGISTER_FILE_SIZE = 1 << 20;
+
+  struct RawDelete {
+    void operator()(Value *values) const { ::operator delete(values); }
+  };
+
+  static bool numbers(Value lhs, Value rhs) {
+    return lhs.isNumber() && rhs.isNumber();
+  }
+  static Value compare(Value lhs, Value rhs, bool result) {
+    return numbers(lhs, rhs) ? Value(result ? 1.0 : 0.0) : Value::null();
+  }
+  static void logicalOperands(Value lhs, Value rhs) {
+    if (!numbers(lhs, rhs)) {
+      throw InterpreterError("Invalid operands for logical expression");
+    }
+  }
+
+  static void collect(Value *top);
+  static Value *findInFrames(Symbol name);
+  static Value callFunction(FnVal *fn, Value *registers, Value *args,
+                            uint32_t count);
+
+  static Environment *env;
+  static Value *registerFile;
+  static RootSpan liveRegisters;
+  static std::vector<Frame> frames;
+  static bool tailCallPending;
+};
+
+#endif
@@ -0,0 +1,671 @@
+#include "ClosureCompiler.h"
+#include "../gc/Heap.h"
+#include "../interpreter/Interpreter.h"
+
+#include <cmath>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Value of a call used as an operand or stored in a variable or field, which
+// the evaluator unwraps.
+inline Value unwrap(Value value) {
+  if (value.type() == ValueType::ReturnValue) {
+    return value.as<ReturnValue>()->value;
+  }
+  return value;
+}
+
+// Whether evaluating the expression can reach a safepoint, which only the
+// statements of a called function do. An operand held across one has to be
+// rooted, it may be moved by the collector.
+bool maySafepoint(Stmt *node) {
+  if (node == nullptr) {
+    return false;
+  }
+
+  switch (node->kind) {
+  case NodeType::NumericLiteral:
+  case NodeType::StrLiteral:
+  case NodeType::Null:
+  case NodeType::Identifier:
+    return false;
+  case NodeType::BinaryExpr: {
+    auto binop = static_cast<BinaryExpr *>(node);
+    return maySafepoint(binop->left) || maySafepoint(binop->right);
+  }
+  case NodeType::LogicalExpr: {
+    auto logical = static_cast<LogicalExpr *>(node);
+    return maySafepoint(logical->left) || maySafepoint(logical->right);
+  }
+  case NodeType::UnaryExpr:
+    return maySafepoint(static_cast<UnaryExpr *>(node)->right);
+  case NodeType::MemberAccessExpr:
+    return maySafepoint(static_cast<MemberAccessExpr *>(node)->object);
+  case NodeType::AssignmentExpr: {
+    auto assignment = static_cast<AssignmentExpr *>(node);
+    return maySafepoint(assignment->assigne) ||
+           maySafepoint(assignment->value);
+  }
+  default:
+    return true;
+  }
+}
+
+Closure throwing(const std::string &message) {
+  return [message](Environment *) -> Value {
+    throw InterpreterError(message);
+  };
+}
+
+struct AddOp {
+  static Value apply(double left, double right) { return Value(left + right); }
+};
+struct SubtractOp {
+  static Value apply(double left, double right) { return Value(left - right); }
+};
+struct MultiplyOp {
+  static Value apply(double left, double right) { return Value(left * right); }
+};
+struct DivideOp {
+  static Value apply(double left, double right) {
+    if (right == 0) {
+      throw InterpreterError("Division by zero error");
+    }
+    return Value(left / right);
+  }
+};
+struct ModuloOp {
+  static Value apply(double left, double right) {
+    if (right == 0) {
+      throw InterpreterError("Modulo by zero error");
+    }
+    return Value(fmod(left, right));
+  }
+};
+struct LessOp {
+  static Value apply(double left, double right) {
+    return Value(left < right ? 1.0 : 0.0);
+  }
+};
+struct LessEqualOp {
+  static Value apply(double left, double right) {
+    return Value(left <= right ? 1.0 : 0.0);
+  }
+};
+struct GreaterOp {
+  static Value apply(double left, double right) {
+    return Value(left > right ? 1.0 : 0.0);
+  }
+};
+struct GreaterEqualOp {
+  static Value apply(double left, double right) {
+    return Value(left >= right ? 1.0 : 0.0);
+  }
+};
+struct EqualOp {
+  static Value apply(double left, double right) {
+    return Value(left == right ? 1.0 : 0.0);
+  }
+};
+struct NotEqualOp {
+  static Value apply(double left, double right) {
+    return Value(left != right ? 1.0 : 0.0);
+  }
+};
+struct AndOp {
+  static Value apply(double left, double right) {
+    return Value(left && right ? 1.0 : 0.0);
+  }
+};
+struct OrOp {
+  static Value apply(double left, double right) {
+    return Value(left || right ? 1.0 : 0.0);
+  }
+};
+
+// Operands that are not numbers give null, see Interpreter::eval_binary_expr.
+template <typename Op, bool RootLeft>
+Closure binary(Closure left, Closure right) {
+  return [left = std::move(left), right = std::move(right)](Environment *env) {
+    Value lhs = left(env);
+    Value rhs;
+    if constexpr (RootLeft) {
+      GcRoot lhsRoot(lhs);
+      rhs = right(env);
+    } else {
+      rhs = right(env);
+    }
+
+    lhs = unwrap(lhs);
+    rhs = unwrap(rhs);
+    if (!lhs.isNumber() || !rhs.isNumber()) {
+      return Value::null();
+    }
+    return Op::apply(lhs.asNumber(), rhs.asNumber());
+  };
+}
+
+// Operands that are not numbers are an error, see
+// Interpreter::eval_logical_expr.
+template <typename Op, bool RootLeft>
+Closure logical(Closure left, Closure right) {
+  return [left = std::move(left), right = std::move(right)](Environment *env) {
+    Value lhs = left(env);
+    Value rhs;
+    if constexpr (RootLeft) {
+      GcRoot lhsRoot(lhs);
+      rhs = right(env);
+    } else {
+      rhs = right(env);
+    }
+
+    lhs = unwrap(lhs);
+    rhs = unwrap(rhs);
+    if (!lhs.isNumber() || !rhs.isNumber()) {
+      throw InterpreterError("Invalid operands for logical expression");
+    }
+    return Op::apply(lhs.asNumber(), rhs.asNumber());
+  };
+}
+
+template <typename Op>
+Closure operands(Closure left, Closure right, bool rootLeft, bool isLogical) {
+  if (isLogical) {
+    return rootLeft ? logical<Op, true>(std::move(left), std::move(right))
+                    : logical<Op, false>(std::move(left), std::move(right));
+  }
+  return rootLeft ? binary<Op, true>(std::move(left), std::move(right))
+                  : binary<Op, false>(std::move(left), std::move(right));
+}
+
+class NodeCompiler {
+public:
+  explicit NodeCompiler(ClosureProgram &program) : program(program) {}
+
+  Closure compile(Stmt *node);
+  // A missing value, like the one of `let x;`, is null.
+  Closure compileValue(Expr *value);
+  std::vector<Closure> compileAll(const NodeList<Stmt> &body);
+
+private:
+  ClosureProgram &program;
+
+  Closure compileBlock(const NodeList<Stmt> &body);
+  Closure compileBinary(BinaryExpr *binop);
+  Closure compileLogical(LogicalExpr *logicalExpr);
+  Closure compileUnary(UnaryExpr *expr);
+  Closure compileAssignment(AssignmentExpr *assignment);
+  Closure compileCall(CallExpr *call);
+  Closure compileMemberAccess(MemberAccessExpr *member);
+  Closure compileIf(IfStatement *ifStmt);
+  Closure compileWhile(WhileLoop *loop);
+  Closure compileVarDeclaration(VarDeclaration *declaration);
+  Closure compileFunctionDeclaration(FunctionDeclaration *declaration);
+  Closure compileStructDeclaration(StructDeclaration *declaration);
+};
+
+std::vector<Closure> NodeCompiler::compileAll(const NodeList<Stmt> &body) {
+  std::vector<Closure> statements;
+  statements.reserve(body.size());
+  for (Stmt *stmt : body) {
+    switch (stmt->kind) {
+    case NodeType::ReturnStatement:
+    case NodeType::IfStatement:
+    case NodeType::WhileLoop:
+    case NodeType::FunctionDeclaration:
+    case NodeType::StructDeclaration:
+      statements.push_back(compile(stmt));
+      break;
+    default:
+      // Only those return from the block, the ReturnValue of a call used as
+      // a statement or stored by one is not a return (see
+      // Interpreter::returned).
+      statements.push_back(
+          [statement = compile(stmt)](Environment *env) {
+            return unwrap(statement(env));
+          });
+      break;
+    }
+  }
+  return statements;
+}
+
+Closure NodeCompiler::compileValue(Expr *value) {
+  if (value == nullptr) {
+    return [](Environment *) { return Value::null(); };
+  }
+  return compile(value);
+}
+
+Closure NodeCompiler::compile(Stmt *node) {
+  switch (node->kind) {
+  case NodeType::NumericLiteral: {
+    Value number(static_cast<NumericLiteral *>(node)->value);
+    return [number](Environment *) { return number; };
+  }
+  case NodeType::StrLiteral: {
+    auto literal = static_cast<StrLiteral *>(node);
+    return [literal](Environment *) { return Value(new StringVal(literal)); };
+  }
+  case NodeType::Null:
+    return [](Environment *) { return Value::null(); };
+  case NodeType::Identifier: {
+    auto ident = static_cast<IdentifierExpr *>(node);
+    if (ident->slot >= 0) {
+      uint32_t slot = static_cast<uint32_t>(ident->slot);
+      return [slot](Environment *env) { return env->lookupSlot(slot); };
+    }
+    Symbol name = ident->symbol;
+    return [name](Environment *env) { return env->lookupVar(name); };
+  }
+  case NodeType::BinaryExpr:
+    return compileBinary(static_cast<BinaryExpr *>(node));
+  case NodeType::LogicalExpr:
+    return compileLogical(static_cast<LogicalExpr *>(node));
+  case NodeType::UnaryExpr:
+    return compileUnary(static_cast<UnaryExpr *>(node));
+  case NodeType::AssignmentExpr:
+    return compileAssignment(static_cast<AssignmentExpr *>(node));
+  case NodeType::CallExpr:
+    return compileCall(static_cast<CallExpr *>(node));
+  case NodeType::MemberAccessExpr:
+    return compileMemberAccess(static_cast<MemberAccessExpr *>(node));
+  case NodeType::VarDeclaration:
+    return compileVarDeclaration(static_cast<VarDeclaration *>(node));
+  case NodeType::FunctionDeclaration:
+    return compileFunctionDeclaration(static_cast<FunctionDeclaration *>(node));
+  case NodeType::StructDeclaration:
+    return compileStructDeclaration(static_cast<StructDeclaration *>(node));
+  case NodeType::IfStatement:
+    return compileIf(static_cast<IfStatement *>(node));
+  case NodeType::WhileLoop:
+    return compileWhile(static_cast<WhileLoop *>(node));
+  case NodeType::ReturnStatement: {
+    auto returnStmt = static_cast<ReturnStatement *>(node);
+    if (returnStmt->returnValue == nullptr) {
+      return [](Environment *) { return Value::null(); };
+    }
+    // A tail call makes the return value itself.
+    if (returnStmt->returnValue->kind == NodeType::CallExpr &&
+        static_cast<CallExpr *>(returnStmt->returnValue)->tailCall) {
+      return compile(returnStmt->returnValue);
+    }
+    Closure value = compile(returnStmt->returnValue);
+    return [value = std::move(value)](Environment *env) {
+      Value result = value(env);
+      return Value(new ReturnValue(result));
+    };
+  }
+  default:
+    return throwing("This AST Node has not yet been set up for interpretation.");
+  }
+}
+
+// See Interpreter::eval_stmt_vector.
+Closure NodeCompiler::compileBlock(const NodeList<Stmt> &body) {
+  return [statements = compileAll(body)](Environment *env) {
+    Value result;
+    for (const Closure &statement : statements) {
+      Heap::safepoint();
+      result = statement(env);
+      if (result.type() == ValueType::ReturnValue) {
+        return result;
+      }
+    }
+    return result;
+  };
+}
+
+Closure NodeCompiler::compileBinary(BinaryExpr *binop) {
+  Closure left = compile(binop->left);
+  Closure right = compile(binop->right);
+  bool rootLeft = maySafepoint(binop->right);
+
+  switch (binop->binaryOperator) {
+  case Operator::Add:
+    return operands<AddOp>(std::move(left), std::move(right), rootLeft, false);
+  case Operator::Subtract:
+    return operands<SubtractOp>(std::move(left), std::move(right), rootLeft,
+                                false);
+  case Operator::Multiply:
+    return operands<MultiplyOp>(std::move(left), std::move(right), rootLeft,
+                                false);
+  case Operator::Divide:
+    return operands<DivideOp>(std::move(left), std::move(right), rootLeft,
+                              false);
+  case Operator::Modulo:
+    return operands<ModuloOp>(std::move(left), std::move(right), rootLeft,
+                              false);
+  case Operator::Less:
+    return operands<LessOp>(std::move(left), std::move(right), rootLeft, false);
+  case Operator::LessEqual:
+    return operands<LessEqualOp>(std::move(left), std::move(right), rootLeft,
+                                 false);
+  case Operator::Greater:
+    return operands<GreaterOp>(std::move(left), std::move(right), rootLeft,
+                               false);
+  case Operator::GreaterEqual:
+    return operands<GreaterEqualOp>(std::move(left), std::move(right),
+                                    rootLeft, false);
+  case Operator::Equal:
+    return operands<EqualOp>(std::move(left), std::move(right), rootLeft,
+                             false);
+  case Operator::NotEqual:
+    return operands<NotEqualOp>(std::move(left), std::move(right), rootLeft,
+                                false);
+  default: {
+    // The operands are still evaluated for their side effects.
+    return [left = std::move(left), right = std::move(right)](
+               Environment *env) {
+      Value lhs = left(env);
+      GcRoot lhsRoot(lhs);
+      right(env);
+      return Value::null();
+    };
+  }
+  }
+}
+
+Closure NodeCompiler::compileLogical(LogicalExpr *logicalExpr) {
+  Closure left = compile(logicalExpr->left);
+  Closure right = compile(logicalExpr->right);
+  bool rootLeft = maySafepoint(logicalExpr->right);
+
+  switch (logicalExpr->logicalOperator) {
+  case Operator::And:
+    return operands<AndOp>(std::move(left), std::move(right), rootLeft, true);
+  case Operator::Or:
+    return operands<OrOp>(std::move(left), std::move(right), rootLeft, true);
+  default: {
+    std::string message = std::string("Invalid logical operator: ") +
+                          OperatorToString(logicalExpr->logicalOperator);
+    return [left = std::move(left), right = std::move(right),
+            message](Environment *env) -> Value {
+      Value lhs = left(env);
+      GcRoot lhsRoot(lhs);
+      Value rhs = right(env);
+      if (!unwrap(lhs).isNumber() || !unwrap(rhs).isNumber()) {
+        throw InterpreterError("Invalid operands for logical expression");
+      }
+      throw InterpreterError(message);
+    };
+  }
+  }
+}
+
+Closure NodeCompiler::compileUnary(UnaryExpr *expr) {
+  Closure right = compile(expr->right);
+  std::string message = std::string("Unsupported unary operator: ") +
+                        OperatorToString(expr->op);
+
+  if (expr->op == Operator::Not) {
+    return [right = std::move(right), message](Environment *env) {
+      Value value = unwrap(right(env));
+      if (!value.isNumber()) {
+        throw InterpreterError(message);
+      }
+      return Value(value.asNumber() == 0 ? 1.0 : 0.0);
+    };
+  }
+  if (expr->op == Operator::Negate) {
+    return [right = std::move(right), message](Environment *env) {
+      Value value = unwrap(right(env));
+      if (!value.isNumber()) {
+        throw InterpreterError(message);
+      }
+      return Value(-value.asNumber());
+    };
+  }
+  return [right = std::move(right), message](Environment *env) -> Value {
+    right(env);
+    throw InterpreterError(message);
+  };
+}
+
+Closure NodeCompiler::compileAssignment(AssignmentExpr *assignment) {
+  if (assignment->assigne->kind == NodeType::MemberAccessExpr) {
+    auto member = static_cast<MemberAccessExpr *>(assignment->assigne);
+    Closure object = compile(member->object);
+    Closure value = compile(assignment->value);
+    Symbol name = member->memberName;
+    FieldCache *cache = &member->cache;
+
+    return [object = std::move(object), value = std::move(value), name,
+            cache](Environment *env) {
+      Value structValue = unwrap(object(env));
+      GcRoot objectRoot(structValue);
+      if (structValue.type() != ValueType::StructValue) {
+        throw InterpreterError(
+            "Error: Member access is only supported for structs.");
+      }
+
+      Value result = unwrap(value(env));
+      // Read after the value, evaluating it may have moved the struct.
+      structValue.as<StructVal>()->setField(name, result, *cache);
+      return result;
+    };
+  }
+
+  if (assignment->assigne->kind != NodeType::Identifier) {
+    return throwing("Invalid LHS inside assignment expr");
+  }
+
+  auto ident = static_cast<IdentifierExpr *>(assignment->assigne);
+  Closure value = compile(assignment->value);
+
+  if (ident->slot >= 0) {
+    uint32_t slot = static_cast<uint32_t>(ident->slot);
+    return [value = std::move(value), slot](Environment *env) {
+      return env->assignSlot(slot, unwrap(value(env)));
+    };
+  }
+  Symbol name = ident->symbol;
+  return [value = std::move(value), name](Environment *env) {
+    return env->assignVar(name, unwrap(value(env)));
+  };
+}
+
+Closure NodeCompiler::compileCall(CallExpr *call) {
+  Closure caller = compile(call->caller);
+  std::vector<Closure> args;
+  args.reserve(call->args.size());
+  for (Expr *arg : call->args) {
+    args.push_back(compile(arg));
+  }
+
+  // Only compiled as the value of its return, see Interpreter::tail_call.
+  if (call->tailCall) {
+    return [caller = std::move(caller), args = std::move(args)](
+               Environment *env) {
+      size_t argCount = args.size();
+      StackFrame frame(argCount);
+      Value *slots = frame.slots();
+      for (size_t i = 0; i < argCount; ++i) {
+        slots[i] = unwrap(args[i](env));
+      }
+      return Interpreter::tail_call(unwrap(caller(env)), frame, argCount, env);
+    };
+  }
+
+  return [caller = std::move(caller), args = std::move(args)](
+             Environment *env) {
+    // Arguments go straight into the frame stack, like in
+    // Interpreter::eval_call_expr.
+    size_t argCount = args.size();
+    StackFrame frame(argCount);
+    Value *slots = frame.slots();
+    for (size_t i = 0; i < argCount; ++i) {
+      slots[i] = unwrap(args[i](env));
+    }
+    return Interpreter::call_value(unwrap(caller(env)), frame, argCount, env);
+  };
+}
+
+Closure NodeCompiler::compileMemberAccess(MemberAccessExpr *member) {
+  Closure object = compile(member->object);
+  Symbol name = member->memberName;
+  FieldCache *cache = &member->cache;
+
+  return [object = std::move(object), name, cache](Environment *env) {
+    Value structValue = unwrap(object(env));
+    if (structValue.type() != ValueType::StructValue) {
+      throw InterpreterError(
+          "Error: Member access is only supported for structs.");
+    }
+    return structValue.as<StructVal>()->getField(name, *cache);
+  };
+}
+
+// See Interpreter::eval_if_statement.
+Closure NodeCompiler::compileIf(IfStatement *ifStmt) {
+  Closure condition = compile(ifStmt->condition);
+  Closure ifBody = compileBlock(ifStmt->ifBody);
+  Closure elseBody = ifStmt->elseBody.size() > 0
+                         ? compileBlock(ifStmt->elseBody)
+                         : compileValue(nullptr);
+
+  return [condition = std::move(condition), ifBody = std::move(ifBody),
+          elseBody = std::move(elseBody)](Environment *env) {
+    Value conditionValue = unwrap(condition(env));
+    if (!conditionValue.isNumber()) {
+      throw InterpreterError(
+          "If statement condition must evaluate to a numeric value.");
+    }
+    if (conditionValue.asNumber() != 0) {
+      return ifBody(env);
+    }
+    return elseBody(env);
+  };
+}
+
+// See Interpreter::eval_while_statement, the loop goes on only while the
+// condition is exactly 1.
+Closure NodeCompiler::compileWhile(WhileLoop *loop) {
+  Closure condition = compile(loop->condition);
+  Closure body = compileBlock(loop->loopBody);
+
+  return [condition = std::move(condition),
+          body = std::move(body)](Environment *env) {
+    Value result = Value::null();
+    GcRoot resultRoot(result);
+
+    while (true) {
+      Value conditionValue = unwrap(condition(env));
+      if (!conditionValue.isNumber()) {
+        throw InterpreterError(
+            "While loop condition must evaluate to a numeric value.");
+      }
+      if (conditionValue.asNumber() != 1) {
+        return result;
+      }
+
+      Value loopResult = body(env);
+      if (loopResult.type() == ValueType::ReturnValue) {
+        return loopResult;
+      }
+      result = loopResult;
+    }
+  };
+}
+
+Closure NodeCompiler::compileVarDeclaration(VarDeclaration *declaration) {
+  Closure value = compileValue(declaration->value);
+  bool constant = declaration->constant;
+
+  if (declaration->slot >= 0) {
+    uint32_t slot = static_cast<uint32_t>(declaration->slot);
+    return [value = std::move(value), slot, constant](Environment *env) {
+      return env->declareSlot(slot, unwrap(value(env)), constant);
+    };
+  }
+  Symbol name = declaration->identifier;
+  return [value = std::move(value), name, constant](Environment *env) {
+    return env->declareVar(name, unwrap(value(env)), constant);
+  };
+}
+
+Closure
+NodeCompiler::compileFunctionDeclaration(FunctionDeclaration *declaration) {
+  program.functions.push_back(std::make_unique<ClosureFunction>());
+  ClosureFunction *function = program.functions.back().get();
+  function->statements = compileAll(declaration->body);
+
+  return [declaration, function](Environment *env) {
+    FnVal *fn = new FnVal(declaration->name, declaration->parameters, env,
+                          declaration->body, nullptr, declaration->slotNames);
+    fn->closure = function;
+    if (declaration->memoizable) {
+      fn->memoized = declaration;
+    }
+    if (declaration->slot >= 0) {
+      return env->declareSlot(declaration->slot, Value(fn), true);
+    }
+    return env->declareVar(declaration->name, Value(fn), true);
+  };
+}
+
+Closure NodeCompiler::compileStructDeclaration(StructDeclaration *declaration) {
+  std::vector<std::pair<Symbol, Closure>> fields;
+  for (Stmt *stmt : declaration->structBody) {
+    if (stmt->kind == NodeType::VarDeclaration) {
+      auto field = static_cast<VarDeclaration *>(stmt);
+      fields.emplace_back(field->identifier, compileValue(field->value));
+    }
+  }
+
+  return [declaration, fields = std::move(fields)](Environment *env) {
+    Value structVal =
+        Value(new StructVal(SymbolTable::name(declaration->structName), true));
+    GcRoot structRoot(structVal);
+
+    for (const auto &field : fields) {
+      Value fieldValue = unwrap(field.second(env));
+      structVal.as<StructVal>()->addField(field.first, fieldValue);
+    }
+
+    if (declaration->slot >= 0) {
+      return env->declareSlot(declaration->slot, structVal, true);
+    }
+    return env->declareVar(declaration->structName, structVal, true);
+  };
+}
+
+} // namespace
+
+Value ClosureFunction::run(Environment *env) const {
+  Value result = Value::null();
+
+  for (const Closure &statement : statements) {
+    Heap::safepoint();
+    result = statement(env);
+    if (result.type() == ValueType::ReturnValue) {
+      return result;
+    }
+  }
+
+  return result;
+}
+
+std::unique_ptr<ClosureProgram>
+ClosureCompiler::compile(const Program &program) {
+  std::unique_ptr<ClosureProgram> compiled =
+      std::make_unique<ClosureProgram>();
+  compiled->slotNames = program.slotNames;
+  compiled->statements = NodeCompiler(*compiled).compileAll(program.body);
+  return compiled;
+}
+
+Value ClosureCompiler::execute(const ClosureProgram &program,
+                               Environment *env) {
+  Value lastEvaluated = Value::null();
+  if (!program.slotNames.empty()) {
+    env->bindSlots(program.slotNames);
+  }
+  for (const Closure &statement : program.statements) {
+    Heap::safepoint();
+    lastEvaluated = statement(env);
+  }
+  return lastEvaluated;
+}
@@ -0,0 +1,45 @@
+#ifndef CLOSURE_COMPILER_H
+#define CLOSURE_COMPILER_H
+
+#include "../../ast/AST.h"
+#include "../environment/Environment.h"
+#include "../values/Values.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Closure compilation, run with --closures. Every node of a Program is turned
+// once into a Closure with its children, operator and slot already bound, so
+// running it never switches on the kind of a node, casts it or looks at its
+// operator again.
+//
+// A closure does exactly what Interpreter::evaluate does for its node: it
+// uses the same environments, lookups, errors and return values, only the
+// dispatch is done ahead of time.
+using Closure = std::function<Value(Environment *)>;
+
+// Body of a function declared by closure compiled code.
+struct ClosureFunction {
+  std::vector<Closure> statements;
+
+  // Runs the body in the environment of a call, like
+  // Interpreter::eval_function_body.
+  Value run(Environment *env) const;
+};
+
+// Closures of one Program. FnVals point into it, so it must live as long as
+// they can be called.
+struct ClosureProgram {
+  ArenaArray<Symbol> slotNames;
+  std::vector<Closure> statements;
+  std::vector<std::unique_ptr<ClosureFunction>> functions;
+};
+
+class ClosureCompiler {
+public:
+  static std::unique_ptr<ClosureProgram> compile(const Program &program);
+  static Value execute(const ClosureProgram &program, Environment *env);
+};
+
+#endif
@@ -1,14 +1,148 @@
 #include "Environment.h"
 #include "../standard-library/BuiltinFunctions.h"
 
-Environment::Environment(Environment *parentEnv) : parent(parentEnv) {
+#include <algorithm>
+#include <new>
+
+namespace {
+
+// Names declared by the builtin scope, indexed by symbol.
+std::vector<bool> builtinNames;
+
+} // namespace
+
+FrameStack::FrameStack()
+    : values(static_cast<Value *>(::operator new(CAPACITY * sizeof(Value)))),
+      flags(static_cast<bool *>(::operator new(CAPACITY * sizeof(bool)))),
+      live{values, values} {
+  // Slots are initialized when they are pushed, the pages of the unused
+  // part are never touched.
+  Heap::addRootSpan(&live);
+}
+
+FrameStack &FrameStack::instance() {
+  static FrameStack stack;
+  return stack;
+}
+
+Value *FrameStack::push(size_t count) {
+  FrameStack &stack = instance();
+  Value *base = stack.live.end;
+  extend(base, count);
+  return base;
+}
+
+void FrameStack::extend(Value *base, size_t count) {
+  FrameStack &stack = instance();
+  Value *end = base + count;
+  if (end <= stack.live.end) {
+    return;
+  }
+  if (end > stack.values + CAPACITY) {
+    throw InterpreterError("Stack overflow");
+  }
+  std::fill(stack.live.end, end, Value());
+  std::fill(stack.flags + (stack.live.end - stack.values),
+            stack.flags + (end - stack.values), false);
+  stack.live.end = end;
+}
+
+void FrameStack::popTo(Value *base) { instance().live.end = base; }
+
+bool *FrameStack::constants(Value *slot) {
+  FrameStack &stack = instance();
+  return stack.flags + (slot - stack.values);
+}
+
+Environment::Environment(Environment *parentEnv,
+                         ArenaArray<Symbol> slotNames, Value *frame)
+    : parent(parentEnv), slotNames(slotNames), slots(frame),
+      constantSlots(nullptr) {
+  if (parent == nullptr) {
+    parent = builtinScope();
+  }
+  if (frame != nullptr) {
+    constantSlots = FrameStack::constants(frame);
+  } else if (!slotNames.empty()) {
+    bindSlots(slotNames);
+  }
+  Heap::addEnvironment(this);
+}
+
+Environment::Environment(BuiltinScopeTag)
+    : parent(nullptr), slots(nullptr), constantSlots(nullptr) {
+  Heap::addEnvironment(this);
   this->createGlobalEnv();
+
+  for (auto &variable : variables) {
+    if (variable.first >= builtinNames.size()) {
+      builtinNames.resize(variable.first + 1);
+    }
+    builtinNames[variable.first] = true;
+  }
+}
+
+Environment *Environment::builtinScope() {
+  static Environment scope{BuiltinScopeTag()};
+  return &scope;
+}
+
+bool Environment::isBuiltin(Symbol name) {
+  return name < builtinNames.size() && builtinNames[name];
+}
+
+void Environment::bindSlots(ArenaArray<Symbol> names) {
+  slotNames = names;
+  ownedSlots.reset(new Value[names.size()]);
+  ownedConstants.reset(new bool[names.size()]());
+  slots = ownedSlots.get();
+  constantSlots = ownedConstants.get();
+}
+
+Environment::~Environment() { Heap::removeEnvironment(this); }
+
+void Environment::traceValues() {
+  // Slots on the FrameStack are traced with the whole stack.
+  if (ownedSlots != nullptr) {
+    for (uint32_t i = 0; i < slotNames.size(); i++) {
+      Heap::visit(ownedSlots[i]);
+    }
+  }
+  for (auto &variable : variables) {
+    Heap::visit(variable.second);
+  }
 }
 
-RuntimeVal *Environment::declareVar(const std::string &varName,
-                                    RuntimeVal *value, bool isConst) {
-  if (variables.find(varName) != variables.end()) {
-    throw InterpreterError("Cannot declare variable " + varName + ". It is already defined.");
+Value Environment::declareSlot(uint32_t slot, Value value, bool isConst) {
+  Symbol varName = slotNames[slot];
+
+  // Builtins used to be declared in every environment, so declaring one of
+  // their names again still fails.
+  if (!slots[slot].isEmpty() || isBuiltin(varName)) {
+    throw InterpreterError("Cannot declare variable " +
+                           SymbolTable::name(varName) +
+                           ". It is already defined.");
+  }
+
+  slots[slot] = value;
+  constantSlots[slot] = isConst;
+  return value;
+}
+
+Value *Environment::findSlot(Symbol varName) {
+  for (uint32_t i = 0; i < slotNames.size(); i++) {
+    if (slotNames[i] == varName && !slots[i].isEmpty()) {
+      return &slots[i];
+    }
+  }
+  return nullptr;
+}
+
+Value Environment::declareVar(Symbol varName, Value value, bool isConst) {
+  if (variables.find(varName) != variables.end() || isBuiltin(varName)) {
+    throw InterpreterError("Cannot declare variable " +
+                           SymbolTable::name(varName) +
+                           ". It is already defined.");
   }
 
   variables[varName] = value;
@@ -20,65 +154,96 @@ RuntimeVal *Environment::declareVar(const std::string &varName,
   return value;
 }
 
-RuntimeVal *Environment::assignVar(const std::string &varName,
-                                   RuntimeVal *value) {
-  Environment *env = resolve(varName);
+Value Environment::declareVar(const std::string &varName, Value value,
+                              bool isConst) {
+  return declareVar(SymbolTable::intern(varName), value, isConst);
+}
 
-  if (isConstant(varName)) {
-    throw InterpreterError("Cannot reassign to variable " + varName +
-                             " as it was declared constant.");
+Value Environment::assignVar(Symbol varName, Value value) {
+  Value *target = findVar(varName);
+
+  if (isConstant(varName) || isBuiltin(varName)) {
+    throw InterpreterError("Cannot reassign to variable " +
+                           SymbolTable::name(varName) +
+                           " as it was declared constant.");
   }
 
-  env->variables[varName] = value;
+  *target = value;
   return value;
 }
 
-RuntimeVal *Environment::lookupVar(const std::string &varName) {
-  Environment *env = resolve(varName);
-  return env->variables[varName];
+Value Environment::assignOuterVar(Symbol varName, Value value) {
+  Value *target = findVar(varName);
+
+  if (isBuiltin(varName)) {
+    throw InterpreterError("Cannot reassign to variable " +
+                           SymbolTable::name(varName) +
+                           " as it was declared constant.");
+  }
+
+  *target = value;
+  return value;
 }
 
-Environment *Environment::resolve(const std::string &varName) {
-  if (variables[varName]) {
-    return this;
+Value Environment::lookupVar(Symbol varName) { return *findVar(varName); }
+
+Value *Environment::findVar(Symbol varName) {
+  // A builtin name is never declared anywhere else, it is looked up in the
+  // builtin scope right away instead of at the end of the chain.
+  if (isBuiltin(varName)) {
+    return &builtinScope()->variables.find(varName)->second;
   }
 
-  if (parent == nullptr) {
-    throw InterpreterError("Cannot resolve ' " + varName + " ' as it does not exist.");
+  for (Environment *env = this; env != nullptr; env = env->parent) {
+    Value *slot = env->findSlot(varName);
+    if (slot != nullptr) {
+      return slot;
+    }
+
+    auto found = env->variables.find(varName);
+    if (found != env->variables.end() && !found->second.isEmpty()) {
+      return &found->second;
+    }
   }
 
-  return parent->resolve(varName);
+  throw InterpreterError("Cannot resolve ' " + SymbolTable::name(varName) +
+                         " ' as it does not exist.");
 }
 
-bool Environment::isConstant(const std::string &varname) {
+bool Environment::isConstant(Symbol varname) {
+  for (uint32_t i = 0; i < slotNames.size(); i++) {
+    if (slotNames[i] == varname && !slots[i].isEmpty()) {
+      return constantSlots[i];
+    }
+  }
   return constants.find(varname) != constants.end();
 }
 
 void Environment::createBuilinFunctions() {
-  this->declareVar("print", new NativeFnVal(printFunction), true);
-  this->declareVar("exit", new NativeFnVal(exitFunction), true);
-  this->declareVar("clear", new NativeFnVal(clearFunction), true);
-  this->declareVar("sqrt", new NativeFnVal(sqrtFunction), true);
-  this->declareVar("pow", new NativeFnVal(powFunction), true);
-  this->declareVar("round", new NativeFnVal(roundFunction), true);
-  this->declareVar("min", new NativeFnVal(minFunction), true);
-  this->declareVar("max", new NativeFnVal(maxFunction), true);
-  this->declareVar("input", new NativeFnVal(inputFunction), true);
-  this->declareVar("num", new NativeFnVal(numberFunction), true);
-  this->declareVar("len", new NativeFnVal(lenFunction), true);
-  this->declareVar("floor", new NativeFnVal(floorFunction), true);
-  this->declareVar("type", new NativeFnVal(typeFunction), true);
-  this->declareVar("concat", new NativeFnVal(concatFunction), true);
-  this->declareVar("sin", new NativeFnVal(sinFunction), true);
-  this->declareVar("cos", new NativeFnVal(cosFunction), true);
-  this->declareVar("tan", new NativeFnVal(tanFunction), true);
-  this->declareVar("log", new NativeFnVal(logFunction), true);
-  this->declareVar("ceil", new NativeFnVal(ceilFunction), true);
+  this->declareVar("print", Value(new NativeFnVal(printFunction)), true);
+  this->declareVar("exit", Value(new NativeFnVal(exitFunction)), true);
+  this->declareVar("clear", Value(new NativeFnVal(clearFunction)), true);
+  this->declareVar("sqrt", Value(new NativeFnVal(sqrtFunction)), true);
+  this->declareVar("pow", Value(new NativeFnVal(powFunction)), true);
+  this->declareVar("round", Value(new NativeFnVal(roundFunction)), true);
+  this->declareVar("min", Value(new NativeFnVal(minFunction)), true);
+  this->declareVar("max", Value(new NativeFnVal(maxFunction)), true);
+  this->declareVar("input", Value(new NativeFnVal(inputFunction)), true);
+  this->declareVar("num", Value(new NativeFnVal(numberFunction)), true);
+  this->declareVar("len", Value(new NativeFnVal(lenFunction)), true);
+  this->declareVar("floor", Value(new NativeFnVal(floorFunction)), true);
+  this->declareVar("type", Value(new NativeFnVal(typeFunction)), true);
+  this->declareVar("concat", Value(new NativeFnVal(concatFunction)), true);
+  this->declareVar("sin", Value(new NativeFnVal(sinFunction)), true);
+  this->declareVar("cos", Value(new NativeFnVal(cosFunction)), true);
+  this->declareVar("tan", Value(new NativeFnVal(tanFunction)), true);
+  this->declareVar("log", Value(new NativeFnVal(logFunction)), true);
+  this->declareVar("ceil", Value(new NativeFnVal(ceilFunction)), true);
 }
 
 void Environment::createGlobalEnv() {
-  this->declareVar("true", new BooleanVal(true), true);
-  this->declareVar("false", new BooleanVal(false), true);
-  this->declareVar("null", new NullVal(), true);
+  this->declareVar("true", Value::boolean(true), true);
+  this->declareVar("false", Value::boolean(false), true);
+  this->declareVar("null", Value::null(), true);
   this->createBuilinFunctions();
 }
@@ -5,35 +5,156 @@
 #include <cstring>
 #include <functional>
 #include <map>
+#include <memory>
 #include <math.h>
 #include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
+
+#include "../../ast/AstArena.h"
+#include "../../lexer/SymbolTable.h"
+#include "../gc/Heap.h"
+#include "../values/Value.h"
 
-class RuntimeVal;
 class NativeFnVal;
 class FnVal;
 class StructVal;
 class InterpreterError;
 
+// Slots of the calls the evaluator is running, one contiguous stack for the
+// whole process. A call takes a window above the top for its arguments and
+// variables and gives it back when it returns. Every slot below the top is a
+// root of the garbage collector.
+class FrameStack {
+public:
+  // Window of count empty, non constant slots above the top.
+  static Value *push(size_t count);
+  // Grows the topmost window, which starts at base, to count slots.
+  static void extend(Value *base, size_t count);
+  static void popTo(Value *base);
+
+  // Constant flag of every slot, at the same index as its value.
+  static bool *constants(Value *slot);
+
+private:
+  static const size_t CAPACITY = 1 << 20;
+
+  FrameStack();
+  static FrameStack &instance();
+
+  Value *values;
+  bool *flags;
+  RootSpan live;
+};
+
+// Frame stack window that is given back when it goes out of scope.
+class StackFrame {
+public:
+  explicit StackFrame(size_t count) : base(FrameStack::push(count)) {}
+  ~StackFrame() { FrameStack::popTo(base); }
+
+  StackFrame(const StackFrame &) = delete;
+  StackFrame &operator=(const StackFrame &) = delete;
+
+  Value *slots() const { return base; }
+  void extend(size_t count) { FrameStack::extend(base, count); }
+  // Gives the window back and takes count cleared slots at the same place.
+  void reset(size_t count) {
+    FrameStack::popTo(base);
+    FrameStack::push(count);
+  }
+
+private:
+  Value *base;
+};
+
 class Environment {
 private:
   Environment *parent;
-  std::unordered_map<std::string, RuntimeVal *> variables;
-  std::set<std::string> constants;
+  // Variables of a resolved function or program, slotNames[i] is the name
+  // of slots[i]. An empty slot is a variable that is not declared yet.
+  // Everything else is kept by name in variables.
+  ArenaArray<Symbol> slotNames;
+  Value *slots;
+  bool *constantSlots;
+  // Slots of a program, which live as long as the environment. The slots of
+  // a call are a window of the FrameStack instead.
+  std::unique_ptr<Value[]> ownedSlots;
+  std::unique_ptr<bool[]> ownedConstants;
+  std::unordered_map<Symbol, Value> variables;
+  std::set<Symbol> constants;
+
+  struct BuiltinScopeTag {};
+  explicit Environment(BuiltinScopeTag);
+
+  Value *findSlot(Symbol varName);
 
 public:
-  Environment(Environment *parentEnv = nullptr);
-  RuntimeVal *declareVar(const std::string &varName, RuntimeVal *value,
-                         bool isConst);
-  RuntimeVal *assignVar(const std::string &varName, RuntimeVal *value);
-  RuntimeVal *lookupVar(const std::string &varName);
-  Environment *resolve(const std::string &varName);
+  // An environment without a parent gets the builtin scope as its parent.
+  // frame holds slotNames.size() slots of the FrameStack.
+  Environment(Environment *parentEnv = nullptr,
+              ArenaArray<Symbol> slotNames = ArenaArray<Symbol>(),
+              Value *frame = nullptr);
+
+  // true, false, null and the native functions, created once and shared by
+  // every environment. Nothing declares or assigns a name it holds.
+  static Environment *builtinScope();
+  static bool isBuiltin(Symbol name);
+
+  // Gives the environment the slots of a program resolved with global
+  // slots, replacing the ones it had.
+  void bindSlots(ArenaArray<Symbol> names);
+
+  Value declareSlot(uint32_t slot, Value value, bool isConst);
+
+  // A slot that is not declared yet is looked up by name, like the
+  // evaluator did before the variable had a slot.
+  Value lookupSlot(uint32_t slot) {
+    Value value = slots[slot];
+    if (!value.isEmpty()) {
+      return value;
+    }
+    return lookupVar(slotNames[slot]);
+  }
+
+  // A declared variable that is not constant, which may be written in
+  // place; null for any other slot.
+  Value *variableSlot(uint32_t slot) {
+    if (slots[slot].isEmpty() || constantSlots[slot]) {
+      return nullptr;
+    }
+    return &slots[slot];
+  }
+
+  Value assignSlot(uint32_t slot, Value value) {
+    if (slots[slot].isEmpty() || constantSlots[slot]) {
+      return assignVar(slotNames[slot], value);
+    }
+    slots[slot] = value;
+    return value;
+  }
+
+  Value declareVar(Symbol varName, Value value, bool isConst);
+  Value declareVar(const std::string &varName, Value value, bool isConst);
+  Value assignVar(Symbol varName, Value value);
+  // Assignment by a function that does not declare varName itself. The
+  // evaluator only rejects the constants of the environment that assigns,
+  // so a constant found in a caller or the globals is assigned too.
+  Value assignOuterVar(Symbol varName, Value value);
+  Value lookupVar(Symbol varName);
+  // Declared variable of this environment or the closest parent that has
+  // one, throws when there is none.
+  Value *findVar(Symbol varName);
   void createGlobalEnv();
   void createBuilinFunctions();
-  bool isConstant(const std::string &varname);
+  bool isConstant(Symbol varname);
+
+  // Hands every variable to the garbage collector, a live environment is a
+  // root. The parent is not owned, it is registered on its own.
+  void traceValues();
 
-  ~Environment() { delete parent; }
+  ~Environment();
 };
 
 #endif
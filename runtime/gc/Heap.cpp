@@ -0,0 +1,331 @@
+#include "Heap.h"
+#include "../environment/Environment.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+bool Heap::collectionRequested = false;
+
+static const size_t ALIGNMENT = alignof(std::max_align_t);
+
+static size_t aligned(size_t size) {
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+Heap::Heap() {
+  // operator new[] hands out memory aligned for any object.
+  nursery.reset(new char[NURSERY_SIZE]);
+  nurseryEnd = nursery.get() + NURSERY_SIZE;
+  nurseryTop = nursery.get();
+}
+
+Heap::~Heap() {
+  // Nothing runs any more, every object can go.
+  for (RuntimeVal *object : nurseryObjects) {
+    object->~RuntimeVal();
+  }
+  for (auto &entry : oldObjects) {
+    entry.first->~RuntimeVal();
+    ::operator delete(entry.first);
+  }
+  for (RuntimeVal *object : permanentObjects) {
+    object->~RuntimeVal();
+    ::operator delete(object);
+  }
+}
+
+Heap &Heap::instance() {
+  static Heap heap;
+  return heap;
+}
+
+void *Heap::allocate(size_t size, Generation generation) {
+  Heap &heap = instance();
+  heap.counters.allocatedObjects++;
+
+  if (generation == Generation::Permanent) {
+    // Never swept, so it must not hold references to collected objects.
+    void *memory = ::operator new(size);
+    heap.permanentObjects.push_back(static_cast<RuntimeVal *>(memory));
+    return memory;
+  }
+
+  if (generation == Generation::Old) {
+    return heap.allocateOld(size);
+  }
+
+  size = aligned(size);
+  if (static_cast<size_t>(heap.nurseryEnd - heap.nurseryTop) >= size) {
+    void *memory = heap.nurseryTop;
+    heap.nurseryTop += size;
+    heap.nurseryObjects.push_back(static_cast<RuntimeVal *>(memory));
+    return memory;
+  }
+
+  // The nursery is full. The object goes straight to the old generation and
+  // is remembered, as it may get young values before the next collection.
+  void *memory = heap.allocateOld(size);
+  heap.remembered.push_back(static_cast<RuntimeVal *>(memory));
+  collectionRequested = true;
+  return memory;
+}
+
+void *Heap::allocateOld(size_t size) {
+  void *memory = ::operator new(size);
+  oldObjects.push_back({static_cast<RuntimeVal *>(memory), size});
+  oldBytes += size;
+
+  if (oldBytes > majorThreshold) {
+    majorRequested = true;
+    collectionRequested = true;
+  }
+
+  return memory;
+}
+
+template <typename T>
+static bool forget(std::vector<T> &objects, RuntimeVal *object) {
+  for (auto it = objects.rbegin(); it != objects.rend(); ++it) {
+    RuntimeVal *candidate;
+    if constexpr (std::is_pointer_v<T>) {
+      candidate = *it;
+    } else {
+      candidate = it->first;
+    }
+    if (candidate == object) {
+      objects.erase(std::next(it).base());
+      return true;
+    }
+  }
+  return false;
+}
+
+void Heap::release(void *memory) {
+  // Objects are only ever freed by the collector, this is reached when the
+  // constructor of a new object throws. The allocation is forgotten so that
+  // nothing destroys the unfinished object later.
+  Heap &heap = instance();
+  RuntimeVal *object = static_cast<RuntimeVal *>(memory);
+
+  if (heap.isYoung(object)) {
+    forget(heap.nurseryObjects, object);
+    return;
+  }
+
+  forget(heap.remembered, object);
+  if (forget(heap.oldObjects, object) ||
+      forget(heap.permanentObjects, object)) {
+    ::operator delete(memory);
+  }
+}
+
+void RuntimeVal::operator delete(void *memory, Generation generation) {
+  (void)generation;
+  Heap::release(memory);
+}
+
+void *RuntimeVal::operator new(size_t size) {
+  return Heap::allocate(size, Generation::Young);
+}
+
+void *RuntimeVal::operator new(size_t size, Generation generation) {
+  return Heap::allocate(size, generation);
+}
+
+void RuntimeVal::operator delete(void *memory) { Heap::release(memory); }
+
+void Heap::rememberIfOld(RuntimeVal *owner, RuntimeVal *value) {
+  if (!isYoung(owner) && isYoung(value)) {
+    owner->remembered = true;
+    remembered.push_back(owner);
+  }
+}
+
+void Heap::addEnvironment(Environment *env) {
+  instance().environments.push_back(env);
+}
+
+void Heap::removeEnvironment(Environment *env) {
+  std::vector<Environment *> &environments = instance().environments;
+  auto found = std::find(environments.rbegin(), environments.rend(), env);
+  if (found != environments.rend()) {
+    environments.erase(std::next(found).base());
+  }
+}
+
+void Heap::addRootSpan(const RootSpan *span) {
+  instance().permanentSpans.push_back(span);
+}
+
+void Heap::visit(Value &slot) {
+  if (!slot.isObject()) {
+    return;
+  }
+
+  Heap &heap = instance();
+  RuntimeVal *object = slot.asObject();
+
+  if (heap.marking) {
+    if (!object->marked) {
+      object->marked = true;
+      heap.worklist.push_back(object);
+    }
+    return;
+  }
+
+  if (!heap.isYoung(object)) {
+    return;
+  }
+
+  if (object->forwarded == nullptr) {
+    object->forwarded = object->tenure();
+    heap.counters.promotedObjects++;
+    heap.worklist.push_back(object->forwarded);
+  }
+  slot = Value(object->forwarded);
+}
+
+void Heap::visitRoots() {
+  for (Environment *env : environments) {
+    env->traceValues();
+  }
+  for (Value *slot : rootSlots) {
+    visit(*slot);
+  }
+  for (std::vector<Value> *values : rootVectors) {
+    for (Value &value : *values) {
+      visit(value);
+    }
+  }
+  for (const RootSpan *span : rootSpans) {
+    for (Value *slot = span->begin; slot != span->end; slot++) {
+      visit(*slot);
+    }
+  }
+  for (const RootSpan *span : permanentSpans) {
+    for (Value *slot = span->begin; slot != span->end; slot++) {
+      visit(*slot);
+    }
+  }
+}
+
+void Heap::drainWorklist() {
+  while (!worklist.empty()) {
+    RuntimeVal *object = worklist.back();
+    worklist.pop_back();
+    object->traceValues();
+  }
+}
+
+void Heap::minorCollection() {
+  counters.minorCollections++;
+
+  visitRoots();
+  for (RuntimeVal *object : remembered) {
+    object->remembered = false;
+    object->traceValues();
+  }
+  drainWorklist();
+  remembered.clear();
+
+  // Survivors were copied out, what is left behind is either garbage or the
+  // moved-from original of a copy.
+  for (RuntimeVal *object : nurseryObjects) {
+    if (object->forwarded == nullptr) {
+      counters.freedObjects++;
+    }
+    object->~RuntimeVal();
+  }
+  nurseryObjects.clear();
+  nurseryTop = nursery.get();
+}
+
+void Heap::majorCollection() {
+  counters.majorCollections++;
+
+  marking = true;
+  visitRoots();
+  drainWorklist();
+  marking = false;
+
+  auto survivor = oldObjects.begin();
+  for (auto &entry : oldObjects) {
+    RuntimeVal *object = entry.first;
+    if (object->marked) {
+      object->marked = false;
+      *survivor++ = entry;
+    } else {
+      object->~RuntimeVal();
+      ::operator delete(object);
+      oldBytes -= entry.second;
+      counters.freedObjects++;
+    }
+  }
+  oldObjects.erase(survivor, oldObjects.end());
+
+  majorThreshold = std::max(MIN_MAJOR_THRESHOLD, oldBytes * 2);
+}
+
+void Heap::collect(bool major) {
+  Heap &heap = instance();
+  collectionRequested = false;
+
+  heap.minorCollection();
+
+  if (major || heap.majorRequested || heap.oldBytes > heap.majorThreshold) {
+    heap.majorRequested = false;
+    heap.majorCollection();
+  }
+}
+
+GcStats Heap::stats() {
+  Heap &heap = instance();
+  GcStats stats = heap.counters;
+  stats.nurseryBytes = heap.nurseryTop - heap.nursery.get();
+  stats.nurseryCapacity = NURSERY_SIZE;
+  stats.oldBytes = heap.oldBytes;
+  stats.oldObjects = heap.oldObjects.size();
+  return stats;
+}
+
+void Heap::printStats(std::ostream &out) {
+  GcStats stats = Heap::stats();
+  out << "GC: " << stats.minorCollections << " minor and "
+      << stats.majorCollections << " major collections, "
+      << stats.allocatedObjects << " objects allocated, "
+      << stats.promotedObjects << " promoted, " << stats.freedObjects
+      << " freed" << std::endl;
+  out << "GC heap: nursery " << stats.nurseryBytes / 1024 << " of "
+      << stats.nurseryCapacity / 1024 << " KiB, old generation "
+      << stats.oldBytes / 1024 << " KiB in " << stats.oldObjects
+      << " objects" << std::endl;
+}
+
+GcRoot::GcRoot(Value &slot) : kind(Kind::Slot) {
+  Heap::instance().rootSlots.push_back(&slot);
+}
+
+GcRoot::GcRoot(std::vector<Value> &values) : kind(Kind::Vector) {
+  Heap::instance().rootVectors.push_back(&values);
+}
+
+GcRoot::GcRoot(const RootSpan &span) : kind(Kind::Span) {
+  Heap::instance().rootSpans.push_back(&span);
+}
+
+GcRoot::~GcRoot() {
+  Heap &heap = Heap::instance();
+  switch (kind) {
+  case Kind::Slot:
+    heap.rootSlots.pop_back();
+    break;
+  case Kind::Vector:
+    heap.rootVectors.pop_back();
+    break;
+  case Kind::Span:
+    heap.rootSpans.pop_back();
+    break;
+  }
+}
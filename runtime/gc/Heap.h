@@ -0,0 +1,165 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include "../values/Value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+class Environment;
+
+// Both can be lowered at build time to make collections frequent, e.g. to
+// check a change to the evaluator or the VM for missing roots.
+#ifndef RUSTEDC_NURSERY_SIZE
+#define RUSTEDC_NURSERY_SIZE (4 * 1024 * 1024)
+#endif
+#ifndef RUSTEDC_MAJOR_THRESHOLD
+#define RUSTEDC_MAJOR_THRESHOLD (16 * 1024 * 1024)
+#endif
+
+// Values of a contiguous block of registers, [begin, end).
+struct RootSpan {
+  Value *begin;
+  Value *end;
+};
+
+struct GcStats {
+  uint64_t minorCollections = 0;
+  uint64_t majorCollections = 0;
+  uint64_t allocatedObjects = 0;
+  uint64_t promotedObjects = 0;
+  uint64_t freedObjects = 0;
+  size_t nurseryBytes = 0;
+  size_t nurseryCapacity = 0;
+  size_t oldBytes = 0;
+  size_t oldObjects = 0;
+};
+
+// Precise generational garbage collector for every RuntimeVal.
+//
+// New objects are bump allocated in a nursery. A minor collection copies the
+// ones still reachable into the old generation and empties the nursery in one
+// go, a major collection marks the old generation and frees what it did not
+// reach. Roots are the live environments, the registers of a running VM and
+// the temporaries the evaluator keeps on the C++ stack (see GcRoot).
+//
+// Allocating never collects, it only asks for a collection. The evaluator and
+// the VM call safepoint() where every Value they still need is reachable from
+// a root, and only there objects are freed or moved.
+class Heap {
+public:
+  static void *allocate(size_t size, Generation generation);
+  static void release(void *memory);
+
+  static void addEnvironment(Environment *env);
+  static void removeEnvironment(Environment *env);
+
+  // Registers a span that stays a root for the rest of the process, unlike
+  // the scoped roots of GcRoot. Its end may move freely.
+  static void addRootSpan(const RootSpan *span);
+
+  // Must be called when a Value is stored into an object that may already be
+  // in the old generation.
+  static void writeBarrier(RuntimeVal *owner, Value value) {
+    if (value.isObject() && !owner->remembered) {
+      instance().rememberIfOld(owner, value.asObject());
+    }
+  }
+
+  // True once an allocation asked for a collection.
+  static bool collectionPending() { return collectionRequested; }
+  // The same flag for machine code made by the Jit, which polls it directly.
+  static const bool *collectionFlag() { return &collectionRequested; }
+
+  static void safepoint() {
+    if (collectionRequested) {
+      collect();
+    }
+  }
+
+  // Minor collection, followed by a major one when asked for or when the old
+  // generation outgrew its limit.
+  static void collect(bool major = false);
+
+  // Called by RuntimeVal::traceValues and Environment::traceValues for every
+  // Value they hold.
+  static void visit(Value &slot);
+
+  static GcStats stats();
+  static void printStats(std::ostream &out);
+
+private:
+  friend class GcRoot;
+
+  static constexpr size_t NURSERY_SIZE = RUSTEDC_NURSERY_SIZE;
+  static constexpr size_t MIN_MAJOR_THRESHOLD = RUSTEDC_MAJOR_THRESHOLD;
+
+  Heap();
+  ~Heap();
+  static Heap &instance();
+
+  bool isYoung(const RuntimeVal *object) const {
+    const char *address = reinterpret_cast<const char *>(object);
+    return address >= nursery.get() && address < nurseryEnd;
+  }
+
+  void *allocateOld(size_t size);
+  void rememberIfOld(RuntimeVal *owner, RuntimeVal *value);
+
+  void visitRoots();
+  void drainWorklist();
+  void minorCollection();
+  void majorCollection();
+
+  static bool collectionRequested;
+
+  std::unique_ptr<char[]> nursery;
+  char *nurseryEnd;
+  char *nurseryTop;
+  std::vector<RuntimeVal *> nurseryObjects;
+
+  std::vector<std::pair<RuntimeVal *, size_t>> oldObjects;
+  size_t oldBytes = 0;
+  size_t majorThreshold = MIN_MAJOR_THRESHOLD;
+  bool majorRequested = false;
+
+  std::vector<RuntimeVal *> permanentObjects;
+
+  // Old objects that may hold a Value in the nursery.
+  std::vector<RuntimeVal *> remembered;
+
+  // Mostly created and destroyed in stack order, the ones of calls are.
+  std::vector<Environment *> environments;
+  std::vector<const RootSpan *> permanentSpans;
+  std::vector<Value *> rootSlots;
+  std::vector<std::vector<Value> *> rootVectors;
+  std::vector<const RootSpan *> rootSpans;
+
+  bool marking = false;
+  std::vector<RuntimeVal *> worklist;
+
+  GcStats counters;
+};
+
+// Registers a Value, a vector of Values or a span of registers as a root for
+// as long as it is in scope. Roots are released in reverse order.
+class GcRoot {
+public:
+  explicit GcRoot(Value &slot);
+  explicit GcRoot(std::vector<Value> &values);
+  explicit GcRoot(const RootSpan &span);
+  ~GcRoot();
+
+  GcRoot(const GcRoot &) = delete;
+  GcRoot &operator=(const GcRoot &) = delete;
+
+private:
+  enum class Kind { Slot, Vector, Span };
+  Kind kind;
+};
+
+#endif
@@ -3,45 +3,99 @@
 
 #include "../../ast/AST.h"
 #include "../environment/Environment.h"
+#include "../gc/Heap.h"
 #include "../values/Values.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <cmath>
 #include <iostream>
+#include <ostream>
+#include <vector>
+
+// How many binary expressions the evaluator specialized for numbers and how
+// many of those went back to the generic version (see Specialization).
+struct NodeStats {
+  uint64_t specialized = 0;
+  uint64_t deoptimized = 0;
+};
 
 class Interpreter {
 public:
-  static RuntimeVal *evaluate(Stmt *astNode, Environment *env);
-
-  static RuntimeVal *eval_program(Program *program, Environment *env);
-  static RuntimeVal *eval_if_statement(IfStatement *ifStmt, Environment *env);
-  static RuntimeVal *eval_while_statement(WhileLoop *whileStmt,
-                                          Environment *env);
-  static RuntimeVal *
-  eval_stmt_vector(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                   Environment *env);
-  static RuntimeVal *eval_function_declaration(FunctionDeclaration *declaration,
-                                               Environment *env);
-  static RuntimeVal *eval_return_statement(ReturnStatement *returnStmt,
-                                           Environment *env);
-  static RuntimeVal *eval_var_declaration(VarDeclaration *declaration,
-                                          Environment *env);
-  static RuntimeVal *eval_struct_declaration(StructDeclaration *declaration,
-                                             Environment *env);
-
-  static RuntimeVal *eval_assignment(AssignmentExpr *node, Environment *env);
-  static RuntimeVal *eval_call_expr(CallExpr *call, Environment *env);
-  static RuntimeVal *eval_identifer(IdentifierExpr *ident, Environment *env);
-  static RuntimeVal *eval_binary_expr(BinaryExpr *binop, Environment *env);
-  static RuntimeVal *eval_unary_expr(UnaryExpr *expr, Environment *env);
-  static RuntimeVal *eval_member_access(MemberAccessExpr *memberAccess,
-                                        Environment *env);
+  static Value evaluate(Stmt *astNode, Environment *env);
+
+  static Value eval_program(Program *program, Environment *env);
+  static Value eval_if_statement(IfStatement *ifStmt, Environment *env);
+  static Value eval_while_statement(WhileLoop *whileStmt, Environment *env);
+  static Value eval_stmt_vector(const NodeList<Stmt> &stmts,
+                                Environment *env);
+  static Value eval_function_declaration(FunctionDeclaration *declaration,
+                                         Environment *env);
+  static Value eval_return_statement(ReturnStatement *returnStmt,
+                                     Environment *env);
+  static Value eval_var_declaration(VarDeclaration *declaration,
+                                    Environment *env);
+  static Value eval_struct_declaration(StructDeclaration *declaration,
+                                       Environment *env);
+
+  static Value eval_assignment(AssignmentExpr *node, Environment *env);
+  static Value eval_call_expr(CallExpr *call, Environment *env);
+  // Calls caller with the argCount arguments at the bottom of frame.
+  static Value call_value(Value caller, StackFrame &frame, size_t argCount,
+                          Environment *env);
+  static Value eval_function_body(FnVal *func, Environment *env);
+  // Return value of a call marked as a tail call. A call of a function that
+  // gets all of its arguments is left to the call_value running the function
+  // that returns it, which makes it in place of the finished one.
+  static Value tail_call(Value caller, StackFrame &frame, size_t argCount,
+                         Environment *env);
+  static Value eval_identifer(IdentifierExpr *ident, Environment *env);
+  static Value eval_binary_expr(BinaryExpr *binop, Environment *env);
+  static Value eval_unary_expr(UnaryExpr *expr, Environment *env);
+  static Value eval_member_access(MemberAccessExpr *memberAccess,
+                                  Environment *env);
    
 
-  static RuntimeVal *eval_logical_expr(LogicalExpr* logicalExpr, Environment* env);
-  static RuntimeVal *
+  static Value eval_logical_expr(LogicalExpr* logicalExpr, Environment* env);
+  static Value
   eval_member_access_assignment(MemberAccessExpr *memberAccessExpr,
                                 Expr *valueExpr, Environment *env);
+
+  static NodeStats nodeStats() { return counters; }
+  static void printNodeStats(std::ostream &out);
+
+private:
+  static NodeStats counters;
+
+  // Callee and arguments of the tail call that tail_call left to call_value.
+  // Nothing collects between the two, they are not roots.
+  static Value pendingCallee;
+  static std::vector<Value> pendingArgs;
+  static Value tailCallMarker();
+
+  static Value eval_tail_call(CallExpr *call, Environment *env);
+
+  // Whether result, the value of stmt in a block, returns from it. Only a
+  // return, or an if or while that ran one, does. Any other statement that
+  // holds the ReturnValue of a call, `f(x)` or `y = f(x)`, gets the value
+  // unwrapped instead, as in the VM.
+  static bool returned(const Stmt *stmt, Value &result);
+  // The value a call returned, for storing it in a variable or field.
+  static Value unwrap(Value value);
+  static Value call_function(FnVal *func, StackFrame &frame, size_t argCount,
+                             Environment *env);
+
+  // Value of an expression inferTypes proved numeric, computed on doubles
+  // for as long as its operands are proven numeric too.
+  static double eval_number(Expr *expr, Environment *env);
+  static Value binary_operation(Operator op, double left, double right);
+  static Value eval_generic_binary(BinaryExpr *binop, Value lhs, Value rhs);
+
+  // Runs a loop markCountedLoops found, whose counter is the number in
+  // counter, with the counter in a double.
+  static Value eval_counted_loop(WhileLoop *loop, Value *counter, double bound,
+                                 Environment *env);
+  static bool counted_condition(Operator op, double counter, double bound);
 };
 
 #endif
@@ -1,9 +1,13 @@
 #include "Interpreter.h"
+#include "../closure/ClosureCompiler.h"
+#include "../memo/Memo.h"
 
-RuntimeVal *Interpreter::eval_identifer(IdentifierExpr *ident,
-                                        Environment *env) {
+Value Interpreter::eval_identifer(IdentifierExpr *ident, Environment *env) {
   try {
-    RuntimeVal *val = env->lookupVar(ident->symbol);
+    if (ident->slot >= 0) {
+      return env->lookupSlot(ident->slot);
+    }
+    Value val = env->lookupVar(ident->symbol);
     return val;
   }
   catch (const InterpreterError& e) {
@@ -11,87 +15,101 @@ RuntimeVal *Interpreter::eval_identifer(IdentifierExpr *ident,
   }
 }
 
-RuntimeVal *Interpreter::eval_assignment(AssignmentExpr *node,
-                                         Environment *env) {
+Value Interpreter::eval_assignment(AssignmentExpr *node, Environment *env) {
 
   try {
     if (node->assigne->kind == NodeType::MemberAccessExpr) {
       return eval_member_access_assignment(
-          dynamic_cast<MemberAccessExpr *>(node->assigne.get()),
-          node->value.get(), env);
+          static_cast<MemberAccessExpr *>(node->assigne),
+          node->value, env);
     }
 
     if (node->assigne->kind != NodeType::Identifier) {
       throw InterpreterError("Invalid LHS inside assignment expr");
     }
 
-    IdentifierExpr *ident = dynamic_cast<IdentifierExpr *>(node->assigne.get());
-    const std::string varname = ident->symbol;
-    return env->assignVar(varname, Interpreter::evaluate(node->value.get(), env));
+    IdentifierExpr *ident = static_cast<IdentifierExpr *>(node->assigne);
+    Value value = unwrap(Interpreter::evaluate(node->value, env));
+    if (ident->slot >= 0) {
+      return env->assignSlot(ident->slot, value);
+    }
+    return env->assignVar(ident->symbol, value);
   }
   catch (const InterpreterError& e) {
     throw;
   }
 }
 
-RuntimeVal *Interpreter::eval_call_expr(CallExpr *expr, Environment *env) {
+Value Interpreter::eval_call_expr(CallExpr *expr, Environment *env) {
   try {
-    std::vector<RuntimeVal *> args;
-
-    for (auto &arg : expr->args) {
-      args.push_back(Interpreter::evaluate(arg.get(), env));
+    // Arguments are evaluated straight into the frame stack, where a
+    // resolved function finds them as its first slots. A call passed as an
+    // argument passes the value it returned, as in the VM.
+    size_t argCount = expr->args.size();
+    StackFrame frame(argCount);
+    Value *args = frame.slots();
+
+    for (size_t i = 0; i < argCount; ++i) {
+      args[i] = unwrap(Interpreter::evaluate(expr->args[i], env));
     }
 
-    RuntimeVal *caller = Interpreter::evaluate(expr->caller.get(), env);
-
-    if (caller->type == ValueType::StructValue) {
-      StructVal *structVal = dynamic_cast<StructVal *>(caller);
-      if (!structVal->isDeclaration) {
-        throw InterpreterError("Cannot create struct instance from other struct instance");
-      }
-
-      StructVal *newStructInstance = new StructVal(structVal->structName, false);
-
-      for (const auto &field : structVal->fields) {
-        newStructInstance->addField(field.first, field.second);
-      }
+    Value caller = unwrap(Interpreter::evaluate(expr->caller, env));
+    return Interpreter::call_value(caller, frame, argCount, env);
+  }
+  catch (const InterpreterError& e) {
+    throw;
+  }
+}
 
-      auto it = newStructInstance->fields.begin();
-      for (const auto &arg : args) {
-        if (it != newStructInstance->fields.end()) {
-          it->second = arg;
-          ++it;
-        }
-      }
+Value Interpreter::call_value(Value caller, StackFrame &frame, size_t argCount,
+                              Environment *env) {
+  try {
+    GcRoot callerRoot(caller);
+    Value *args = frame.slots();
 
-      return newStructInstance;
+    if (caller.type() == ValueType::StructValue) {
+      StructVal *structVal = caller.as<StructVal>();
+      return Value(
+          structVal->instantiate(std::vector<Value>(args, args + argCount)));
     }
 
-    if (caller->type == ValueType::NativeFunction) {
-      NativeFnVal *nativeFn = dynamic_cast<NativeFnVal *>(caller);
-      return nativeFn->call(args, env);
+    if (caller.type() == ValueType::NativeFunction) {
+      NativeFnVal *nativeFn = caller.as<NativeFnVal>();
+      return nativeFn->call(std::vector<Value>(args, args + argCount), env);
     }
 
-    if (caller->type == ValueType::Function) {
-      FnVal *func = dynamic_cast<FnVal *>(caller);
-      Environment *functionEnv = new Environment(env);
+    if (caller.type() == ValueType::Function) {
+      FnVal *func = caller.as<FnVal>();
+      Memo::Key key;
+      bool memoized = func->memoized != nullptr &&
+                      Memo::makeKey(func->memoized, args, argCount, key);
+      Value result;
+      if (memoized && Memo::lookup(key, result)) {
+        return result;
+      }
 
-      for (size_t i = 0; i < func->parameters.size(); ++i) {
-        if (i < args.size()) {
-          functionEnv->declareVar(func->parameters[i], args[i], false);
+      result = call_function(func, frame, argCount, env);
+      if (result.raw() == tailCallMarker().raw()) {
+        // The function returned a tail call, which reuses its frame window.
+        // Its callee runs in the environment of the first call, the one of
+        // the finished function is never looked into again.
+        while (result.raw() == tailCallMarker().raw()) {
+          caller = pendingCallee;
+          argCount = pendingArgs.size();
+          frame.reset(argCount);
+          std::copy(pendingArgs.begin(), pendingArgs.end(), frame.slots());
+          result = call_function(caller.as<FnVal>(), frame, argCount, env);
         }
-      }
-      RuntimeVal *result = new NullVal;
 
-      for (Stmt *stmt : func->body) {
-        result = Interpreter::evaluate(stmt, functionEnv);
-        if (result->type == ValueType::ReturnValue) {
-          return result;
-          delete functionEnv;
+        // What the nested returns would have given, wrapped once.
+        if (result.type() != ValueType::ReturnValue) {
+          result = Value(new ReturnValue(result));
         }
       }
 
-      delete functionEnv;
+      if (memoized) {
+        Memo::store(key, result);
+      }
       return result;
     }
 
@@ -102,49 +120,103 @@ RuntimeVal *Interpreter::eval_call_expr(CallExpr *expr, Environment *env) {
   }
 }
 
-RuntimeVal *Interpreter::eval_member_access(MemberAccessExpr *memberAccess,
-                                            Environment *env) {
+Value Interpreter::call_function(FnVal *func, StackFrame &frame,
+                                 size_t argCount, Environment *env) {
+  Value *args = frame.slots();
+  size_t parameterCount = func->parameters.size();
+  size_t passed = std::min(argCount, parameterCount);
+
+  for (size_t i = 0; i < passed; ++i) {
+    if (Environment::isBuiltin(func->parameters[i])) {
+      throw InterpreterError("Cannot declare variable " +
+                             SymbolTable::name(func->parameters[i]) +
+                             ". It is already defined.");
+    }
+  }
+
+  if (func->slotNames.empty()) {
+    Environment functionEnv(env);
+    for (size_t i = 0; i < passed; ++i) {
+      functionEnv.declareVar(func->parameters[i], args[i], false);
+    }
+    return eval_function_body(func, &functionEnv);
+  }
+
+  // Parameters are the first slots and already hold their arguments.
+  // Extra arguments sit where the locals go and are cleared.
+  frame.extend(func->slotNames.size());
+  for (size_t i = passed; i < argCount; ++i) {
+    args[i] = Value();
+  }
+
+  Environment functionEnv(env, func->slotNames, args);
+  return eval_function_body(func, &functionEnv);
+}
+
+Value Interpreter::eval_function_body(FnVal *func, Environment *env) {
+  if (func->closure != nullptr) {
+    return func->closure->run(env);
+  }
+
+  Value result = Value::null();
+
+  for (Stmt *stmt : func->body) {
+    Heap::safepoint();
+    result = Interpreter::evaluate(stmt, env);
+    if (returned(stmt, result)) {
+      return result;
+    }
+  }
+
+  return result;
+}
+
+Value Interpreter::eval_member_access(MemberAccessExpr *memberAccess,
+                                      Environment *env) {
   try {
-    RuntimeVal *object = evaluate(memberAccess->object.get(), env);
+    Value object = unwrap(evaluate(memberAccess->object, env));
 
-    if (object->type != ValueType::StructValue) {
+    if (object.type() != ValueType::StructValue) {
       throw InterpreterError("Error: Member access is only supported for structs.");
     }
 
-    StructVal *structVal = dynamic_cast<StructVal *>(object);
-    return structVal->getField(memberAccess->memberName);
+    StructVal *structVal = object.as<StructVal>();
+    return structVal->getField(memberAccess->memberName, memberAccess->cache);
   }
   catch (const InterpreterError& e) {
     throw;
   }
 }
 
-RuntimeVal* Interpreter::eval_logical_expr(LogicalExpr* logicalExpr, Environment* env) {
+Value Interpreter::eval_logical_expr(LogicalExpr* logicalExpr, Environment* env) {
   try {
-    RuntimeVal* left = evaluate(logicalExpr->left.get(), env);
-    RuntimeVal* right = evaluate(logicalExpr->right.get(), env);
-
-    if (left->type == ValueType::ReturnValue) {
-        left = dynamic_cast<ReturnValue*>(left)->value;
+    if (logicalExpr->left->numeric && logicalExpr->right->numeric) {
+      return Value(eval_number(logicalExpr, env));
     }
 
-    if (right->type == ValueType::ReturnValue) {
-        right = dynamic_cast<ReturnValue*>(right)->value;
+    Value left = evaluate(logicalExpr->left, env);
+    GcRoot leftRoot(left);
+    Value right = evaluate(logicalExpr->right, env);
+
+    if (left.type() == ValueType::ReturnValue) {
+        left = left.as<ReturnValue>()->value;
     }
 
-    if (left->type == ValueType::NumberValue && right->type == ValueType::NumberValue) {
-        NumberVal* leftBool = dynamic_cast<NumberVal*>(left);
-        NumberVal* rightBool = dynamic_cast<NumberVal*>(right);
+    if (right.type() == ValueType::ReturnValue) {
+        right = right.as<ReturnValue>()->value;
+    }
 
-        NumberVal left = (*leftBool);
-        NumberVal right = (*rightBool);
+    if (left.isNumber() && right.isNumber()) {
+        double leftBool = left.asNumber();
+        double rightBool = right.asNumber();
 
-        if (logicalExpr->logicalOperator == "&&") {
-            return left && right;
-        } else if (logicalExpr->logicalOperator == "||") {
-            return left || right;
+        if (logicalExpr->logicalOperator == Operator::And) {
+            return Value(leftBool && rightBool ? 1.0 : 0.0);
+        } else if (logicalExpr->logicalOperator == Operator::Or) {
+            return Value(leftBool || rightBool ? 1.0 : 0.0);
         } else {
-          throw InterpreterError("Invalid logical operator: " + logicalExpr->logicalOperator);
+          throw InterpreterError(std::string("Invalid logical operator: ") +
+                                 OperatorToString(logicalExpr->logicalOperator));
         }
     }
 
@@ -155,19 +227,22 @@ RuntimeVal* Interpreter::eval_logical_expr(LogicalExpr* logicalExpr, Environment
   }
 }
 
-RuntimeVal *
+Value
 Interpreter::eval_member_access_assignment(MemberAccessExpr *memberAccessExpr,
                                            Expr *valueExpr, Environment *env) {
   try {
-    RuntimeVal *object = evaluate(memberAccessExpr->object.get(), env);
-    if (object->type != ValueType::StructValue) {
+    Value object = unwrap(evaluate(memberAccessExpr->object, env));
+    GcRoot objectRoot(object);
+    if (object.type() != ValueType::StructValue) {
       throw InterpreterError("Error: Member access is only supported for structs.");
     }
-    StructVal *structVal = dynamic_cast<StructVal *>(object);
 
-    RuntimeVal *value = evaluate(valueExpr, env);
+    Value value = unwrap(evaluate(valueExpr, env));
 
-    structVal->setField(memberAccessExpr->memberName, value);
+    // Read after the value, evaluating it may have moved the struct.
+    StructVal *structVal = object.as<StructVal>();
+    structVal->setField(memberAccessExpr->memberName, value,
+                        memberAccessExpr->cache);
 
     return value;
   }
@@ -176,92 +251,165 @@ Interpreter::eval_member_access_assignment(MemberAccessExpr *memberAccessExpr,
   }
 }
 
-RuntimeVal *Interpreter::eval_unary_expr(UnaryExpr *expr, Environment *env) {
+Value Interpreter::eval_unary_expr(UnaryExpr *expr, Environment *env) {
   try {
-    RuntimeVal *rightValue = Interpreter::evaluate(expr->right.get(), env);
+    if (expr->right->numeric) {
+      return Value(eval_number(expr, env));
+    }
+
+    Value rightValue = unwrap(Interpreter::evaluate(expr->right, env));
 
-    if (expr->op == "!") {
-      if (rightValue->type == ValueType::NumberValue) {
-        NumberVal *number = dynamic_cast<NumberVal *>(rightValue);
-        return new NumberVal(!number->value);
+    if (expr->op == Operator::Not) {
+      if (rightValue.isNumber()) {
+        return Value(rightValue.asNumber() == 0 ? 1.0 : 0.0);
       }
     }
 
-    if (expr->op == "-") {
-      if (rightValue->type == ValueType::NumberValue) {
-        NumberVal *number = dynamic_cast<NumberVal *>(rightValue);
-        return new NumberVal(-number->value);
+    if (expr->op == Operator::Negate) {
+      if (rightValue.isNumber()) {
+        return Value(-rightValue.asNumber());
       }
     }
 
-    throw InterpreterError("Unsupported unary operator: " + expr->op);
+    throw InterpreterError(std::string("Unsupported unary operator: ") +
+                           OperatorToString(expr->op));
   }
   catch (const InterpreterError& e) {
     throw;
   }
 }
 
-RuntimeVal *Interpreter::eval_binary_expr(BinaryExpr *binop, Environment *env) {
+Value Interpreter::eval_binary_expr(BinaryExpr *binop, Environment *env) {
   try {
-    RuntimeVal *lhs = Interpreter::evaluate(binop->left.get(), env);
-    RuntimeVal *rhs = Interpreter::evaluate(binop->right.get(), env);
-
+    if (binop->numeric) {
+      return Value(eval_number(binop, env));
+    }
 
-    RuntimeVal* result = new NullVal();
+    Value lhs = Interpreter::evaluate(binop->left, env);
 
-    if (lhs->type == ValueType::ReturnValue) {
-      lhs = dynamic_cast<ReturnValue *>(lhs)->value;
+    if (binop->specialization == Specialization::Numbers) {
+      // A number needs no root, the right operand is evaluated right away.
+      if (lhs.isNumber()) {
+        Value rhs = Interpreter::evaluate(binop->right, env);
+        if (rhs.isNumber()) {
+          return binary_operation(binop->binaryOperator, lhs.asNumber(),
+                                  rhs.asNumber());
+        }
+        binop->specialization = Specialization::Generic;
+        counters.deoptimized++;
+        return eval_generic_binary(binop, lhs, rhs);
+      }
+      binop->specialization = Specialization::Generic;
+      counters.deoptimized++;
     }
 
-    if (rhs->type == ValueType::ReturnValue) {
-      rhs = dynamic_cast<ReturnValue *>(rhs)->value;
-    }
+    GcRoot lhsRoot(lhs);
+    Value rhs = Interpreter::evaluate(binop->right, env);
 
-    if (lhs->type == ValueType::NumberValue &&
-        rhs->type == ValueType::NumberValue) {
-        NumberVal* leftNumber = dynamic_cast<NumberVal*>(lhs);
-        NumberVal* rightNumber = dynamic_cast<NumberVal*>(rhs);
-
-        NumberVal left = (*leftNumber);
-        NumberVal right = (*rightNumber);
-
-         
-      if (binop->binaryOperator == "+") {
-          result = left + right;
-      } else if (binop->binaryOperator == "-") {
-          result = left - right;
-      } else if (binop->binaryOperator == "*") {
-          result = left * right;
-      } else if (binop->binaryOperator == ">") {
-          result = left > right;
-      } else if (binop->binaryOperator == "<") {
-          result = left < right;
-      } else if (binop->binaryOperator == "<=") {
-          result = left <= right;
-      } else if (binop->binaryOperator == ">=") {
-          result = left >= right;
-      } else if (binop->binaryOperator == "==") {
-          result = left == right;
-      } else if (binop->binaryOperator == "!=") {
-          result = left != right;
-      } else if (binop->binaryOperator == "/") {
-        if (rightNumber->value != 0) {
-          result = left / right;
-        } else {
-          throw InterpreterError("Division by zero error");
-        }
-      } else if (binop->binaryOperator == "%") {
-        if (rightNumber->value != 0) {
-          result = left % right;
-        } else {
-          throw InterpreterError("Modulo by zero error");
-        }
+    if (binop->specialization == Specialization::Uninitialized) {
+      if (lhs.isNumber() && rhs.isNumber()) {
+        binop->specialization = Specialization::Numbers;
+        counters.specialized++;
+      } else {
+        binop->specialization = Specialization::Generic;
       }
+    }
 
-    } 
-    return result;
+    return eval_generic_binary(binop, lhs, rhs);
   }
   catch (const InterpreterError& e) {
     throw;
   }
 }
+
+double Interpreter::eval_number(Expr *expr, Environment *env) {
+  switch (expr->kind) {
+  case NodeType::NumericLiteral:
+    return static_cast<NumericLiteral *>(expr)->value;
+  case NodeType::Identifier:
+    return eval_identifer(static_cast<IdentifierExpr *>(expr), env).asNumber();
+  case NodeType::BinaryExpr: {
+    // Both operands of a numeric BinaryExpr are numeric.
+    auto binop = static_cast<BinaryExpr *>(expr);
+    double left = eval_number(binop->left, env);
+    double right = eval_number(binop->right, env);
+    return binary_operation(binop->binaryOperator, left, right).asNumber();
+  }
+  case NodeType::UnaryExpr: {
+    auto unary = static_cast<UnaryExpr *>(expr);
+    if (!unary->right->numeric) {
+      break;
+    }
+    double operand = eval_number(unary->right, env);
+    return unary->op == Operator::Not ? (operand == 0 ? 1.0 : 0.0) : -operand;
+  }
+  case NodeType::LogicalExpr: {
+    auto logical = static_cast<LogicalExpr *>(expr);
+    if (!logical->left->numeric || !logical->right->numeric) {
+      break;
+    }
+    double left = eval_number(logical->left, env);
+    double right = eval_number(logical->right, env);
+    if (logical->logicalOperator == Operator::And) {
+      return left && right ? 1.0 : 0.0;
+    }
+    return left || right ? 1.0 : 0.0;
+  }
+  default:
+    break;
+  }
+  return evaluate(expr, env).asNumber();
+}
+
+Value Interpreter::eval_generic_binary(BinaryExpr *binop, Value lhs,
+                                       Value rhs) {
+  if (lhs.type() == ValueType::ReturnValue) {
+    lhs = lhs.as<ReturnValue>()->value;
+  }
+
+  if (rhs.type() == ValueType::ReturnValue) {
+    rhs = rhs.as<ReturnValue>()->value;
+  }
+
+  if (!lhs.isNumber() || !rhs.isNumber()) {
+    return Value::null();
+  }
+
+  return binary_operation(binop->binaryOperator, lhs.asNumber(),
+                          rhs.asNumber());
+}
+
+Value Interpreter::binary_operation(Operator op, double left, double right) {
+  switch (op) {
+  case Operator::Add:
+    return Value(left + right);
+  case Operator::Subtract:
+    return Value(left - right);
+  case Operator::Multiply:
+    return Value(left * right);
+  case Operator::Greater:
+    return Value(left > right ? 1.0 : 0.0);
+  case Operator::Less:
+    return Value(left < right ? 1.0 : 0.0);
+  case Operator::LessEqual:
+    return Value(left <= right ? 1.0 : 0.0);
+  case Operator::GreaterEqual:
+    return Value(left >= right ? 1.0 : 0.0);
+  case Operator::Equal:
+    return Value(left == right ? 1.0 : 0.0);
+  case Operator::NotEqual:
+    return Value(left != right ? 1.0 : 0.0);
+  case Operator::Divide:
+    if (right == 0) {
+      throw InterpreterError("Division by zero error");
+    }
+    return Value(left / right);
+  case Operator::Modulo:
+    if (right == 0) {
+      throw InterpreterError("Modulo by zero error");
+    }
+    return Value(fmod(left, right));
+  default:
+    return Value::null();
+  }
+}
@@ -1,10 +1,14 @@
 #include "Interpreter.h"
 
-RuntimeVal *Interpreter::eval_program(Program *program, Environment *env) {
+Value Interpreter::eval_program(Program *program, Environment *env) {
   try {
-    RuntimeVal *lastEvaluated = new NullVal;
-    for (std::unique_ptr<Stmt> &statement : program->body) {
-      lastEvaluated = Interpreter::evaluate(statement.get(), env);
+    Value lastEvaluated = Value::null();
+    if (!program->slotNames.empty()) {
+      env->bindSlots(program->slotNames);
+    }
+    for (Stmt *statement : program->body) {
+      Heap::safepoint();
+      lastEvaluated = Interpreter::evaluate(statement, env);
     }
     return lastEvaluated;
     }
@@ -13,14 +17,19 @@ RuntimeVal *Interpreter::eval_program(Program *program, Environment *env) {
   }
 }
 
-RuntimeVal *Interpreter::eval_return_statement(ReturnStatement *stmt,
-                                               Environment *env) {
+Value Interpreter::eval_return_statement(ReturnStatement *stmt,
+                                         Environment *env) {
   try {
     if (stmt->returnValue) {
-      RuntimeVal *result = Interpreter::evaluate(stmt->returnValue.get(), env);
-      return new ReturnValue(result);
+      if (stmt->returnValue->kind == NodeType::CallExpr &&
+          static_cast<CallExpr *>(stmt->returnValue)->tailCall) {
+        return eval_tail_call(static_cast<CallExpr *>(stmt->returnValue),
+                              env);
+      }
+      Value result = Interpreter::evaluate(stmt->returnValue, env);
+      return Value(new ReturnValue(result));
     } else {
-      return new NullVal;
+      return Value::null();
     }
   }
   catch (const InterpreterError& e) {
@@ -28,15 +37,47 @@ RuntimeVal *Interpreter::eval_return_statement(ReturnStatement *stmt,
   }
 }
 
-RuntimeVal *
-Interpreter::eval_stmt_vector(const std::vector<std::unique_ptr<Stmt>> &stmts,
-                              Environment *env) {
+Value Interpreter::eval_tail_call(CallExpr *call, Environment *env) {
+  size_t argCount = call->args.size();
+  StackFrame frame(argCount);
+  Value *args = frame.slots();
+
+  for (size_t i = 0; i < argCount; ++i) {
+    args[i] = unwrap(Interpreter::evaluate(call->args[i], env));
+  }
+
+  Value caller = unwrap(Interpreter::evaluate(call->caller, env));
+  return tail_call(caller, frame, argCount, env);
+}
+
+Value Interpreter::tail_call(Value caller, StackFrame &frame, size_t argCount,
+                             Environment *env) {
+  if (caller.type() == ValueType::Function &&
+      argCount >= caller.as<FnVal>()->parameters.size()) {
+    pendingCallee = caller;
+    pendingArgs.assign(frame.slots(), frame.slots() + argCount);
+    return tailCallMarker();
+  }
+
+  Value result = call_value(caller, frame, argCount, env);
+  return Value(new ReturnValue(result));
+}
+
+Value Interpreter::tailCallMarker() {
+  static Value marker =
+      Value(new (Generation::Permanent) ReturnValue(Value::null()));
+  return marker;
+}
+
+Value Interpreter::eval_stmt_vector(const NodeList<Stmt> &stmts,
+                                    Environment *env) {
   try {
-    RuntimeVal *result = nullptr;
+    Value result;
 
-    for (auto &stmt : stmts) {
-      result = Interpreter::evaluate(stmt.get(), env);
-      if (result->type == ValueType::ReturnValue) {
+    for (Stmt *stmt : stmts) {
+      Heap::safepoint();
+      result = Interpreter::evaluate(stmt, env);
+      if (returned(stmt, result)) {
         return result;
       }
     }
@@ -48,16 +89,36 @@ Interpreter::eval_stmt_vector(const std::vector<std::unique_ptr<Stmt>> &stmts,
   }
 }
 
-RuntimeVal *Interpreter::eval_if_statement(IfStatement *ifStmt,
-                                           Environment *env) {
-  try {
-    RuntimeVal *conditionValue =
-        Interpreter::evaluate(ifStmt->condition.get(), env);
+bool Interpreter::returned(const Stmt *stmt, Value &result) {
+  if (result.type() != ValueType::ReturnValue) {
+    return false;
+  }
 
-    if (conditionValue->type == ValueType::NumberValue) {
-      NumberVal *numCondition = dynamic_cast<NumberVal *>(conditionValue);
+  switch (stmt->kind) {
+  case NodeType::ReturnStatement:
+  case NodeType::IfStatement:
+  case NodeType::WhileLoop:
+    return true;
+  default:
+    result = result.as<ReturnValue>()->value;
+    return false;
+  }
+}
 
-      if (numCondition->value != 0) {
+Value Interpreter::unwrap(Value value) {
+  if (value.type() == ValueType::ReturnValue) {
+    return value.as<ReturnValue>()->value;
+  }
+  return value;
+}
+
+Value Interpreter::eval_if_statement(IfStatement *ifStmt, Environment *env) {
+  try {
+    Value conditionValue =
+        unwrap(Interpreter::evaluate(ifStmt->condition, env));
+
+    if (conditionValue.isNumber()) {
+      if (conditionValue.asNumber() != 0) {
         return Interpreter::eval_stmt_vector(ifStmt->ifBody, env);
       } else if (ifStmt->elseBody.size() > 0) {
         return Interpreter::eval_stmt_vector(ifStmt->elseBody, env);
@@ -66,37 +127,41 @@ RuntimeVal *Interpreter::eval_if_statement(IfStatement *ifStmt,
       throw InterpreterError("If statement condition must evaluate to a numeric value.");
     }
 
-    return new NullVal;
+    return Value::null();
   }
   catch (const InterpreterError& e) {
     throw;
   }
 }
 
-RuntimeVal *Interpreter::eval_while_statement(WhileLoop *loop,
-                                              Environment *env) {
+Value Interpreter::eval_while_statement(WhileLoop *loop, Environment *env) {
   try {
-    RuntimeVal *result = new NullVal;
+    if (loop->counted != nullptr) {
+      Value *counter = env->variableSlot(loop->counted->slot);
+      Value bound = unwrap(Interpreter::evaluate(loop->counted->bound, env));
+      if (counter != nullptr && counter->isNumber() && bound.isNumber()) {
+        return eval_counted_loop(loop, counter, bound.asNumber(), env);
+      }
+    }
+
+    Value result = Value::null();
+    GcRoot resultRoot(result);
 
     bool conditionMet = true;
 
     while (conditionMet) {
-      RuntimeVal *conditionValue =
-          Interpreter::evaluate(loop->condition.get(), env);
-
-      if (conditionValue->type == ValueType::NumberValue) {
-        NumberVal *numCondition = dynamic_cast<NumberVal *>(conditionValue);
+      Value conditionValue =
+          unwrap(Interpreter::evaluate(loop->condition, env));
 
-        if (numCondition->value == 1) {
-          RuntimeVal *loopResult =
+      if (conditionValue.isNumber()) {
+        if (conditionValue.asNumber() == 1) {
+          Value loopResult =
               Interpreter::eval_stmt_vector(loop->loopBody, env);
 
-          if (loopResult->type == ValueType::ReturnValue) {
-            delete result;
+          if (loopResult.type() == ValueType::ReturnValue) {
             return loopResult;
           }
 
-          delete result;
           result = loopResult;
 
         } else {
@@ -113,10 +178,57 @@ RuntimeVal *Interpreter::eval_while_statement(WhileLoop *loop,
   }
 }
 
-RuntimeVal *Interpreter::eval_var_declaration(VarDeclaration *declaration,
-                                              Environment *env) {
+Value Interpreter::eval_counted_loop(WhileLoop *loop, Value *counter,
+                                     double bound, Environment *env) {
+  const CountedLoop &counted = *loop->counted;
+  // Every statement of the body but the increment.
+  NodeList<Stmt> body(loop->loopBody.begin(), loop->loopBody.size() - 1);
+  double value = counter->asNumber();
+  bool ran = false;
+
+  while (counted_condition(counted.comparison, value, bound)) {
+    Value bodyResult = Interpreter::eval_stmt_vector(body, env);
+    if (bodyResult.type() == ValueType::ReturnValue) {
+      *counter = Value(value);
+      return bodyResult;
+    }
+
+    value += counted.step;
+    if (counted.counterRead) {
+      *counter = Value(value);
+    }
+    ran = true;
+  }
+
+  // The value of a loop is the one of the last statement it ran, the
+  // increment.
+  *counter = Value(value);
+  return ran ? Value(value) : Value::null();
+}
+
+bool Interpreter::counted_condition(Operator op, double counter,
+                                    double bound) {
+  switch (op) {
+  case Operator::Less:
+    return counter < bound;
+  case Operator::LessEqual:
+    return counter <= bound;
+  case Operator::Greater:
+    return counter > bound;
+  case Operator::GreaterEqual:
+    return counter >= bound;
+  default:
+    return counter != bound;
+  }
+}
+
+Value Interpreter::eval_var_declaration(VarDeclaration *declaration,
+                                        Environment *env) {
   try {
-    RuntimeVal *value = Interpreter::evaluate(declaration->value.get(), env);
+    Value value = unwrap(Interpreter::evaluate(declaration->value, env));
+    if (declaration->slot >= 0) {
+      return env->declareSlot(declaration->slot, value, declaration->constant);
+    }
     return env->declareVar(declaration->identifier, value, declaration->constant);
   }
   catch (const InterpreterError& e) {
@@ -124,19 +236,24 @@ RuntimeVal *Interpreter::eval_var_declaration(VarDeclaration *declaration,
   }
 }
 
-RuntimeVal *Interpreter::eval_struct_declaration(StructDeclaration *structDecl,
-                                                 Environment *env) {
+Value Interpreter::eval_struct_declaration(StructDeclaration *structDecl,
+                                           Environment *env) {
   try {
-    StructVal *structVal = new StructVal(structDecl->structName, true);
+    Value structVal =
+        Value(new StructVal(SymbolTable::name(structDecl->structName), true));
+    GcRoot structRoot(structVal);
 
     for (const auto &stmt : structDecl->structBody) {
       if (stmt->kind == NodeType::VarDeclaration) {
-        auto fieldDecl = dynamic_cast<VarDeclaration *>(stmt.get());
-        structVal->addField(fieldDecl->identifier,
-                            Interpreter::evaluate(fieldDecl->value.get(), env));
+        auto fieldDecl = static_cast<VarDeclaration *>(stmt);
+        Value fieldValue = unwrap(Interpreter::evaluate(fieldDecl->value, env));
+        structVal.as<StructVal>()->addField(fieldDecl->identifier, fieldValue);
       }
     }
 
+    if (structDecl->slot >= 0) {
+      return env->declareSlot(structDecl->slot, structVal, true);
+    }
     return env->declareVar(structDecl->structName, structVal, true);
   }
   catch (const InterpreterError& e) {
@@ -144,13 +261,19 @@ RuntimeVal *Interpreter::eval_struct_declaration(StructDeclaration *structDecl,
   }
 }
 
-RuntimeVal *
+Value
 Interpreter::eval_function_declaration(FunctionDeclaration *declaration,
                                        Environment *env) {
   try {
     FnVal *fn = new FnVal(declaration->name, declaration->parameters, env,
-                          declaration->body);
-    return env->declareVar(declaration->name, fn, true);
+                          declaration->body, nullptr, declaration->slotNames);
+    if (declaration->memoizable) {
+      fn->memoized = declaration;
+    }
+    if (declaration->slot >= 0) {
+      return env->declareSlot(declaration->slot, Value(fn), true);
+    }
+    return env->declareVar(declaration->name, Value(fn), true);
   }
   catch (const InterpreterError& e) {
     throw;
@@ -0,0 +1,448 @@
+#include "Jit.h"
+#include "../gc/Heap.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+bool Jit::active = false;
+uint32_t Jit::threshold = Jit::DEFAULT_THRESHOLD;
+
+#if defined(__x86_64__) && defined(__linux__)
+#define RUSTEDC_JIT_X86_64
+#endif
+
+bool Jit::supported() {
+#ifdef RUSTEDC_JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Jit::enable(uint32_t hotness) {
+  active = supported() && hotness > 0;
+  threshold = hotness;
+}
+
+void Jit::disable() { active = false; }
+
+#ifdef RUSTEDC_JIT_X86_64
+
+namespace {
+
+// Registers the templates rely on, set up by the prologue:
+//
+//   rbx   registers of the frame
+//   r12   Value::EMPTY, which is also the mask of the tag bits
+//   r13   address of the collection flag of the Heap
+//   xmm6  0.0
+//   xmm7  1.0
+//
+// rax, rcx, rdx and xmm0 to xmm2 are scratch. The code never calls out, so
+// nothing else has to survive and the stack is left alone.
+enum Xmm : uint8_t { XMM0 = 0, XMM1 = 1, XMM2 = 2, XMM6 = 6, XMM7 = 7 };
+
+// Predicates of cmpsd.
+enum Predicate : uint8_t { EQ = 0, LT = 1, LE = 2, NEQ = 4 };
+
+const uint64_t EMPTY_BITS = Value().raw();
+
+uint64_t numberBits(double number) {
+  uint64_t bits;
+  std::memcpy(&bits, &number, sizeof(bits));
+  return bits;
+}
+
+// Emits the templates of one FunctionProto. Every instruction that cannot be
+// finished in machine code jumps to an exit of its own, which returns its
+// index to the VM.
+class Assembler {
+public:
+  explicit Assembler(const FunctionProto &proto) : proto(proto) {}
+
+  std::unique_ptr<NativeCode> assemble() {
+    prologue();
+
+    for (uint32_t i = 0; i < proto.code.size(); i++) {
+      entries.push_back(static_cast<uint32_t>(code.size()));
+      instruction(i, proto.code[i]);
+    }
+
+    for (const Patch &patch : jumps) {
+      bind(patch.at, entries[patch.target]);
+    }
+    for (const Patch &patch : exits) {
+      bind(patch.at, exitStub(patch.target));
+    }
+
+    size_t size = 0;
+    void *memory = NativeCode::allocate(code, size);
+    if (memory == nullptr) {
+      return nullptr;
+    }
+    return std::unique_ptr<NativeCode>(
+        new NativeCode(memory, size, std::move(entries)));
+  }
+
+private:
+  // A rel32 at offset at that must reach instruction target, or its exit.
+  struct Patch {
+    size_t at;
+    uint32_t target;
+  };
+
+  void instruction(uint32_t index, const Instruction &ins) {
+    // A superinstruction is assembled as the one it stands in for, the
+    // instructions after it are assembled anyway.
+    switch (unfused(ins.op)) {
+    case Opcode::LoadConst:
+      loadConstant(ins.b);
+      storeRax(ins.a);
+      break;
+    case Opcode::Move:
+      loadRax(ins.b);
+      storeRax(ins.a);
+      break;
+    case Opcode::GetLocal:
+      // An undeclared local is looked up by name in the callers.
+      loadRax(ins.b);
+      compareRaxWithEmpty();
+      jumpToExit(0x84, index);
+      storeRax(ins.a);
+      break;
+    case Opcode::SetLocal:
+    case Opcode::DeclareLocal:
+      loadRax(ins.a);
+      compareRaxWithEmpty();
+      jumpToExit(ins.op == Opcode::SetLocal ? 0x84 : 0x85, index);
+      loadRax(ins.b);
+      storeRax(ins.a);
+      break;
+    case Opcode::Add:
+      arithmetic(index, ins, 0x58);
+      break;
+    case Opcode::Subtract:
+      arithmetic(index, ins, 0x5C);
+      break;
+    case Opcode::Multiply:
+      arithmetic(index, ins, 0x59);
+      break;
+    case Opcode::Divide:
+      loadNumbers(index, ins.b, ins.c);
+      // The VM throws for a zero divisor.
+      exitIfZero(index, XMM1);
+      emit({0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+      storeXmm(XMM0, ins.a);
+      break;
+    case Opcode::Modulo:
+      modulo(index, ins);
+      break;
+    case Opcode::Less:
+      comparison(index, ins.b, ins.c, LT, ins.a);
+      break;
+    case Opcode::LessEqual:
+      comparison(index, ins.b, ins.c, LE, ins.a);
+      break;
+    case Opcode::Greater:
+      comparison(index, ins.c, ins.b, LT, ins.a);
+      break;
+    case Opcode::GreaterEqual:
+      comparison(index, ins.c, ins.b, LE, ins.a);
+      break;
+    case Opcode::Equal:
+      comparison(index, ins.b, ins.c, EQ, ins.a);
+      break;
+    case Opcode::NotEqual:
+      comparison(index, ins.b, ins.c, NEQ, ins.a);
+      break;
+    case Opcode::And:
+    case Opcode::Or:
+      // Any number but 0, NaN included, counts as true.
+      loadNumbers(index, ins.b, ins.c);
+      compare(XMM0, XMM6, NEQ);
+      compare(XMM1, XMM6, NEQ);
+      // andpd / orpd xmm0, xmm1
+      emit({0x66, 0x0F,
+            static_cast<uint8_t>(ins.op == Opcode::And ? 0x54 : 0x56), 0xC1});
+      emit({0x66, 0x0F, 0x54, 0xC7}); // andpd xmm0, xmm7
+      storeXmm(XMM0, ins.a);
+      break;
+    case Opcode::Not:
+      loadNumber(index, XMM0, ins.b);
+      compare(XMM0, XMM6, EQ);
+      emit({0x66, 0x0F, 0x54, 0xC7}); // andpd xmm0, xmm7
+      storeXmm(XMM0, ins.a);
+      break;
+    case Opcode::Negate:
+      loadNumber(index, XMM0, ins.b);
+      emit({0x48, 0x0F, 0xBA, 0xF8, 0x3F}); // btc rax, 63
+      storeRax(ins.a);
+      break;
+    case Opcode::Jump:
+      if (ins.b <= index) {
+        // Loops give the VM a chance to collect, like its own Jump does.
+        emit({0x41, 0x80, 0x7D, 0x00, 0x00}); // cmp byte [r13], 0
+        jumpToExit(0x85, index);
+      }
+      emit({0xE9});
+      jumps.push_back({code.size(), ins.b});
+      emit32(0);
+      break;
+    case Opcode::JumpIfFalse:
+      loadNumber(index, XMM0, ins.a);
+      emit({0x66, 0x0F, 0x2E, 0xC6}); // ucomisd xmm0, xmm6
+      emit({0x7A, 0x06});             // jp over the je, NaN is not 0
+      jumpTo(0x84, ins.b);
+      break;
+    case Opcode::JumpUnlessOne:
+      loadNumber(index, XMM0, ins.a);
+      emit({0x66, 0x0F, 0x2E, 0xC7}); // ucomisd xmm0, xmm7
+      jumpTo(0x8A, ins.b);
+      jumpTo(0x85, ins.b);
+      break;
+    default:
+      // Calls, returns and names of callers or globals are the VM's.
+      exitNow(index);
+      break;
+    }
+  }
+
+  void arithmetic(uint32_t index, const Instruction &ins, uint8_t opcode) {
+    loadNumbers(index, ins.b, ins.c);
+    emit({0xF2, 0x0F, opcode, 0xC1}); // addsd / subsd / mulsd xmm0, xmm1
+    storeXmm(XMM0, ins.a);
+  }
+
+  void comparison(uint32_t index, uint32_t lhs, uint32_t rhs,
+                  Predicate predicate, uint32_t dst) {
+    loadNumbers(index, lhs, rhs);
+    compare(XMM0, XMM1, predicate);
+    // The all ones mask of a true comparison becomes 1.0.
+    emit({0x66, 0x0F, 0x54, 0xC7}); // andpd xmm0, xmm7
+    storeXmm(XMM0, dst);
+  }
+
+  // Integer remainder of a whole dividend that is not negative, the case the
+  // VM computes with integers too. Everything else is left to its fmod.
+  void modulo(uint32_t index, const Instruction &ins) {
+    loadNumbers(index, ins.b, ins.c);
+    exitIfZero(index, XMM1);
+    emit({0xF2, 0x48, 0x0F, 0x2C, 0xC0}); // cvttsd2si rax, xmm0
+    emit({0xF2, 0x48, 0x0F, 0x2A, 0xD0}); // cvtsi2sd xmm2, rax
+    emit({0x66, 0x0F, 0x2E, 0xD0});       // ucomisd xmm2, xmm0
+    jumpToExit(0x85, index);
+    jumpToExit(0x8A, index);
+    emit({0x48, 0x85, 0xC0}); // test rax, rax
+    jumpToExit(0x88, index);  // js
+    emit({0xF2, 0x48, 0x0F, 0x2C, 0xC9}); // cvttsd2si rcx, xmm1
+    emit({0xF2, 0x48, 0x0F, 0x2A, 0xD1}); // cvtsi2sd xmm2, rcx
+    emit({0x66, 0x0F, 0x2E, 0xD1});       // ucomisd xmm2, xmm1
+    jumpToExit(0x85, index);
+    jumpToExit(0x8A, index);
+    emit({0x48, 0x99});                   // cqo
+    emit({0x48, 0xF7, 0xF9});             // idiv rcx
+    emit({0xF2, 0x48, 0x0F, 0x2A, 0xC2}); // cvtsi2sd xmm0, rdx
+    storeXmm(XMM0, ins.a);
+  }
+
+  void prologue() {
+    emit({0x53, 0x41, 0x54, 0x41, 0x55}); // push rbx, r12, r13
+    emit({0x48, 0x89, 0xFB});             // mov rbx, rdi
+    emit({0x49, 0xBC});                   // mov r12, EMPTY
+    emit64(EMPTY_BITS);
+    emit({0x49, 0xBD}); // mov r13, flag
+    emit64(reinterpret_cast<uint64_t>(Heap::collectionFlag()));
+    emit({0x66, 0x0F, 0x57, 0xF6}); // xorpd xmm6, xmm6
+    emit({0x48, 0xB8});             // mov rax, 1.0
+    emit64(numberBits(1.0));
+    emit({0x66, 0x48, 0x0F, 0x6E, 0xF8}); // movq xmm7, rax
+    emit({0xFF, 0xE6});                   // jmp rsi
+
+    epilogue = code.size();
+    emit({0x41, 0x5D, 0x41, 0x5C, 0x5B}); // pop r13, r12, rbx
+    emit({0xC3});                         // ret
+  }
+
+  // Loads register reg into xmm, leaving its bits in rax, and exits unless
+  // it holds a number.
+  void loadNumber(uint32_t index, Xmm xmm, uint32_t reg) {
+    loadRax(reg);
+    emit({0x48, 0x89, 0xC2}); // mov rdx, rax
+    emit({0x4C, 0x21, 0xE2}); // and rdx, r12
+    emit({0x4C, 0x39, 0xE2}); // cmp rdx, r12
+    jumpToExit(0x84, index);
+    emit({0x66, 0x48, 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (xmm << 3))});
+  }
+
+  void loadNumbers(uint32_t index, uint32_t lhs, uint32_t rhs) {
+    loadNumber(index, XMM0, lhs);
+    loadNumber(index, XMM1, rhs);
+  }
+
+  // Exits when xmm is 0 or NaN.
+  void exitIfZero(uint32_t index, Xmm xmm) {
+    emit({0x66, 0x0F, 0x2E, static_cast<uint8_t>(0xC6 | (xmm << 3))});
+    jumpToExit(0x84, index);
+  }
+
+  // cmpsd dst, src, predicate.
+  void compare(Xmm dst, Xmm src, Predicate predicate) {
+    emit({0xF2, 0x0F, 0xC2, static_cast<uint8_t>(0xC0 | (dst << 3) | src),
+          predicate});
+  }
+
+  void loadConstant(uint32_t constant) {
+    Value value = proto.constants[constant];
+    if (value.isNumber()) {
+      emit({0x48, 0xB8}); // mov rax, bits
+      emit64(value.raw());
+      return;
+    }
+    // Objects are read through the constant, which the garbage collector
+    // keeps up to date.
+    emit({0x48, 0xB8});
+    emit64(reinterpret_cast<uint64_t>(&proto.constants[constant]));
+    emit({0x48, 0x8B, 0x00}); // mov rax, [rax]
+  }
+
+  void loadRax(uint32_t reg) {
+    emit({0x48, 0x8B, 0x83}); // mov rax, [rbx + 8 * reg]
+    emit32(8 * reg);
+  }
+
+  void storeRax(uint32_t reg) {
+    emit({0x48, 0x89, 0x83}); // mov [rbx + 8 * reg], rax
+    emit32(8 * reg);
+  }
+
+  void storeXmm(Xmm xmm, uint32_t reg) {
+    emit({0xF2, 0x0F, 0x11, static_cast<uint8_t>(0x83 | (xmm << 3))});
+    emit32(8 * reg); // movsd [rbx + 8 * reg], xmm
+  }
+
+  void compareRaxWithEmpty() {
+    emit({0x4C, 0x39, 0xE0}); // cmp rax, r12
+  }
+
+  // Conditional jump (0x0F, condition) to instruction target.
+  void jumpTo(uint8_t condition, uint32_t target) {
+    emit({0x0F, condition});
+    jumps.push_back({code.size(), target});
+    emit32(0);
+  }
+
+  void jumpToExit(uint8_t condition, uint32_t index) {
+    emit({0x0F, condition});
+    exits.push_back({code.size(), index});
+    emit32(0);
+  }
+
+  void exitNow(uint32_t index) {
+    emit({0xB8}); // mov eax, index
+    emit32(index);
+    emit({0xE9}); // jmp epilogue
+    emit32(0);
+    bind(code.size() - 4, epilogue);
+  }
+
+  // Offset of the exit of instruction index, made on first use.
+  size_t exitStub(uint32_t index) {
+    auto found = stubs.find(index);
+    if (found != stubs.end()) {
+      return found->second;
+    }
+    size_t at = code.size();
+    exitNow(index);
+    stubs[index] = at;
+    return at;
+  }
+
+  void bind(size_t at, size_t target) {
+    int32_t offset = static_cast<int32_t>(target - (at + 4));
+    std::memcpy(&code[at], &offset, sizeof(offset));
+  }
+
+  void emit(std::initializer_list<uint8_t> bytes) {
+    code.insert(code.end(), bytes.begin(), bytes.end());
+  }
+
+  void emit32(uint32_t value) {
+    uint8_t bytes[4];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code.insert(code.end(), bytes, bytes + sizeof(bytes));
+  }
+
+  void emit64(uint64_t value) {
+    uint8_t bytes[8];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    code.insert(code.end(), bytes, bytes + sizeof(bytes));
+  }
+
+  const FunctionProto &proto;
+  std::vector<uint8_t> code;
+  std::vector<uint32_t> entries;
+  std::vector<Patch> jumps;
+  std::vector<Patch> exits;
+  std::map<uint32_t, size_t> stubs;
+  size_t epilogue = 0;
+};
+
+// Functions made only of these stay in machine code apart from their calls
+// and returns. Structs, globals and throwing are left to the VM for good.
+bool compilable(const FunctionProto &proto) {
+  for (const Instruction &ins : proto.code) {
+    switch (unfused(ins.op)) {
+    case Opcode::LoadConst:
+    case Opcode::Move:
+    case Opcode::GetLocal:
+    case Opcode::SetLocal:
+    case Opcode::DeclareLocal:
+    case Opcode::GetGlobal:
+    case Opcode::Add:
+    case Opcode::Subtract:
+    case Opcode::Multiply:
+    case Opcode::Divide:
+    case Opcode::Modulo:
+    case Opcode::Less:
+    case Opcode::LessEqual:
+    case Opcode::Greater:
+    case Opcode::GreaterEqual:
+    case Opcode::Equal:
+    case Opcode::NotEqual:
+    case Opcode::And:
+    case Opcode::Or:
+    case Opcode::Not:
+    case Opcode::Negate:
+    case Opcode::Jump:
+    case Opcode::JumpIfFalse:
+    case Opcode::JumpUnlessOne:
+    case Opcode::Call:
+    case Opcode::TailCall:
+    case Opcode::Return:
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+void Jit::compile(const FunctionProto &proto) {
+  if (!compilable(proto)) {
+    return;
+  }
+  // Without executable memory the function simply stays interpreted.
+  proto.native = Assembler(proto).assemble();
+}
+
+#else
+
+void Jit::compile(const FunctionProto &) {}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "../vm/Bytecode.h"
+
+#include <cstdint>
+
+// Baseline JIT of the VM for x86-64, enabled with --jit. A function whose
+// calls and loop iterations pass the threshold is translated instruction by
+// instruction into machine code from fixed templates, working on the same
+// registers as the VM.
+//
+// Only functions that stay within numbers, locals, comparisons and loops are
+// compiled; calls, returns and reading names a function does not declare are
+// left to the VM, which the code returns to with the index of the
+// instruction to run. The same happens when a guard fails: an operand that
+// is not a number, a local that is not declared yet, a division by zero or
+// a pending garbage collection on a loop back edge. The VM then runs the
+// instruction with all its checks and enters the machine code again on the
+// next call, loop back edge or return.
+class Jit {
+public:
+  static const uint32_t DEFAULT_THRESHOLD = 1000;
+
+  // Does nothing where machine code cannot be generated, see supported().
+  static void enable(uint32_t threshold = DEFAULT_THRESHOLD);
+  static void disable();
+  static bool enabled() { return active; }
+  static bool supported();
+
+  // Counts a call or a loop iteration of proto and compiles it when that
+  // makes it hot.
+  static void countUse(const FunctionProto &proto) {
+    if (++proto.hotness == threshold) {
+      compile(proto);
+    }
+  }
+
+private:
+  static void compile(const FunctionProto &proto);
+
+  static bool active;
+  static uint32_t threshold;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "NativeCode.h"
+
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+NativeCode::NativeCode(void *memory, size_t size,
+                       std::vector<uint32_t> entries)
+    : memory(memory), size(size), start(static_cast<const uint8_t *>(memory)),
+      function(reinterpret_cast<Function>(memory)),
+      entries(std::move(entries)) {}
+
+NativeCode::~NativeCode() { munmap(memory, size); }
+
+void *NativeCode::allocate(const std::vector<uint8_t> &code, size_t &size) {
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size = (code.size() + page - 1) / page * page;
+
+  // Written first and made executable after, the pages are never both.
+  void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return nullptr;
+  }
+
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return nullptr;
+  }
+  return memory;
+}
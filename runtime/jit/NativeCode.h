@@ -0,0 +1,44 @@
+#ifndef NATIVE_CODE_H
+#define NATIVE_CODE_H
+
+#include "../values/Value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Machine code of one FunctionProto, made by the Jit. It works on the
+// registers of a frame of the VM, and every instruction of the bytecode has
+// an entry point, so the VM can hand a frame over at any instruction and get
+// it back at any other.
+class NativeCode {
+public:
+  // Takes over the executable pages at memory. entries[i] is the offset of
+  // the code of instruction i.
+  NativeCode(void *memory, size_t size, std::vector<uint32_t> entries);
+  ~NativeCode();
+
+  NativeCode(const NativeCode &) = delete;
+  NativeCode &operator=(const NativeCode &) = delete;
+
+  // Runs the code from instruction index on and returns the index of the
+  // instruction the VM continues with.
+  uint32_t run(Value *registers, uint32_t index) const {
+    return function(registers, start + entries[index]);
+  }
+
+  // Executable pages of size bytes holding code, null when the system does
+  // not give any.
+  static void *allocate(const std::vector<uint8_t> &code, size_t &size);
+
+private:
+  typedef uint32_t (*Function)(Value *registers, const uint8_t *entry);
+
+  void *memory;
+  size_t size;
+  const uint8_t *start;
+  Function function;
+  std::vector<uint32_t> entries;
+};
+
+#endif
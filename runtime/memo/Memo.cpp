@@ -0,0 +1,119 @@
+#include "Memo.h"
+
+#include <list>
+#include <unordered_map>
+
+namespace {
+
+struct KeyHash {
+  size_t operator()(const Memo::Key &key) const {
+    uint64_t hash = reinterpret_cast<uintptr_t>(key.function);
+    for (uint32_t i = 0; i < key.count; i++) {
+      hash = (hash ^ key.args[i]) * 0x100000001b3ULL;
+    }
+    return static_cast<size_t>(hash ^ (hash >> 32));
+  }
+};
+
+struct Entry {
+  Memo::Key key;
+  Value value;
+  // Whether the evaluator got the value as a ReturnValue.
+  bool returned;
+};
+
+// Entries from the one used last to the one used first, with an index into
+// them by key.
+struct Table {
+  std::list<Entry> entries;
+  std::unordered_map<Memo::Key, std::list<Entry>::iterator, KeyHash> index;
+};
+
+Table &table() {
+  static Table instance;
+  return instance;
+}
+
+} // namespace
+
+size_t Memo::capacity = 0;
+MemoStats Memo::counters;
+
+bool Memo::Key::operator==(const Key &other) const {
+  if (function != other.function || count != other.count) {
+    return false;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (args[i] != other.args[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Memo::enable(size_t size) {
+  capacity = size;
+  table().index.reserve(size);
+}
+
+bool Memo::makeKey(const FunctionDeclaration *function, const Value *args,
+                   size_t count, Key &key) {
+  size_t parameterCount = function->parameters.size();
+  // Parameters without an argument are looked up in the callers.
+  if (count < parameterCount || parameterCount > MAX_ARGUMENTS) {
+    return false;
+  }
+
+  key.function = function;
+  key.count = static_cast<uint32_t>(parameterCount);
+  for (size_t i = 0; i < parameterCount; i++) {
+    if (args[i].isObject()) {
+      return false;
+    }
+    key.args[i] = args[i].raw();
+  }
+  return true;
+}
+
+bool Memo::lookup(const Key &key, Value &result) {
+  Table &memo = table();
+  auto found = memo.index.find(key);
+  if (found == memo.index.end()) {
+    counters.misses++;
+    return false;
+  }
+
+  counters.hits++;
+  memo.entries.splice(memo.entries.begin(), memo.entries, found->second);
+  const Entry &entry = *found->second;
+  result = entry.returned ? Value(new ReturnValue(entry.value)) : entry.value;
+  return true;
+}
+
+void Memo::store(const Key &key, Value result) {
+  bool returned = result.type() == ValueType::ReturnValue;
+  if (returned) {
+    result = result.as<ReturnValue>()->value;
+  }
+  if (result.isObject()) {
+    return;
+  }
+
+  Table &memo = table();
+  if (memo.index.count(key) != 0) {
+    return;
+  }
+  if (memo.entries.size() >= capacity) {
+    memo.index.erase(memo.entries.back().key);
+    memo.entries.pop_back();
+    counters.evictions++;
+  }
+  memo.entries.push_front({key, result, returned});
+  memo.index.emplace(key, memo.entries.begin());
+}
+
+void Memo::printStats(std::ostream &out) {
+  out << "Memo: " << counters.hits << " hits, " << counters.misses
+      << " misses, " << counters.evictions << " evicted, "
+      << table().entries.size() << " results kept" << std::endl;
+}
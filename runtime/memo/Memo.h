@@ -0,0 +1,62 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include "../../ast/AST.h"
+#include "../values/Values.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// How many calls of memoizable functions were answered from the table and
+// how many had to run, and how many results the table forgot to make room.
+struct MemoStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// Results of calls of memoizable functions (see ast/PurityAST.h), enabled
+// with --memoize. Every engine but the transpiled C++ looks a call up before
+// running it and stores its result afterwards.
+//
+// A call is identified by its function and the bits of its arguments, so
+// only calls whose arguments are all numbers, booleans or null are kept, and
+// only results of those kinds: a struct could be changed by whoever got it.
+// The table holds at most capacity results and forgets the one used least
+// recently first.
+class Memo {
+public:
+  static const size_t DEFAULT_CAPACITY = 1 << 16;
+  static const size_t MAX_ARGUMENTS = 4;
+
+  struct Key {
+    const FunctionDeclaration *function;
+    uint32_t count;
+    uint64_t args[MAX_ARGUMENTS];
+
+    bool operator==(const Key &other) const;
+  };
+
+  static void enable(size_t capacity = DEFAULT_CAPACITY);
+  static bool enabled() { return capacity > 0; }
+
+  // Key of a call of function with count args, false when the call cannot
+  // be memoized.
+  static bool makeKey(const FunctionDeclaration *function, const Value *args,
+                      size_t count, Key &key);
+  // Result of an earlier call with the same key, false when there is none.
+  static bool lookup(const Key &key, Value &result);
+  // Remembers the result of the call with key, which may be the ReturnValue
+  // of the evaluator.
+  static void store(const Key &key, Value result);
+
+  static MemoStats stats() { return counters; }
+  static void printStats(std::ostream &out);
+
+private:
+  static size_t capacity;
+  static MemoStats counters;
+};
+
+#endif
@@ -1,13 +1,12 @@
 #include "BuiltinFunctions.h"
 
-RuntimeVal *printFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env) {
+Value printFunction(const std::vector<Value> &args, Environment *env) {
   for (auto arg : args) {
-    std::cout << arg->toString() << " ";
+    std::cout << arg.toString() << " ";
   }
   std::cout << std::endl;
 
-  return new NullVal;
+  return Value::null();
 }
 
 void clearScreen() {
@@ -22,11 +21,10 @@ std::string argumentsNumberMessage = "Wrong number of arguments in ";
 
 std::string argumentsTypeMessage = "Wrong argument type for";
 
-RuntimeVal *clearFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env) {
+Value clearFunction(const std::vector<Value> &args, Environment *env) {
   clearScreen();
 
-  return new NullVal;
+  return Value::null();
 }
 
 bool checkNumberOfArgument(int argumentsNumber, int numberToCheck) {
@@ -46,143 +44,133 @@ void exitWithError(const std::string& message1, const std::string& message2) {
     std::exit(1);
 }
 
-RuntimeVal *sqrtFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env) {
+Value sqrtFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "sqrt function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "sqrt function");
   }
 
-  NumberVal *number = dynamic_cast<NumberVal *>(args[0]);
-
-  return new NumberVal(sqrt(number->value));
+  return Value(sqrt(args[0].asNumber()));
 }
 
-RuntimeVal *powFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value powFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 2)) {
       exitWithError(argumentsNumberMessage, "pow function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue) && (!checkArgumentType(args[1]->type, ValueType::NumberValue))) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue) && (!checkArgumentType(args[1].type(), ValueType::NumberValue))) {
       exitWithError(argumentsTypeMessage, "pow function");
   }
 
-  return new NumberVal(pow(dynamic_cast<NumberVal *>(args[0])->value,
-                            dynamic_cast<NumberVal *>(args[1])->value));
+  return Value(pow(args[0].asNumber(),
+                            args[1].asNumber()));
 }
 
-RuntimeVal *roundFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env) {
+Value roundFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "round function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "round function");
   }
 
-  return new NumberVal(round(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(round(args[0].asNumber()));
 }
 
-RuntimeVal *floorFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env) {
+Value floorFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "floor function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "floor function");
   }
 
-  return new NumberVal(floor(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(floor(args[0].asNumber()));
 }
 
-RuntimeVal *minFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value minFunction(const std::vector<Value> &args, Environment *env) {
 
   if (args.size() == 0) {
-    return new NullVal();
+    return Value::null();
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "min function");
   }
 
-  double minNumber = dynamic_cast<NumberVal *>(args[0])->value;
+  double minNumber = args[0].asNumber();
 
   for (size_t i = 1; i < args.size(); i++) {
-    if (!checkArgumentType(args[i]->type, ValueType::NumberValue)) {
+    if (!checkArgumentType(args[i].type(), ValueType::NumberValue)) {
         exitWithError(argumentsTypeMessage, "min function");
     }
 
-    double nextNumber = dynamic_cast<NumberVal *>(args[i])->value;
+    double nextNumber = args[i].asNumber();
     if (nextNumber < minNumber) {
       minNumber = nextNumber;
     }
   }
 
-  return new NumberVal(minNumber);
+  return Value(minNumber);
 }
 
-RuntimeVal *maxFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value maxFunction(const std::vector<Value> &args, Environment *env) {
   if (args.size() == 0) {
-    return new NullVal();
+    return Value::null();
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "max function");
   }
 
-  double maxNumber = dynamic_cast<NumberVal *>(args[0])->value;
+  double maxNumber = args[0].asNumber();
 
   for (size_t i = 1; i < args.size(); i++) {
-    if (!checkArgumentType(args[i]->type, ValueType::NumberValue)) {
+    if (!checkArgumentType(args[i].type(), ValueType::NumberValue)) {
         exitWithError(argumentsTypeMessage, "max function");
     }
 
-    double nextNumber = dynamic_cast<NumberVal *>(args[i])->value;
+    double nextNumber = args[i].asNumber();
     if (nextNumber > maxNumber) {
       maxNumber = nextNumber;
     }
   }
 
-  return new NumberVal(maxNumber);
+  return Value(maxNumber);
 }
 
-RuntimeVal *absFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value absFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "abs function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "abs funcion");
   }
 
-  double num = dynamic_cast<NumberVal *>(args[0])->value;
+  double num = args[0].asNumber();
 
   if (num >= 0) {
     return args[0];
   }
   if (num < 0) {
-    return new NumberVal(-num);
+    return Value(-num);
   }
 
-  return new NullVal();
+  return Value::null();
 }
 
-RuntimeVal *inputFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env) {
+Value inputFunction(const std::vector<Value> &args, Environment *env) {
   if (args.size() > 1) {
     std::cerr
         << "Wrong number of arguments in input function, expected only one"
@@ -191,158 +179,144 @@ RuntimeVal *inputFunction(const std::vector<RuntimeVal *> args,
   }
 
   if (args.size() == 1) {
-    if (!checkArgumentType(args[0]->type, ValueType::StringValue)) {
+    if (!checkArgumentType(args[0].type(), ValueType::StringValue)) {
         exitWithError(argumentsTypeMessage, "input function");
     }
-    std::cout << dynamic_cast<StringVal *>(args[0])->value << std::endl;
+    std::cout << args[0].as<StringVal>()->value << std::endl;
   }
 
   std::string input;
   std::cin >> input;
 
-  return new StringVal(input);
+  return Value(new StringVal(input));
 }
 
-RuntimeVal *numberFunction(const std::vector<RuntimeVal *> args,
-                           Environment *env) {
+Value numberFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "num function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::StringValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::StringValue)) {
       exitWithError(argumentsTypeMessage, "num function");
   }
 
-  return new NumberVal(std::stoi(dynamic_cast<StringVal *>(args[0])->value));
+  return Value(std::stoi(args[0].as<StringVal>()->value));
 }
 
-RuntimeVal *stringFunction(const std::vector<RuntimeVal *> args,
-                           Environment *env) {
+Value stringFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "str function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "str function");
   }
 
-  return new StringVal(
-      std::to_string(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(new StringVal(std::to_string(args[0].asNumber())));
 }
 
-RuntimeVal *lenFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value lenFunction(const std::vector<Value> &args, Environment *env) {
 
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "len function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::StringValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::StringValue)) {
       exitWithError(argumentsTypeMessage, "len function");
   }
 
-  StringVal *stringValue = dynamic_cast<StringVal *>(args[0]);
+  StringVal *stringValue = args[0].as<StringVal>();
 
   int strLen = std::strlen(stringValue->value.c_str());
 
-  NumberVal *stringLenght = new NumberVal(strLen);
-
-  return stringLenght;
+  return Value(strLen);
 }
 
-RuntimeVal *exitFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env) {
+Value exitFunction(const std::vector<Value> &args, Environment *env) {
   exit(1);
-  return new NullVal;
+  return Value::null();
 }
 
-RuntimeVal *typeFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env) {
+Value typeFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "type function");
   }
 
-  return new StringVal(args[0]->getType());
+  return Value(new StringVal(args[0].getType()));
 }
 
-RuntimeVal *concatFunction(const std::vector<RuntimeVal *> args,
-                            Environment *env) {
+Value concatFunction(const std::vector<Value> &args, Environment *env) {
   std::string result;
 
   for (auto arg : args) {
-    if (!checkArgumentType(arg->type, ValueType::StringValue)) {
+    if (!checkArgumentType(arg.type(), ValueType::StringValue)) {
       exitWithError(argumentsTypeMessage, "concat function");
     }
 
-    result += dynamic_cast<StringVal *>(arg)->value;
+    result += arg.as<StringVal>()->value;
   }
 
-  return new StringVal(result);
+  return Value(new StringVal(result));
 }
 
-RuntimeVal *sinFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value sinFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "sin function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "sin function");
   }
 
-  return new NumberVal(std::sin(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(std::sin(args[0].asNumber()));
 }
 
-RuntimeVal *cosFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value cosFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "cos function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "cos function");
   }
 
-  return new NumberVal(std::cos(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(std::cos(args[0].asNumber()));
 }
 
-RuntimeVal *tanFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value tanFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "tan function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "tan function");
   }
 
-  return new NumberVal(std::tan(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(std::tan(args[0].asNumber()));
 }
 
-RuntimeVal *logFunction(const std::vector<RuntimeVal *> args,
-                        Environment *env) {
+Value logFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "log function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "log function");
   }
 
-  return new NumberVal(std::log(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(std::log(args[0].asNumber()));
 }
 
-RuntimeVal *ceilFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env) {
+Value ceilFunction(const std::vector<Value> &args, Environment *env) {
   if (!checkNumberOfArgument(args.size(), 1)) {
       exitWithError(argumentsNumberMessage, "ceil function");
   }
 
-  if (!checkArgumentType(args[0]->type, ValueType::NumberValue)) {
+  if (!checkArgumentType(args[0].type(), ValueType::NumberValue)) {
       exitWithError(argumentsTypeMessage, "ceil function");
   }
 
-  return new NumberVal(std::ceil(dynamic_cast<NumberVal *>(args[0])->value));
+  return Value(std::ceil(args[0].asNumber()));
 }
@@ -14,48 +14,32 @@ bool checkArgumentType(ValueType argumentToChek, ValueType typeToCheck);
 
 void exitWithError(std::string message);
 
-RuntimeVal *printFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env);
-RuntimeVal *clearFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env);
-RuntimeVal *sqrtFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-RuntimeVal *powFunction(const std::vector<RuntimeVal *> args, Environment *env);
-RuntimeVal *roundFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env);
-RuntimeVal *floorFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env);
-RuntimeVal *minFunction(const std::vector<RuntimeVal *> args, Environment *env);
-RuntimeVal *maxFunction(const std::vector<RuntimeVal *> args, Environment *env);
-RuntimeVal *absFunction(const std::vector<RuntimeVal *> args, Environment *env);
-RuntimeVal *inputFunction(const std::vector<RuntimeVal *> args,
-                          Environment *env);
-RuntimeVal *numberFunction(const std::vector<RuntimeVal *> args,
-                           Environment *env);
-RuntimeVal *stringFunction(const std::vector<RuntimeVal *> args,
-                           Environment *env);
-RuntimeVal *lenFunction(const std::vector<RuntimeVal *> args, Environment *env);
-RuntimeVal *exitFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *typeFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *concatFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *sinFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *cosFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *tanFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *logFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
-
-RuntimeVal *ceilFunction(const std::vector<RuntimeVal *> args,
-                         Environment *env);
+Value printFunction(const std::vector<Value> &args, Environment *env);
+Value clearFunction(const std::vector<Value> &args, Environment *env);
+Value sqrtFunction(const std::vector<Value> &args, Environment *env);
+Value powFunction(const std::vector<Value> &args, Environment *env);
+Value roundFunction(const std::vector<Value> &args, Environment *env);
+Value floorFunction(const std::vector<Value> &args, Environment *env);
+Value minFunction(const std::vector<Value> &args, Environment *env);
+Value maxFunction(const std::vector<Value> &args, Environment *env);
+Value absFunction(const std::vector<Value> &args, Environment *env);
+Value inputFunction(const std::vector<Value> &args, Environment *env);
+Value numberFunction(const std::vector<Value> &args, Environment *env);
+Value stringFunction(const std::vector<Value> &args, Environment *env);
+Value lenFunction(const std::vector<Value> &args, Environment *env);
+Value exitFunction(const std::vector<Value> &args, Environment *env);
+
+Value typeFunction(const std::vector<Value> &args, Environment *env);
+
+Value concatFunction(const std::vector<Value> &args, Environment *env);
+
+Value sinFunction(const std::vector<Value> &args, Environment *env);
+
+Value cosFunction(const std::vector<Value> &args, Environment *env);
+
+Value tanFunction(const std::vector<Value> &args, Environment *env);
+
+Value logFunction(const std::vector<Value> &args, Environment *env);
+
+Value ceilFunction(const std::vector<Value> &args, Environment *env);
 #endif
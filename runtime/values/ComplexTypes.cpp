@@ -1,39 +1,115 @@
 #include "Values.h"
+#include "../gc/Heap.h"
+
+#include <algorithm>
 
 NativeFnVal::NativeFnVal(FunctionType c)
     : RuntimeVal(ValueType::NativeFunction), call(c) {}
 
-FnVal::FnVal(std::string n, std::vector<std::string> p, Environment *d,
-             std::vector<Stmt *> b)
-    : RuntimeVal(ValueType::Function), name(n), parameters(std::move(p)),
-      declarationEnv(d), body(std::move(b)) {}
+RuntimeVal *NativeFnVal::tenure() {
+  return new (Generation::Old) NativeFnVal(std::move(*this));
+}
+
+FnVal::FnVal(Symbol n, ArenaArray<Symbol> p, Environment *d,
+             NodeList<Stmt> b, const FunctionProto *code,
+             ArenaArray<Symbol> slots)
+    : RuntimeVal(ValueType::Function), name(n), parameters(p),
+      declarationEnv(d), body(b), proto(code), slotNames(slots) {}
+
+RuntimeVal *FnVal::tenure() {
+  return new (Generation::Old) FnVal(std::move(*this));
+}
+
+const StructShape *StructShape::empty() {
+  static StructShape shape;
+  return &shape;
+}
+
+int32_t StructShape::find(Symbol fieldName) const {
+  for (size_t i = 0; i < names.size(); i++) {
+    if (names[i] == fieldName) {
+      return static_cast<int32_t>(i);
+    }
+  }
+  return -1;
+}
+
+const StructShape *StructShape::withField(Symbol fieldName) const {
+  std::unique_ptr<StructShape> &next = transitions[fieldName];
+
+  if (next == nullptr) {
+    next.reset(new StructShape());
+    next->names = names;
+    const std::string &newName = SymbolTable::name(fieldName);
+    auto position = std::find_if(
+        next->names.begin(), next->names.end(),
+        [&](Symbol name) { return newName < SymbolTable::name(name); });
+    next->names.insert(position, fieldName);
+  }
+
+  return next.get();
+}
 
 StructVal::StructVal(const std::string &name, bool isDecl)
     : RuntimeVal(ValueType::StructValue), structName(name),
-      isDeclaration(isDecl) {}
+      isDeclaration(isDecl), shape(StructShape::empty()) {}
 
-RuntimeVal *StructVal::getField(const std::string &fieldName) {
-  auto it = this->fields.find(fieldName);
+Value StructVal::getField(Symbol fieldName, FieldCache &cache) {
+  if (cache.shape != shape) {
+    int32_t slot = shape->find(fieldName);
+    if (slot < 0) {
+      std::cerr << "Error: Field '" << SymbolTable::name(fieldName)
+                << "' not found in struct '" << this->structName << "'"
+                << std::endl;
+      std::exit(1);
+    }
+    cache.shape = shape;
+    cache.slot = static_cast<uint32_t>(slot);
+  }
+  return fields[cache.slot];
+}
 
-  if (it != this->fields.end()) {
-    return it->second;
-  } else {
-    std::cerr << "Error: Field '" << fieldName << "' not found in struct '"
-              << this->structName << "'" << std::endl;
-    std::exit(1);
+Value StructVal::getField(Symbol fieldName) {
+  FieldCache cache;
+  return getField(fieldName, cache);
+}
+
+void StructVal::addField(Symbol fieldName, Value value) {
+  if (shape->find(fieldName) >= 0) {
+    return;
   }
-  return nullptr;
+
+  // The slots after the new one move up by one, like the names in its shape.
+  Heap::writeBarrier(this, value);
+  shape = shape->withField(fieldName);
+  fields.insert(fields.begin() + shape->find(fieldName), value);
 }
 
-void StructVal::addField(const std::string &fieldName, RuntimeVal *value) {
-  this->fields.insert({fieldName, value});
+StructVal *StructVal::instantiate(const std::vector<Value> &args) {
+  if (!this->isDeclaration) {
+    throw InterpreterError(
+        "Cannot create struct instance from other struct instance");
+  }
+
+  StructVal *instance = new StructVal(this->structName, false);
+  instance->shape = this->shape;
+  instance->fields = this->fields;
+
+  size_t count = std::min(args.size(), instance->fields.size());
+  for (size_t i = 0; i < count; i++) {
+    Heap::writeBarrier(instance, args[i]);
+    instance->fields[i] = args[i];
+  }
+
+  return instance;
 }
 
 std::string StructVal::toString() {
   std::string result = "Struct " + structName + " {";
 
-  for (const auto &field : fields) {
-    result += "\n  " + field.first + ": " + field.second->toString();
+  for (uint32_t slot = 0; slot < shape->size(); slot++) {
+    result += "\n  " + SymbolTable::name(shape->name(slot)) + ": " +
+              fields[slot].toString();
   }
 
   result += "\n}";
@@ -48,6 +124,28 @@ std::string StructVal::getType() {
   return "Struct instance";
 }
 
-void StructVal::setField(const std::string &fieldName, RuntimeVal *value) {
-  fields[fieldName] = value;
+void StructVal::setField(Symbol fieldName, Value value, FieldCache &cache) {
+  if (cache.shape != shape) {
+    // Assigning a field the struct does not have adds it.
+    addField(fieldName, value);
+    cache.shape = shape;
+    cache.slot = static_cast<uint32_t>(shape->find(fieldName));
+  }
+  Heap::writeBarrier(this, value);
+  fields[cache.slot] = value;
+}
+
+void StructVal::setField(Symbol fieldName, Value value) {
+  FieldCache cache;
+  setField(fieldName, value, cache);
+}
+
+void StructVal::traceValues() {
+  for (Value &field : fields) {
+    Heap::visit(field);
+  }
+}
+
+RuntimeVal *StructVal::tenure() {
+  return new (Generation::Old) StructVal(std::move(*this));
 }
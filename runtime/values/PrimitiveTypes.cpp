@@ -1,99 +1,55 @@
 #include "Values.h"
+#include "../gc/Heap.h"
 
 RuntimeVal::RuntimeVal(ValueType type) : type(type){};
 
-NullVal::NullVal() : RuntimeVal(ValueType::NullValue) {}
-
-std::string NullVal::toString() { return value; }
-
-BooleanVal::BooleanVal(bool b)
-    : RuntimeVal(ValueType::BooleanValue), value(b) {}
-
-BooleanVal::BooleanVal(BooleanVal &orginal)
-    : RuntimeVal(ValueType::BooleanValue), value(orginal.value) {}
-
-std::string BooleanVal::toString() {
-  if (value) {
-    return "true";
+std::string Value::toString() const {
+  if (isNumber()) {
+    double value = asNumber();
+    int valueInt = value;
+    if ((value - valueInt) == 0) {
+      return std::to_string(valueInt);
+    }
+    return std::to_string(value);
   }
-  return "false";
-}
-
-NumberVal::NumberVal(double n) : RuntimeVal(ValueType::NumberValue), value(n) {}
-
-NumberVal::NumberVal(const NumberVal &orginal)
-    : RuntimeVal(ValueType::NumberValue), value(orginal.value) {}
-
-NumberVal::NumberVal(const NumericLiteral *numberLiteral)
-    : RuntimeVal(ValueType::NumberValue), value(numberLiteral->value) {}
-
-NumberVal* NumberVal::operator+(const NumberVal& other) const {
-    return new NumberVal(this->value + other.value);
-}
-
-NumberVal* NumberVal::operator-(const NumberVal& other) const {
-    return new NumberVal(this->value - other.value);
-}
-
-NumberVal* NumberVal::operator*(const NumberVal& other) const {
-    return new NumberVal(this->value * other.value);
-}
-
-NumberVal* NumberVal::operator/(const NumberVal& other) const {
-    return new NumberVal(this->value / other.value);
-}
-
-NumberVal* NumberVal::operator<(const NumberVal& other) const {
-    return new NumberVal(this->value < other.value);
-}
-
-NumberVal* NumberVal::operator<=(const NumberVal& other) const {
-    return new NumberVal(this->value <= other.value);
-}
-
-NumberVal* NumberVal::operator>=(const NumberVal& other) const {
-    return new NumberVal(this->value >= other.value);
-}
-
-NumberVal* NumberVal::operator>(const NumberVal& other) const {
-    return new NumberVal(this->value > other.value);
-}
-
-NumberVal* NumberVal::operator==(const NumberVal& other) const {
-    return new NumberVal(this->value == other.value);
-}
-
-NumberVal* NumberVal::operator!=(const NumberVal& other) const {
-    return new NumberVal(this->value != other.value);
-}
-
-NumberVal* NumberVal::operator%(const NumberVal& other) const {
-    return new NumberVal(fmod(this->value, other.value));
-}
-
-NumberVal* NumberVal::operator&&(const NumberVal& other) const {
-    return new NumberVal(this->value && other.value);
-}
-
-NumberVal* NumberVal::operator||(const NumberVal& other) const {
-    return new NumberVal(this->value || other.value);
+  if (isObject()) {
+    return asObject()->toString();
+  }
+  if (isBoolean()) {
+    if (asBoolean()) {
+      return "true";
+    }
+    return "false";
+  }
+  return "null";
 }
 
-std::string NumberVal::toString() {
-  int valueInt = value;
-  if ((value - valueInt) == 0) {
-    return std::to_string(valueInt);
+std::string Value::getType() const {
+  if (isNumber()) {
+    return "NumberVal";
+  }
+  if (isObject()) {
+    return asObject()->getType();
+  }
+  if (isBoolean()) {
+    return "BooleanVal";
   }
-  return std::to_string(value);
+  return "NullVal";
 }
 
-ReturnValue::ReturnValue(RuntimeVal *val)
+ReturnValue::ReturnValue(Value val)
     : RuntimeVal(ValueType::ReturnValue), value(val) {}
 
 ReturnValue::ReturnValue(ReturnValue &orginal)
     : RuntimeVal(ValueType::ReturnValue), value(orginal.value) {}
 
-std::string ReturnValue::toString() { return value->toString(); }
+std::string ReturnValue::toString() { return value.toString(); }
+
+void ReturnValue::traceValues() { Heap::visit(value); }
+
+RuntimeVal *ReturnValue::tenure() {
+  return new (Generation::Old) ReturnValue(*this);
+}
 
 StringVal::StringVal(const std::string &str)
     : RuntimeVal(ValueType::StringValue), value(str) {}
@@ -105,3 +61,7 @@ StringVal::StringVal(const StrLiteral *strLiteral)
     : RuntimeVal(ValueType::StringValue), value(strLiteral->value) {}
 
 std::string StringVal::toString() { return value; }
+
+RuntimeVal *StringVal::tenure() {
+  return new (Generation::Old) StringVal(std::move(*this));
+}
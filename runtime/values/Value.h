@@ -0,0 +1,150 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+enum class ValueType {
+  NullValue,
+  NumberValue,
+  StringValue,
+  BooleanValue,
+
+  NativeFunction,
+  Function,
+  ReturnValue,
+  StructValue,
+};
+
+class Heap;
+class Value;
+
+// Where a RuntimeVal is allocated. Young objects go to the nursery of the
+// garbage collector, Old is used when one survives a collection, Permanent
+// objects (constants of compiled code) are never freed.
+enum class Generation { Young, Old, Permanent };
+
+// Base of the values that live on the heap: strings, structs and functions.
+// Every one of them is owned by the garbage collector (runtime/gc/Heap.h), a
+// plain `new` puts it in the nursery and nothing deletes it by hand.
+class RuntimeVal {
+public:
+  ValueType type;
+  virtual ~RuntimeVal() = default;
+  virtual std::string toString() = 0;
+  virtual std::string getType() = 0;
+  RuntimeVal(ValueType type);
+  RuntimeVal(const RuntimeVal &other) : type(other.type) {}
+
+  // Hands every Value the object holds to Heap::visit.
+  virtual void traceValues() {}
+
+  // Moves the object into the old generation and returns the copy.
+  virtual RuntimeVal *tenure() = 0;
+
+  static void *operator new(size_t size);
+  static void *operator new(size_t size, Generation generation);
+  static void operator delete(void *memory);
+  static void operator delete(void *memory, Generation generation);
+
+private:
+  friend class Heap;
+
+  bool marked = false;
+  bool remembered = false;
+  RuntimeVal *forwarded = nullptr;
+};
+
+// A value of the language in 64 bits, passed around by value.
+//
+// Numbers are stored as plain doubles. Everything else is hidden in the
+// payload of quiet NaNs with bit 50 set, which a number never uses (that bit
+// is cleared from NaN results on the way in): null and booleans as small
+// constants, heap objects as a pointer with the sign bit set. Only strings,
+// structs and functions need an allocation.
+class Value {
+public:
+  // No value at all, used for variables and registers that are not declared
+  // yet. Behaves like null when printed.
+  Value() : bits(EMPTY) {}
+
+  Value(double number) {
+    std::memcpy(&bits, &number, sizeof(bits));
+    if ((bits & QUIET_NAN) == QUIET_NAN) {
+      bits &= ~TAG_BIT;
+    }
+  }
+
+  Value(int number) : Value(static_cast<double>(number)) {}
+
+  explicit Value(RuntimeVal *object)
+      : bits(OBJECT | reinterpret_cast<uintptr_t>(object)) {}
+
+  // A bool would silently become the number 0 or 1, use Value::boolean.
+  Value(bool) = delete;
+
+  static Value null() { return fromBits(NULL_VALUE); }
+  static Value boolean(bool value) {
+    return fromBits(value ? TRUE_VALUE : FALSE_VALUE);
+  }
+
+  bool isEmpty() const { return bits == EMPTY; }
+  bool isNumber() const { return (bits & QUIET_NAN) != QUIET_NAN; }
+  bool isObject() const { return (bits & OBJECT) == OBJECT; }
+  bool isBoolean() const { return (bits | 1) == TRUE_VALUE; }
+
+  double asNumber() const {
+    double number;
+    std::memcpy(&number, &bits, sizeof(number));
+    return number;
+  }
+  bool asBoolean() const { return bits == TRUE_VALUE; }
+  RuntimeVal *asObject() const {
+    return reinterpret_cast<RuntimeVal *>(
+        static_cast<uintptr_t>(bits & ~OBJECT));
+  }
+  template <typename T> T *as() const { return static_cast<T *>(asObject()); }
+
+  // The 64 bits themselves, for machine code made by the Jit.
+  uint64_t raw() const { return bits; }
+
+  ValueType type() const {
+    if (isNumber()) {
+      return ValueType::NumberValue;
+    }
+    if (isObject()) {
+      return asObject()->type;
+    }
+    if (isBoolean()) {
+      return ValueType::BooleanValue;
+    }
+    return ValueType::NullValue;
+  }
+
+  std::string toString() const;
+  std::string getType() const;
+
+private:
+  static constexpr uint64_t TAG_BIT = 0x0004000000000000;
+  static constexpr uint64_t QUIET_NAN = 0x7ff8000000000000 | TAG_BIT;
+  static constexpr uint64_t OBJECT = 0x8000000000000000 | QUIET_NAN;
+
+  static constexpr uint64_t EMPTY = QUIET_NAN;
+  static constexpr uint64_t NULL_VALUE = QUIET_NAN | 1;
+  static constexpr uint64_t FALSE_VALUE = QUIET_NAN | 2;
+  static constexpr uint64_t TRUE_VALUE = QUIET_NAN | 3;
+
+  static Value fromBits(uint64_t bits) {
+    Value value;
+    value.bits = bits;
+    return value;
+  }
+
+  uint64_t bits;
+};
+
+static_assert(sizeof(Value) == sizeof(uint64_t), "Value must stay 64 bits");
+
+#endif
@@ -6,90 +6,28 @@
 #include <map>
 #include <memory>
 #include <cmath>
+#include <vector>
 
 class Environment; // Deklaracja wstpna
 
 #include "../../ast/AST.h"
+#include "Value.h"
 
-enum class ValueType {
-  NullValue,
-  NumberValue,
-  StringValue,
-  BooleanValue,
-
-  NativeFunction,
-  Function,
-  ReturnValue,
-  StructValue,
-};
-
-class RuntimeVal {
-public:
-  ValueType type;
-  virtual ~RuntimeVal() = default;
-  virtual std::string toString() = 0;
-  virtual std::string getType() = 0;
-  RuntimeVal(ValueType type);
-};
-
-class NullVal : public RuntimeVal {
-public:
-  const std::string value = "null";
-  NullVal();
-
-  std::string toString() override;
-  std::string getType() override { return "NullVal"; }
-};
-
-class BooleanVal : public RuntimeVal {
-public:
-  bool value;
-
-  BooleanVal(bool b = true);
-  BooleanVal(BooleanVal &orginal);
-
-  std::string toString() override;
-  std::string getType() override { return "BooleanVal"; }
-};
-
-class NumberVal : public RuntimeVal {
-public:
-  double value;
-
-  NumberVal(double n = 0);
-  NumberVal(const NumberVal &orginal);
-  NumberVal(const NumericLiteral *numberLiteral);
-
-  NumberVal* operator+(const NumberVal& other) const;
-  NumberVal* operator-(const NumberVal& other) const;
-  NumberVal* operator*(const NumberVal& other) const;
-  NumberVal* operator/(const NumberVal& other) const;
-  NumberVal* operator<(const NumberVal& other) const;
-  NumberVal* operator<=(const NumberVal& other) const;
-  NumberVal* operator>=(const NumberVal& other) const;
-  NumberVal* operator>(const NumberVal& other) const;
-  NumberVal* operator==(const NumberVal& other) const;
-  NumberVal* operator!=(const NumberVal& other) const;
-  NumberVal* operator%(const NumberVal& other) const;
-  NumberVal* operator&&(const NumberVal& other) const;
-  NumberVal* operator||(const NumberVal& other) const;
-;
-
-  std::string toString() override;
-  std::string getType() override { return "NumberVal"; }
-};
+struct FunctionProto;
+struct ClosureFunction;
 
 class ReturnValue : public RuntimeVal {
 public:
-  RuntimeVal *value;
+  Value value;
 
-  ReturnValue(RuntimeVal *val);
+  ReturnValue(Value val);
   ReturnValue(ReturnValue &val);
 
   std::string toString() override;
   std::string getType() override { return "ReturnVal"; }
 
-  ~ReturnValue() { delete value; }
+  void traceValues() override;
+  RuntimeVal *tenure() override;
 };
 
 class StringVal : public RuntimeVal {
@@ -101,10 +39,11 @@ public:
 
   std::string toString() override;
   std::string getType() override { return "StringVal"; }
+
+  RuntimeVal *tenure() override;
 };
 
-typedef std::function<RuntimeVal *(const std::vector<RuntimeVal *>,
-                                   Environment *)>
+typedef std::function<Value(const std::vector<Value> &, Environment *)>
     FunctionType;
 
 class NativeFnVal : public RuntimeVal {
@@ -115,38 +54,94 @@ public:
   std::string toString() override { return "NativeFnVal"; }
 
   std::string getType() override { return "NativeFnVal"; }
+
+  RuntimeVal *tenure() override;
 };
 
 class FnVal : public RuntimeVal {
 public:
-  std::string name;
-  std::vector<std::string> parameters;
+  Symbol name;
+  ArenaArray<Symbol> parameters;
   Environment *declarationEnv;
-  std::vector<Stmt *> body;
-
-  FnVal(std::string n, std::vector<std::string> p, Environment *d,
-        std::vector<Stmt *> b);
+  NodeList<Stmt> body;
+  // Bytecode of the function when it was declared by the VM.
+  const FunctionProto *proto;
+  // Slots of the environment of a call, empty when the function was not
+  // resolved (see ast/ResolverAST.h).
+  ArenaArray<Symbol> slotNames;
+  // Body of the function when it was declared by closure compiled code.
+  const ClosureFunction *closure = nullptr;
+  // Declaration of the function when its calls are memoized (see
+  // runtime/memo/Memo.h).
+  const FunctionDeclaration *memoized = nullptr;
+
+  FnVal(Symbol n, ArenaArray<Symbol> p, Environment *d, NodeList<Stmt> b,
+        const FunctionProto *code = nullptr,
+        ArenaArray<Symbol> slots = ArenaArray<Symbol>());
 
   std::string toString() override { return "FnVal"; }
 
   std::string getType() override { return "FnVal"; }
+
+  RuntimeVal *tenure() override;
+};
+
+// Names of the fields of a struct and the slot each one is stored in. Slots
+// follow the names in alphabetical order, the order instantiate takes its
+// arguments in and toString prints the fields in.
+//
+// Shapes are shared and never freed. Adding a field to a struct leads from its
+// shape to the same next shape every time, so a declaration and all of its
+// instances have one shape, and a FieldCache comparing shapes by address
+// knows the slot of a field without looking for it.
+class StructShape {
+public:
+  // Shape of a struct without fields.
+  static const StructShape *empty();
+
+  // Slot of the field, or -1 when there is no such field.
+  int32_t find(Symbol fieldName) const;
+
+  // Shape with one more field, which must not be in this shape yet.
+  const StructShape *withField(Symbol fieldName) const;
+
+  uint32_t size() const { return static_cast<uint32_t>(names.size()); }
+  Symbol name(uint32_t slot) const { return names[slot]; }
+
+private:
+  std::vector<Symbol> names;
+  mutable std::map<Symbol, std::unique_ptr<StructShape>> transitions;
 };
 
 class StructVal : public RuntimeVal {
 public:
   std::string structName;
   bool isDeclaration;
-  std::map<std::string, RuntimeVal *> fields;
+  const StructShape *shape;
+  // Value of every field, indexed by its slot in shape.
+  std::vector<Value> fields;
 
 public:
   StructVal(const std::string &name, bool isDecl);
 
-  RuntimeVal *getField(const std::string &fieldName);
-  void setField(const std::string &fieldName, RuntimeVal *value);
-  void addField(const std::string &fieldName, RuntimeVal *value);
+  // The cache holds the slot of the field for structs of the shape it saw
+  // last and is updated when this struct has another shape.
+  Value getField(Symbol fieldName, FieldCache &cache);
+  void setField(Symbol fieldName, Value value, FieldCache &cache);
+  Value getField(Symbol fieldName);
+  void setField(Symbol fieldName, Value value);
+  // Keeps the value the field already has, if any.
+  void addField(Symbol fieldName, Value value);
+
+  // New instance of this declaration. Arguments replace the default field
+  // values in the order the fields are stored (by name).
+  StructVal *instantiate(const std::vector<Value> &args);
 
   std::string toString() override;
   std::string getType() override;
+
+  void traceValues() override;
+  RuntimeVal *tenure() override;
 };
 
 class InterpreterError : public std::runtime_error {
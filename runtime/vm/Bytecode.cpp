@@ -0,0 +1,56 @@
+#include "Bytecode.h"
+
+#include <algorithm>
+
+namespace {
+
+std::vector<bool> functionLocals;
+
+} // namespace
+
+Opcode unfused(Opcode op) {
+  switch (op) {
+  case Opcode::AddConst:
+  case Opcode::SubtractConst:
+    return Opcode::LoadConst;
+  case Opcode::BranchLess:
+    return Opcode::Less;
+  case Opcode::BranchLessEqual:
+    return Opcode::LessEqual;
+  case Opcode::BranchGreater:
+    return Opcode::Greater;
+  case Opcode::BranchGreaterEqual:
+    return Opcode::GreaterEqual;
+  case Opcode::BranchEqual:
+    return Opcode::Equal;
+  case Opcode::BranchNotEqual:
+    return Opcode::NotEqual;
+  case Opcode::BranchModuloZero:
+    return Opcode::Modulo;
+  default:
+    return op;
+  }
+}
+
+int64_t FunctionProto::findLocal(Symbol name) const {
+  auto it = std::lower_bound(
+      locals.begin(), locals.end(), name,
+      [](const std::pair<Symbol, uint32_t> &local, Symbol symbol) {
+        return local.first < symbol;
+      });
+  if (it == locals.end() || it->first != name) {
+    return -1;
+  }
+  return it->second;
+}
+
+void markFunctionLocal(Symbol name) {
+  if (name >= functionLocals.size()) {
+    functionLocals.resize(name + 1);
+  }
+  functionLocals[name] = true;
+}
+
+bool isFunctionLocal(Symbol name) {
+  return name < functionLocals.size() && functionLocals[name];
+}
@@ -0,0 +1,141 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "../../ast/AST.h"
+#include "../jit/NativeCode.h"
+#include "../values/Values.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Register bytecode executed by the VM. Every function, and the top level of
+// a program, is compiled into a FunctionProto: a flat array of instructions
+// working on a window of registers, plus the constants they load.
+//
+// Operands are register numbers relative to the frame, constant indices,
+// symbols or absolute instruction indices (for jumps) depending on the
+// opcode. The comment next to every opcode lists how a, b and c are used.
+//
+// The opcodes after Throw are superinstructions. The compiler puts them in
+// place of the first instruction of a common sequence, keeping its operands
+// and the rest of the sequence (see Compiler.h). When the operands are
+// numbers a superinstruction does the whole sequence and skips the rest of
+// it, otherwise it does what the instruction it replaced does.
+#define RUSTEDC_OPCODES(X)                                                     \
+  X(LoadConst)      /* a = dst, b = constant                              */   \
+  X(Move)           /* a = dst, b = src                                   */   \
+  X(GetLocal)       /* a = dst, b = local, c = symbol when undeclared     */   \
+  X(SetLocal)       /* a = local, b = src, c = symbol when undeclared     */   \
+  X(SetConstLocal)  /* a = local, b = src, c = symbol                     */   \
+  X(DeclareLocal)   /* a = local, b = src, c = symbol                     */   \
+  X(GetGlobal)      /* a = dst, b = symbol                                */   \
+  X(SetGlobal)      /* a = src, b = symbol                                */   \
+  X(DeclareGlobal)  /* a = src, b = symbol, c = constant flag             */   \
+  X(Add)            /* a = dst, b = lhs, c = rhs (same for all below)     */   \
+  X(Subtract)                                                                  \
+  X(Multiply)                                                                  \
+  X(Divide)                                                                    \
+  X(Modulo)                                                                    \
+  X(Less)                                                                      \
+  X(LessEqual)                                                                 \
+  X(Greater)                                                                   \
+  X(GreaterEqual)                                                              \
+  X(Equal)                                                                     \
+  X(NotEqual)                                                                  \
+  X(And)                                                                       \
+  X(Or)                                                                        \
+  X(Not)            /* a = dst, b = src                                   */   \
+  X(Negate)         /* a = dst, b = src                                   */   \
+  X(Jump)           /* b = target                                         */   \
+  X(JumpIfFalse)    /* a = condition of an if, b = target                 */   \
+  X(JumpUnlessOne)  /* a = condition of a while, b = target               */   \
+  X(GetField)       /* a = dst, b = object, c = field site                */   \
+  X(SetField)       /* a = object, b = src, c = field site                */   \
+  X(NewStruct)      /* a = dst, b = struct name symbol                    */   \
+  X(AddField)       /* a = struct, b = src, c = field symbol              */   \
+  X(MakeFunction)   /* a = dst, b = index in CompiledProgram::functions   */   \
+  X(Call)           /* a = dst, b = callee, args follow it, c = count     */   \
+  X(TailCall)       /* as Call, in the frame when the callee is bytecode  */   \
+  X(Return)         /* a = src                                            */   \
+  X(Throw)          /* b = constant holding the message                   */   \
+  X(AddConst)       /* LoadConst, then an Add of it as rhs                */   \
+  X(SubtractConst)  /* LoadConst, then a Subtract of it as rhs            */   \
+  X(BranchLess)     /* Less, then a JumpIfFalse or JumpUnlessOne of it    */   \
+  X(BranchLessEqual)                                                           \
+  X(BranchGreater)                                                             \
+  X(BranchGreaterEqual)                                                        \
+  X(BranchEqual)                                                               \
+  X(BranchNotEqual)                                                            \
+  X(BranchModuloZero) /* Modulo, LoadConst 0, Equal or NotEqual, jump    */
+
+enum class Opcode : uint8_t {
+#define RUSTEDC_OPCODE_ENUM(name) name,
+  RUSTEDC_OPCODES(RUSTEDC_OPCODE_ENUM)
+#undef RUSTEDC_OPCODE_ENUM
+};
+
+// The opcode a superinstruction stands in for, any other opcode itself.
+Opcode unfused(Opcode op);
+
+struct Instruction {
+  Opcode op;
+  uint16_t a;
+  uint32_t b;
+  uint32_t c;
+};
+
+struct FunctionProto {
+  Symbol name;
+  // Parameters take the first registers, declared locals follow them and
+  // temporaries come last.
+  uint32_t parameterCount = 0;
+  uint32_t registerCount = 0;
+  std::vector<Instruction> code;
+  std::vector<Value> constants;
+  // Field read or assigned by every GetField and SetField, with the slot it
+  // had in the struct the instruction saw last.
+  struct FieldSite {
+    Symbol name;
+    FieldCache cache;
+  };
+  mutable std::vector<FieldSite> fieldSites;
+
+  // Register of every local by name, sorted by symbol. Used when a callee
+  // reads a name it does not declare, which the evaluator resolves through
+  // the environments of its callers.
+  std::vector<std::pair<Symbol, uint32_t>> locals;
+
+  // Kept so that the FnVal of this function looks like one made by the
+  // evaluator.
+  ArenaArray<Symbol> parameters;
+  NodeList<Stmt> body;
+
+  // Declaration of a function whose calls are memoized, see
+  // runtime/memo/Memo.h.
+  const FunctionDeclaration *memoized = nullptr;
+
+  // Calls and loop iterations counted by the Jit, and the machine code it
+  // made once they passed its threshold.
+  mutable uint32_t hotness = 0;
+  mutable std::unique_ptr<NativeCode> native;
+
+  // Register holding name, or -1 when the function has no such local.
+  int64_t findLocal(Symbol name) const;
+};
+
+// Every function of one Program. The top level is functions[0]. FnVals point
+// into it, so it must live as long as they can be called.
+struct CompiledProgram {
+  std::vector<std::unique_ptr<FunctionProto>> functions;
+};
+
+// Names that some compiled function declares as a local. Only these can be
+// found in the frame of a caller, every other name a function reads without
+// declaring it is looked up in the global environment right away.
+void markFunctionLocal(Symbol name);
+bool isFunctionLocal(Symbol name);
+
+#endif
@@ -0,0 +1,728 @@
+#include "Compiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Statements whose value is not needed are compiled with this instead of a
+// result register.
+const int64_t DISCARD = -1;
+
+FuseStats fused;
+
+struct LocalInfo {
+  uint32_t reg;
+  bool constant;
+};
+
+class FunctionCompiler {
+public:
+  FunctionCompiler(CompiledProgram &program, FunctionProto &proto,
+                   bool topLevel)
+      : program(program), proto(proto), topLevel(topLevel), nextRegister(0),
+        completion(0), topLevelResult(DISCARD) {}
+
+  void compileProgram(const NodeList<Stmt> &body);
+  void compileFunction(const FunctionDeclaration &declaration);
+
+private:
+  CompiledProgram &program;
+  FunctionProto &proto;
+  bool topLevel;
+
+  std::unordered_map<Symbol, LocalInfo> locals;
+
+  // Registers of the locals whose declaration dominates the code being
+  // compiled. They are read and written directly, every other local may
+  // still be undeclared and goes through the checked instructions.
+  std::vector<bool> declared;
+  std::vector<uint32_t> declaredLog;
+
+  uint32_t nextRegister;
+
+  // Value of the statement executed last, which is what a function that
+  // does not return and the whole program evaluate to.
+  uint32_t completion;
+
+  std::unordered_map<uint64_t, uint32_t> numberConstants;
+  int64_t nullConstant = -1;
+
+  // A return at the top level ends the top level statement it is in, the
+  // jumps are patched once that statement is compiled.
+  std::vector<size_t> topLevelReturns;
+  int64_t topLevelResult;
+
+  size_t emit(Opcode op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+  void patch(size_t jump);
+  uint32_t allocate(uint32_t count = 1);
+
+  uint32_t constant(Value value);
+  uint32_t numberConstant(double value);
+  uint32_t nullValue();
+  uint32_t fieldSite(Symbol name);
+  void emitThrow(const std::string &message);
+
+  void collectLocals(const NodeList<Stmt> &body);
+  void addLocal(Symbol name, bool constant);
+  const LocalInfo *findLocal(Symbol name) const;
+  void markDeclared(uint32_t reg);
+  void restoreDeclared(size_t mark);
+  void declare(Symbol name, uint32_t value, bool constant);
+
+  void compileBlock(const NodeList<Stmt> &body, int64_t result);
+  void compileStatement(Stmt *stmt, int64_t result);
+  void compileStructDeclaration(StructDeclaration *declaration,
+                                uint32_t value);
+  void compileIf(IfStatement *ifStmt, int64_t result);
+  void compileWhile(WhileLoop *loop, int64_t result);
+  void compileReturn(ReturnStatement *returnStmt, int64_t result);
+
+  uint32_t compileOperand(Expr *expr);
+  void compileInto(Expr *expr, uint32_t dst);
+  uint32_t compileAssignment(AssignmentExpr *assignment);
+  void compileCall(CallExpr *call, uint32_t dst);
+
+  void fuse(uint32_t firstTemporary);
+};
+
+size_t FunctionCompiler::emit(Opcode op, uint32_t a, uint32_t b, uint32_t c) {
+  if (a > UINT16_MAX) {
+    throw InterpreterError("Function " + SymbolTable::name(proto.name) +
+                           " needs too many registers");
+  }
+  proto.code.push_back({op, static_cast<uint16_t>(a), b, c});
+  return proto.code.size() - 1;
+}
+
+void FunctionCompiler::patch(size_t jump) {
+  proto.code[jump].b = static_cast<uint32_t>(proto.code.size());
+}
+
+uint32_t FunctionCompiler::allocate(uint32_t count) {
+  uint32_t reg = nextRegister;
+  nextRegister += count;
+  proto.registerCount = std::max(proto.registerCount, nextRegister);
+  return reg;
+}
+
+uint32_t FunctionCompiler::constant(Value value) {
+  proto.constants.push_back(value);
+  return static_cast<uint32_t>(proto.constants.size() - 1);
+}
+
+uint32_t FunctionCompiler::fieldSite(Symbol name) {
+  // Every instruction gets its own site, they see structs of other shapes.
+  proto.fieldSites.push_back({name, FieldCache()});
+  return static_cast<uint32_t>(proto.fieldSites.size() - 1);
+}
+
+uint32_t FunctionCompiler::numberConstant(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  auto found = numberConstants.find(bits);
+  if (found != numberConstants.end()) {
+    return found->second;
+  }
+  uint32_t index = constant(Value(value));
+  numberConstants.emplace(bits, index);
+  return index;
+}
+
+uint32_t FunctionCompiler::nullValue() {
+  if (nullConstant < 0) {
+    nullConstant = constant(Value::null());
+  }
+  return static_cast<uint32_t>(nullConstant);
+}
+
+void FunctionCompiler::emitThrow(const std::string &message) {
+  emit(Opcode::Throw, 0,
+       constant(Value(new (Generation::Permanent) StringVal(message))));
+}
+
+void FunctionCompiler::collectLocals(const NodeList<Stmt> &body) {
+  for (Stmt *stmt : body) {
+    switch (stmt->kind) {
+    case NodeType::VarDeclaration: {
+      auto declaration = static_cast<VarDeclaration *>(stmt);
+      addLocal(declaration->identifier, declaration->constant);
+      break;
+    }
+    case NodeType::FunctionDeclaration:
+      addLocal(static_cast<FunctionDeclaration *>(stmt)->name, true);
+      break;
+    case NodeType::StructDeclaration:
+      addLocal(static_cast<StructDeclaration *>(stmt)->structName, true);
+      break;
+    case NodeType::IfStatement: {
+      auto ifStmt = static_cast<IfStatement *>(stmt);
+      collectLocals(ifStmt->ifBody);
+      collectLocals(ifStmt->elseBody);
+      break;
+    }
+    case NodeType::WhileLoop:
+      collectLocals(static_cast<WhileLoop *>(stmt)->loopBody);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+void FunctionCompiler::addLocal(Symbol name, bool constant) {
+  auto found = locals.find(name);
+  if (found != locals.end()) {
+    found->second.constant = found->second.constant || constant;
+    return;
+  }
+  locals.emplace(name, LocalInfo{allocate(), constant});
+  proto.locals.emplace_back(name, locals[name].reg);
+  markFunctionLocal(name);
+}
+
+const LocalInfo *FunctionCompiler::findLocal(Symbol name) const {
+  auto found = locals.find(name);
+  return found == locals.end() ? nullptr : &found->second;
+}
+
+void FunctionCompiler::markDeclared(uint32_t reg) {
+  if (reg >= declared.size()) {
+    declared.resize(reg + 1);
+  }
+  if (!declared[reg]) {
+    declared[reg] = true;
+    declaredLog.push_back(reg);
+  }
+}
+
+void FunctionCompiler::restoreDeclared(size_t mark) {
+  while (declaredLog.size() > mark) {
+    declared[declaredLog.back()] = false;
+    declaredLog.pop_back();
+  }
+}
+
+void FunctionCompiler::declare(Symbol name, uint32_t value, bool constant) {
+  if (topLevel) {
+    emit(Opcode::DeclareGlobal, value, name, constant);
+    return;
+  }
+  uint32_t reg = findLocal(name)->reg;
+  emit(Opcode::DeclareLocal, reg, value, name);
+  markDeclared(reg);
+}
+
+void FunctionCompiler::compileProgram(const NodeList<Stmt> &body) {
+  completion = allocate();
+
+  if (body.empty()) {
+    emit(Opcode::LoadConst, completion, nullValue());
+  }
+
+  for (size_t i = 0; i < body.size(); i++) {
+    bool last = i + 1 == body.size();
+    topLevelResult = last ? completion : DISCARD;
+    compileStatement(body[i], topLevelResult);
+
+    for (size_t jump : topLevelReturns) {
+      patch(jump);
+    }
+    topLevelReturns.clear();
+  }
+
+  emit(Opcode::Return, completion);
+  fuse(completion + 1);
+}
+
+void FunctionCompiler::compileFunction(const FunctionDeclaration &declaration) {
+  proto.name = declaration.name;
+  proto.parameters = declaration.parameters;
+  proto.body = declaration.body;
+  proto.parameterCount = declaration.parameters.size();
+  if (declaration.memoizable) {
+    proto.memoized = &declaration;
+  }
+
+  // Arguments are copied into the first registers, so every parameter gets
+  // its own one even when a name is repeated.
+  for (Symbol parameter : declaration.parameters) {
+    uint32_t reg = allocate();
+    if (locals.emplace(parameter, LocalInfo{reg, false}).second) {
+      proto.locals.emplace_back(parameter, reg);
+      markFunctionLocal(parameter);
+    }
+    markDeclared(reg);
+  }
+  collectLocals(declaration.body);
+  std::sort(proto.locals.begin(), proto.locals.end());
+
+  completion = allocate();
+  compileBlock(declaration.body, completion);
+  emit(Opcode::Return, completion);
+  fuse(completion + 1);
+}
+
+void FunctionCompiler::compileBlock(const NodeList<Stmt> &body,
+                                   int64_t result) {
+  if (body.empty()) {
+    if (result != DISCARD) {
+      emit(Opcode::LoadConst, result, nullValue());
+    }
+    return;
+  }
+
+  size_t mark = declaredLog.size();
+  for (size_t i = 0; i < body.size(); i++) {
+    // Only the last statement of a block can decide its value.
+    compileStatement(body[i], i + 1 == body.size() ? result : DISCARD);
+  }
+  restoreDeclared(mark);
+}
+
+void FunctionCompiler::compileStatement(Stmt *stmt, int64_t result) {
+  uint32_t mark = nextRegister;
+
+  switch (stmt->kind) {
+  case NodeType::VarDeclaration: {
+    auto declaration = static_cast<VarDeclaration *>(stmt);
+    uint32_t value = result != DISCARD ? result : allocate();
+    if (declaration->value != nullptr) {
+      compileInto(declaration->value, value);
+    } else {
+      emit(Opcode::LoadConst, value, nullValue());
+    }
+    declare(declaration->identifier, value, declaration->constant);
+    break;
+  }
+  case NodeType::FunctionDeclaration: {
+    auto declaration = static_cast<FunctionDeclaration *>(stmt);
+    uint32_t index = static_cast<uint32_t>(program.functions.size());
+    program.functions.push_back(std::make_unique<FunctionProto>());
+    FunctionCompiler(program, *program.functions.back(), false)
+        .compileFunction(*declaration);
+
+    uint32_t value = result != DISCARD ? result : allocate();
+    emit(Opcode::MakeFunction, value, index);
+    declare(declaration->name, value, true);
+    break;
+  }
+  case NodeType::StructDeclaration: {
+    auto declaration = static_cast<StructDeclaration *>(stmt);
+    uint32_t value = result != DISCARD ? result : allocate();
+    compileStructDeclaration(declaration, value);
+    declare(declaration->structName, value, true);
+    break;
+  }
+  case NodeType::IfStatement:
+    compileIf(static_cast<IfStatement *>(stmt), result);
+    break;
+  case NodeType::WhileLoop:
+    compileWhile(static_cast<WhileLoop *>(stmt), result);
+    break;
+  case NodeType::ReturnStatement:
+    compileReturn(static_cast<ReturnStatement *>(stmt), result);
+    break;
+  default:
+    if (result != DISCARD) {
+      compileInto(static_cast<Expr *>(stmt), result);
+    } else {
+      compileOperand(static_cast<Expr *>(stmt));
+    }
+    break;
+  }
+
+  nextRegister = mark;
+}
+
+void FunctionCompiler::compileStructDeclaration(StructDeclaration *declaration,
+                                                uint32_t value) {
+  emit(Opcode::NewStruct, value, declaration->structName);
+
+  for (Stmt *stmt : declaration->structBody) {
+    if (stmt->kind != NodeType::VarDeclaration) {
+      continue;
+    }
+    auto field = static_cast<VarDeclaration *>(stmt);
+    uint32_t mark = nextRegister;
+    uint32_t fieldValue = allocate();
+    if (field->value != nullptr) {
+      compileInto(field->value, fieldValue);
+    } else {
+      emit(Opcode::LoadConst, fieldValue, nullValue());
+    }
+    emit(Opcode::AddField, value, fieldValue, field->identifier);
+    nextRegister = mark;
+  }
+}
+
+void FunctionCompiler::compileIf(IfStatement *ifStmt, int64_t result) {
+  uint32_t mark = nextRegister;
+  uint32_t condition = compileOperand(ifStmt->condition);
+  size_t toElse = emit(Opcode::JumpIfFalse, condition);
+  nextRegister = mark;
+
+  compileBlock(ifStmt->ifBody, result);
+
+  if (ifStmt->elseBody.empty() && result == DISCARD) {
+    patch(toElse);
+    return;
+  }
+
+  size_t toEnd = emit(Opcode::Jump);
+  patch(toElse);
+  // Without an else branch a false condition makes the if evaluate to null.
+  compileBlock(ifStmt->elseBody, result);
+  patch(toEnd);
+}
+
+void FunctionCompiler::compileWhile(WhileLoop *loop, int64_t result) {
+  // A loop that never runs its body evaluates to null.
+  if (result != DISCARD) {
+    emit(Opcode::LoadConst, result, nullValue());
+  }
+
+  uint32_t mark = nextRegister;
+  size_t top = proto.code.size();
+  uint32_t condition = compileOperand(loop->condition);
+  size_t exit = emit(Opcode::JumpUnlessOne, condition);
+  nextRegister = mark;
+
+  compileBlock(loop->loopBody, result);
+  emit(Opcode::Jump, 0, static_cast<uint32_t>(top));
+  patch(exit);
+}
+
+void FunctionCompiler::compileReturn(ReturnStatement *returnStmt,
+                                     int64_t result) {
+  // A bare return does not leave anything, it only evaluates to null.
+  if (returnStmt->returnValue == nullptr) {
+    if (result != DISCARD) {
+      emit(Opcode::LoadConst, result, nullValue());
+    }
+    return;
+  }
+
+  if (topLevel) {
+    compileStatement(returnStmt->returnValue, topLevelResult);
+    topLevelReturns.push_back(emit(Opcode::Jump));
+    return;
+  }
+
+  uint32_t value;
+  if (returnStmt->returnValue->kind >= NodeType::AssignmentExpr) {
+    value = compileOperand(static_cast<Expr *>(returnStmt->returnValue));
+  } else {
+    value = allocate();
+    compileStatement(returnStmt->returnValue, value);
+  }
+  emit(Opcode::Return, value);
+}
+
+uint32_t FunctionCompiler::compileOperand(Expr *expr) {
+  if (expr->kind == NodeType::Identifier && !topLevel) {
+    const LocalInfo *local =
+        findLocal(static_cast<IdentifierExpr *>(expr)->symbol);
+    if (local != nullptr && local->reg < declared.size() &&
+        declared[local->reg]) {
+      return local->reg;
+    }
+  }
+
+  if (expr->kind == NodeType::AssignmentExpr) {
+    return compileAssignment(static_cast<AssignmentExpr *>(expr));
+  }
+
+  uint32_t reg = allocate();
+  compileInto(expr, reg);
+  return reg;
+}
+
+void FunctionCompiler::compileInto(Expr *expr, uint32_t dst) {
+  uint32_t mark = nextRegister;
+
+  switch (expr->kind) {
+  case NodeType::NumericLiteral:
+    emit(Opcode::LoadConst, dst,
+         numberConstant(static_cast<NumericLiteral *>(expr)->value));
+    break;
+  case NodeType::StrLiteral:
+    emit(Opcode::LoadConst, dst,
+         constant(Value(new (Generation::Permanent) StringVal(
+             static_cast<StrLiteral *>(expr)))));
+    break;
+  case NodeType::Null:
+    emit(Opcode::LoadConst, dst, nullValue());
+    break;
+  case NodeType::Identifier: {
+    Symbol name = static_cast<IdentifierExpr *>(expr)->symbol;
+    const LocalInfo *local = topLevel ? nullptr : findLocal(name);
+    if (local == nullptr) {
+      emit(Opcode::GetGlobal, dst, name);
+    } else if (local->reg < declared.size() && declared[local->reg]) {
+      if (local->reg != dst) {
+        emit(Opcode::Move, dst, local->reg);
+      }
+    } else {
+      emit(Opcode::GetLocal, dst, local->reg, name);
+    }
+    break;
+  }
+  case NodeType::BinaryExpr: {
+    auto binary = static_cast<BinaryExpr *>(expr);
+    uint32_t left = compileOperand(binary->left);
+    uint32_t right = compileOperand(binary->right);
+
+    Opcode op;
+    switch (binary->binaryOperator) {
+    case Operator::Add:
+      op = Opcode::Add;
+      break;
+    case Operator::Subtract:
+      op = Opcode::Subtract;
+      break;
+    case Operator::Multiply:
+      op = Opcode::Multiply;
+      break;
+    case Operator::Divide:
+      op = Opcode::Divide;
+      break;
+    case Operator::Modulo:
+      op = Opcode::Modulo;
+      break;
+    case Operator::Less:
+      op = Opcode::Less;
+      break;
+    case Operator::LessEqual:
+      op = Opcode::LessEqual;
+      break;
+    case Operator::Greater:
+      op = Opcode::Greater;
+      break;
+    case Operator::GreaterEqual:
+      op = Opcode::GreaterEqual;
+      break;
+    case Operator::Equal:
+      op = Opcode::Equal;
+      break;
+    case Operator::NotEqual:
+      op = Opcode::NotEqual;
+      break;
+    default:
+      // The evaluator leaves null for operators it does not know.
+      emit(Opcode::LoadConst, dst, nullValue());
+      nextRegister = mark;
+      return;
+    }
+    emit(op, dst, left, right);
+    break;
+  }
+  case NodeType::LogicalExpr: {
+    auto logical = static_cast<LogicalExpr *>(expr);
+    // Both sides are always evaluated, there is no short circuit.
+    uint32_t left = compileOperand(logical->left);
+    uint32_t right = compileOperand(logical->right);
+    if (logical->logicalOperator == Operator::And) {
+      emit(Opcode::And, dst, left, right);
+    } else if (logical->logicalOperator == Operator::Or) {
+      emit(Opcode::Or, dst, left, right);
+    } else {
+      emitThrow(std::string("Invalid logical operator: ") +
+                OperatorToString(logical->logicalOperator));
+    }
+    break;
+  }
+  case NodeType::UnaryExpr: {
+    auto unary = static_cast<UnaryExpr *>(expr);
+    uint32_t operand = compileOperand(unary->right);
+    if (unary->op == Operator::Not) {
+      emit(Opcode::Not, dst, operand);
+    } else if (unary->op == Operator::Negate) {
+      emit(Opcode::Negate, dst, operand);
+    } else {
+      emitThrow(std::string("Unsupported unary operator: ") +
+                OperatorToString(unary->op));
+    }
+    break;
+  }
+  case NodeType::AssignmentExpr: {
+    uint32_t value = compileAssignment(static_cast<AssignmentExpr *>(expr));
+    if (value != dst) {
+      emit(Opcode::Move, dst, value);
+    }
+    break;
+  }
+  case NodeType::CallExpr:
+    compileCall(static_cast<CallExpr *>(expr), dst);
+    break;
+  case NodeType::MemberAccessExpr: {
+    auto member = static_cast<MemberAccessExpr *>(expr);
+    uint32_t object = compileOperand(member->object);
+    emit(Opcode::GetField, dst, object, fieldSite(member->memberName));
+    break;
+  }
+  default:
+    emitThrow("This AST Node has not yet been set up for interpretation.");
+    break;
+  }
+
+  nextRegister = mark;
+}
+
+uint32_t FunctionCompiler::compileAssignment(AssignmentExpr *assignment) {
+  if (assignment->assigne->kind == NodeType::MemberAccessExpr) {
+    auto member = static_cast<MemberAccessExpr *>(assignment->assigne);
+    uint32_t object = compileOperand(member->object);
+    uint32_t value = compileOperand(assignment->value);
+    emit(Opcode::SetField, object, value, fieldSite(member->memberName));
+    return value;
+  }
+
+  if (assignment->assigne->kind != NodeType::Identifier) {
+    emitThrow("Invalid LHS inside assignment expr");
+    return allocate();
+  }
+
+  Symbol name = static_cast<IdentifierExpr *>(assignment->assigne)->symbol;
+  const LocalInfo *local = topLevel ? nullptr : findLocal(name);
+
+  if (local == nullptr) {
+    uint32_t value = compileOperand(assignment->value);
+    emit(Opcode::SetGlobal, value, name);
+    return value;
+  }
+
+  // Every subexpression is evaluated into a temporary and the register
+  // passed to compileInto is only written last, so a declared local can be
+  // the destination of its own new value.
+  if (!local->constant && local->reg < declared.size() &&
+      declared[local->reg]) {
+    compileInto(assignment->value, local->reg);
+    return local->reg;
+  }
+
+  uint32_t value = compileOperand(assignment->value);
+  emit(local->constant ? Opcode::SetConstLocal : Opcode::SetLocal, local->reg,
+       value, name);
+  return value;
+}
+
+void FunctionCompiler::compileCall(CallExpr *call, uint32_t dst) {
+  uint32_t count = call->args.size();
+  uint32_t callee = allocate(count + 1);
+
+  // Arguments are evaluated before the callee, as in the evaluator.
+  for (uint32_t i = 0; i < count; i++) {
+    compileInto(call->args[i], callee + 1 + i);
+  }
+  compileInto(call->caller, callee);
+
+  emit(call->tailCall ? Opcode::TailCall : Opcode::Call, dst, callee, count);
+}
+
+void FunctionCompiler::fuse(uint32_t firstTemporary) {
+  std::vector<Instruction> &code = proto.code;
+  std::vector<bool> isTarget(code.size() + 1);
+  for (const Instruction &ins : code) {
+    if (ins.op == Opcode::Jump || ins.op == Opcode::JumpIfFalse ||
+        ins.op == Opcode::JumpUnlessOne) {
+      isTarget[ins.b] = true;
+    }
+  }
+
+  auto isTemporary = [firstTemporary](uint32_t reg) {
+    return reg >= firstTemporary;
+  };
+  auto isBranch = [&code](size_t i, uint32_t condition) {
+    return (code[i].op == Opcode::JumpIfFalse ||
+            code[i].op == Opcode::JumpUnlessOne) &&
+           code[i].a == condition;
+  };
+  auto isNumberConstant = [this](uint32_t index, bool zero) {
+    Value value = proto.constants[index];
+    return value.isNumber() && (!zero || value.asNumber() == 0);
+  };
+
+  for (size_t i = 0; i + 1 < code.size(); i++) {
+    Instruction &ins = code[i];
+    const Instruction &next = code[i + 1];
+    if (isTarget[i + 1]) {
+      continue;
+    }
+
+    switch (ins.op) {
+    case Opcode::LoadConst:
+      if ((next.op == Opcode::Add || next.op == Opcode::Subtract) &&
+          next.c == ins.a && next.b != ins.a && isTemporary(ins.a) &&
+          isNumberConstant(ins.b, false)) {
+        ins.op =
+            next.op == Opcode::Add ? Opcode::AddConst : Opcode::SubtractConst;
+        fused.constants++;
+        i++;
+      }
+      break;
+    case Opcode::Modulo: {
+      if (i + 3 >= code.size() || isTarget[i + 2] || isTarget[i + 3]) {
+        break;
+      }
+      const Instruction &test = code[i + 2];
+      bool comparesWithZero =
+          next.op == Opcode::LoadConst && isNumberConstant(next.b, true) &&
+          (test.op == Opcode::Equal || test.op == Opcode::NotEqual) &&
+          ((test.b == ins.a && test.c == next.a) ||
+           (test.b == next.a && test.c == ins.a));
+      if (comparesWithZero && ins.a != next.a && isTemporary(ins.a) &&
+          isTemporary(next.a) && isTemporary(test.a) &&
+          isBranch(i + 3, test.a)) {
+        ins.op = Opcode::BranchModuloZero;
+        fused.moduloTests++;
+        i += 3;
+      }
+      break;
+    }
+    case Opcode::Less:
+    case Opcode::LessEqual:
+    case Opcode::Greater:
+    case Opcode::GreaterEqual:
+    case Opcode::Equal:
+    case Opcode::NotEqual:
+      if (isTemporary(ins.a) && isBranch(i + 1, ins.a)) {
+        // Both groups of opcodes are in the same order.
+        ins.op = static_cast<Opcode>(
+            static_cast<uint8_t>(Opcode::BranchLess) +
+            (static_cast<uint8_t>(ins.op) - static_cast<uint8_t>(Opcode::Less)));
+        fused.branches++;
+        i++;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+} // namespace
+
+FuseStats Compiler::fuseStats() { return fused; }
+
+void Compiler::printFuseStats(std::ostream &out) {
+  out << "Fused: " << fused.constants << " constant additions, "
+      << fused.branches << " compare and branch, " << fused.moduloTests
+      << " modulo tests" << std::endl;
+}
+
+std::unique_ptr<CompiledProgram> Compiler::compile(const Program &program) {
+  try {
+    std::unique_ptr<CompiledProgram> compiled =
+        std::make_unique<CompiledProgram>();
+    compiled->functions.push_back(std::make_unique<FunctionProto>());
+
+    FunctionCompiler(*compiled, *compiled->functions[0], true)
+        .compileProgram(program.body);
+
+    return compiled;
+  } catch (const InterpreterError &e) {
+    throw;
+  }
+}
@@ -0,0 +1,40 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "../../ast/AST.h"
+#include "Bytecode.h"
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+// Translates a Program into register bytecode for the VM.
+//
+// Names declared at the top level live in the global Environment, exactly as
+// with the evaluator. Inside a function, parameters and everything declared
+// with let, const, func or struct get a register of the frame instead.
+//
+// A peephole pass over every compiled function then puts superinstructions
+// (see Bytecode.h) in place of the sequences loops spend their time in:
+//  - a constant added to or subtracted from a value, as in i = i + 1,
+//  - a comparison a while or an if branches on, as in while (i <= n),
+//  - a remainder compared with 0 to branch on, as in if (a % b == 0).
+// Only sequences whose intermediate results go to temporaries and that no
+// jump enters halfway are fused.
+
+// Sequences fused by every compilation of a run.
+struct FuseStats {
+  uint64_t constants = 0;
+  uint64_t branches = 0;
+  uint64_t moduloTests = 0;
+};
+
+class Compiler {
+public:
+  static std::unique_ptr<CompiledProgram> compile(const Program &program);
+
+  static FuseStats fuseStats();
+  static void printFuseStats(std::ostream &out);
+};
+
+#endif
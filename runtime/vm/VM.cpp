@@ -0,0 +1,568 @@
+#include "VM.h"
+#include "../jit/Jit.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Computed goto jumps straight from one instruction handler to the next
+// instead of going back through a switch, compilers without the extension
+// use the switch.
+#if defined(__GNUC__)
+#define RUSTEDC_COMPUTED_GOTO
+#endif
+
+static const double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+// Remainder of two numbers, right not 0.
+static double remainderOf(double left, double right) {
+  // fmod is slow, and for whole numbers below 2^53 integer remainder gives
+  // the same result. A negative dividend can produce -0, so it is left to
+  // fmod.
+  if (left >= 0 && left < MAX_EXACT_INTEGER &&
+      std::fabs(right) < MAX_EXACT_INTEGER && left == std::trunc(left) &&
+      right == std::trunc(right)) {
+    return static_cast<double>(static_cast<int64_t>(left) %
+                               static_cast<int64_t>(right));
+  }
+  return fmod(left, right);
+}
+
+VM::VM(const CompiledProgram &program, Environment *env)
+    : program(program), env(env),
+      registerFile(static_cast<Value *>(
+          ::operator new(REGISTER_FILE_SIZE * sizeof(Value)))),
+      liveRegisters{registerFile.get(), registerFile.get()} {
+  frames.reserve(64);
+}
+
+Value VM::execute(const CompiledProgram &program, Environment *env) {
+  try {
+    VM vm(program, env);
+    return vm.run();
+  } catch (const InterpreterError &e) {
+    throw;
+  }
+}
+
+Value *VM::findInFrames(Symbol name, size_t frameCount) {
+  if (!isFunctionLocal(name)) {
+    return nullptr;
+  }
+
+  for (size_t i = frameCount; i-- > 0;) {
+    int64_t reg = frames[i].proto->findLocal(name);
+    if (reg >= 0 && !frames[i].registers[reg].isEmpty()) {
+      return &frames[i].registers[reg];
+    }
+  }
+
+  return nullptr;
+}
+
+Value VM::lookupName(Symbol name, size_t frameCount) {
+  Value *slot = findInFrames(name, frameCount);
+  if (slot != nullptr) {
+    return *slot;
+  }
+  return env->lookupVar(name);
+}
+
+void VM::assignName(Symbol name, Value value, size_t frameCount) {
+  Value *slot = findInFrames(name, frameCount);
+  if (slot != nullptr) {
+    *slot = value;
+    return;
+  }
+  // A function assigns the globals like the evaluator, see assignOuterVar.
+  if (frameCount > 0) {
+    env->assignOuterVar(name, value);
+  } else {
+    env->assignVar(name, value);
+  }
+}
+
+Value *VM::enterFunction(const FnVal *fn, Value *callerRegisters, Value *args,
+                         uint32_t count, const Instruction *returnAddress,
+                         uint32_t returnRegister) {
+  const FunctionProto *callee = fn->proto;
+  if (callee == nullptr) {
+    throw InterpreterError("Function " + SymbolTable::name(fn->name) +
+                           " was not compiled to bytecode");
+  }
+
+  Value *registers = callerRegisters + frames.back().proto->registerCount;
+  if (registers + callee->registerCount >
+      registerFile.get() + REGISTER_FILE_SIZE) {
+    throw InterpreterError("Stack overflow in function " +
+                           SymbolTable::name(fn->name));
+  }
+
+  // An empty value marks a local that is not declared yet.
+  std::fill(registers, registers + callee->registerCount, Value());
+
+  uint32_t passed = std::min(count, callee->parameterCount);
+  std::copy(args, args + passed, registers);
+
+  frames.push_back({callee, registers, returnAddress, returnRegister});
+
+  // The evaluator does not declare parameters that got no argument, reading
+  // one finds the name in a caller instead. It is resolved once, here.
+  for (uint32_t i = passed; i < callee->parameterCount; i++) {
+    registers[i] = lookupName(callee->parameters[i], frames.size() - 1);
+  }
+
+  return registers;
+}
+
+Value VM::run() {
+  const FunctionProto *proto = program.functions[0].get();
+  Value *regs = registerFile.get();
+  std::fill(regs, regs + proto->registerCount, Value());
+  frames.push_back({proto, regs, nullptr, 0});
+  GcRoot registersRoot(liveRegisters);
+
+  const Instruction *code = proto->code.data();
+  const Value *k = proto->constants.data();
+  const Instruction *pc = code;
+  const Instruction *ins;
+
+#ifdef RUSTEDC_COMPUTED_GOTO
+  static void *const dispatchTable[] = {
+#define RUSTEDC_OPCODE_LABEL(name) &&op_##name,
+      RUSTEDC_OPCODES(RUSTEDC_OPCODE_LABEL)
+#undef RUSTEDC_OPCODE_LABEL
+  };
+#define CASE(name) op_##name:
+#define NEXT goto *dispatchTable[static_cast<uint8_t>((ins = pc++)->op)]
+  NEXT;
+#else
+#define CASE(name) case Opcode::name:
+#define NEXT continue
+  for (;;) {
+    ins = pc++;
+    switch (ins->op) {
+#endif
+
+// Collections happen on jumps and calls only, which every loop and every
+// recursion passes through.
+#define SAFEPOINT()                                                            \
+  if (Heap::collectionPending()) {                                             \
+    liveRegisters.end = regs + proto->registerCount;                          \
+    Heap::collect();                                                           \
+  }
+
+// Hands the frame over to machine code of its function, which returns the
+// index of the instruction it stopped at. Hot spots are the entry of a
+// function and the back edge of a loop.
+#define ENTER_NATIVE()                                                         \
+  if (proto->native) {                                                         \
+    pc = code + proto->native->run(regs, static_cast<uint32_t>(pc - code));   \
+  }
+#define HOT_SPOT()                                                             \
+  if (Jit::enabled()) {                                                        \
+    Jit::countUse(*proto);                                                     \
+    ENTER_NATIVE();                                                            \
+  }
+
+#define ARITHMETIC(name, operation)                                            \
+  CASE(name) {                                                                 \
+    Value lhs = regs[ins->b];                                                  \
+    Value rhs = regs[ins->c];                                                  \
+    if (lhs.isNumber() && rhs.isNumber()) {                                    \
+      double left = lhs.asNumber();                                            \
+      double right = rhs.asNumber();                                           \
+      regs[ins->a] = Value(operation);                                         \
+    } else {                                                                   \
+      regs[ins->a] = Value::null();                                            \
+    }                                                                          \
+    NEXT;                                                                      \
+  }
+
+// Comparisons produce the numbers 0 and 1, like the evaluator.
+#define COMPARISON(name, operation)                                            \
+  ARITHMETIC(name, (operation) ? 1.0 : 0.0)
+
+// Superinstructions, see Compiler.h. The instructions they stand for follow
+// them, pc points to the first of those.
+#define CONSTANT_ARITHMETIC(name, operation)                                   \
+  CASE(name) {                                                                 \
+    Value lhs = regs[pc->b];                                                   \
+    if (lhs.isNumber()) {                                                      \
+      double left = lhs.asNumber();                                            \
+      double right = k[ins->b].asNumber();                                     \
+      regs[pc->a] = Value(operation);                                          \
+      pc++;                                                                    \
+    } else {                                                                   \
+      regs[ins->a] = k[ins->b];                                                \
+    }                                                                          \
+    NEXT;                                                                      \
+  }
+
+// A comparison of numbers is 0 or 1, so JumpIfFalse and JumpUnlessOne both
+// branch when it is false.
+#define BRANCH(name, operation)                                                \
+  CASE(name) {                                                                 \
+    Value lhs = regs[ins->b];                                                  \
+    Value rhs = regs[ins->c];                                                  \
+    if (lhs.isNumber() && rhs.isNumber()) {                                    \
+      double left = lhs.asNumber();                                            \
+      double right = rhs.asNumber();                                           \
+      pc = (operation) ? pc + 1 : code + pc->b;                                \
+    } else {                                                                   \
+      regs[ins->a] = Value::null();                                            \
+    }                                                                          \
+    NEXT;                                                                      \
+  }
+
+  CASE(LoadConst) {
+    regs[ins->a] = k[ins->b];
+    NEXT;
+  }
+
+  CASE(Move) {
+    regs[ins->a] = regs[ins->b];
+    NEXT;
+  }
+
+  CASE(GetLocal) {
+    Value value = regs[ins->b];
+    if (value.isEmpty()) {
+      value = lookupName(ins->c, frames.size() - 1);
+    }
+    regs[ins->a] = value;
+    NEXT;
+  }
+
+  CASE(SetLocal) {
+    if (!regs[ins->a].isEmpty()) {
+      regs[ins->a] = regs[ins->b];
+    } else {
+      assignName(ins->c, regs[ins->b], frames.size() - 1);
+    }
+    NEXT;
+  }
+
+  CASE(SetConstLocal) {
+    if (!regs[ins->a].isEmpty()) {
+      throw InterpreterError("Cannot reassign to variable " +
+                             SymbolTable::name(ins->c) +
+                             " as it was declared constant.");
+    }
+    assignName(ins->c, regs[ins->b], frames.size() - 1);
+    NEXT;
+  }
+
+  CASE(DeclareLocal) {
+    if (!regs[ins->a].isEmpty()) {
+      throw InterpreterError("Cannot declare variable " +
+                             SymbolTable::name(ins->c) +
+                             ". It is already defined.");
+    }
+    regs[ins->a] = regs[ins->b];
+    NEXT;
+  }
+
+  CASE(GetGlobal) {
+    regs[ins->a] = frames.size() > 1 ? lookupName(ins->b, frames.size() - 1)
+                                     : env->lookupVar(ins->b);
+    NEXT;
+  }
+
+  CASE(SetGlobal) {
+    assignName(ins->b, regs[ins->a], frames.size() - 1);
+    NEXT;
+  }
+
+  CASE(DeclareGlobal) {
+    env->declareVar(ins->b, regs[ins->a], ins->c != 0);
+    NEXT;
+  }
+
+  ARITHMETIC(Add, left + right)
+  ARITHMETIC(Subtract, left - right)
+  ARITHMETIC(Multiply, left * right)
+  COMPARISON(Less, left < right)
+  COMPARISON(LessEqual, left <= right)
+  COMPARISON(Greater, left > right)
+  COMPARISON(GreaterEqual, left >= right)
+  COMPARISON(Equal, left == right)
+  COMPARISON(NotEqual, left != right)
+
+  CASE(Divide) {
+    Value lhs = regs[ins->b];
+    Value rhs = regs[ins->c];
+    if (lhs.isNumber() && rhs.isNumber()) {
+      if (rhs.asNumber() == 0) {
+        throw InterpreterError("Division by zero error");
+      }
+      regs[ins->a] = Value(lhs.asNumber() / rhs.asNumber());
+    } else {
+      regs[ins->a] = Value::null();
+    }
+    NEXT;
+  }
+
+  CASE(Modulo) {
+    Value lhs = regs[ins->b];
+    Value rhs = regs[ins->c];
+    if (lhs.isNumber() && rhs.isNumber()) {
+      if (rhs.asNumber() == 0) {
+        throw InterpreterError("Modulo by zero error");
+      }
+      regs[ins->a] = Value(remainderOf(lhs.asNumber(), rhs.asNumber()));
+    } else {
+      regs[ins->a] = Value::null();
+    }
+    NEXT;
+  }
+
+  CASE(And) {
+    Value lhs = regs[ins->b];
+    Value rhs = regs[ins->c];
+    if (!lhs.isNumber() || !rhs.isNumber()) {
+      throw InterpreterError("Invalid operands for logical expression");
+    }
+    regs[ins->a] = Value(lhs.asNumber() && rhs.asNumber() ? 1.0 : 0.0);
+    NEXT;
+  }
+
+  CASE(Or) {
+    Value lhs = regs[ins->b];
+    Value rhs = regs[ins->c];
+    if (!lhs.isNumber() || !rhs.isNumber()) {
+      throw InterpreterError("Invalid operands for logical expression");
+    }
+    regs[ins->a] = Value(lhs.asNumber() || rhs.asNumber() ? 1.0 : 0.0);
+    NEXT;
+  }
+
+  CASE(Not) {
+    Value operand = regs[ins->b];
+    if (!operand.isNumber()) {
+      throw InterpreterError("Unsupported unary operator: !");
+    }
+    regs[ins->a] = Value(operand.asNumber() == 0 ? 1.0 : 0.0);
+    NEXT;
+  }
+
+  CASE(Negate) {
+    Value operand = regs[ins->b];
+    if (!operand.isNumber()) {
+      throw InterpreterError("Unsupported unary operator: -");
+    }
+    regs[ins->a] = Value(-operand.asNumber());
+    NEXT;
+  }
+
+  CASE(Jump) {
+    pc = code + ins->b;
+    SAFEPOINT();
+    if (pc <= ins) {
+      HOT_SPOT();
+    }
+    NEXT;
+  }
+
+  CASE(JumpIfFalse) {
+    Value condition = regs[ins->a];
+    if (!condition.isNumber()) {
+      throw InterpreterError(
+          "If statement condition must evaluate to a numeric value.");
+    }
+    if (condition.asNumber() == 0) {
+      pc = code + ins->b;
+    }
+    NEXT;
+  }
+
+  CASE(JumpUnlessOne) {
+    Value condition = regs[ins->a];
+    if (!condition.isNumber()) {
+      throw InterpreterError(
+          "While loop condition must evaluate to a numeric value.");
+    }
+    if (condition.asNumber() != 1) {
+      pc = code + ins->b;
+    }
+    NEXT;
+  }
+
+  CASE(GetField) {
+    Value object = regs[ins->b];
+    if (object.type() != ValueType::StructValue) {
+      throw InterpreterError(
+          "Error: Member access is only supported for structs.");
+    }
+    FunctionProto::FieldSite &site = proto->fieldSites[ins->c];
+    regs[ins->a] = object.as<StructVal>()->getField(site.name, site.cache);
+    NEXT;
+  }
+
+  CASE(SetField) {
+    Value object = regs[ins->a];
+    if (object.type() != ValueType::StructValue) {
+      throw InterpreterError(
+          "Error: Member access is only supported for structs.");
+    }
+    FunctionProto::FieldSite &site = proto->fieldSites[ins->c];
+    object.as<StructVal>()->setField(site.name, regs[ins->b], site.cache);
+    NEXT;
+  }
+
+  CASE(NewStruct) {
+    regs[ins->a] = Value(new StructVal(SymbolTable::name(ins->b), true));
+    NEXT;
+  }
+
+  CASE(AddField) {
+    regs[ins->a].as<StructVal>()->addField(ins->c, regs[ins->b]);
+    NEXT;
+  }
+
+  CASE(MakeFunction) {
+    const FunctionProto *function = program.functions[ins->b].get();
+    FnVal *fn = new FnVal(function->name, function->parameters, env,
+                          function->body, function);
+    fn->memoized = function->memoized;
+    regs[ins->a] = Value(fn);
+    NEXT;
+  }
+
+  CASE(TailCall) {
+    // The call of a return whose function nobody looks into any more (see
+    // ast/ResolverAST.h). A bytecode callee that gets all of its arguments
+    // takes over the frame, keeping its return address.
+    Value callee = regs[ins->b];
+    if (callee.type() == ValueType::Function &&
+        callee.as<FnVal>()->proto != nullptr &&
+        ins->c >= callee.as<FnVal>()->proto->parameterCount) {
+      const FunctionProto *target = callee.as<FnVal>()->proto;
+      if (regs + target->registerCount >
+          registerFile.get() + REGISTER_FILE_SIZE) {
+        throw InterpreterError("Stack overflow in function " +
+                               SymbolTable::name(target->name));
+      }
+
+      Value *args = regs + ins->b + 1;
+      std::copy(args, args + target->parameterCount, regs);
+      std::fill(regs + target->parameterCount, regs + target->registerCount,
+                Value());
+
+      frames.back().proto = target;
+      proto = target;
+      code = proto->code.data();
+      k = proto->constants.data();
+      pc = code;
+      SAFEPOINT();
+      HOT_SPOT();
+      NEXT;
+    }
+    // Any other callee falls through to an ordinary call.
+  }
+
+  CASE(Call) {
+    Value callee = regs[ins->b];
+    Value *args = regs + ins->b + 1;
+
+    switch (callee.type()) {
+    case ValueType::Function: {
+      FnVal *fn = callee.as<FnVal>();
+      if (fn->memoized != nullptr) {
+        MemoCall call{frames.size() + 1, {}};
+        if (Memo::makeKey(fn->memoized, args, ins->c, call.key)) {
+          if (Memo::lookup(call.key, regs[ins->a])) {
+            break;
+          }
+          memoCalls.push_back(call);
+        }
+      }
+      regs = enterFunction(fn, regs, args, ins->c, pc, ins->a);
+      proto = fn->proto;
+      code = proto->code.data();
+      k = proto->constants.data();
+      pc = code;
+      SAFEPOINT();
+      HOT_SPOT();
+      break;
+    }
+    case ValueType::NativeFunction:
+      regs[ins->a] = callee.as<NativeFnVal>()->call(
+          std::vector<Value>(args, args + ins->c), env);
+      break;
+    case ValueType::StructValue:
+      regs[ins->a] = Value(callee.as<StructVal>()->instantiate(
+          std::vector<Value>(args, args + ins->c)));
+      break;
+    default:
+      throw InterpreterError("Cannot call value that is not a function");
+    }
+    NEXT;
+  }
+
+  CASE(Return) {
+    Value result = regs[ins->a];
+    if (!memoCalls.empty() && memoCalls.back().depth == frames.size()) {
+      Memo::store(memoCalls.back().key, result);
+      memoCalls.pop_back();
+    }
+    Frame finished = frames.back();
+    frames.pop_back();
+
+    if (frames.empty()) {
+      return result;
+    }
+
+    proto = frames.back().proto;
+    regs = frames.back().registers;
+    code = proto->code.data();
+    k = proto->constants.data();
+    pc = finished.returnAddress;
+    regs[finished.returnRegister] = result;
+    ENTER_NATIVE();
+    NEXT;
+  }
+
+  CASE(Throw) {
+    throw InterpreterError(k[ins->b].as<StringVal>()->value);
+  }
+
+  CONSTANT_ARITHMETIC(AddConst, left + right)
+  CONSTANT_ARITHMETIC(SubtractConst, left - right)
+  BRANCH(BranchLess, left < right)
+  BRANCH(BranchLessEqual, left <= right)
+  BRANCH(BranchGreater, left > right)
+  BRANCH(BranchGreaterEqual, left >= right)
+  BRANCH(BranchEqual, left == right)
+  BRANCH(BranchNotEqual, left != right)
+
+  CASE(BranchModuloZero) {
+    // pc is the LoadConst of 0, the comparison and the jump follow it.
+    Value lhs = regs[ins->b];
+    Value rhs = regs[ins->c];
+    if (lhs.isNumber() && rhs.isNumber() && rhs.asNumber() != 0) {
+      bool zero = remainderOf(lhs.asNumber(), rhs.asNumber()) == 0;
+      bool condition = pc[1].op == Opcode::Equal ? zero : !zero;
+      pc = condition ? pc + 3 : code + pc[2].b;
+    } else if (lhs.isNumber() && rhs.isNumber()) {
+      throw InterpreterError("Modulo by zero error");
+    } else {
+      regs[ins->a] = Value::null();
+    }
+    NEXT;
+  }
+
+#ifndef RUSTEDC_COMPUTED_GOTO
+    }
+  }
+#endif
+
+#undef ARITHMETIC
+#undef COMPARISON
+#undef CONSTANT_ARITHMETIC
+#undef BRANCH
+#undef SAFEPOINT
+#undef ENTER_NATIVE
+#undef HOT_SPOT
+#undef CASE
+#undef NEXT
+}
@@ -0,0 +1,69 @@
+#ifndef VM_H
+#define VM_H
+
+#include "../environment/Environment.h"
+#include "../gc/Heap.h"
+#include "../memo/Memo.h"
+#include "../values/Values.h"
+#include "Bytecode.h"
+
+#include <memory>
+#include <vector>
+
+// Executes a CompiledProgram. Calls between compiled functions do not recurse
+// on the C++ stack: every call pushes a Frame and its registers are a window
+// of one register file shared by the whole run.
+class VM {
+public:
+  static Value execute(const CompiledProgram &program, Environment *env);
+
+private:
+  struct Frame {
+    const FunctionProto *proto;
+    Value *registers;
+    // Where the caller continues and which of its registers gets the result.
+    const Instruction *returnAddress;
+    uint32_t returnRegister;
+  };
+
+  // A memoized call, whose result is stored when the frame at depth returns.
+  struct MemoCall {
+    size_t depth;
+    Memo::Key key;
+  };
+
+  static const size_t REGISTER_FILE_SIZE = 1 << 20;
+
+  struct RawDelete {
+    void operator()(Value *values) const { ::operator delete(values); }
+  };
+
+  VM(const CompiledProgram &program, Environment *env);
+
+  Value run();
+
+  // Names a function reads or assigns without declaring them are found in the
+  // frames of its callers first and in the global environment last, the same
+  // order the evaluator walks its environments in.
+  Value lookupName(Symbol name, size_t callerFrame);
+  void assignName(Symbol name, Value value, size_t callerFrame);
+  Value *findInFrames(Symbol name, size_t callerFrame);
+
+  Value *enterFunction(const FnVal *fn, Value *callerRegisters, Value *args,
+                       uint32_t count, const Instruction *returnAddress,
+                       uint32_t returnRegister);
+
+  const CompiledProgram &program;
+  Environment *env;
+  // Allocated without constructing its values, every frame clears the
+  // registers it takes, so the pages above the deepest frame are never
+  // touched.
+  std::unique_ptr<Value, RawDelete> registerFile;
+  // Registers of every active frame, a root of the garbage collector. Its end
+  // is only brought up to date at safepoints.
+  RootSpan liveRegisters;
+  std::vector<Frame> frames;
+  std::vector<MemoCall> memoCalls;
+};
+
+#endif